@@ -23,13 +23,25 @@ struct AppArgs
     Glib::ustring indicatorIconName;
     Glib::ustring appVms;
     Glib::ustring isDeamonMode;
+    int dbusUpdatesFlushInterval = DBusService::DefaultUpdatesFlushInterval.count();
+    bool isDBusBatchedUpdatesEnabled = false;
+    Glib::ustring logLevel = "info";
+    Glib::ustring logOutput = "stderr";
+    std::string traceFile;
+    bool isBackendThreadEnabled = false;
+    bool isPeakMeteringEnabled = false;
+    std::string profilesFile;
+    Glib::ustring ignoredDevices;
+    Glib::ustring volumeCurve = "linear";
+    int maxStreamRows = 0;
+    Glib::ustring aggregatePeers;
 };
 
-std::vector<std::string> GetAppVmsList(const std::string& appVms)
+std::vector<std::string> GetCommaSeparatedList(const std::string& list)
 {
     std::vector<std::string> result;
 
-    std::istringstream iss(appVms);
+    std::istringstream iss(list);
     std::string buf;
 
     while (getline(iss, buf, ','))
@@ -38,6 +50,107 @@ std::vector<std::string> GetAppVmsList(const std::string& appVms)
     return result;
 }
 
+DBusService::DeviceInfo CreateDeviceInfo(const IAudioControlBackend::IDevice& device, IAudioControlBackend::EventType eventType,
+                                         IAudioControlBackend::Generation generation)
+{
+    const auto type = device.getType();
+    const auto state = device.getState();
+    const bool isHardwareDevice = type == IAudioControlBackend::IDevice::Type::Sink || type == IAudioControlBackend::IDevice::Type::Source;
+
+    return {.index = device.getIndex(),
+            .type = type,
+            .name = isHardwareDevice ? state->description : state->name,
+            .volume = state->volume,
+            .isMuted = state->isMuted,
+            .isDefault = isHardwareDevice && state->isDefault,
+            .eventType = eventType,
+            .generation = generation};
+}
+
+[[nodiscard]] bool IsStream(IAudioControlBackend::IDevice::Type type) noexcept
+{
+    return type == IAudioControlBackend::IDevice::Type::SinkInput || type == IAudioControlBackend::IDevice::Type::SourceOutput;
+}
+
+DBusService::StreamMetadata CreateStreamMetadata(const IAudioControlBackend::IDevice& device)
+{
+    return {.index = device.getIndex(), .type = device.getType(), .metadata = device.getState()->metadata};
+}
+
+// The streams of an AppVM, to be changed as a group
+std::vector<IAudioControlBackend::IDevice::Ptr> GetAppVmStreams(const IAudioControlBackend& backend, std::string_view appVmName)
+{
+    std::vector<IAudioControlBackend::IDevice::Ptr> streams;
+
+    for (auto& device : backend.getAllDevices())
+    {
+        if (device->getType() != IAudioControlBackend::IDevice::Type::SinkInput)
+            continue;
+
+        if (const auto& state = device->getState(); state && state->appVmName && *state->appVmName == appVmName)
+            streams.push_back(std::move(device));
+    }
+
+    return streams;
+}
+
+// The results of a group as one
+IAudioControlBackend::ResultsCallback ReportFirstFailure(IAudioControlBackend::ResultCallback onDone)
+{
+    return [onDone = std::move(onDone)](const std::vector<IAudioControlBackend::Result>& results)
+    {
+        const auto failure = std::ranges::find_if(results, [](auto result) { return result != IAudioControlBackend::Result::Ok; });
+        onDone(failure == results.end() ? IAudioControlBackend::Result::Ok : *failure);
+    };
+}
+
+void SetAppVmState(const std::weak_ptr<IAudioControlBackend>& weakBackend, const std::string& appVmName, std::optional<bool> mute,
+                   std::optional<Volume> volume, IAudioControlBackend::ResultCallback onDone)
+{
+    auto backend = weakBackend.lock();
+    if (!backend)
+    {
+        Logger::error("SetAppVmState: backend doesn't exist anymore");
+        onDone(IAudioControlBackend::Result::Failed);
+        return;
+    }
+
+    const auto streams = GetAppVmStreams(*backend, appVmName);
+    if (streams.empty())
+    {
+        onDone(IAudioControlBackend::Result::NoSuchDevice);
+        return;
+    }
+
+    backend->setDevicesState(IAudioControlBackend::MakeGroupRequests(streams, mute, volume), ReportFirstFailure(std::move(onDone)));
+}
+
+void MoveAppVm(const std::weak_ptr<IAudioControlBackend>& weakBackend, const std::string& appVmName, Index targetIndex,
+               IAudioControlBackend::ResultCallback onDone)
+{
+    auto backend = weakBackend.lock();
+    if (!backend)
+    {
+        Logger::error("MoveAppVm: backend doesn't exist anymore");
+        onDone(IAudioControlBackend::Result::Failed);
+        return;
+    }
+
+    const auto streams = GetAppVmStreams(*backend, appVmName);
+    if (streams.empty())
+    {
+        onDone(IAudioControlBackend::Result::NoSuchDevice);
+        return;
+    }
+
+    backend->moveDevices(IAudioControlBackend::MakeGroupMoveRequests(streams, targetIndex), ReportFirstFailure(std::move(onDone)));
+}
+
+bool IsOptionEnabled(const Glib::ustring& value)
+{
+    return value == "true" || value == "1" || value == "yes" || value == "on";
+}
+
 } // namespace
 
 App::AppMenu::AppMenu(App& app)
@@ -54,7 +167,6 @@ App::AppMenu::AppMenu(App& app)
 
 App::App(int argc, char** argv)
     : Gtk::Application("org.ghaf.AudioControl", Gio::APPLICATION_HANDLES_COMMAND_LINE)
-    , m_menu(*this)
     , m_connections{m_dbusService.openSignal().connect(sigc::mem_fun(*this, &App::openWindow)),
                     m_dbusService.toggleSignal().connect(sigc::mem_fun(*this, &App::toggleWindow))}
 {
@@ -62,7 +174,7 @@ App::App(int argc, char** argv)
 
     Glib::OptionEntry pulseServerOption;
     pulseServerOption.set_long_name("pulseaudio_server");
-    pulseServerOption.set_description("PulseAudio server address");
+    pulseServerOption.set_description("PulseAudio server address, or several comma separated ones");
 
     Glib::OptionEntry indicatorIconNameOption;
     indicatorIconNameOption.set_long_name("indicator_icon_name");
@@ -76,11 +188,72 @@ App::App(int argc, char** argv)
     deamonModeOption.set_long_name("deamon_mode");
     deamonModeOption.set_description("Deamon mode");
 
+    Glib::OptionEntry dbusUpdatesFlushIntervalOption;
+    dbusUpdatesFlushIntervalOption.set_long_name("dbus_updates_flush_interval");
+    dbusUpdatesFlushIntervalOption.set_description("Interval in milliseconds to coalesce the DeviceUpdated signals. 0 sends them on the next main loop iteration");
+
+    Glib::OptionEntry dbusBatchedUpdatesOption;
+    dbusBatchedUpdatesOption.set_long_name("dbus_batched_updates");
+    dbusBatchedUpdatesOption.set_description("Additionally send the DevicesUpdated signal with all the changes of a flush");
+
+    Glib::OptionEntry logLevelOption;
+    logLevelOption.set_long_name("log_level");
+    logLevelOption.set_description("The lowest level to log: debug, info or error");
+
+    Glib::OptionEntry logOutputOption;
+    logOutputOption.set_long_name("log_output");
+    logOutputOption.set_description("Where to write the logs: stderr or journald");
+
+    Glib::OptionEntry recordTraceOption;
+    recordTraceOption.set_long_name("record_trace");
+    recordTraceOption.set_description("Record the PulseAudio events and device payloads to the given file, to be replayed with GhafAudioControlBench");
+
+    Glib::OptionEntry backendThreadOption;
+    backendThreadOption.set_long_name("backend_thread");
+    backendThreadOption.set_description("Run the PulseAudio backend on a thread of its own, apart from the UI");
+
+    Glib::OptionEntry peakMetersOption;
+    peakMetersOption.set_long_name("peak_meters");
+    peakMetersOption.set_description("Show the peak levels of the sinks and the AppVM streams, and send them in the PeakLevels D-Bus signal");
+
+    Glib::OptionEntry profilesFileOption;
+    profilesFileOption.set_long_name("profiles_file");
+    profilesFileOption.set_description("Keep the volume and mute of the AppVM streams in the given file, and restore them as the streams come back");
+
+    Glib::OptionEntry ignoredDevicesOption;
+    ignoredDevicesOption.set_long_name("ignore_devices");
+    ignoredDevicesOption.set_description("Comma separated rules of the devices to ignore besides the monitor sources: [sink|source|sinkinput|sourceoutput:]"
+                                         "name|description|appvm|property.<key>=<pattern>, where '*' matches any characters");
+
+    Glib::OptionEntry volumeCurveOption;
+    volumeCurveOption.set_long_name("volume_curve");
+    volumeCurveOption.set_description("How the volume percents map to the volume of the devices with the dB volume: linear, cubic or db");
+
+    Glib::OptionEntry maxStreamRowsOption;
+    maxStreamRowsOption.set_long_name("max_stream_rows");
+    maxStreamRowsOption.set_description("Show at most this many rows of the AppVM streams, hiding the ones inactive for the longest. 0 shows all of them");
+
+    Glib::OptionEntry aggregatePeersOption;
+    aggregatePeersOption.set_long_name("aggregate_peers");
+    aggregatePeersOption.set_description("Comma separated D-Bus addresses of other instances of the service, to serve their devices along with the local ones");
+
     Glib::OptionGroup options("Main", "Main");
     options.add_entry(pulseServerOption, appArgs.pulseServerAddress);
     options.add_entry(indicatorIconNameOption, appArgs.indicatorIconName);
     options.add_entry(appVmsOption, appArgs.appVms);
     options.add_entry(deamonModeOption, appArgs.isDeamonMode);
+    options.add_entry(dbusUpdatesFlushIntervalOption, appArgs.dbusUpdatesFlushInterval);
+    options.add_entry(dbusBatchedUpdatesOption, appArgs.isDBusBatchedUpdatesEnabled);
+    options.add_entry(logLevelOption, appArgs.logLevel);
+    options.add_entry(logOutputOption, appArgs.logOutput);
+    options.add_entry_filename(recordTraceOption, appArgs.traceFile);
+    options.add_entry(backendThreadOption, appArgs.isBackendThreadEnabled);
+    options.add_entry(peakMetersOption, appArgs.isPeakMeteringEnabled);
+    options.add_entry_filename(profilesFileOption, appArgs.profilesFile);
+    options.add_entry(ignoredDevicesOption, appArgs.ignoredDevices);
+    options.add_entry(volumeCurveOption, appArgs.volumeCurve);
+    options.add_entry(maxStreamRowsOption, appArgs.maxStreamRows);
+    options.add_entry(aggregatePeersOption, appArgs.aggregatePeers);
 
     Glib::OptionContext context("Application Options");
     context.set_main_group(options);
@@ -91,10 +264,56 @@ App::App(int argc, char** argv)
         throw std::runtime_error{"Couldn't parse the command line arguments"};
     }
 
+    // Set up first, so the rest of the startup is logged as requested
+    if (const auto logOutput = Logger::outputFromString(appArgs.logOutput.raw()))
+        Logger::setOutput(*logOutput);
+    else
+        throw std::runtime_error{std::format("'{}' has an unsupported value: {}", logOutputOption.get_long_name().c_str(), appArgs.logOutput.c_str())};
+
+    if (const auto logLevel = Logger::logLevelFromString(appArgs.logLevel.raw()))
+        Logger::setLevel(*logLevel);
+    else
+        throw std::runtime_error{std::format("'{}' has an unsupported value: {}", logLevelOption.get_long_name().c_str(), appArgs.logLevel.c_str())};
+
     Logger::info("Parsed the option: '{}' = '{}'", pulseServerOption.get_long_name().c_str(), appArgs.pulseServerAddress.c_str());
     Logger::info("Parsed the option: '{}' = '{}'", indicatorIconNameOption.get_long_name().c_str(), appArgs.indicatorIconName.c_str());
     Logger::info("Parsed the option: '{}' = '{}'", appVmsOption.get_long_name().c_str(), appArgs.appVms.c_str());
     Logger::info("Parsed the option: '{}' = '{}'", deamonModeOption.get_long_name().c_str(), appArgs.isDeamonMode.c_str());
+    Logger::info("Parsed the option: '{}' = '{}'", dbusUpdatesFlushIntervalOption.get_long_name().c_str(), appArgs.dbusUpdatesFlushInterval);
+    Logger::info("Parsed the option: '{}' = '{}'", dbusBatchedUpdatesOption.get_long_name().c_str(), appArgs.isDBusBatchedUpdatesEnabled);
+    Logger::info("Parsed the option: '{}' = '{}'", logLevelOption.get_long_name().c_str(), appArgs.logLevel.c_str());
+    Logger::info("Parsed the option: '{}' = '{}'", logOutputOption.get_long_name().c_str(), appArgs.logOutput.c_str());
+    Logger::info("Parsed the option: '{}' = '{}'", recordTraceOption.get_long_name().c_str(), appArgs.traceFile);
+    Logger::info("Parsed the option: '{}' = '{}'", backendThreadOption.get_long_name().c_str(), appArgs.isBackendThreadEnabled);
+    Logger::info("Parsed the option: '{}' = '{}'", peakMetersOption.get_long_name().c_str(), appArgs.isPeakMeteringEnabled);
+    Logger::info("Parsed the option: '{}' = '{}'", profilesFileOption.get_long_name().c_str(), appArgs.profilesFile);
+    Logger::info("Parsed the option: '{}' = '{}'", ignoredDevicesOption.get_long_name().c_str(), appArgs.ignoredDevices.c_str());
+    Logger::info("Parsed the option: '{}' = '{}'", volumeCurveOption.get_long_name().c_str(), appArgs.volumeCurve.c_str());
+    Logger::info("Parsed the option: '{}' = '{}'", maxStreamRowsOption.get_long_name().c_str(), appArgs.maxStreamRows);
+    Logger::info("Parsed the option: '{}' = '{}'", aggregatePeersOption.get_long_name().c_str(), appArgs.aggregatePeers.c_str());
+
+    if (appArgs.dbusUpdatesFlushInterval < 0)
+        throw std::runtime_error{std::format("'{}' can't be negative", dbusUpdatesFlushIntervalOption.get_long_name().c_str())};
+
+    if (appArgs.maxStreamRows < 0)
+        throw std::runtime_error{std::format("'{}' can't be negative", maxStreamRowsOption.get_long_name().c_str())};
+
+    // Parsed up front, so a wrong rule stops the startup instead of the backend thread
+    auto deviceFilter = Backend::PulseAudio::DeviceFilter::CreateDefault();
+
+    for (const auto& rule : GetCommaSeparatedList(appArgs.ignoredDevices))
+        deviceFilter.addRule(Backend::PulseAudio::DeviceFilter::ParseRule(rule));
+
+    // Before the backend makes the first device
+    if (const auto volumeCurve = Backend::PulseAudio::VolumeCurveFromString(appArgs.volumeCurve.raw()))
+        Backend::PulseAudio::SetVolumeCurve(*volumeCurve);
+    else
+        throw std::runtime_error{std::format("'{}' has an unsupported value: {}", volumeCurveOption.get_long_name().c_str(), appArgs.volumeCurve.c_str())};
+
+    logStartupPhase("the options are parsed");
+
+    m_dbusService.setUpdatesFlushInterval(std::chrono::milliseconds{appArgs.dbusUpdatesFlushInterval});
+    m_dbusService.setBatchedUpdatesEnabled(appArgs.isDBusBatchedUpdatesEnabled);
 
     m_connections += signal_command_line().connect(
         [this]([[maybe_unused]] const Glib::RefPtr<Gio::ApplicationCommandLine>& args)
@@ -104,83 +323,301 @@ App::App(int argc, char** argv)
         },
         false);
 
-    m_indicator = createAppIndicator();
-    app_indicator_set_icon(m_indicator->get(), appArgs.indicatorIconName.c_str());
-
-    m_audioControl = std::make_unique<AudioControl>(std::make_unique<Backend::PulseAudio::AudioControlBackend>(appArgs.pulseServerAddress),
-                                                    GetAppVmsList(appArgs.appVms));
-
-    // if (!appArgs.indicatorIconName.empty())
-    // {
-    //     Glib::signal_idle().connect(
-    //         [this, iconName = appArgs.indicatorIconName]() -> bool
-    //         {
-    //             Logger::info("Setting up an indicator icon: {}", iconName.c_str());
-    //             m_dbusService.registerSystemTrayIcon(iconName);
-
-    //             return false;
-    //         });
-    // }
-    // else
-    // {
-    //     Logger::info("No indicator icon was specified");
-    // }
-
-    const auto onDevice = [this](IAudioControlBackend::OnSignalMapChangeSignalInfo info)
+    m_isDaemonMode = IsOptionEnabled(appArgs.isDeamonMode);
+    m_appVms = GetCommaSeparatedList(appArgs.appVms);
+    m_maxStreamRows = static_cast<size_t>(appArgs.maxStreamRows);
+
+    if (m_isDaemonMode)
+        Logger::info("Running in the daemon mode, the UI is created on the first Open or Toggle request");
+    else
     {
+        m_menu = std::make_unique<AppMenu>(*this);
+
+        m_indicator = createAppIndicator();
+        app_indicator_set_icon(m_indicator.get(), appArgs.indicatorIconName.c_str());
+    }
+
+    // The app indicator shows the icon of the UI mode. In the daemon mode the icon is a StatusNotifierItem of the service, which
+    // toggles the UI when activated. The registration doesn't wait for the tray host
+    if (m_isDaemonMode && !appArgs.indicatorIconName.empty())
+    {
+        Logger::info("Setting up a system tray icon: {}", appArgs.indicatorIconName.c_str());
+        m_dbusService.registerSystemTrayIcon(appArgs.indicatorIconName);
+    }
+
+    const auto onDevice = [this](const IAudioControlBackend::OnSignalMapChangeSignalInfo& info)
+    {
+        // The clients see the name, the volume, the mute and the default only
+        constexpr ChangeMask SentFields = DeviceField::Name | DeviceField::Volume | DeviceField::Mute | DeviceField::Default;
+
+        // Before the early return: a metadata change alone has no DeviceUpdated signal
+        if (info.ptr && IsStream(info.type) &&
+            (info.eventType == IAudioControlBackend::EventType::Add || info.changes.has(DeviceField::Metadata)))
+            m_dbusService.sendStreamMetadata(CreateStreamMetadata(*info.ptr));
+
+        // The steps of a ramp are not sent, the clients get the volume it ends with
+        constexpr ChangeMask SentRampStepFields = DeviceField::Name | DeviceField::Mute | DeviceField::Default;
+        const ChangeMask sentFields = info.changes.has(DeviceField::RampStep) ? SentRampStepFields : SentFields;
+
+        if (info.eventType == IAudioControlBackend::EventType::Update && !info.changes.intersects(sentFields))
+            return;
+
         if (info.ptr)
+            m_dbusService.sendDeviceInfo(CreateDeviceInfo(*info.ptr, info.eventType, info.generation));
+        else
+            m_dbusService.sendDeviceInfo({.index = info.index,
+                                          .type = info.type,
+                                          .name = InternedString{"Deleted"},
+                                          .volume = Volume::fromPercents(0U),
+                                          .isMuted = false,
+                                          .isDefault = false,
+                                          .eventType = IAudioControlBackend::EventType::Delete,
+                                          .generation = info.generation});
+    };
+
+    const auto createPulseBackend = [&appArgs, &deviceFilter](Glib::RefPtr<Glib::MainContext> mainContext)
+    {
+        auto pulseBackend = std::make_shared<Backend::PulseAudio::AudioControlBackend>(GetCommaSeparatedList(appArgs.pulseServerAddress), std::move(mainContext));
+        pulseBackend->setDeviceFilter(deviceFilter);
+
+        if (!appArgs.traceFile.empty())
         {
-            if (auto* defaultable = dynamic_cast<IAudioControlBackend::IDefaultable*>(info.ptr.get()))
-                m_dbusService.sendDeviceInfo(info.index,
-                                             info.type,
-                                             info.ptr->getDescription(),
-                                             info.ptr->getVolume(),
-                                             info.ptr->isMuted(),
-                                             defaultable->isDefault(),
-                                             info.eventType);
-            else
-                m_dbusService.sendDeviceInfo(info.index, info.type, info.ptr->getName(), info.ptr->getVolume(), info.ptr->isMuted(), false, info.eventType);
+            Logger::info("Recording a trace to: {}", appArgs.traceFile);
+            pulseBackend->setTraceRecorder(std::make_unique<Backend::PulseAudio::TraceRecorder>(appArgs.traceFile));
         }
-        else
-            m_dbusService.sendDeviceInfo(info.index, info.type, "Deleted", Volume::fromPercents(0U), false, false, IAudioControlBackend::EventType::Delete);
+
+        if (!appArgs.profilesFile.empty())
+            pulseBackend->setProfileStore(std::make_unique<Backend::PulseAudio::ProfileStore>(appArgs.profilesFile));
+
+        return pulseBackend;
     };
 
-    auto backend = std::make_shared<Backend::PulseAudio::AudioControlBackend>(appArgs.pulseServerAddress);
-    const std::weak_ptr weakBackend(backend);
+    if (appArgs.isBackendThreadEnabled)
+        m_backend = std::make_shared<Backend::ThreadedAudioControlBackend>(createPulseBackend);
+    else
+        m_backend = createPulseBackend(Glib::MainContext::get_default());
+
+    // The peers come before the control calls, which are routed to them by the device ids
+    if (const auto peers = GetCommaSeparatedList(appArgs.aggregatePeers); !peers.empty())
+    {
+        m_peers = std::make_unique<PeerAggregator>(peers);
+        m_connections += m_peers->onDeviceInfo().connect([this](DBusService::DeviceInfo info) { m_dbusService.sendDeviceInfo(std::move(info)); });
+    }
+
+    const std::weak_ptr weakBackend(m_backend);
 
     m_connections += m_dbusService.setDeviceVolumeSignal().connect(
-        [weakBackend](auto id, auto type, auto volume)
+        [this, weakBackend](auto id, auto type, auto volume, auto onDone)
         {
-            if (auto backend = weakBackend.lock())
-                backend->setDeviceVolume(id, type, volume);
+            if (m_peers && PeerAggregator::IsPeerDevice(id))
+                m_peers->setDeviceVolume(id, type, volume, std::move(onDone));
+            else if (auto backend = weakBackend.lock())
+                backend->setDeviceVolume(id, type, volume, std::move(onDone));
             else
+            {
                 Logger::error("m_dbusService.setDeviceVolumeSignal().connect: backend doesn't exist anymore");
+                onDone(IAudioControlBackend::Result::Failed);
+            }
+        });
+
+    m_connections += m_dbusService.adjustDeviceVolumeSignal().connect(
+        [this, weakBackend](auto id, auto type, auto delta, auto onDone)
+        {
+            if (m_peers && PeerAggregator::IsPeerDevice(id))
+                m_peers->adjustDeviceVolume(id, type, delta, std::move(onDone));
+            else if (auto backend = weakBackend.lock())
+                backend->adjustDeviceVolume(id, type, delta, std::move(onDone));
+            else
+            {
+                Logger::error("m_dbusService.adjustDeviceVolumeSignal().connect: backend doesn't exist anymore");
+                onDone(IAudioControlBackend::Result::Failed);
+            }
+        });
+
+    m_connections += m_dbusService.rampDeviceVolumeSignal().connect(
+        [this, weakBackend](auto id, auto type, auto volume, auto duration, auto onDone)
+        {
+            if (m_peers && PeerAggregator::IsPeerDevice(id))
+                m_peers->rampDeviceVolume(id, type, volume, duration, std::move(onDone));
+            else if (auto backend = weakBackend.lock())
+                backend->rampDeviceVolume(id, type, volume, duration, std::move(onDone));
+            else
+            {
+                Logger::error("m_dbusService.rampDeviceVolumeSignal().connect: backend doesn't exist anymore");
+                onDone(IAudioControlBackend::Result::Failed);
+            }
         });
 
     m_connections += m_dbusService.setDeviceMuteSignal().connect(
-        [weakBackend](auto id, auto type, auto volume)
+        [this, weakBackend](auto id, auto type, auto mute, auto onDone)
         {
-            if (auto backend = weakBackend.lock())
-                backend->setDeviceMute(id, type, volume);
+            if (m_peers && PeerAggregator::IsPeerDevice(id))
+                m_peers->setDeviceMute(id, type, mute, std::move(onDone));
+            else if (auto backend = weakBackend.lock())
+                backend->setDeviceMute(id, type, mute, std::move(onDone));
             else
+            {
                 Logger::error("m_dbusService.setDeviceMuteSignal().connect: backend doesn't exist anymore");
+                onDone(IAudioControlBackend::Result::Failed);
+            }
         });
 
     m_connections += m_dbusService.makeDeviceDefaultSignal().connect(
-        [weakBackend](auto id, auto type)
+        [this, weakBackend](auto id, auto type, auto onDone)
         {
-            if (auto backend = weakBackend.lock())
-                backend->makeDeviceDefault(id, type);
+            if (m_peers && PeerAggregator::IsPeerDevice(id))
+                m_peers->makeDeviceDefault(id, type, std::move(onDone));
+            else if (auto backend = weakBackend.lock())
+                backend->makeDeviceDefault(id, type, std::move(onDone));
             else
-                Logger::error("m_dbusService.setDeviceMuteSignal().connect: backend doesn't exist anymore");
+            {
+                Logger::error("m_dbusService.makeDeviceDefaultSignal().connect: backend doesn't exist anymore");
+                onDone(IAudioControlBackend::Result::Failed);
+            }
+        });
+
+    const auto setLocalDevicesState = [weakBackend](const std::vector<IAudioControlBackend::DeviceStateRequest>& requests,
+                                                    IAudioControlBackend::ResultsCallback onDone)
+    {
+        if (auto backend = weakBackend.lock())
+            backend->setDevicesState(requests, std::move(onDone));
+        else
+        {
+            Logger::error("m_dbusService.setDevicesStateSignal().connect: backend doesn't exist anymore");
+            onDone(std::vector<IAudioControlBackend::Result>(requests.size(), IAudioControlBackend::Result::Failed));
+        }
+    };
+
+    m_connections += m_dbusService.setDevicesStateSignal().connect(
+        [this, setLocalDevicesState](const auto& requests, auto onDone)
+        {
+            if (m_peers)
+                m_peers->setDevicesState(requests, setLocalDevicesState, std::move(onDone));
+            else
+                setLocalDevicesState(requests, std::move(onDone));
+        });
+
+    m_connections += m_dbusService.setAppVmVolumeSignal().connect(
+        [this, weakBackend](const auto& appVmName, auto volume, auto onDone)
+        {
+            const auto setLocal = [weakBackend, appVmName, volume](auto onLocalDone)
+            { SetAppVmState(weakBackend, appVmName, std::nullopt, volume, std::move(onLocalDone)); };
+
+            if (m_peers)
+                m_peers->setAppVmVolume(appVmName, volume, setLocal, std::move(onDone));
+            else
+                setLocal(std::move(onDone));
+        });
+
+    m_connections += m_dbusService.setAppVmMuteSignal().connect(
+        [this, weakBackend](const auto& appVmName, auto mute, auto onDone)
+        {
+            const auto setLocal = [weakBackend, appVmName, mute](auto onLocalDone)
+            { SetAppVmState(weakBackend, appVmName, mute, std::nullopt, std::move(onLocalDone)); };
+
+            if (m_peers)
+                m_peers->setAppVmMute(appVmName, mute, setLocal, std::move(onDone));
+            else
+                setLocal(std::move(onDone));
+        });
+
+    m_connections += m_dbusService.moveDeviceSignal().connect(
+        [this, weakBackend](auto id, auto type, auto target, auto onDone)
+        {
+            if (m_peers && PeerAggregator::IsPeerDevice(id))
+                m_peers->moveDevice(id, type, target, std::move(onDone));
+            else if (auto backend = weakBackend.lock())
+                backend->moveDevice(id, type, target, std::move(onDone));
+            else
+            {
+                Logger::error("m_dbusService.moveDeviceSignal().connect: backend doesn't exist anymore");
+                onDone(IAudioControlBackend::Result::Failed);
+            }
+        });
+
+    m_connections += m_dbusService.moveAppVmSignal().connect(
+        [this, weakBackend](const auto& appVmName, auto target, auto onDone)
+        {
+            const auto moveLocal = [weakBackend, appVmName, target](auto onLocalDone) { MoveAppVm(weakBackend, appVmName, target, std::move(onLocalDone)); };
+
+            if (m_peers)
+                m_peers->moveAppVm(appVmName, target, moveLocal, std::move(onDone));
+            else
+                moveLocal(std::move(onDone));
         });
 
-    m_connections += backend->onSinksChanged().connect(onDevice);
-    m_connections += backend->onSourcesChanged().connect(onDevice);
-    m_connections += backend->onSinkInputsChanged().connect(onDevice);
-    m_connections += backend->onSourceOutputsChanged().connect(onDevice);
+    m_connections += m_dbusService.getAllDevicesSignal().connect(
+        [this, weakBackend]() -> DBusService::DevicesSnapshot
+        {
+            auto backend = weakBackend.lock();
+            if (!backend)
+            {
+                Logger::error("m_dbusService.getAllDevicesSignal().connect: backend doesn't exist anymore");
+                return {};
+            }
+
+            DBusService::DevicesSnapshot snapshot{.generation = backend->getGeneration(), .devices = {}};
+
+            const auto devices = backend->getAllDevices();
+            snapshot.devices.reserve(devices.size());
+
+            for (const auto& device : devices)
+                snapshot.devices.push_back(CreateDeviceInfo(*device, IAudioControlBackend::EventType::Add, snapshot.generation));
+
+            if (m_peers)
+            {
+                const auto peerDevices = m_peers->getDevices();
+                snapshot.devices.insert(snapshot.devices.end(), peerDevices.begin(), peerDevices.end());
+            }
+
+            return snapshot;
+        });
 
-    m_audioControl = std::make_unique<AudioControl>(std::move(backend), GetAppVmsList(appArgs.appVms));
+    m_connections += m_dbusService.getStreamsMetadataSignal().connect(
+        [weakBackend]() -> std::vector<DBusService::StreamMetadata>
+        {
+            auto backend = weakBackend.lock();
+            if (!backend)
+            {
+                Logger::error("m_dbusService.getStreamsMetadataSignal().connect: backend doesn't exist anymore");
+                return {};
+            }
+
+            std::vector<DBusService::StreamMetadata> streams;
+
+            for (const auto& device : backend->getAllDevices())
+            {
+                if (IsStream(device->getType()))
+                    streams.push_back(CreateStreamMetadata(*device));
+            }
+
+            return streams;
+        });
+
+    m_connections += m_backend->onDevicesChanged().connect(onDevice);
+
+    m_connections += m_backend->onPeaks().connect([this](const auto& levels) { m_dbusService.sendPeakLevels(levels); });
+    m_backend->setPeakMeteringEnabled(appArgs.isPeakMeteringEnabled);
+
+    m_connections += m_backend->onStateChange().connect(
+        [this](IAudioControlBackend::State state)
+        {
+            if (state == IAudioControlBackend::State::Connected)
+                logStartupPhase("PulseAudio is ready");
+            else if (state == IAudioControlBackend::State::Synchronized)
+                logStartupPhase("all the devices are listed");
+        });
+
+    // The window, the D-Bus service and the peers share the backend, so it is stopped here and not by one of them
+    m_connections += m_backend->onError().connect(
+        [this](const std::string& error)
+        {
+            Logger::error("App: the audio backend has failed, stopping it: {}", error);
+            m_backend->stop();
+        });
+
+    // Start only when all the consumers are connected, so none of them misses the initial devices
+    m_backend->start();
 }
 
 int App::start()
@@ -240,6 +677,10 @@ void App::on_activate()
 {
     Logger::debug(__PRETTY_FUNCTION__);
 
+    // Created on demand, picking up the devices the backend already has
+    if (!m_audioControl)
+        m_audioControl = std::make_unique<AudioControl>(m_backend, m_appVms, m_maxStreamRows);
+
     m_window = std::make_unique<Gtk::ApplicationWindow>();
     m_window->set_title(AppId);
     m_window->add(*m_audioControl);
@@ -251,18 +692,24 @@ void App::on_activate()
 
     m_window->show();
     m_audioControl->show();
+
+    logStartupPhase("the window is ready");
 }
 
-RaiiWrap<AppIndicator*> App::createAppIndicator()
+void App::logStartupPhase(std::string_view phase) const
 {
-    const auto contructor = [this](AppIndicator*& indicator)
-    {
-        indicator = app_indicator_new(AppId, "", APP_INDICATOR_CATEGORY_APPLICATION_STATUS);
-        app_indicator_set_status(indicator, APP_INDICATOR_STATUS_ACTIVE);
-        app_indicator_set_label(indicator, AppId, AppId);
-        app_indicator_set_title(indicator, AppId);
-        app_indicator_set_menu(indicator, GTK_MENU(m_menu.gobj()));
-    };
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_startTime);
+    Logger::info("Startup: {} in {} ms", phase, elapsed.count());
+}
+
+App::AppIndicatorHandle App::createAppIndicator()
+{
+    AppIndicatorHandle indicator{app_indicator_new(AppId, "", APP_INDICATOR_CATEGORY_APPLICATION_STATUS)};
+
+    app_indicator_set_status(indicator.get(), APP_INDICATOR_STATUS_ACTIVE);
+    app_indicator_set_label(indicator.get(), AppId, AppId);
+    app_indicator_set_title(indicator.get(), AppId);
+    app_indicator_set_menu(indicator.get(), GTK_MENU(m_menu->gobj()));
 
-    return {contructor, {}};
+    return indicator;
 }
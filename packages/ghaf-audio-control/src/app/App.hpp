@@ -6,17 +6,22 @@
 #pragma once
 
 #include <GhafAudioControl/Backends/PulseAudio/AudioControlBackend.hpp>
+#include <GhafAudioControl/Backends/ThreadedAudioControlBackend.hpp>
 #include <GhafAudioControl/utils/Debug.hpp>
 #include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/UniqueHandle.hpp>
 #include <GhafAudioControl/widgets/AudioControl.hpp>
 
 #include "DBusService.hpp"
+#include "PeerAggregator.hpp"
 
 #include <gtkmm/application.h>
 #include <gtkmm/applicationwindow.h>
 
 #include <libayatana-appindicator/app-indicator.h>
 
+#include <chrono>
+
 class App : public Gtk::Application
 {
 private:
@@ -40,7 +45,9 @@ public:
 
     int start();
 
-    [[nodiscard]] ghaf::AudioControl::RaiiWrap<AppIndicator*> createAppIndicator();
+    using AppIndicatorHandle = ghaf::AudioControl::UniqueHandle<AppIndicator, ghaf::AudioControl::FunctionDeleter<g_object_unref>>;
+
+    [[nodiscard]] AppIndicatorHandle createAppIndicator();
 
     void openWindow();
     void toggleWindow();
@@ -51,14 +58,26 @@ private:
 
     void on_activate() override;
 
+    void logStartupPhase(std::string_view phase) const;
+
 private:
+    const std::chrono::steady_clock::time_point m_startTime = std::chrono::steady_clock::now();
+
     DBusService m_dbusService;
+    std::unique_ptr<PeerAggregator> m_peers; // After the service, so no peer device comes to it once it is gone
+
+    std::shared_ptr<ghaf::AudioControl::IAudioControlBackend> m_backend;
+
+    // The UI is created when the window is requested for the first time. In the daemon mode there is no tray menu either
+    bool m_isDaemonMode = false;
+    std::vector<std::string> m_appVms;
+    size_t m_maxStreamRows = 0;
 
     std::unique_ptr<ghaf::AudioControl::AudioControl> m_audioControl;
     std::unique_ptr<Gtk::ApplicationWindow> m_window;
 
-    AppMenu m_menu;
-    std::optional<ghaf::AudioControl::RaiiWrap<AppIndicator*>> m_indicator;
+    std::unique_ptr<AppMenu> m_menu;
+    AppIndicatorHandle m_indicator; // After the menu, so it goes away first
 
     ghaf::AudioControl::ConnectionContainer m_connections;
 };
@@ -6,11 +6,22 @@
 #include "DBusService.hpp"
 
 #include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
 
+#include <giomm/cancellable.h>
 #include <giomm/dbuserror.h>
 #include <giomm/dbusownname.h>
+#include <giomm/dbuswatchname.h>
 
+#include <glibmm/main.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ranges>
 #include <set>
+#include <tuple>
+#include <utility>
 
 using namespace ghaf::AudioControl;
 
@@ -28,6 +39,9 @@ constexpr auto RegisterStatusNotifierMethodName = "RegisterStatusNotifierItem";
 
 constexpr auto NewIconSignalName = "NewIcon";
 
+// A tray host that doesn't answer in time gets the icon the next time its watcher appears
+constexpr int RegisterTimeoutMsec = 5000;
+
 } // namespace SystemTrayWatcher
 
 namespace StatusNotifierItem
@@ -61,16 +75,32 @@ constexpr auto SubscribeToDeviceUpdatedSignal = "SubscribeToDeviceUpdatedSignal"
 constexpr auto UnsubscribeFromDeviceUpdatedSignal = "UnsubscribeFromDeviceUpdatedSignal";
 
 constexpr auto SetDeviceVolume = "SetDeviceVolume";
+constexpr auto AdjustDeviceVolume = "AdjustDeviceVolume";
+constexpr auto RampDeviceVolume = "RampDeviceVolume";
 constexpr auto SetDeviceMute = "SetDeviceMute";
 
 constexpr auto MakeDeviceDefault = "MakeDeviceDefault";
 
+constexpr auto SetDevicesState = "SetDevicesState";
+constexpr auto SetAppVmVolume = "SetAppVmVolume";
+constexpr auto SetAppVmMute = "SetAppVmMute";
+
+constexpr auto MoveDevice = "MoveDevice";
+constexpr auto MoveAppVm = "MoveAppVm";
+constexpr auto GetAllDevices = "GetAllDevices";
+constexpr auto GetStreamsMetadata = "GetStreamsMetadata";
+
+constexpr auto GetStats = "GetStats";
+
 } // namespace MethodName
 
 namespace SignalName
 {
 
 constexpr auto DeviceUpdated = "DeviceUpdated";
+constexpr auto DevicesUpdated = "DevicesUpdated";
+constexpr auto PeakLevels = "PeakLevels";
+constexpr auto StreamMetadataUpdated = "StreamMetadataUpdated";
 
 }
 
@@ -95,9 +125,32 @@ constexpr auto IntrospectionXml = R"xml(
                     - 0: Add
                     - 1: Update
                     - 2: Delete
+
+                Enum: Result
+                Values:
+                    - 0: OK
+                    - 1: No such device
+                    - 2: Invalid argument
+                    - 3: Failed
+
+                The methods returning a Result reply once the audio server has applied the change or rejected it
+
+                With the peers aggregated, their devices have negative ids, the ones of this instance are never negative.
+                The calls for them go to their instances, and a stream moves only to a device of its own instance
             -->
 
-            <method name='UnsubscribeFromDeviceUpdatedSignal' />
+            <!--
+                Returns the changes made after the given generation. If they are not available anymore,
+                or the generation is 0, returns the snapshot of all the devices with the Add event instead
+            -->
+            <method name='SubscribeToDeviceUpdatedSignal'>
+                <arg name='since' type='t' direction='in' />
+
+                <arg name='generation' type='t' direction='out' />
+                <arg name='isSnapshot' type='b' direction='out' />
+                <arg name='devices' type='a(iisibbit)' direction='out' /> <!-- Array of the DeviceUpdated arguments -->
+            </method>
+
             <method name='UnsubscribeFromDeviceUpdatedSignal' />
 
             <method name='SetDeviceVolume'>
@@ -105,7 +158,29 @@ constexpr auto IntrospectionXml = R"xml(
                 <arg name='type' type='i' direction='in' />         <!-- See DeviceType enum -->
                 <arg name='volume' type='i' direction='in' />       <!-- min: 0, max: 100 -->
 
-                <arg name='result' type='i' direction='out' />      <!-- result 0 is OK, Error otherwise -->
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum -->
+            </method>
+
+            <!-- Changes all the channels of the device at once, keeping the balance between them -->
+            <method name='AdjustDeviceVolume'>
+                <arg name='id' type='i' direction='in' />
+                <arg name='type' type='i' direction='in' />         <!-- See DeviceType enum -->
+                <arg name='delta' type='i' direction='in' />        <!-- min: -100, max: 100 -->
+
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum -->
+            </method>
+
+            <!--
+                Moves the volume to the target over the duration. The DeviceUpdated signals skip the steps,
+                and the result is of the last one. Another change of the device volume replaces the ramp, which fails
+            -->
+            <method name='RampDeviceVolume'>
+                <arg name='id' type='i' direction='in' />
+                <arg name='type' type='i' direction='in' />         <!-- See DeviceType enum -->
+                <arg name='volume' type='i' direction='in' />       <!-- min: 0, max: 100 -->
+                <arg name='duration_ms' type='i' direction='in' />  <!-- min: 0, max: 60000 -->
+
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum -->
             </method>
 
             <method name='SetDeviceMute'>
@@ -113,14 +188,81 @@ constexpr auto IntrospectionXml = R"xml(
                 <arg name='type' type='i' direction='in' />         <!-- See DeviceType enum -->
                 <arg name='mute' type='b' direction='in' />
 
-                <arg name='result' type='i' direction='out' />      <!-- result 0 is OK, Error otherwise -->
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum -->
             </method>
 
             <method name='MakeDeviceDefault'>
                 <arg name='id' type='i' direction='in' />
                 <arg name='type' type='i' direction='in' />         <!-- See DeviceType enum. Only a Sink or a Source -->
 
-                <arg name='result' type='i' direction='out' />      <!-- result 0 is OK, Error otherwise -->
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum -->
+            </method>
+
+            <method name='SetDevicesState'>
+                <!--
+                    Array of (id, type, mute, volume):
+                        - type: see DeviceType enum
+                        - mute: 0 is unmute, 1 is mute, -1 is unchanged
+                        - volume: min: 0, max: 100, -1 is unchanged
+                -->
+                <arg name='devices' type='a(iiii)' direction='in' />
+
+                <arg name='results' type='ai' direction='out' />    <!-- Result per device, in the same order. See Result enum -->
+            </method>
+
+            <!-- Sets all the streams of the AppVM at once. The result is the first failure, if any -->
+            <method name='SetAppVmVolume'>
+                <arg name='name' type='s' direction='in' />
+                <arg name='volume' type='i' direction='in' />       <!-- min: 0, max: 100 -->
+
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum. NoSuchDevice when the AppVM has no streams -->
+            </method>
+
+            <method name='SetAppVmMute'>
+                <arg name='name' type='s' direction='in' />
+                <arg name='mute' type='b' direction='in' />
+
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum. NoSuchDevice when the AppVM has no streams -->
+            </method>
+
+            <!-- A SinkInput to a Sink, or a SourceOutput to a Source -->
+            <method name='MoveDevice'>
+                <arg name='id' type='i' direction='in' />
+                <arg name='type' type='i' direction='in' />         <!-- See DeviceType enum. Only a SinkInput or a SourceOutput -->
+                <arg name='target' type='i' direction='in' />       <!-- The id of the Sink or of the Source -->
+
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum -->
+            </method>
+
+            <!-- Moves all the streams of the AppVM to the sink at once. The result is the first failure, if any -->
+            <method name='MoveAppVm'>
+                <arg name='name' type='s' direction='in' />
+                <arg name='target' type='i' direction='in' />       <!-- The id of the Sink -->
+
+                <arg name='result' type='i' direction='out' />      <!-- See Result enum. NoSuchDevice when the AppVM has no streams -->
+            </method>
+
+            <!--
+                Every change bumps the generation. Signals with a generation not greater than the one of
+                the snapshot are already reflected in it, and can be ignored
+            -->
+            <method name='GetAllDevices'>
+                <arg name='generation' type='t' direction='out' />
+                <arg name='devices' type='a(iisibbit)' direction='out' /> <!-- Array of the DeviceUpdated arguments, with the Add event -->
+            </method>
+
+            <!--
+                The proplist metadata of the streams, so the clients don't have to ask PulseAudio. The keys are
+                application.name, application.icon_name, media.role and application.process.binary, those the stream has
+            -->
+            <method name='GetStreamsMetadata'>
+                <arg name='streams' type='a(iia{ss})' direction='out' /> <!-- Array of the StreamMetadataUpdated arguments -->
+            </method>
+
+            <!-- Counters, gauges and latency histograms of the service, since its start -->
+            <method name='GetStats'>
+                <arg name='counters' type='a{st}' direction='out' />  <!-- The counters and gauges by their Prometheus names, with the labels -->
+                <arg name='text' type='s' direction='out' />          <!-- All the metrics in Prometheus text format. The latencies are in microseconds -->
             </method>
 
             <signal name='DeviceUpdated'>
@@ -131,6 +273,24 @@ constexpr auto IntrospectionXml = R"xml(
                 <arg name='isMuted' type='b' />
                 <arg name='isDefault' type='b' />                    <!-- Makes sense only for a Sink and a Source -->
                 <arg name='event' type='i' />                        <!-- See EventType enum -->
+                <arg name='generation' type='t' />
+            </signal>
+
+            <!-- Sent only if enabled. Carries all the DeviceUpdated changes of one flush -->
+            <signal name='DevicesUpdated'>
+                <arg name='devices' type='a(iisibbit)' />            <!-- Array of the DeviceUpdated arguments -->
+            </signal>
+
+            <!-- Sent only if the peak meters are enabled, a few times per second at most, with the changed levels only -->
+            <signal name='PeakLevels'>
+                <arg name='levels' type='a(iid)' />                  <!-- Array of (id, type, peak). See DeviceType enum. Peak: min: 0.0, max: 1.0 -->
+            </signal>
+
+            <!-- Sent as a stream is added and as its metadata changes, right away: it may come before the DeviceUpdated signal of the stream -->
+            <signal name='StreamMetadataUpdated'>
+                <arg name='id' type='i' />
+                <arg name='type' type='i' />                         <!-- See DeviceType enum. Only a SinkInput or a SourceOutput -->
+                <arg name='metadata' type='a{ss}' />                 <!-- See GetStreamsMetadata -->
             </signal>
         </interface>
 
@@ -174,16 +334,223 @@ int DeviceTypeToInt(DBusService::DeviceType type)
     return static_cast<int>(type);
 }
 
+auto CreateDeviceInfoTuple(const DBusService::DeviceInfo& info)
+{
+    return std::make_tuple(static_cast<int>(info.index),
+                           DeviceTypeToInt(info.type),
+                           Glib::ustring(info.name.str()),
+                           static_cast<int>(info.volume.getPercents()),
+                           info.isMuted,
+                           info.isDefault,
+                           static_cast<int>(info.eventType),
+                           static_cast<guint64>(info.generation));
+}
+
+using DeviceInfoTuple = decltype(CreateDeviceInfoTuple(std::declval<DBusService::DeviceInfo>()));
+
+template<std::ranges::input_range RangeT>
+auto CreateDevicesVariant(const RangeT& infos)
+{
+    std::vector<DeviceInfoTuple> devices;
+
+    if constexpr (std::ranges::sized_range<RangeT>)
+        devices.reserve(std::ranges::size(infos));
+
+    for (const DBusService::DeviceInfo& info : infos)
+        devices.push_back(CreateDeviceInfoTuple(info));
+
+    return Glib::Variant<std::vector<DeviceInfoTuple>>::create(devices);
+}
+
+auto CreateStreamMetadataTuple(const DBusService::StreamMetadata& stream)
+{
+    std::map<Glib::ustring, Glib::ustring> metadata;
+
+    const auto add = [&metadata](const char* key, const ghaf::AudioControl::InternedString& value)
+    {
+        if (!value.str().empty())
+            metadata.emplace(key, Glib::ustring(value.str()));
+    };
+
+    add("application.name", stream.metadata.applicationName);
+    add("application.icon_name", stream.metadata.iconName);
+    add("media.role", stream.metadata.mediaRole);
+    add("application.process.binary", stream.metadata.processBinary);
+
+    return std::make_tuple(static_cast<int>(stream.index), DeviceTypeToInt(stream.type), std::move(metadata));
+}
+
 auto CreateEmptyResponse()
 {
     return Glib::VariantContainerBase::create_tuple(std::vector<Glib::VariantBase>{});
 };
 
-auto CreateResultOkResponse()
+auto CreateResultResponse(DBusService::Result result)
+{
+    return Glib::VariantContainerBase::create_tuple(Glib::Variant<int>::create(static_cast<int>(result)));
+};
+
+DBusService::ResultCallback CreateResultCallback(DBusService::MethodReply reply)
+{
+    return [reply = std::move(reply)](DBusService::Result result)
+    {
+        reply(CreateResultResponse(result));
+    };
+}
+
+void RecordMethodLatency(LatencyHistogram& histogram, std::chrono::steady_clock::time_point startTime)
+{
+    histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime));
+}
+
+// The signals are a fixed set, so their counters are resolved once
+Metrics::Counter& GetSignalsEmittedCounter(std::string_view signalName)
+{
+    const auto get = [](std::string_view name) -> Metrics::Counter&
+    {
+        return Metrics::GetCounter(std::format("dbus_signals_emitted_total{{signal=\"{}\"}}", name));
+    };
+
+    static Metrics::Counter& deviceUpdated = get(AudioControlService::SignalName::DeviceUpdated);
+    static Metrics::Counter& devicesUpdated = get(AudioControlService::SignalName::DevicesUpdated);
+    static Metrics::Counter& peakLevels = get(AudioControlService::SignalName::PeakLevels);
+    static Metrics::Counter& streamMetadataUpdated = get(AudioControlService::SignalName::StreamMetadataUpdated);
+
+    if (signalName == AudioControlService::SignalName::DeviceUpdated)
+        return deviceUpdated;
+    if (signalName == AudioControlService::SignalName::DevicesUpdated)
+        return devicesUpdated;
+    if (signalName == AudioControlService::SignalName::PeakLevels)
+        return peakLevels;
+    if (signalName == AudioControlService::SignalName::StreamMetadataUpdated)
+        return streamMetadataUpdated;
+
+    return get(signalName);
+}
+
+// Replies to a method call exactly once. If no one has replied when the last copy is gone, e.g. the operation has been dropped, the client gets an error
+class PendingReply final
+{
+public:
+    PendingReply(Glib::RefPtr<Gio::DBus::MethodInvocation> invocation, LatencyHistogram& latencyHistogram, std::chrono::steady_clock::time_point startTime)
+        : m_invocation(std::move(invocation))
+        , m_latencyHistogram(latencyHistogram)
+        , m_startTime(startTime)
+    {
+    }
+
+    PendingReply(const PendingReply&) = delete;
+    PendingReply& operator=(const PendingReply&) = delete;
+
+    ~PendingReply()
+    {
+        fail("The operation has been dropped");
+    }
+
+    void reply(const DBusService::MethodResult& result)
+    {
+        if (auto invocation = std::exchange(m_invocation, {}))
+        {
+            invocation->return_value(result);
+            RecordMethodLatency(m_latencyHistogram, m_startTime);
+        }
+    }
+
+    void fail(const std::string& message)
+    {
+        if (auto invocation = std::exchange(m_invocation, {}))
+        {
+            invocation->return_error(Gio::DBus::Error(Gio::DBus::Error::FAILED, message));
+            RecordMethodLatency(m_latencyHistogram, m_startTime);
+        }
+    }
+
+private:
+    Glib::RefPtr<Gio::DBus::MethodInvocation> m_invocation;
+    LatencyHistogram& m_latencyHistogram;
+    std::chrono::steady_clock::time_point m_startTime;
+};
+
+template<class HandlerT>
+void CallDeferredMethod(HandlerT&& handler, LatencyHistogram& latencyHistogram, std::chrono::steady_clock::time_point startTime,
+                        const DBusService::MethodParameters& parameters, const Glib::RefPtr<Gio::DBus::MethodInvocation>& invocation)
 {
-    return Glib::VariantContainerBase::create_tuple(Glib::Variant<int>::create(0));
+    const auto pending = std::make_shared<PendingReply>(invocation, latencyHistogram, startTime);
+
+    try
+    {
+        handler(parameters,
+                [pending](const DBusService::MethodResult& result)
+                {
+                    pending->reply(result);
+                });
+    }
+    catch (const std::exception& ex)
+    {
+        Logger::error(ex.what());
+        pending->fail(ex.what());
+    }
+}
+
+// FNV-1a, seeded, so the method names can be spread over the slots without collisions
+[[nodiscard]] constexpr uint32_t HashMethodName(std::string_view name, uint32_t seed) noexcept
+{
+    uint32_t hash = 2166136261U ^ seed;
+
+    for (const char value : name)
+    {
+        hash ^= static_cast<unsigned char>(value);
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+// A perfect hash of the method names: every name has a slot of its own, so a lookup is a hash and a comparison
+template<size_t SlotCount>
+struct MethodSlots
+{
+    static constexpr uint8_t Empty = 0xFF;
+
+    uint32_t seed = 0;
+    std::array<uint8_t, SlotCount> slots{};
+
+    [[nodiscard]] constexpr size_t getSlot(std::string_view name) const noexcept
+    {
+        return HashMethodName(name, seed) % SlotCount;
+    }
 };
 
+constexpr uint32_t MaxMethodSlotsSeed = 4096;
+
+// Takes the first seed putting no two names into the same slot. MaxMethodSlotsSeed if there is none, then more slots are needed
+template<size_t SlotCount, class MethodsT>
+[[nodiscard]] constexpr MethodSlots<SlotCount> BuildMethodSlots(const MethodsT& methods) noexcept
+{
+    static_assert(std::tuple_size_v<MethodsT> < MethodSlots<SlotCount>::Empty);
+
+    for (uint32_t seed = 0; seed < MaxMethodSlotsSeed; ++seed)
+    {
+        MethodSlots<SlotCount> table{.seed = seed, .slots = {}};
+        table.slots.fill(MethodSlots<SlotCount>::Empty);
+
+        bool isPerfect = true;
+
+        for (size_t i = 0; i < std::size(methods) && isPerfect; ++i)
+        {
+            uint8_t& slot = table.slots[table.getSlot(methods[i].name)];
+
+            isPerfect = slot == MethodSlots<SlotCount>::Empty;
+            slot = static_cast<uint8_t>(i);
+        }
+
+        if (isPerfect)
+            return table;
+    }
+
+    return {.seed = MaxMethodSlotsSeed, .slots = {}};
+}
+
 } // namespace
 
 DBusService::DBusService()
@@ -193,86 +560,259 @@ DBusService::DBusService()
     , m_connectionId(Gio::DBus::own_name(Gio::DBus::BUS_TYPE_SESSION, AudioControlService::InterfaceName, sigc::mem_fun(*this, &DBusService::onBusAcquired),
                                          sigc::mem_fun(*this, &DBusService::onNameAcquired), sigc::mem_fun(*this, &DBusService::onNameLost)))
 {
-    m_audioControlServiceMethodHandlers = {
-        {AudioControlService::MethodName::Open, sigc::mem_fun(*this, &DBusService::onOpenMethod)},
-        {AudioControlService::MethodName::Toggle, sigc::mem_fun(*this, &DBusService::onToggleMethod)},
+}
 
-        {AudioControlService::MethodName::SubscribeToDeviceUpdatedSignal, sigc::mem_fun(*this, &DBusService::onSubscribeToDeviceUpdatedSignalMethod)},
-        {AudioControlService::MethodName::UnsubscribeFromDeviceUpdatedSignal, sigc::mem_fun(*this, &DBusService::onUnsubscribeFromDeviceUpdatedSignalMethod)},
+DBusService::~DBusService()
+{
+    m_pendingDeviceInfoFlush.disconnect();
+    m_bulkCallsDrain.disconnect();
 
-        {AudioControlService::MethodName::SetDeviceVolume, sigc::mem_fun(*this, &DBusService::onSetDeviceVolumeMethod)},
-        {AudioControlService::MethodName::SetDeviceMute, sigc::mem_fun(*this, &DBusService::onSetDeviceMuteMethod)},
+    for (const auto& call : m_bulkCalls)
+        call.invocation->return_error(Gio::DBus::Error(Gio::DBus::Error::FAILED, "The service is shutting down"));
 
-        {AudioControlService::MethodName::MakeDeviceDefault, sigc::mem_fun(*this, &DBusService::onMakeDeviceDefaultMethod)},
-    };
+    cancelTrayRegistration();
+
+    if (m_trayWatcherId != 0)
+        Gio::DBus::unwatch_name(m_trayWatcherId);
+
+    Gio::DBus::unown_name(m_connectionId);
+}
+
+void DBusService::sendDeviceInfo(DeviceInfo info)
+{
+    // The generations are of the service, consecutive across the backend and the aggregated peers alike
+    info.generation = m_lastGeneration + 1;
+    addToJournal(info);
+
+    const auto key = std::make_pair(info.type, info.index);
+
+    if (auto it = m_pendingDeviceInfo.find(key); it != m_pendingDeviceInfo.end())
+    {
+        const auto pendingEventType = it->second.eventType;
+
+        // Clients have never heard of the device, so there is nothing to tell them
+        if (pendingEventType == DeviceEventType::Add && info.eventType == DeviceEventType::Delete)
+        {
+            m_pendingDeviceInfo.erase(it);
+            updateBuffersMemory();
+            return;
+        }
 
-    m_statusNotifierItemMethodHandlers = {
-        {StatusNotifierItem::MethodName::Activate, sigc::mem_fun(*this, &DBusService::onActivateMethod)},
+        if (pendingEventType == DeviceEventType::Add)
+            info.eventType = DeviceEventType::Add;
+        else if (pendingEventType == DeviceEventType::Delete && info.eventType == DeviceEventType::Add)
+            info.eventType = DeviceEventType::Update;
+
+        it->second = std::move(info);
+    }
+    else
+        m_pendingDeviceInfo.emplace(key, std::move(info));
+
+    updateBuffersMemory();
+
+    if (m_pendingDeviceInfoFlush.connected())
+        return;
+
+    const auto flush = [this]
+    {
+        flushDeviceInfo();
+        return false;
     };
+
+    if (m_updatesFlushInterval == std::chrono::milliseconds::zero())
+        m_pendingDeviceInfoFlush = Glib::signal_idle().connect(flush);
+    else
+        m_pendingDeviceInfoFlush = Glib::signal_timeout().connect(flush, m_updatesFlushInterval.count());
 }
 
-DBusService::~DBusService()
+void DBusService::addToJournal(const DeviceInfo& info)
 {
-    Gio::DBus::unown_name(m_connectionId);
+    m_lastGeneration = info.generation;
+
+    if (m_journal.size() == DefaultJournalCapacity)
+        m_journal.pop_front();
+
+    m_journal.push_back(info);
 }
 
-void DBusService::sendDeviceInfo(DeviceIndex index, DeviceType type, const std::string& name, DeviceVolume volume, bool isMuted, bool isDefault,
-                                 DeviceEventType eventType)
+DBusService::DevicesSnapshot DBusService::getSnapshot()
 {
-    const Glib::VariantContainerBase args = Glib::VariantContainerBase::create_tuple({
-        Glib::Variant<int>::create(index),                      // id
-        Glib::Variant<int>::create(DeviceTypeToInt(type)),      // type
-        Glib::Variant<Glib::ustring>::create(name.c_str()),     // name
-        Glib::Variant<int>::create(volume.getPercents()),       // volume
-        Glib::Variant<bool>::create(isMuted),                   // isMuted
-        Glib::Variant<bool>::create(isDefault),                 // isDefault
-        Glib::Variant<int>::create(static_cast<int>(eventType)) // event
-    });
+    // The devices are in their latest state, which the journal has up to its last generation
+    auto snapshot = m_getAllDevicesSignal();
+    snapshot.generation = m_lastGeneration;
 
-    Logger::debug("DBusService::sendDeviceInfo: {}", args.print(true).c_str());
+    for (auto& info : snapshot.devices)
+        info.generation = m_lastGeneration;
 
-    Gio::DBus::Connection::get_sync(Gio::DBus::BUS_TYPE_SESSION)
-        ->emit_signal(AudioControlService::ObjectPath, AudioControlService::InterfaceName, AudioControlService::SignalName::DeviceUpdated, "", args);
+    return snapshot;
 }
 
-void DBusService::registerSystemTrayIcon(const Glib::ustring& iconName)
+std::optional<std::vector<DBusService::DeviceInfo>> DBusService::getJournalSince(Generation generation) const
 {
-    m_iconName = iconName;
+    // Generations are consecutive, so the journal covers the request if it still has the next change after the given one
+    const bool isCovered = generation == m_lastGeneration || (!m_journal.empty() && m_journal.front().generation <= generation + 1);
 
-    try
+    if (generation == 0 || generation > m_lastGeneration || !isCovered)
+        return std::nullopt;
+
+    const auto first = std::ranges::upper_bound(m_journal, generation, {}, &DeviceInfo::generation);
+    return std::vector<DeviceInfo>(first, m_journal.end());
+}
+
+void DBusService::updateBuffersMemory() noexcept
+{
+    // A node of the map has the key, the value and the three links and the color of the tree
+    constexpr size_t PendingDeviceInfoSize = sizeof(decltype(m_pendingDeviceInfo)::value_type) + (4 * sizeof(void*));
+
+    const size_t bytes =
+        (m_pendingDeviceInfo.size() * PendingDeviceInfoSize) + (m_journal.size() * sizeof(DeviceInfo)) + (m_bulkCalls.size() * sizeof(QueuedCall));
+
+    m_buffersMemory.resize(bytes, m_pendingDeviceInfo.size() + m_journal.size() + m_bulkCalls.size());
+}
+
+void DBusService::flushDeviceInfo()
+{
+    const auto pendingDeviceInfo = std::exchange(m_pendingDeviceInfo, {});
+    updateBuffersMemory();
+
+    if (!m_connection)
     {
-        auto connection = Gio::DBus::Connection::get_sync(Gio::DBus::BUS_TYPE_SESSION);
+        Logger::debug("DBusService::flushDeviceInfo: no connection, dropping {} updates", pendingDeviceInfo.size());
+        return;
+    }
 
-        auto args = Glib::VariantContainerBase::create_tuple(
-            std::vector<Glib::VariantBase>{Glib::Variant<Glib::ustring>::create(StatusNotifierItem::ObjectPath)});
-        connection->call_sync(SystemTrayWatcher::ObjectPath,
-                              SystemTrayWatcher::InterfaceName,
-                              SystemTrayWatcher::RegisterStatusNotifierMethodName,
-                              args,
-                              SystemTrayWatcher::ServiceName);
+    Logger::debug("DBusService::flushDeviceInfo: sending {} updates", pendingDeviceInfo.size());
 
-        {
-            auto signalArgs = Glib::VariantContainerBase::create_tuple(
-                std::vector<Glib::VariantBase>{Glib::Variant<Glib::ustring>::create(StatusNotifierItem::ObjectPath)});
-            connection->emit_signal(SystemTrayWatcher::ObjectPath,
-                                    SystemTrayWatcher::InterfaceName,
-                                    SystemTrayWatcher::NewIconSignalName,
-                                    SystemTrayWatcher::ServiceName,
-                                    signalArgs);
-        }
+    const auto infos = pendingDeviceInfo | std::views::values;
+
+    for (const auto& info : infos)
+        emitSignal(AudioControlService::SignalName::DeviceUpdated, Glib::Variant<DeviceInfoTuple>::create(CreateDeviceInfoTuple(info)));
+
+    if (m_isBatchedUpdatesEnabled)
+        emitSignal(AudioControlService::SignalName::DevicesUpdated, Glib::VariantContainerBase::create_tuple(CreateDevicesVariant(infos)));
+}
+
+void DBusService::sendPeakLevels(const std::vector<PeakLevel>& levels)
+{
+    if (!m_connection)
+        return;
 
-        Logger::debug("Registered StatusNotifierItem successfully.");
+    std::vector<std::tuple<int, int, double>> items;
+    items.reserve(levels.size());
+
+    for (const auto& level : levels)
+        items.emplace_back(static_cast<int>(level.index), DeviceTypeToInt(level.type), static_cast<double>(level.peak));
+
+    emitSignal(AudioControlService::SignalName::PeakLevels,
+               Glib::VariantContainerBase::create_tuple(Glib::Variant<std::vector<std::tuple<int, int, double>>>::create(items)));
+}
+
+void DBusService::sendStreamMetadata(const StreamMetadata& stream)
+{
+    if (!m_connection)
+        return;
+
+    const auto [index, type, metadata] = CreateStreamMetadataTuple(stream);
+
+    emitSignal(AudioControlService::SignalName::StreamMetadataUpdated,
+               Glib::VariantContainerBase::create_tuple({Glib::Variant<int>::create(index),
+                                                         Glib::Variant<int>::create(type),
+                                                         Glib::Variant<std::map<Glib::ustring, Glib::ustring>>::create(metadata)}));
+}
+
+void DBusService::emitSignal(const char* signalName, const Glib::VariantContainerBase& args)
+{
+    try
+    {
+        m_connection->emit_signal(AudioControlService::ObjectPath, AudioControlService::InterfaceName, signalName, "", args);
+        GetSignalsEmittedCounter(signalName).increment();
     }
     catch (const Glib::Error& ex)
     {
-        Logger::error("Error registering StatusNotifierItem: {}", ex.what().c_str());
+        Logger::error("DBusService::emitSignal: couldn't emit {}: {}", signalName, ex.what().c_str());
     }
 }
 
-void DBusService::onBusAcquired([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name)
+void DBusService::registerSystemTrayIcon(const Glib::ustring& iconName)
+{
+    m_iconName = iconName;
+
+    // The watcher may be absent or slow, so nothing waits for it. The icon is registered every time the watcher appears,
+    // which covers a tray host started after the app and a restarted one
+    if (m_trayWatcherId == 0)
+        m_trayWatcherId = Gio::DBus::watch_name(Gio::DBus::BUS_TYPE_SESSION,
+                                                SystemTrayWatcher::ServiceName,
+                                                sigc::mem_fun(*this, &DBusService::onTrayWatcherAppeared),
+                                                sigc::mem_fun(*this, &DBusService::onTrayWatcherVanished));
+}
+
+void DBusService::onTrayWatcherAppeared(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name, const Glib::ustring& nameOwner)
+{
+    Logger::debug("The system tray watcher: {} has appeared, owned by: {}. Registering StatusNotifierItem...", name.c_str(), nameOwner.c_str());
+
+    cancelTrayRegistration();
+
+    // Given to the reply: once cancelled, the reply doesn't touch this object, which may be gone already
+    const auto cancellable = Gio::Cancellable::create();
+    m_trayRegistration = cancellable;
+
+    const auto args = Glib::VariantContainerBase::create_tuple(
+        std::vector<Glib::VariantBase>{Glib::Variant<Glib::ustring>::create(StatusNotifierItem::ObjectPath)});
+
+    connection->call(
+        SystemTrayWatcher::ObjectPath,
+        SystemTrayWatcher::InterfaceName,
+        SystemTrayWatcher::RegisterStatusNotifierMethodName,
+        args,
+        [this, connection, cancellable](Glib::RefPtr<Gio::AsyncResult>& result)
+        {
+            if (cancellable->is_cancelled())
+                return;
+
+            m_trayRegistration.reset();
+
+            try
+            {
+                connection->call_finish(result);
+
+                auto signalArgs = Glib::VariantContainerBase::create_tuple(
+                    std::vector<Glib::VariantBase>{Glib::Variant<Glib::ustring>::create(StatusNotifierItem::ObjectPath)});
+                connection->emit_signal(SystemTrayWatcher::ObjectPath,
+                                        SystemTrayWatcher::InterfaceName,
+                                        SystemTrayWatcher::NewIconSignalName,
+                                        SystemTrayWatcher::ServiceName,
+                                        signalArgs);
+
+                Logger::info("Registered StatusNotifierItem successfully");
+            }
+            catch (const Glib::Error& ex)
+            {
+                Logger::error("Error registering StatusNotifierItem: {}", ex.what().c_str());
+            }
+        },
+        cancellable,
+        nameOwner,
+        SystemTrayWatcher::RegisterTimeoutMsec);
+}
+
+void DBusService::onTrayWatcherVanished([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name)
+{
+    Logger::info("No system tray watcher: {}. The icon is registered once it appears", name.c_str());
+    cancelTrayRegistration();
+}
+
+void DBusService::cancelTrayRegistration()
+{
+    if (const auto cancellable = std::exchange(m_trayRegistration, {}))
+        cancellable->cancel();
+}
+
+void DBusService::onBusAcquired(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name)
 {
     Logger::debug("The bus for a name: {} is acquired, registering...", name.c_str());
 
+    m_connection = connection;
+
     connection->register_object(AudioControlService::ObjectPath, m_introspectionData->lookup_interface(AudioControlService::InterfaceName), m_interfaceVtable);
     connection->register_object(StatusNotifierItem::ObjectPath, m_introspectionData->lookup_interface(StatusNotifierItem::InterfaceName), m_interfaceVtable);
 }
@@ -294,30 +834,77 @@ void DBusService::onMethodCall([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Co
 {
     Logger::debug("Invokated method: {}{} on the interface: {} from a client: {}",
                   methodName.c_str(),
-                  parameters.print(true).c_str(),
+                  Logger::lazy([&parameters] { return parameters.print(true).raw(); }),
                   interfaceName.c_str(),
                   sender.c_str());
 
-    try
+    const auto startTime = std::chrono::steady_clock::now();
+    const Method* method = FindMethod(objectPath.raw(), methodName.raw());
+
+    if (method == nullptr)
     {
-        if (objectPath == AudioControlService::ObjectPath)
-        {
-            if (auto method = m_audioControlServiceMethodHandlers.find(methodName); method != m_audioControlServiceMethodHandlers.end())
-                invocation->return_value(method->second(parameters));
-            else
-                throw std::runtime_error{std::format("Unsupported method: {}", methodName.c_str())};
-        }
-        else if (objectPath == StatusNotifierItem::ObjectPath)
-        {
-            if (auto method = m_statusNotifierItemMethodHandlers.find(methodName); method != m_statusNotifierItemMethodHandlers.end())
-                invocation->return_value(method->second(parameters));
-            else
-                throw std::runtime_error{std::format("Unsupported method: {}", methodName.c_str())};
-        }
-        else
+        const auto message = std::format("Unsupported method: {} on the object path: {}", methodName.c_str(), objectPath.c_str());
+
+        Logger::error(message);
+        invocation->return_error(Gio::DBus::Error(Gio::DBus::Error::UNKNOWN_METHOD, message));
+
+        return;
+    }
+
+    // A backlog of volume changes doesn't delay opening the window: the bulk calls run when the main loop is idle, i.e. after
+    // the calls arriving meanwhile are dispatched and the window is drawn
+    if (method->priority == MethodPriority::Interactive)
+    {
+        callMethod(*method, parameters, invocation, startTime);
+        return;
+    }
+
+    m_bulkCalls.push_back({method, parameters, invocation, startTime});
+    updateBuffersMemory();
+
+    if (!m_bulkCallsDrain.connected())
+        m_bulkCallsDrain = Glib::signal_idle().connect(sigc::mem_fun(*this, &DBusService::drainBulkCalls), Glib::PRIORITY_DEFAULT_IDLE);
+}
+
+bool DBusService::drainBulkCalls()
+{
+    static Metrics::Counter& queuedCallsCounter = Metrics::GetCounter("dbus_bulk_calls_total");
+    static LatencyHistogram& queueWaitHistogram = Metrics::GetHistogram("dbus_bulk_call_wait_microseconds");
+
+    for (size_t i = 0; i < BulkCallsPerIteration && !m_bulkCalls.empty(); ++i)
+    {
+        const QueuedCall call = std::move(m_bulkCalls.front());
+        m_bulkCalls.pop_front();
+
+        queuedCallsCounter.increment();
+        queueWaitHistogram.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - call.startTime));
+
+        callMethod(*call.method, call.parameters, call.invocation, call.startTime);
+    }
+
+    updateBuffersMemory();
+
+    return !m_bulkCalls.empty();
+}
+
+void DBusService::callMethod(const Method& method, const MethodParameters& parameters, const Glib::RefPtr<Gio::DBus::MethodInvocation>& invocation,
+                             std::chrono::steady_clock::time_point startTime)
+{
+    if (method.deferredHandler != nullptr)
+    {
+        const auto handler = [this, &method](const MethodParameters& methodParameters, MethodReply reply)
         {
-            throw std::runtime_error{std::format("Unsupported method: {} from unsupported objectPath: {}", methodName.c_str(), objectPath.c_str())};
-        }
+            (this->*method.deferredHandler)(methodParameters, std::move(reply));
+        };
+
+        CallDeferredMethod(handler, GetLatencyHistogram(method), startTime, parameters, invocation);
+        return;
+    }
+
+    try
+    {
+        invocation->return_value((this->*method.handler)(parameters));
+        RecordMethodLatency(GetLatencyHistogram(method), startTime);
     }
     catch (const std::exception& ex)
     {
@@ -326,6 +913,89 @@ void DBusService::onMethodCall([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Co
     }
 }
 
+struct DBusService::Method
+{
+    std::string_view objectPath;
+    std::string_view name;
+    MethodPriority priority;
+
+    // One of them
+    MethodHandler handler;
+    DeferredMethodHandler deferredHandler;
+};
+
+struct DBusService::MethodTable
+{
+    static constexpr auto Methods = []
+    {
+        using namespace AudioControlService;
+        using StatusNotifierItem::MethodName::Activate;
+
+        constexpr auto Interactive = MethodPriority::Interactive;
+        constexpr auto Bulk = MethodPriority::Bulk;
+
+        return std::array{
+            Method{ObjectPath, MethodName::Open, Interactive, &DBusService::onOpenMethod, nullptr},
+            Method{ObjectPath, MethodName::Toggle, Interactive, &DBusService::onToggleMethod, nullptr},
+
+            Method{ObjectPath, MethodName::SubscribeToDeviceUpdatedSignal, Bulk, &DBusService::onSubscribeToDeviceUpdatedSignalMethod, nullptr},
+            Method{ObjectPath, MethodName::UnsubscribeFromDeviceUpdatedSignal, Bulk, &DBusService::onUnsubscribeFromDeviceUpdatedSignalMethod, nullptr},
+
+            Method{ObjectPath, MethodName::GetAllDevices, Bulk, &DBusService::onGetAllDevicesMethod, nullptr},
+            Method{ObjectPath, MethodName::GetStreamsMetadata, Bulk, &DBusService::onGetStreamsMetadataMethod, nullptr},
+
+            Method{ObjectPath, MethodName::GetStats, Bulk, &DBusService::onGetStatsMethod, nullptr},
+
+            Method{ObjectPath, MethodName::SetDeviceVolume, Bulk, nullptr, &DBusService::onSetDeviceVolumeMethod},
+            Method{ObjectPath, MethodName::AdjustDeviceVolume, Bulk, nullptr, &DBusService::onAdjustDeviceVolumeMethod},
+            Method{ObjectPath, MethodName::RampDeviceVolume, Bulk, nullptr, &DBusService::onRampDeviceVolumeMethod},
+            Method{ObjectPath, MethodName::SetDeviceMute, Bulk, nullptr, &DBusService::onSetDeviceMuteMethod},
+
+            Method{ObjectPath, MethodName::MakeDeviceDefault, Bulk, nullptr, &DBusService::onMakeDeviceDefaultMethod},
+
+            Method{ObjectPath, MethodName::SetDevicesState, Bulk, nullptr, &DBusService::onSetDevicesStateMethod},
+            Method{ObjectPath, MethodName::SetAppVmVolume, Bulk, nullptr, &DBusService::onSetAppVmVolumeMethod},
+            Method{ObjectPath, MethodName::SetAppVmMute, Bulk, nullptr, &DBusService::onSetAppVmMuteMethod},
+
+            Method{ObjectPath, MethodName::MoveDevice, Bulk, nullptr, &DBusService::onMoveDeviceMethod},
+            Method{ObjectPath, MethodName::MoveAppVm, Bulk, nullptr, &DBusService::onMoveAppVmMethod},
+
+            Method{StatusNotifierItem::ObjectPath, Activate, Interactive, &DBusService::onActivateMethod, nullptr},
+        };
+    }();
+
+    static constexpr auto Slots = BuildMethodSlots<64>(Methods);
+    static_assert(Slots.seed != MaxMethodSlotsSeed, "No perfect hash of the method names, add the slots");
+};
+
+const DBusService::Method* DBusService::FindMethod(std::string_view objectPath, std::string_view name) noexcept
+{
+    const auto& slots = MethodTable::Slots;
+
+    const uint8_t index = slots.slots[slots.getSlot(name)];
+    if (index == MethodSlots<64>::Empty)
+        return nullptr;
+
+    const Method& method = MethodTable::Methods[index];
+    return method.name == name && method.objectPath == objectPath ? &method : nullptr;
+}
+
+LatencyHistogram& DBusService::GetLatencyHistogram(const Method& method)
+{
+    // Resolved once per method, so a call records its latency without a lookup in the registry
+    static const auto histograms = []
+    {
+        std::array<LatencyHistogram*, MethodTable::Methods.size()> result{};
+
+        for (size_t i = 0; i < result.size(); ++i)
+            result[i] = &Metrics::GetHistogram(std::format("dbus_method_duration_microseconds{{method=\"{}\"}}", MethodTable::Methods[i].name));
+
+        return result;
+    }();
+
+    return *histograms[static_cast<size_t>(&method - MethodTable::Methods.data())];
+}
+
 void DBusService::onPropertyGet(Glib::VariantBase& property, [[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection,
                                 [[maybe_unused]] const Glib::ustring& sender, [[maybe_unused]] const Glib::ustring& objectPath,
                                 const Glib::ustring& interfaceName, const Glib::ustring& propertyName)
@@ -335,17 +1005,22 @@ void DBusService::onPropertyGet(Glib::VariantBase& property, [[maybe_unused]] co
         {"Id", "Ghaf Audio Control"},
         {"Status", "Active"},
         {"Title", "Ghaf Audio Control"},
-        {"IconName", m_iconName.value_or("")},
         {"Menu", ""},
         {"IconThemePath", ""},
     };
 
-    if (auto it = propertyMap.find(propertyName); it != propertyMap.end())
+    // Not in the map: the icon name is set once the icon is registered, after the first property requests maybe
+    if (propertyName == "IconName")
+        property = Glib::Variant<Glib::ustring>::create(m_iconName.value_or(""));
+    else if (auto it = propertyMap.find(propertyName); it != propertyMap.end())
         property = Glib::Variant<Glib::ustring>::create(it->second);
     else
         property = Glib::VariantBase();
 
-    Logger::debug("onPropertyGet: property: {} on the interface: {} returns: {}", propertyName.c_str(), interfaceName.c_str(), property.print(true).c_str());
+    Logger::debug("onPropertyGet: property: {} on the interface: {} returns: {}",
+                  propertyName.c_str(),
+                  interfaceName.c_str(),
+                  Logger::lazy([&property] { return property.print(true).raw(); }));
 }
 
 bool DBusService::onPropertySet([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection, [[maybe_unused]] const Glib::ustring& sender,
@@ -368,10 +1043,29 @@ DBusService::MethodResult DBusService::onToggleMethod([[maybe_unused]] const Met
     return CreateEmptyResponse();
 }
 
-DBusService::MethodResult DBusService::onSubscribeToDeviceUpdatedSignalMethod([[maybe_unused]] const MethodParameters& parameters)
+DBusService::MethodResult DBusService::onSubscribeToDeviceUpdatedSignalMethod(const MethodParameters& parameters)
 {
+    Glib::Variant<guint64> since;
+    parameters.get_child(since, 0);
+
     m_subscribeToDeviceUpdatedSignal();
-    return CreateEmptyResponse();
+
+    const auto createResponse = [](Generation generation, bool isSnapshot, const std::vector<DeviceInfo>& infos)
+    {
+        return Glib::VariantContainerBase::create_tuple(
+            {Glib::Variant<guint64>::create(generation), Glib::Variant<bool>::create(isSnapshot), CreateDevicesVariant(infos)});
+    };
+
+    if (auto changes = getJournalSince(since.get()))
+    {
+        Logger::debug("DBusService: replaying {} changes since the generation {}", changes->size(), since.get());
+        return createResponse(m_lastGeneration, false, *changes);
+    }
+
+    Logger::debug("DBusService: the generation {} is not in the journal, sending a snapshot", since.get());
+
+    const auto snapshot = getSnapshot();
+    return createResponse(snapshot.generation, true, snapshot.devices);
 }
 
 DBusService::MethodResult DBusService::onUnsubscribeFromDeviceUpdatedSignalMethod([[maybe_unused]] const MethodParameters& parameters)
@@ -380,7 +1074,7 @@ DBusService::MethodResult DBusService::onUnsubscribeFromDeviceUpdatedSignalMetho
     return CreateEmptyResponse();
 }
 
-DBusService::MethodResult DBusService::onSetDeviceVolumeMethod(const MethodParameters& parameters)
+void DBusService::onSetDeviceVolumeMethod(const MethodParameters& parameters, MethodReply reply)
 {
     Glib::Variant<int> id;
     Glib::Variant<int> type;
@@ -390,12 +1084,49 @@ DBusService::MethodResult DBusService::onSetDeviceVolumeMethod(const MethodParam
     parameters.get_child(type, 1);
     parameters.get_child(volume, 2);
 
-    m_setDeviceVolumeSignal(id.get(), IntToDeviceType(type.get()), Volume::fromPercents(static_cast<unsigned long>(volume.get())));
+    m_setDeviceVolumeSignal(id.get(), IntToDeviceType(type.get()), Volume::fromPercents(static_cast<unsigned long>(volume.get())),
+                            CreateResultCallback(std::move(reply)));
+}
+
+void DBusService::onAdjustDeviceVolumeMethod(const MethodParameters& parameters, MethodReply reply)
+{
+    Glib::Variant<int> id;
+    Glib::Variant<int> type;
+    Glib::Variant<int> delta;
+
+    parameters.get_child(id, 0);
+    parameters.get_child(type, 1);
+    parameters.get_child(delta, 2);
 
-    return CreateResultOkResponse();
+    if (delta.get() < -Volume::Max || delta.get() > Volume::Max)
+        throw std::runtime_error{std::format("'delta' field has an unsupported value: {}", delta.get())};
+
+    m_adjustDeviceVolumeSignal(id.get(), IntToDeviceType(type.get()), delta.get(), CreateResultCallback(std::move(reply)));
 }
 
-DBusService::MethodResult DBusService::onSetDeviceMuteMethod(const MethodParameters& parameters)
+void DBusService::onRampDeviceVolumeMethod(const MethodParameters& parameters, MethodReply reply)
+{
+    Glib::Variant<int> id;
+    Glib::Variant<int> type;
+    Glib::Variant<int> volume;
+    Glib::Variant<int> duration;
+
+    parameters.get_child(id, 0);
+    parameters.get_child(type, 1);
+    parameters.get_child(volume, 2);
+    parameters.get_child(duration, 3);
+
+    if (volume.get() < Volume::Min || volume.get() > Volume::Max)
+        throw std::runtime_error{std::format("'volume' field has an unsupported value: {}", volume.get())};
+
+    if (duration.get() < 0 || duration.get() > MaxVolumeRampDuration.count())
+        throw std::runtime_error{std::format("'duration_ms' field has an unsupported value: {}", duration.get())};
+
+    m_rampDeviceVolumeSignal(id.get(), IntToDeviceType(type.get()), Volume::fromPercents(static_cast<unsigned>(volume.get())),
+                             std::chrono::milliseconds{duration.get()}, CreateResultCallback(std::move(reply)));
+}
+
+void DBusService::onSetDeviceMuteMethod(const MethodParameters& parameters, MethodReply reply)
 {
     Glib::Variant<int> id;
     Glib::Variant<int> type;
@@ -405,12 +1136,10 @@ DBusService::MethodResult DBusService::onSetDeviceMuteMethod(const MethodParamet
     parameters.get_child(type, 1);
     parameters.get_child(mute, 2);
 
-    m_setDeviceMuteSignal(id.get(), IntToDeviceType(type.get()), mute.get());
-
-    return CreateResultOkResponse();
+    m_setDeviceMuteSignal(id.get(), IntToDeviceType(type.get()), mute.get(), CreateResultCallback(std::move(reply)));
 }
 
-DBusService::MethodResult DBusService::onMakeDeviceDefaultMethod(const MethodParameters& parameters)
+void DBusService::onMakeDeviceDefaultMethod(const MethodParameters& parameters, MethodReply reply)
 {
     Glib::Variant<int> id;
     Glib::Variant<int> type;
@@ -423,12 +1152,160 @@ DBusService::MethodResult DBusService::onMakeDeviceDefaultMethod(const MethodPar
     if (!std::set{DBusService::DeviceType::Sink, DBusService::DeviceType::Source}.contains(deviceType))
         throw std::runtime_error{std::format("'type' field has an unsupported value: {}. Only Sink and Source allowed", type.get())};
 
-    m_makeDeviceDefaultSignal(id.get(), deviceType);
+    m_makeDeviceDefaultSignal(id.get(), deviceType, CreateResultCallback(std::move(reply)));
+}
+
+void DBusService::onSetAppVmVolumeMethod(const MethodParameters& parameters, MethodReply reply)
+{
+    Glib::Variant<Glib::ustring> name;
+    Glib::Variant<int> volume;
+
+    parameters.get_child(name, 0);
+    parameters.get_child(volume, 1);
+
+    if (volume.get() < Volume::Min || volume.get() > Volume::Max)
+        throw std::runtime_error{std::format("'volume' field has an unsupported value: {}", volume.get())};
+
+    m_setAppVmVolumeSignal(name.get().raw(), Volume::fromPercents(static_cast<unsigned>(volume.get())), CreateResultCallback(std::move(reply)));
+}
+
+void DBusService::onSetAppVmMuteMethod(const MethodParameters& parameters, MethodReply reply)
+{
+    Glib::Variant<Glib::ustring> name;
+    Glib::Variant<bool> mute;
+
+    parameters.get_child(name, 0);
+    parameters.get_child(mute, 1);
+
+    m_setAppVmMuteSignal(name.get().raw(), mute.get(), CreateResultCallback(std::move(reply)));
+}
+
+void DBusService::onMoveDeviceMethod(const MethodParameters& parameters, MethodReply reply)
+{
+    Glib::Variant<int> id;
+    Glib::Variant<int> type;
+    Glib::Variant<int> target;
+
+    parameters.get_child(id, 0);
+    parameters.get_child(type, 1);
+    parameters.get_child(target, 2);
+
+    const auto deviceType = IntToDeviceType(type.get());
+
+    if (!std::set{DBusService::DeviceType::SinkInput, DBusService::DeviceType::SourceOutput}.contains(deviceType))
+        throw std::runtime_error{std::format("'type' field has an unsupported value: {}. Only SinkInput and SourceOutput allowed", type.get())};
 
-    return CreateResultOkResponse();
+    m_moveDeviceSignal(id.get(), deviceType, target.get(), CreateResultCallback(std::move(reply)));
+}
+
+void DBusService::onMoveAppVmMethod(const MethodParameters& parameters, MethodReply reply)
+{
+    Glib::Variant<Glib::ustring> name;
+    Glib::Variant<int> target;
+
+    parameters.get_child(name, 0);
+    parameters.get_child(target, 1);
+
+    m_moveAppVmSignal(name.get().raw(), target.get(), CreateResultCallback(std::move(reply)));
 }
 
 DBusService::MethodResult DBusService::onActivateMethod(const MethodParameters& parameters)
 {
     return onToggleMethod(parameters);
 }
+
+void DBusService::onSetDevicesStateMethod(const MethodParameters& parameters, MethodReply reply)
+{
+    using Item = std::tuple<int, int, int, int>;
+
+    Glib::Variant<std::vector<Item>> devices;
+    parameters.get_child(devices, 0);
+
+    const auto items = devices.get();
+
+    // Validate the whole batch first, so only the well-formed requests reach the backend
+    std::vector<std::optional<DeviceStateRequest>> requests;
+    requests.reserve(items.size());
+
+    std::vector<DeviceStateRequest> validRequests;
+    validRequests.reserve(items.size());
+
+    for (const auto& [id, type, mute, volume] : items)
+    {
+        const bool isValid = type >= 0 && type <= DeviceTypeToInt(DeviceType::SourceOutput) && mute >= -1 && mute <= 1 && volume >= -1 &&
+                             volume <= Volume::Max;
+
+        if (!isValid)
+        {
+            Logger::error("DBusService::onSetDevicesStateMethod: invalid request: id: {}, type: {}, mute: {}, volume: {}", id, type, mute, volume);
+            requests.emplace_back(std::nullopt);
+            continue;
+        }
+
+        DeviceStateRequest request{.index = static_cast<DeviceIndex>(id), .type = IntToDeviceType(type), .mute = {}, .volume = {}};
+
+        if (mute != -1)
+            request.mute = mute == 1;
+
+        if (volume != -1)
+            request.volume = Volume::fromPercents(static_cast<unsigned>(volume));
+
+        requests.emplace_back(request);
+        validRequests.push_back(request);
+    }
+
+    const auto onDone = [requests = std::move(requests), reply = std::move(reply)](std::vector<Result> validResults)
+    {
+        std::vector<int> results;
+        results.reserve(requests.size());
+
+        auto validResult = validResults.begin();
+
+        for (const auto& request : requests)
+        {
+            auto result = Result::InvalidArgument;
+
+            if (request)
+                result = validResult != validResults.end() ? *validResult++ : Result::Failed;
+
+            results.push_back(static_cast<int>(result));
+        }
+
+        reply(Glib::VariantContainerBase::create_tuple(Glib::Variant<std::vector<int>>::create(results)));
+    };
+
+    m_setDevicesStateSignal(validRequests, onDone);
+}
+
+DBusService::MethodResult DBusService::onGetAllDevicesMethod([[maybe_unused]] const MethodParameters& parameters)
+{
+    const auto snapshot = getSnapshot();
+    return Glib::VariantContainerBase::create_tuple({Glib::Variant<guint64>::create(snapshot.generation), CreateDevicesVariant(snapshot.devices)});
+}
+
+DBusService::MethodResult DBusService::onGetStreamsMetadataMethod([[maybe_unused]] const MethodParameters& parameters)
+{
+    using StreamMetadataTuple = decltype(CreateStreamMetadataTuple(std::declval<StreamMetadata>()));
+
+    std::vector<StreamMetadataTuple> streams;
+
+    for (const auto& stream : m_getStreamsMetadataSignal())
+        streams.push_back(CreateStreamMetadataTuple(stream));
+
+    return Glib::VariantContainerBase::create_tuple(Glib::Variant<std::vector<StreamMetadataTuple>>::create(streams));
+}
+
+DBusService::MethodResult DBusService::onGetStatsMethod([[maybe_unused]] const MethodParameters& parameters)
+{
+    std::map<Glib::ustring, guint64> counters;
+
+    for (const auto& [name, value] : Metrics::GetCounterValues())
+        counters.emplace(name, value);
+
+    // The gauges are sizes and counts, a negative one would be an accounting bug
+    for (const auto& [name, value] : Metrics::GetGaugeValues())
+        counters.emplace(name, static_cast<guint64>(std::max<int64_t>(value, 0)));
+
+    return Glib::VariantContainerBase::create_tuple(
+        {Glib::Variant<std::map<Glib::ustring, guint64>>::create(counters), Glib::Variant<Glib::ustring>::create(Metrics::ToPrometheusText())});
+}
@@ -6,76 +6,248 @@
 #pragma once
 
 #include <GhafAudioControl/IAudioControlBackend.hpp>
+#include <GhafAudioControl/utils/MemoryCharge.hpp>
 
+#include <giomm/cancellable.h>
 #include <giomm/dbusinterfacevtable.h>
 #include <giomm/dbusintrospection.h>
 #include <giomm/dbusmethodinvocation.h>
 
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string_view>
+#include <vector>
+
 class DBusService final
 {
 public:
     using DeviceIndex = ghaf::AudioControl::IAudioControlBackend::IDevice::IntexT;
     using DeviceType = ghaf::AudioControl::IAudioControlBackend::IDevice::Type;
+    using DeviceName = ghaf::AudioControl::InternedString;
     using DeviceVolume = ghaf::AudioControl::Volume;
     using DeviceEventType = ghaf::AudioControl::IAudioControlBackend::EventType;
+    using Generation = ghaf::AudioControl::IAudioControlBackend::Generation;
 
     using OpenSignalSignature = sigc::signal<void()>;
     using ToggleSignalSignature = sigc::signal<void()>;
     using SubscribeToDeviceUpdatedSignalSignature = sigc::signal<void()>;
 
-    using SetDeviceVolumeSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type, DeviceVolume)>;
-    using SetDeviceMuteSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type, bool mute)>;
+    // The method replies once the result callback is called. A callback dropped without a call replies with an error
+    using Result = ghaf::AudioControl::IAudioControlBackend::Result;
+    using ResultCallback = ghaf::AudioControl::IAudioControlBackend::ResultCallback;
+    using ResultsCallback = ghaf::AudioControl::IAudioControlBackend::ResultsCallback;
+
+    using SetDeviceVolumeSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type, DeviceVolume, ResultCallback onDone)>;
+    using AdjustDeviceVolumeSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type, int delta, ResultCallback onDone)>;
+    using RampDeviceVolumeSignalSignature =
+        sigc::signal<void(DeviceIndex id, DeviceType type, DeviceVolume target, std::chrono::milliseconds duration, ResultCallback onDone)>;
+    using SetDeviceMuteSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type, bool mute, ResultCallback onDone)>;
+
+    using MakeDeviceDefaultSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type, ResultCallback onDone)>;
+
+    using DeviceStateRequest = ghaf::AudioControl::IAudioControlBackend::DeviceStateRequest;
+    using SetDevicesStateSignalSignature = sigc::signal<void(const std::vector<DeviceStateRequest>& requests, ResultsCallback onDone)>;
+
+    // All the streams of an AppVM at once
+    using SetAppVmVolumeSignalSignature = sigc::signal<void(const std::string& appVmName, DeviceVolume volume, ResultCallback onDone)>;
+    using SetAppVmMuteSignalSignature = sigc::signal<void(const std::string& appVmName, bool mute, ResultCallback onDone)>;
+
+    using MoveDeviceSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type, DeviceIndex target, ResultCallback onDone)>;
+    using MoveAppVmSignalSignature = sigc::signal<void(const std::string& appVmName, DeviceIndex target, ResultCallback onDone)>;
+
+    struct DeviceInfo
+    {
+        DeviceIndex index;
+        DeviceType type;
+        DeviceName name; // A handle, the pending updates and the journal share the strings with the devices
+        DeviceVolume volume;
+        bool isMuted;
+        bool isDefault; // Makes sense only for a Sink and a Source
+        DeviceEventType eventType;
+        Generation generation;
+    };
+
+    struct DevicesSnapshot
+    {
+        Generation generation = 0;
+        std::vector<DeviceInfo> devices;
+    };
+
+    using GetAllDevicesSignalSignature = sigc::signal<DevicesSnapshot()>;
+
+    struct StreamMetadata
+    {
+        DeviceIndex index;
+        DeviceType type;
+        ghaf::AudioControl::IAudioControlBackend::IDevice::State::Metadata metadata;
+    };
+
+    using GetStreamsMetadataSignalSignature = sigc::signal<std::vector<StreamMetadata>()>;
 
-    using MakeDeviceDefaultSignalSignature = sigc::signal<void(DeviceIndex id, DeviceType type)>;
+    static constexpr std::chrono::milliseconds DefaultUpdatesFlushInterval{50};
+    static constexpr size_t DefaultJournalCapacity = 1024;
 
     using MethodResult = Glib::VariantContainerBase;
     using MethodParameters = Glib::VariantContainerBase;
-    using MethodCallHandler = std::function<MethodResult(const MethodParameters& parameters)>;
+
+    // For the methods that reply after the main loop has done the work. The reply may be called once, from the main loop only
+    using MethodReply = std::function<void(const MethodResult& result)>;
+
+    static constexpr std::chrono::milliseconds MaxVolumeRampDuration{60000};
+
+    // The bulk calls run this many at a time, each time the main loop is idle
+    static constexpr size_t BulkCallsPerIteration = 16;
 
 public:
     DBusService();
     ~DBusService();
 
 public:
-    OpenSignalSignature openSignal() const noexcept
+    OpenSignalSignature& openSignal() noexcept
     {
         return m_openSignal;
     }
 
-    ToggleSignalSignature toggleSignal() const noexcept
+    ToggleSignalSignature& toggleSignal() noexcept
     {
         return m_toggleSignal;
     }
 
-    SubscribeToDeviceUpdatedSignalSignature subscribeToDeviceUpdatedSignal() const noexcept
+    SubscribeToDeviceUpdatedSignalSignature& subscribeToDeviceUpdatedSignal() noexcept
     {
         return m_subscribeToDeviceUpdatedSignal;
     }
 
-    SetDeviceVolumeSignalSignature setDeviceVolumeSignal() const noexcept
+    SetDeviceVolumeSignalSignature& setDeviceVolumeSignal() noexcept
     {
         return m_setDeviceVolumeSignal;
     }
 
-    SetDeviceMuteSignalSignature setDeviceMuteSignal() const noexcept
+    AdjustDeviceVolumeSignalSignature& adjustDeviceVolumeSignal() noexcept
+    {
+        return m_adjustDeviceVolumeSignal;
+    }
+
+    RampDeviceVolumeSignalSignature& rampDeviceVolumeSignal() noexcept
+    {
+        return m_rampDeviceVolumeSignal;
+    }
+
+    SetDeviceMuteSignalSignature& setDeviceMuteSignal() noexcept
     {
         return m_setDeviceMuteSignal;
     }
 
-    MakeDeviceDefaultSignalSignature makeDeviceDefaultSignal() const noexcept
+    MakeDeviceDefaultSignalSignature& makeDeviceDefaultSignal() noexcept
     {
         return m_makeDeviceDefaultSignal;
     }
 
-    void sendDeviceInfo(DeviceIndex index, DeviceType type, const std::string& name, DeviceVolume volume, bool isMuted, bool isDefault,
-                        DeviceEventType eventType);
+    SetDevicesStateSignalSignature& setDevicesStateSignal() noexcept
+    {
+        return m_setDevicesStateSignal;
+    }
+
+    SetAppVmVolumeSignalSignature& setAppVmVolumeSignal() noexcept
+    {
+        return m_setAppVmVolumeSignal;
+    }
+
+    SetAppVmMuteSignalSignature& setAppVmMuteSignal() noexcept
+    {
+        return m_setAppVmMuteSignal;
+    }
+
+    MoveDeviceSignalSignature& moveDeviceSignal() noexcept
+    {
+        return m_moveDeviceSignal;
+    }
+
+    MoveAppVmSignalSignature& moveAppVmSignal() noexcept
+    {
+        return m_moveAppVmSignal;
+    }
+
+    GetAllDevicesSignalSignature& getAllDevicesSignal() noexcept
+    {
+        return m_getAllDevicesSignal;
+    }
+
+    GetStreamsMetadataSignalSignature& getStreamsMetadataSignal() noexcept
+    {
+        return m_getStreamsMetadataSignal;
+    }
+
+    // Updates are coalesced per device and sent once per flush interval. Zero interval sends them on the next main loop iteration
+    void sendDeviceInfo(DeviceInfo info);
+
+    // Sent right away, the backend caps the rate already
+    using PeakLevel = ghaf::AudioControl::IAudioControlBackend::PeakLevel;
+    void sendPeakLevels(const std::vector<PeakLevel>& levels);
+
+    // Sent right away as well, the metadata of a stream seldom changes
+    void sendStreamMetadata(const StreamMetadata& stream);
+
+    void setUpdatesFlushInterval(std::chrono::milliseconds interval) noexcept
+    {
+        m_updatesFlushInterval = interval;
+    }
+
+    // Additionally send all the changes of a flush as a single DevicesUpdated signal
+    void setBatchedUpdatesEnabled(bool enabled) noexcept
+    {
+        m_isBatchedUpdatesEnabled = enabled;
+    }
+
+    // Doesn't block: the icon is registered in the background, whenever the StatusNotifierWatcher appears on the bus
     void registerSystemTrayIcon(const Glib::ustring& iconName);
 
 private:
+    // A method of an object served, with its handler. Defined in the source file, see FindMethod()
+    struct Method;
+    struct MethodTable; // All of them
+
+    // The window calls run as they come, the rest wait for the main loop to be idle, in the order they came
+    enum class MethodPriority
+    {
+        Interactive,
+        Bulk
+    };
+
+    using MethodHandler = MethodResult (DBusService::*)(const MethodParameters& parameters);
+    using DeferredMethodHandler = void (DBusService::*)(const MethodParameters& parameters, MethodReply reply);
+
+    struct QueuedCall
+    {
+        const Method* method;
+        MethodParameters parameters;
+        Glib::RefPtr<Gio::DBus::MethodInvocation> invocation;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    [[nodiscard]] static const Method* FindMethod(std::string_view objectPath, std::string_view name) noexcept;
+    [[nodiscard]] static ghaf::AudioControl::LatencyHistogram& GetLatencyHistogram(const Method& method);
+
+    void callMethod(const Method& method, const MethodParameters& parameters, const Glib::RefPtr<Gio::DBus::MethodInvocation>& invocation,
+                    std::chrono::steady_clock::time_point startTime);
+    bool drainBulkCalls();
+
+    void flushDeviceInfo();
+    void addToJournal(const DeviceInfo& info);
+    [[nodiscard]] std::optional<std::vector<DeviceInfo>> getJournalSince(Generation generation) const;
+    [[nodiscard]] DevicesSnapshot getSnapshot();
+    void updateBuffersMemory() noexcept;
+    void emitSignal(const char* signalName, const Glib::VariantContainerBase& args);
+
     void onBusAcquired(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name);
     void onNameAcquired(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name);
     void onNameLost(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name);
 
+    void onTrayWatcherAppeared(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name, const Glib::ustring& nameOwner);
+    void onTrayWatcherVanished(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& name);
+    void cancelTrayRegistration();
+
     void onMethodCall(const Glib::RefPtr<Gio::DBus::Connection>& connection, const Glib::ustring& sender, const Glib::ustring& objectPath,
                       const Glib::ustring& interfaceName, const Glib::ustring& methodName, const Glib::VariantContainerBase& parameters,
                       const Glib::RefPtr<Gio::DBus::MethodInvocation>& invocation);
@@ -92,10 +264,21 @@ private:
     MethodResult onSubscribeToDeviceUpdatedSignalMethod(const MethodParameters& parameters);
     MethodResult onUnsubscribeFromDeviceUpdatedSignalMethod(const MethodParameters& parameters);
 
-    MethodResult onSetDeviceVolumeMethod(const MethodParameters& parameters);
-    MethodResult onSetDeviceMuteMethod(const MethodParameters& parameters);
+    void onSetDeviceVolumeMethod(const MethodParameters& parameters, MethodReply reply);
+    void onAdjustDeviceVolumeMethod(const MethodParameters& parameters, MethodReply reply);
+    void onRampDeviceVolumeMethod(const MethodParameters& parameters, MethodReply reply);
+    void onSetDeviceMuteMethod(const MethodParameters& parameters, MethodReply reply);
+
+    void onMakeDeviceDefaultMethod(const MethodParameters& parameters, MethodReply reply);
 
-    MethodResult onMakeDeviceDefaultMethod(const MethodParameters& parameters);
+    void onSetDevicesStateMethod(const MethodParameters& parameters, MethodReply reply);
+    void onSetAppVmVolumeMethod(const MethodParameters& parameters, MethodReply reply);
+    void onSetAppVmMuteMethod(const MethodParameters& parameters, MethodReply reply);
+    void onMoveDeviceMethod(const MethodParameters& parameters, MethodReply reply);
+    void onMoveAppVmMethod(const MethodParameters& parameters, MethodReply reply);
+    MethodResult onGetAllDevicesMethod(const MethodParameters& parameters);
+    MethodResult onGetStreamsMetadataMethod(const MethodParameters& parameters);
+    MethodResult onGetStatsMethod(const MethodParameters& parameters);
 
     MethodResult onActivateMethod(const MethodParameters& parameters);
 
@@ -105,19 +288,41 @@ private:
     SubscribeToDeviceUpdatedSignalSignature m_subscribeToDeviceUpdatedSignal;
 
     SetDeviceVolumeSignalSignature m_setDeviceVolumeSignal;
+    AdjustDeviceVolumeSignalSignature m_adjustDeviceVolumeSignal;
+    RampDeviceVolumeSignalSignature m_rampDeviceVolumeSignal;
     SetDeviceMuteSignalSignature m_setDeviceMuteSignal;
 
     MakeDeviceDefaultSignalSignature m_makeDeviceDefaultSignal;
+    SetDevicesStateSignalSignature m_setDevicesStateSignal;
+    SetAppVmVolumeSignalSignature m_setAppVmVolumeSignal;
+    SetAppVmMuteSignalSignature m_setAppVmMuteSignal;
+    MoveDeviceSignalSignature m_moveDeviceSignal;
+    MoveAppVmSignalSignature m_moveAppVmSignal;
+    GetAllDevicesSignalSignature m_getAllDevicesSignal;
+    GetStreamsMetadataSignalSignature m_getStreamsMetadataSignal;
 
     Gio::DBus::InterfaceVTable m_interfaceVtable;
     Glib::RefPtr<Gio::DBus::NodeInfo> m_introspectionData;
 
-    std::map<std::string, MethodCallHandler> m_audioControlServiceMethodHandlers;
-    std::map<std::string, MethodCallHandler> m_statusNotifierItemMethodHandlers;
+    std::deque<QueuedCall> m_bulkCalls;
+    sigc::connection m_bulkCallsDrain;
 
     std::optional<Glib::ustring> m_iconName;
+    guint m_trayWatcherId = 0;
+    Glib::RefPtr<Gio::Cancellable> m_trayRegistration; // The registration waiting for the reply of the watcher
 
     Glib::RefPtr<Gio::DBus::Connection> m_connection;
 
+    std::map<std::pair<DeviceType, DeviceIndex>, DeviceInfo> m_pendingDeviceInfo;
+    sigc::connection m_pendingDeviceInfoFlush;
+    std::chrono::milliseconds m_updatesFlushInterval = DefaultUpdatesFlushInterval;
+    bool m_isBatchedUpdatesEnabled = false;
+
+    // The latest changes in the order of their generations, to let reconnecting clients catch up
+    std::deque<DeviceInfo> m_journal;
+    Generation m_lastGeneration = 0;
+
+    ghaf::AudioControl::MemoryCharge m_buffersMemory{ghaf::AudioControl::MemorySubsystem::DBusBuffers, 0, 0};
+
     guint m_connectionId;
 };
@@ -0,0 +1,762 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "PeerAggregator.hpp"
+
+#include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
+
+#include <giomm/dbuswatchname.h>
+#include <glibmm/main.h>
+
+#include <algorithm>
+#include <ranges>
+#include <set>
+#include <typeinfo>
+#include <utility>
+
+using namespace ghaf::AudioControl;
+
+namespace
+{
+
+// The interface of the peers is the one of this service
+namespace AudioControlService
+{
+
+constexpr auto ServiceName = "org.ghaf.Audio";
+constexpr auto ObjectPath = "/org/ghaf/Audio";
+constexpr auto InterfaceName = "org.ghaf.Audio";
+
+namespace MethodName
+{
+
+constexpr auto SubscribeToDeviceUpdatedSignal = "SubscribeToDeviceUpdatedSignal";
+
+constexpr auto SetDeviceVolume = "SetDeviceVolume";
+constexpr auto AdjustDeviceVolume = "AdjustDeviceVolume";
+constexpr auto RampDeviceVolume = "RampDeviceVolume";
+constexpr auto SetDeviceMute = "SetDeviceMute";
+constexpr auto MakeDeviceDefault = "MakeDeviceDefault";
+
+constexpr auto SetDevicesState = "SetDevicesState";
+constexpr auto SetAppVmVolume = "SetAppVmVolume";
+constexpr auto SetAppVmMute = "SetAppVmMute";
+
+constexpr auto MoveDevice = "MoveDevice";
+constexpr auto MoveAppVm = "MoveAppVm";
+
+} // namespace MethodName
+
+namespace SignalName
+{
+
+constexpr auto DeviceUpdated = "DeviceUpdated";
+
+}
+
+} // namespace AudioControlService
+
+constexpr size_t LocalNode = 0;
+
+using DeviceInfoTuple = std::tuple<int, int, Glib::ustring, int, bool, bool, int, guint64>;
+using DeviceStateTuple = std::tuple<int, int, int, int>;
+
+Metrics::Counter& DeviceUpdatesCounter = Metrics::GetCounter("peer_device_updates_total");
+Metrics::Counter& ReconnectsCounter = Metrics::GetCounter("peer_reconnects_total");
+Metrics::Counter& SucceededCallsCounter = Metrics::GetCounter("peer_calls_total{result=\"ok\"}");
+Metrics::Counter& FailedCallsCounter = Metrics::GetCounter("peer_calls_total{result=\"failed\"}");
+Metrics::Gauge& DevicesGauge = Metrics::GetGauge("peer_devices");
+
+// The merged ids of the peer devices count down from -1, they are int on D-Bus too
+PeerAggregator::DeviceIndex MakePeerDeviceId(int32_t sequence)
+{
+    return static_cast<PeerAggregator::DeviceIndex>(-static_cast<int64_t>(sequence));
+}
+
+std::optional<PeerAggregator::DeviceType> IntToDeviceType(int value)
+{
+    if (value < static_cast<int>(PeerAggregator::DeviceType::Sink) || value > static_cast<int>(PeerAggregator::DeviceType::SourceOutput))
+        return std::nullopt;
+
+    return static_cast<PeerAggregator::DeviceType>(value);
+}
+
+int DeviceTypeToInt(PeerAggregator::DeviceType type)
+{
+    return static_cast<int>(type);
+}
+
+std::optional<DBusService::DeviceEventType> IntToEventType(int value)
+{
+    if (value < static_cast<int>(DBusService::DeviceEventType::Add) || value > static_cast<int>(DBusService::DeviceEventType::Delete))
+        return std::nullopt;
+
+    return static_cast<DBusService::DeviceEventType>(value);
+}
+
+PeerAggregator::Result IntToResult(int value)
+{
+    if (value < static_cast<int>(PeerAggregator::Result::Ok) || value > static_cast<int>(PeerAggregator::Result::Failed))
+        return PeerAggregator::Result::Failed;
+
+    return static_cast<PeerAggregator::Result>(value);
+}
+
+std::optional<PeerAggregator::DeviceInfo> ParseDeviceInfo(const DeviceInfoTuple& tuple)
+{
+    const auto& [id, type, name, volume, isMuted, isDefault, eventType, generation] = tuple;
+
+    const auto deviceType = IntToDeviceType(type);
+    const auto deviceEventType = IntToEventType(eventType);
+
+    if (id < 0 || !deviceType || !deviceEventType || volume < Volume::Min || volume > Volume::Max)
+    {
+        Logger::error("PeerAggregator: invalid device: id: {}, type: {}, volume: {}, event: {}", id, type, volume, eventType);
+        return std::nullopt;
+    }
+
+    return PeerAggregator::DeviceInfo{.index = static_cast<PeerAggregator::DeviceIndex>(id),
+                                      .type = *deviceType,
+                                      .name = InternedString{name.raw()},
+                                      .volume = Volume::fromPercents(static_cast<unsigned>(volume)),
+                                      .isMuted = isMuted,
+                                      .isDefault = isDefault,
+                                      .eventType = *deviceEventType,
+                                      .generation = generation};
+}
+
+// Failed for a call that failed or for an unexpected reply
+PeerAggregator::Result ParseResult(const std::optional<Glib::VariantContainerBase>& reply)
+{
+    if (!reply)
+        return PeerAggregator::Result::Failed;
+
+    try
+    {
+        Glib::Variant<int> value;
+        reply->get_child(value, 0);
+
+        return IntToResult(value.get());
+    }
+    catch (const std::bad_cast& ex)
+    {
+        Logger::error("PeerAggregator: unexpected result: {}", ex.what());
+        return PeerAggregator::Result::Failed;
+    }
+}
+
+template<class... Args>
+Glib::VariantContainerBase CreateParameters(Args... args)
+{
+    return Glib::VariantContainerBase::create_tuple(std::vector<Glib::VariantBase>{Glib::Variant<Args>::create(args)...});
+}
+
+// Collects the results of the parts of a call sent to several nodes at once. Done once the last part has replied
+struct SplitCall
+{
+    std::vector<PeerAggregator::Result> results;
+    size_t pendingParts;
+    PeerAggregator::ResultsCallback onDone;
+
+    void complete(const std::vector<size_t>& positions, const std::vector<PeerAggregator::Result>& partResults)
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+            results[positions[i]] = i < partResults.size() ? partResults[i] : PeerAggregator::Result::Failed;
+
+        if (--pendingParts == 0)
+            onDone(std::move(results));
+    }
+};
+
+// The node that hasn't got the AppVM has nothing to do, so NoSuchDevice only when none of them has got it
+PeerAggregator::Result MergeAppVmResults(const std::vector<PeerAggregator::Result>& results)
+{
+    using Result = PeerAggregator::Result;
+
+    if (std::ranges::all_of(results, [](Result result) { return result == Result::NoSuchDevice; }))
+        return Result::NoSuchDevice;
+
+    for (const Result result : results)
+        if (result != Result::Ok && result != Result::NoSuchDevice)
+            return result;
+
+    return Result::Ok;
+}
+
+} // namespace
+
+PeerAggregator::PeerAggregator(const std::vector<std::string>& addresses)
+{
+    for (const auto& address : addresses)
+    {
+        auto& peer = m_peers.emplace_back(std::make_unique<Peer>(Peer{.node = m_peers.size() + 1, .address = address}));
+        connect(*peer);
+    }
+}
+
+PeerAggregator::~PeerAggregator()
+{
+    m_cancellable->cancel();
+
+    for (const auto& peer : m_peers)
+    {
+        peer->reconnect.disconnect();
+        peer->closed.disconnect();
+
+        if (peer->connection && peer->deviceUpdatedSubscription != 0)
+            peer->connection->signal_unsubscribe(peer->deviceUpdatedSubscription);
+
+        if (peer->nameWatch != 0)
+            Gio::DBus::unwatch_name(peer->nameWatch);
+    }
+}
+
+std::vector<PeerAggregator::DeviceInfo> PeerAggregator::getDevices() const
+{
+    std::vector<DeviceInfo> devices;
+    devices.reserve(m_devices.size());
+
+    for (const auto& device : m_devices | std::views::values)
+    {
+        devices.push_back(device.info);
+        devices.back().eventType = DBusService::DeviceEventType::Add;
+    }
+
+    return devices;
+}
+
+void PeerAggregator::setDeviceVolume(DeviceIndex id, DeviceType type, Volume volume, ResultCallback onDone)
+{
+    const auto* device = findDevice(id, type);
+    if (device == nullptr)
+    {
+        onDone(Result::NoSuchDevice);
+        return;
+    }
+
+    callForResult(*device, AudioControlService::MethodName::SetDeviceVolume,
+                  CreateParameters(static_cast<int>(device->peerIndex), DeviceTypeToInt(type), static_cast<int>(volume.getPercents())), std::move(onDone));
+}
+
+void PeerAggregator::adjustDeviceVolume(DeviceIndex id, DeviceType type, int delta, ResultCallback onDone)
+{
+    const auto* device = findDevice(id, type);
+    if (device == nullptr)
+    {
+        onDone(Result::NoSuchDevice);
+        return;
+    }
+
+    callForResult(*device, AudioControlService::MethodName::AdjustDeviceVolume,
+                  CreateParameters(static_cast<int>(device->peerIndex), DeviceTypeToInt(type), delta), std::move(onDone));
+}
+
+void PeerAggregator::rampDeviceVolume(DeviceIndex id, DeviceType type, Volume target, std::chrono::milliseconds duration, ResultCallback onDone)
+{
+    const auto* device = findDevice(id, type);
+    if (device == nullptr)
+    {
+        onDone(Result::NoSuchDevice);
+        return;
+    }
+
+    callForResult(*device, AudioControlService::MethodName::RampDeviceVolume,
+                  CreateParameters(static_cast<int>(device->peerIndex), DeviceTypeToInt(type), static_cast<int>(target.getPercents()),
+                                   static_cast<int>(duration.count())),
+                  std::move(onDone));
+}
+
+void PeerAggregator::setDeviceMute(DeviceIndex id, DeviceType type, bool mute, ResultCallback onDone)
+{
+    const auto* device = findDevice(id, type);
+    if (device == nullptr)
+    {
+        onDone(Result::NoSuchDevice);
+        return;
+    }
+
+    callForResult(*device, AudioControlService::MethodName::SetDeviceMute, CreateParameters(static_cast<int>(device->peerIndex), DeviceTypeToInt(type), mute),
+                  std::move(onDone));
+}
+
+void PeerAggregator::makeDeviceDefault(DeviceIndex id, DeviceType type, ResultCallback onDone)
+{
+    const auto* device = findDevice(id, type);
+    if (device == nullptr)
+    {
+        onDone(Result::NoSuchDevice);
+        return;
+    }
+
+    callForResult(*device, AudioControlService::MethodName::MakeDeviceDefault, CreateParameters(static_cast<int>(device->peerIndex), DeviceTypeToInt(type)),
+                  std::move(onDone));
+}
+
+void PeerAggregator::moveDevice(DeviceIndex id, DeviceType type, DeviceIndex target, ResultCallback onDone)
+{
+    const auto* device = findDevice(id, type);
+    if (device == nullptr)
+    {
+        onDone(Result::NoSuchDevice);
+        return;
+    }
+
+    const auto targetType = type == DeviceType::SinkInput ? DeviceType::Sink : DeviceType::Source;
+    const auto* targetDevice = findDevice(target, targetType);
+
+    if (targetDevice == nullptr || targetDevice->node != device->node)
+    {
+        Logger::error("PeerAggregator::moveDevice: the target {} is not on the node {} of the device {}", static_cast<int64_t>(target), device->node,
+                      static_cast<int64_t>(id));
+        onDone(Result::InvalidArgument);
+        return;
+    }
+
+    callForResult(*device, AudioControlService::MethodName::MoveDevice,
+                  CreateParameters(static_cast<int>(device->peerIndex), DeviceTypeToInt(type), static_cast<int>(targetDevice->peerIndex)), std::move(onDone));
+}
+
+void PeerAggregator::setDevicesState(const std::vector<DeviceStateRequest>& requests, const LocalDevicesStateCall& setLocal, ResultsCallback onDone)
+{
+    // The positions of the requests in the batch, by the node
+    std::map<size_t, std::vector<size_t>> positions;
+
+    // An unknown peer device is no such device, as the backend tells of an unknown local one
+    std::vector<Result> results(requests.size(), Result::NoSuchDevice);
+
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        if (!IsPeerDevice(requests[i].index))
+            positions[LocalNode].push_back(i);
+        else if (const auto* device = findDevice(requests[i].index, requests[i].type))
+            positions[device->node].push_back(i);
+    }
+
+    if (positions.empty())
+    {
+        onDone(std::move(results));
+        return;
+    }
+
+    auto split = std::make_shared<SplitCall>(SplitCall{.results = std::move(results), .pendingParts = positions.size(), .onDone = std::move(onDone)});
+
+    for (auto& [node, nodePositions] : positions)
+    {
+        auto onPartDone = [split, nodePositions](const std::vector<Result>& partResults) { split->complete(nodePositions, partResults); };
+
+        if (node == LocalNode)
+        {
+            std::vector<DeviceStateRequest> localRequests;
+            localRequests.reserve(nodePositions.size());
+
+            for (const size_t position : nodePositions)
+                localRequests.push_back(requests[position]);
+
+            setLocal(localRequests, std::move(onPartDone));
+            continue;
+        }
+
+        std::vector<DeviceStateTuple> items;
+        items.reserve(nodePositions.size());
+
+        for (const size_t position : nodePositions)
+        {
+            const auto& request = requests[position];
+
+            items.emplace_back(static_cast<int>(m_devices.at(request.index).peerIndex), DeviceTypeToInt(request.type), request.mute ? int{*request.mute} : -1,
+                               request.volume ? static_cast<int>(request.volume->getPercents()) : -1);
+        }
+
+        call(*m_peers[node - 1], AudioControlService::MethodName::SetDevicesState,
+             Glib::VariantContainerBase::create_tuple(Glib::Variant<std::vector<DeviceStateTuple>>::create(items)),
+             [onPartDone = std::move(onPartDone), size = nodePositions.size()](std::optional<Glib::VariantContainerBase> reply)
+             {
+                 std::vector<Result> partResults(size, Result::Failed);
+
+                 try
+                 {
+                     if (reply)
+                     {
+                         Glib::Variant<std::vector<int>> values;
+                         reply->get_child(values, 0);
+
+                         for (size_t i = 0; const int value : values.get())
+                             if (i < size)
+                                 partResults[i++] = IntToResult(value);
+                     }
+                 }
+                 catch (const std::bad_cast& ex)
+                 {
+                     Logger::error("PeerAggregator::setDevicesState: unexpected reply: {}", ex.what());
+                 }
+
+                 onPartDone(partResults);
+             });
+    }
+}
+
+void PeerAggregator::setAppVmVolume(const std::string& appVmName, Volume volume, const LocalAppVmCall& setLocal, ResultCallback onDone)
+{
+    callAppVm(AudioControlService::MethodName::SetAppVmVolume, CreateParameters(Glib::ustring(appVmName), static_cast<int>(volume.getPercents())), setLocal,
+              std::move(onDone));
+}
+
+void PeerAggregator::setAppVmMute(const std::string& appVmName, bool mute, const LocalAppVmCall& setLocal, ResultCallback onDone)
+{
+    callAppVm(AudioControlService::MethodName::SetAppVmMute, CreateParameters(Glib::ustring(appVmName), mute), setLocal, std::move(onDone));
+}
+
+void PeerAggregator::moveAppVm(const std::string& appVmName, DeviceIndex target, const LocalAppVmCall& moveLocal, ResultCallback onDone)
+{
+    if (!IsPeerDevice(target))
+    {
+        moveLocal(std::move(onDone));
+        return;
+    }
+
+    const auto* targetDevice = findDevice(target, DeviceType::Sink);
+    if (targetDevice == nullptr)
+    {
+        onDone(Result::NoSuchDevice);
+        return;
+    }
+
+    callForResult(*targetDevice, AudioControlService::MethodName::MoveAppVm,
+                  CreateParameters(Glib::ustring(appVmName), static_cast<int>(targetDevice->peerIndex)), std::move(onDone));
+}
+
+void PeerAggregator::connect(Peer& peer)
+{
+    Logger::info("PeerAggregator: connecting to the peer {}: {}", peer.node, peer.address);
+
+    const auto cancellable = m_cancellable;
+
+    Gio::DBus::Connection::create_for_address(
+        peer.address,
+        [this, &peer, cancellable](Glib::RefPtr<Gio::AsyncResult>& result)
+        {
+            if (cancellable->is_cancelled())
+                return;
+
+            try
+            {
+                onConnected(peer, Gio::DBus::Connection::create_for_address_finish(result));
+            }
+            catch (const Glib::Error& ex)
+            {
+                Logger::error("PeerAggregator: couldn't connect to the peer {}: {}", peer.node, ex.what().c_str());
+
+                peer.reconnect = Glib::signal_timeout().connect(
+                    [this, &peer]
+                    {
+                        connect(peer);
+                        return false;
+                    },
+                    ReconnectInterval.count());
+            }
+        },
+        cancellable, Gio::DBus::CONNECTION_FLAGS_AUTHENTICATION_CLIENT | Gio::DBus::CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION);
+}
+
+void PeerAggregator::onConnected(Peer& peer, Glib::RefPtr<Gio::DBus::Connection> connection)
+{
+    Logger::info("PeerAggregator: connected to the peer {}", peer.node);
+
+    peer.connection = std::move(connection);
+    peer.connection->set_exit_on_close(false);
+
+    peer.closed = peer.connection->signal_closed().connect([this, &peer]([[maybe_unused]] bool remotePeerVanished, [[maybe_unused]] const Glib::Error& error)
+                                                           { onClosed(peer); });
+
+    // Before the subscription, so no change falls between its reply and the first signal
+    peer.deviceUpdatedSubscription = peer.connection->signal_subscribe(
+        [this, &peer]([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection, [[maybe_unused]] const Glib::ustring& sender,
+                      [[maybe_unused]] const Glib::ustring& objectPath, [[maybe_unused]] const Glib::ustring& interfaceName,
+                      [[maybe_unused]] const Glib::ustring& signalName, const Glib::VariantContainerBase& parameters) { onDeviceUpdated(peer, parameters); },
+        AudioControlService::ServiceName, AudioControlService::InterfaceName, AudioControlService::SignalName::DeviceUpdated, AudioControlService::ObjectPath);
+
+    // The service may restart on the bus without the connection closing, so it is synchronized with each of its owners,
+    // the first one included once it is found
+    peer.nameWatch = Gio::DBus::watch_name(
+        peer.connection, AudioControlService::ServiceName,
+        [this, &peer]([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection, [[maybe_unused]] Glib::ustring name,
+                      const Glib::ustring& owner) { onOwnerChanged(peer, owner); },
+        [this, &peer]([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection, [[maybe_unused]] Glib::ustring name)
+        { onOwnerChanged(peer, {}); });
+}
+
+void PeerAggregator::onOwnerChanged(Peer& peer, const Glib::ustring& owner)
+{
+    peer.isSynchronized = false;
+    peer.syncGeneration = 0;
+
+    // The instance is kept, the service coming back is another one then, with another unique name
+    if (owner.empty())
+    {
+        Logger::error("PeerAggregator: the service of the peer {} is gone, its devices are kept till it is back", peer.node);
+        return;
+    }
+
+    // The generations of another instance say nothing of this one's: only a snapshot, which the generation 0 always gets,
+    // is sure to be of it. The same owner on the same bus after a reconnect is the same instance, with the changes since the last one applied.
+    // A restarted bus gives the unique names from the start again, but has another GUID
+    if (std::string instance = peer.connection->get_guid() + owner.raw(); instance != peer.instance)
+    {
+        Logger::info("PeerAggregator: the service of the peer {} is {}", peer.node, owner.c_str());
+
+        peer.instance = std::move(instance);
+        peer.generation = 0;
+    }
+
+    synchronize(peer);
+}
+
+void PeerAggregator::onClosed(Peer& peer)
+{
+    Logger::error("PeerAggregator: the connection to the peer {} is closed, {} devices are kept till it is back", peer.node,
+                  std::ranges::count(m_devices | std::views::values, peer.node, &PeerDevice::node));
+
+    ReconnectsCounter.increment();
+
+    peer.closed.disconnect();
+    peer.connection->signal_unsubscribe(peer.deviceUpdatedSubscription);
+    peer.deviceUpdatedSubscription = 0;
+    Gio::DBus::unwatch_name(peer.nameWatch);
+    peer.nameWatch = 0;
+    peer.isSynchronized = false;
+    peer.connection.reset();
+
+    peer.reconnect = Glib::signal_timeout().connect(
+        [this, &peer]
+        {
+            connect(peer);
+            return false;
+        },
+        ReconnectInterval.count());
+}
+
+void PeerAggregator::synchronize(Peer& peer)
+{
+    call(peer, AudioControlService::MethodName::SubscribeToDeviceUpdatedSignal, CreateParameters(static_cast<guint64>(peer.generation)),
+         [this, &peer, instance = peer.instance](std::optional<Glib::VariantContainerBase> reply)
+         {
+             if (!reply)
+                 return; // The connection is closed then, and the peer is synchronized once it is back
+
+             if (instance != peer.instance)
+                 return; // Of an instance gone since, the current one has a synchronization of its own
+
+             std::vector<DeviceInfo> devices;
+             Glib::Variant<guint64> generation;
+             Glib::Variant<bool> isSnapshot;
+
+             try
+             {
+                 Glib::Variant<std::vector<DeviceInfoTuple>> deviceTuples;
+
+                 reply->get_child(generation, 0);
+                 reply->get_child(isSnapshot, 1);
+                 reply->get_child(deviceTuples, 2);
+
+                 for (const auto& tuple : deviceTuples.get())
+                     if (auto info = ParseDeviceInfo(tuple))
+                         devices.push_back(std::move(*info));
+             }
+             catch (const std::bad_cast& ex)
+             {
+                 Logger::error("PeerAggregator: unexpected subscription reply of the peer {}: {}", peer.node, ex.what());
+                 return;
+             }
+
+             Logger::debug("PeerAggregator: the peer {} is at the generation {}, {} {}", peer.node, generation.get(), devices.size(),
+                           isSnapshot.get() ? "devices" : "changes");
+
+             if (isSnapshot.get())
+                 applySnapshot(peer, devices);
+             else
+                 for (auto& info : devices)
+                     applyChange(peer, std::move(info));
+
+             peer.isSynchronized = true;
+             peer.syncGeneration = generation.get();
+             peer.generation = generation.get();
+         });
+}
+
+void PeerAggregator::onDeviceUpdated(Peer& peer, const Glib::VariantContainerBase& parameters)
+{
+    std::optional<DeviceInfo> info;
+
+    try
+    {
+        info = ParseDeviceInfo(Glib::VariantBase::cast_dynamic<Glib::Variant<DeviceInfoTuple>>(parameters).get());
+    }
+    catch (const std::bad_cast& ex)
+    {
+        Logger::error("PeerAggregator: unexpected DeviceUpdated signal of the peer {}: {}", peer.node, ex.what());
+        return;
+    }
+
+    if (!info || !peer.isSynchronized || info->generation <= peer.syncGeneration)
+        return;
+
+    peer.generation = std::max(peer.generation, info->generation);
+    applyChange(peer, std::move(*info));
+}
+
+void PeerAggregator::applySnapshot(Peer& peer, const std::vector<DeviceInfo>& devices)
+{
+    // The snapshot is the state of the peer now, whatever generations it was known by before
+    for (auto& device : m_devices | std::views::values)
+        if (device.node == peer.node)
+            device.peerGeneration = 0;
+
+    std::set<PeerDeviceKey> present;
+
+    for (const auto& info : devices)
+    {
+        present.emplace(peer.node, info.type, info.index);
+        applyChange(peer, info);
+    }
+
+    // The devices gone while the peer was away
+    std::vector<DeviceInfo> gone;
+
+    for (const auto& [key, id] : m_ids)
+        if (std::get<0>(key) == peer.node && !present.contains(key))
+        {
+            gone.push_back(m_devices.at(id).info);
+            gone.back().index = std::get<2>(key);
+            gone.back().eventType = DBusService::DeviceEventType::Delete;
+        }
+
+    for (auto& info : gone)
+        applyChange(peer, std::move(info));
+}
+
+void PeerAggregator::applyChange(Peer& peer, DeviceInfo info)
+{
+    const PeerDeviceKey key{peer.node, info.type, info.index};
+    const auto idIter = m_ids.find(key);
+
+    if (info.eventType == DBusService::DeviceEventType::Delete)
+    {
+        if (idIter == m_ids.end())
+            return;
+
+        info.index = idIter->second;
+
+        m_devices.erase(idIter->second);
+        m_ids.erase(idIter);
+    }
+    else if (idIter == m_ids.end())
+    {
+        const DeviceIndex id = MakePeerDeviceId(++m_lastDeviceId);
+        const DeviceIndex peerIndex = info.index;
+
+        info.index = id;
+        info.eventType = DBusService::DeviceEventType::Add;
+
+        m_ids.emplace(key, id);
+        m_devices.emplace(id, PeerDevice{.node = peer.node, .peerIndex = peerIndex, .peerGeneration = info.generation, .info = info});
+    }
+    else
+    {
+        auto& device = m_devices.at(idIter->second);
+
+        // A snapshot has the devices that haven't changed too, and a signal may come again with the replay of the journal
+        if (info.generation <= device.peerGeneration)
+            return;
+
+        info.index = idIter->second;
+        info.eventType = DBusService::DeviceEventType::Update;
+
+        const bool isSame = info.name == device.info.name && info.volume == device.info.volume && info.isMuted == device.info.isMuted &&
+                            info.isDefault == device.info.isDefault;
+
+        device.peerGeneration = info.generation;
+        device.info = info;
+
+        if (isSame)
+            return;
+    }
+
+    DeviceUpdatesCounter.increment();
+    DevicesGauge.set(static_cast<int64_t>(m_devices.size()));
+
+    m_onDeviceInfo(std::move(info));
+}
+
+const PeerAggregator::PeerDevice* PeerAggregator::findDevice(DeviceIndex id, DeviceType type) const
+{
+    const auto iter = m_devices.find(id);
+    return iter != m_devices.end() && iter->second.info.type == type ? &iter->second : nullptr;
+}
+
+void PeerAggregator::call(Peer& peer, const char* method, const Glib::VariantContainerBase& parameters, CallReply onReply)
+{
+    if (!peer.connection)
+    {
+        Logger::error("PeerAggregator: {} to the peer {}: not connected", method, peer.node);
+        FailedCallsCounter.increment();
+        onReply(std::nullopt);
+        return;
+    }
+
+    const auto cancellable = m_cancellable;
+    const auto connection = peer.connection;
+
+    connection->call(
+        AudioControlService::ObjectPath, AudioControlService::InterfaceName, method, parameters,
+        [connection, cancellable, method, node = peer.node, onReply = std::move(onReply)](Glib::RefPtr<Gio::AsyncResult>& result)
+        {
+            if (cancellable->is_cancelled())
+                return;
+
+            std::optional<Glib::VariantContainerBase> reply;
+
+            try
+            {
+                reply = connection->call_finish(result);
+                SucceededCallsCounter.increment();
+            }
+            catch (const Glib::Error& ex)
+            {
+                Logger::error("PeerAggregator: {} to the peer {} failed: {}", method, node, ex.what().c_str());
+                FailedCallsCounter.increment();
+            }
+
+            onReply(std::move(reply));
+        },
+        cancellable, AudioControlService::ServiceName, static_cast<int>(CallTimeout.count()));
+}
+
+void PeerAggregator::callForResult(const PeerDevice& device, const char* method, const Glib::VariantContainerBase& parameters, ResultCallback onDone)
+{
+    call(*m_peers[device.node - 1], method, parameters,
+         [onDone = std::move(onDone)](std::optional<Glib::VariantContainerBase> reply) { onDone(ParseResult(reply)); });
+}
+
+void PeerAggregator::callAppVm(const char* method, const Glib::VariantContainerBase& parameters, const LocalAppVmCall& callLocal, ResultCallback onDone)
+{
+    // Only the peers that are connected, an AppVM of the others can't be told from a missing one
+    std::vector<Peer*> peers;
+
+    for (const auto& peer : m_peers)
+        if (peer->connection)
+            peers.push_back(peer.get());
+
+    auto split = std::make_shared<SplitCall>(SplitCall{.results = std::vector<Result>(peers.size() + 1, Result::Failed),
+                                                       .pendingParts = peers.size() + 1,
+                                                       .onDone = [onDone = std::move(onDone)](std::vector<Result> results)
+                                                       { onDone(MergeAppVmResults(results)); }});
+
+    callLocal([split](Result result) { split->complete({LocalNode}, {result}); });
+
+    for (size_t i = 0; i < peers.size(); ++i)
+        call(*peers[i], method, parameters,
+             [split, position = i + 1](std::optional<Glib::VariantContainerBase> reply) { split->complete({position}, {ParseResult(reply)}); });
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "DBusService.hpp"
+
+#include <giomm/cancellable.h>
+#include <giomm/dbusconnection.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Merges the devices of the other instances of the service, each serving on a D-Bus of its own, e.g. the session bus of another
+// audio VM forwarded over vsock, into the devices this one serves. A peer is synchronized with the changes since the generation
+// it was left at, or from a snapshot once its service has restarted, and is reconnected to when it goes away, keeping its devices meanwhile.
+// The devices of the peers have negative ids, so they never meet the local ones, and their control calls go to their nodes
+class PeerAggregator final
+{
+public:
+    using DeviceIndex = DBusService::DeviceIndex;
+    using DeviceType = DBusService::DeviceType;
+    using DeviceInfo = DBusService::DeviceInfo;
+    using DeviceStateRequest = DBusService::DeviceStateRequest;
+    using Generation = DBusService::Generation;
+    using Result = DBusService::Result;
+    using ResultCallback = DBusService::ResultCallback;
+    using ResultsCallback = DBusService::ResultsCallback;
+    using Volume = ghaf::AudioControl::Volume;
+
+    // Emitted with a merged id, and with the generation of the peer: the service stamps its own
+    using OnDeviceInfoSignal = sigc::signal<void(DeviceInfo)>;
+
+    // The part of a batch or of an AppVM call for the devices of this instance
+    using LocalDevicesStateCall = std::function<void(const std::vector<DeviceStateRequest>& requests, ResultsCallback onDone)>;
+    using LocalAppVmCall = std::function<void(ResultCallback onDone)>;
+
+    static constexpr std::chrono::milliseconds ReconnectInterval{2000};
+    static constexpr std::chrono::milliseconds CallTimeout{5000};
+
+    // The D-Bus addresses of the buses the peers serve on, e.g. unix:path=/run/audiovm2/bus
+    explicit PeerAggregator(const std::vector<std::string>& addresses);
+    ~PeerAggregator();
+
+    PeerAggregator(const PeerAggregator&) = delete;
+    PeerAggregator& operator=(const PeerAggregator&) = delete;
+
+    // The ids come from D-Bus as int, so the negative ones are sign extended here
+    [[nodiscard]] static bool IsPeerDevice(DeviceIndex id) noexcept
+    {
+        return static_cast<int64_t>(id) < 0;
+    }
+
+    [[nodiscard]] OnDeviceInfoSignal& onDeviceInfo() noexcept
+    {
+        return m_onDeviceInfo;
+    }
+
+    // With the Add event, for the snapshots of the service
+    [[nodiscard]] std::vector<DeviceInfo> getDevices() const;
+
+    // For the ids of the peer devices only. NoSuchDevice for an unknown one, Failed if its peer can't be reached
+    void setDeviceVolume(DeviceIndex id, DeviceType type, Volume volume, ResultCallback onDone);
+    void adjustDeviceVolume(DeviceIndex id, DeviceType type, int delta, ResultCallback onDone);
+    void rampDeviceVolume(DeviceIndex id, DeviceType type, Volume target, std::chrono::milliseconds duration, ResultCallback onDone);
+    void setDeviceMute(DeviceIndex id, DeviceType type, bool mute, ResultCallback onDone);
+    void makeDeviceDefault(DeviceIndex id, DeviceType type, ResultCallback onDone);
+
+    // The target is of the same peer, a stream doesn't move between the nodes
+    void moveDevice(DeviceIndex id, DeviceType type, DeviceIndex target, ResultCallback onDone);
+
+    // Split by the node, and sent to all of them at once. The results are in the order of the requests
+    void setDevicesState(const std::vector<DeviceStateRequest>& requests, const LocalDevicesStateCall& setLocal, ResultsCallback onDone);
+
+    // To this instance and to all the connected peers at once. NoSuchDevice only when none of them has the AppVM,
+    // otherwise the first failure, if any
+    void setAppVmVolume(const std::string& appVmName, Volume volume, const LocalAppVmCall& setLocal, ResultCallback onDone);
+    void setAppVmMute(const std::string& appVmName, bool mute, const LocalAppVmCall& setLocal, ResultCallback onDone);
+
+    // Only the streams of the node of the target sink move
+    void moveAppVm(const std::string& appVmName, DeviceIndex target, const LocalAppVmCall& moveLocal, ResultCallback onDone);
+
+private:
+    struct Peer
+    {
+        size_t node; // From 1, 0 is this instance
+        std::string address;
+
+        Glib::RefPtr<Gio::DBus::Connection> connection;
+        guint deviceUpdatedSubscription = 0;
+        sigc::connection closed;
+        sigc::connection reconnect;
+        guint nameWatch = 0;
+
+        std::string instance; // The bus GUID and the unique name of the service the generations are of, kept over a reconnect
+
+        // Till the subscription of a connection replies, its signals are of the changes the reply has already.
+        // The signals up to its generation may come after it too, the pending updates of the peer are sent later
+        bool isSynchronized = false;
+        Generation syncGeneration = 0;
+
+        Generation generation = 0; // The latest change applied, to synchronize from after a reconnect to the same instance
+    };
+
+    struct PeerDevice
+    {
+        size_t node;
+        DeviceIndex peerIndex;
+        Generation peerGeneration;
+        DeviceInfo info; // With the merged id
+    };
+
+    using PeerDeviceKey = std::tuple<size_t, DeviceType, DeviceIndex>;
+    using CallReply = std::function<void(std::optional<Glib::VariantContainerBase> reply)>; // Empty on a failure
+
+    void connect(Peer& peer);
+    void onConnected(Peer& peer, Glib::RefPtr<Gio::DBus::Connection> connection);
+    void onOwnerChanged(Peer& peer, const Glib::ustring& owner); // Empty when the service is gone
+    void onClosed(Peer& peer);
+    void synchronize(Peer& peer);
+
+    void onDeviceUpdated(Peer& peer, const Glib::VariantContainerBase& parameters);
+    void applySnapshot(Peer& peer, const std::vector<DeviceInfo>& devices);
+    void applyChange(Peer& peer, DeviceInfo info);
+
+    [[nodiscard]] const PeerDevice* findDevice(DeviceIndex id, DeviceType type) const;
+
+    void call(Peer& peer, const char* method, const Glib::VariantContainerBase& parameters, CallReply onReply);
+    void callForResult(const PeerDevice& device, const char* method, const Glib::VariantContainerBase& parameters, ResultCallback onDone);
+    void callAppVm(const char* method, const Glib::VariantContainerBase& parameters, const LocalAppVmCall& callLocal, ResultCallback onDone);
+
+private:
+    const Glib::RefPtr<Gio::Cancellable> m_cancellable = Gio::Cancellable::create(); // Cancelled when gone, for the replies then
+
+    std::vector<std::unique_ptr<Peer>> m_peers; // By the node, from 1
+
+    std::map<PeerDeviceKey, DeviceIndex> m_ids;
+    std::unordered_map<DeviceIndex, PeerDevice> m_devices; // By the merged id
+    int32_t m_lastDeviceId = 0;
+
+    OnDeviceInfoSignal m_onDeviceInfo;
+};
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "DBusService.hpp"
+
+#include <GhafAudioControl/Backends/PulseAudio/AudioControlBackend.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/SinkInput.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/Trace.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/Volume.hpp>
+#include <GhafAudioControl/models/DeviceModel.hpp>
+#include <GhafAudioControl/utils/ConnectionContainer.hpp>
+#include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
+
+#include <giomm/init.h>
+#include <glibmm/main.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/proplist.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace ghaf::AudioControl;
+using namespace ghaf::AudioControl::Backend::PulseAudio;
+
+namespace
+{
+
+std::atomic<uint64_t> Allocations = 0;
+
+} // namespace
+
+// Every allocation of the process is counted, so the numbers include the ones made by the libraries
+void* operator new(size_t size)
+{
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, [[maybe_unused]] size_t size) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+
+constexpr std::array StreamCounts = {10U, 100U, 1000U};
+constexpr size_t MinEventCount = 10000;
+
+// At the maximum speed, the records closer than this to each other are dispatched in one main loop iteration, as the server sends them in one go
+constexpr auto ReplayBurstGap = std::chrono::milliseconds{1};
+
+// A context that is never connected. The devices only keep a reference to it, and nothing here sends a request
+class OfflineContext final
+{
+public:
+    OfflineContext()
+        : m_mainloop(pa_mainloop_new())
+        , m_context(pa_context_new(pa_mainloop_get_api(m_mainloop), "GhafAudioControlBench"))
+    {
+    }
+
+    OfflineContext(const OfflineContext&) = delete;
+    OfflineContext& operator=(const OfflineContext&) = delete;
+
+    ~OfflineContext()
+    {
+        pa_context_unref(m_context);
+        pa_mainloop_free(m_mainloop);
+    }
+
+    pa_context& get() noexcept
+    {
+        return *m_context;
+    }
+
+private:
+    pa_mainloop* m_mainloop;
+    pa_context* m_context;
+};
+
+// Synthetic sink input payloads, as the server sends them on volume changes
+class StreamInfos final
+{
+public:
+    explicit StreamInfos(size_t count)
+        : m_proplist(pa_proplist_new())
+        , m_names(count)
+        , m_infos(count)
+    {
+        pa_proplist_sets(m_proplist, "application.process.host", "bench-vm");
+        pa_channel_map_init_stereo(&m_channelMap);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_names[i] = std::format("bench-stream-{}", i);
+
+            pa_sink_input_info& info = m_infos[i];
+            info.index = static_cast<uint32_t>(i);
+            info.name = m_names[i].c_str();
+            info.channel_map = m_channelMap;
+            info.proplist = m_proplist;
+            pa_cvolume_set(&info.volume, m_channelMap.channels, PA_VOLUME_NORM);
+        }
+    }
+
+    StreamInfos(const StreamInfos&) = delete;
+    StreamInfos& operator=(const StreamInfos&) = delete;
+
+    ~StreamInfos()
+    {
+        pa_proplist_free(m_proplist);
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return m_infos.size();
+    }
+
+    // The payload of the given event: one of the streams with a new volume
+    [[nodiscard]] const pa_sink_input_info& next(size_t event) noexcept
+    {
+        pa_sink_input_info& info = m_infos[event % m_infos.size()];
+        pa_cvolume_set(&info.volume, m_channelMap.channels, ToPulseAudioVolume(Volume::fromPercents(event % (Volume::Max + 1)), VolumeCurve::Linear));
+
+        return info;
+    }
+
+private:
+    pa_proplist* m_proplist;
+    pa_channel_map m_channelMap{};
+    std::vector<std::string> m_names;
+    std::vector<pa_sink_input_info> m_infos;
+};
+
+struct BenchResult
+{
+    std::string name;
+    size_t streams;
+    size_t events;
+    std::chrono::nanoseconds elapsed;
+    uint64_t allocations;
+};
+
+template<class Fx>
+BenchResult Measure(std::string name, size_t streams, size_t events, Fx&& fx)
+{
+    const auto allocationsBefore = Allocations.load(std::memory_order_relaxed);
+    const auto startTime = std::chrono::steady_clock::now();
+
+    for (size_t event = 0; event < events; ++event)
+        fx(event);
+
+    const auto elapsed = std::chrono::steady_clock::now() - startTime;
+    return {std::move(name), streams, events, elapsed, Allocations.load(std::memory_order_relaxed) - allocationsBefore};
+}
+
+void Print(const BenchResult& result)
+{
+    const double events = static_cast<double>(result.events);
+    const auto nsPerEvent = static_cast<double>(result.elapsed.count()) / events;
+
+    std::cout << std::format("{:<40} {:>7} {:>8} {:>12.1f} {:>12.0f} {:>10.2f}\n",
+                             result.name,
+                             result.streams,
+                             result.events,
+                             nsPerEvent,
+                             1e9 / nsPerEvent,
+                             static_cast<double>(result.allocations) / events);
+}
+
+struct Fixture
+{
+    explicit Fixture(OfflineContext& context, size_t streams)
+        : infos(streams)
+    {
+        for (size_t i = 0; i < streams; ++i)
+            map.add(i, std::make_shared<SinkInput>(infos.next(i), context.get()));
+    }
+
+    IAudioControlBackend::Generation generation = 0;
+    IAudioControlBackend::OnDevicesChangeSignal onChange;
+    IAudioControlBackend::SignalMap<SinkInput> map{generation, onChange};
+    StreamInfos infos;
+};
+
+// The path of AudioControlBackend::onSinkInputInfo for a known stream: the lookup, the new state snapshot and the notification
+BenchResult BenchDeviceInfo(OfflineContext& context, size_t streams, size_t events)
+{
+    Fixture fixture{context, streams};
+
+    return Measure("OnPulseDeviceInfo (SinkInput)",
+                   streams,
+                   events,
+                   [&fixture](size_t event)
+                   {
+                       const auto& info = fixture.infos.next(event);
+
+                       if (auto iter = fixture.map.findByKey(info.index))
+                           fixture.map.update(*iter,
+                                              [&info](SinkInput& device)
+                                              { return device.update(info); });
+                   });
+}
+
+BenchResult BenchSignalMapUpdate(OfflineContext& context, size_t streams, size_t events)
+{
+    Fixture fixture{context, streams};
+
+    using Filter = IAudioControlBackend::DeviceChangeFilter;
+    using Type = IAudioControlBackend::IDevice::Type;
+
+    // The subscribers of the app: the D-Bus service takes everything, the UI its own device types. Two of them aren't called
+    size_t notifications = 0;
+    const auto count = [&notifications](const IAudioControlBackend::OnSignalMapChangeSignalInfo&) { ++notifications; };
+
+    ConnectionContainer connections{fixture.onChange.connect(count),
+                                    fixture.onChange.connect(count, Filter::Types({Type::SinkInput}).mask()),
+                                    fixture.onChange.connect(count, Filter::Types({Type::Sink, Type::Source}).mask()),
+                                    fixture.onChange.connect(count, Filter::Types({Type::SourceOutput}).mask())};
+
+    auto result = Measure("SignalMap::update",
+                          streams,
+                          events,
+                          [&fixture](size_t event)
+                          {
+                              if (auto iter = fixture.map.findByKey(event % fixture.infos.size()))
+                                  fixture.map.update(*iter, [](auto&) { return ChangeMask{DeviceField::Volume}; });
+                          });
+
+    connections.clear();
+    return result;
+}
+
+BenchResult BenchDeviceModelUpdate(OfflineContext& context, size_t streams, size_t events)
+{
+    Fixture fixture{context, streams};
+
+    std::vector<DeviceModel::Ptr> models;
+    models.reserve(streams);
+
+    for (const auto& device : fixture.map.getValues())
+        models.push_back(DeviceModel::create(device));
+
+    return Measure("DeviceModel::updateDevice",
+                   streams,
+                   events,
+                   [&fixture, &models](size_t event)
+                   {
+                       const auto& info = fixture.infos.next(event);
+
+                       auto iter = fixture.map.findByKey(info.index);
+                       static_cast<SinkInput&>(*iter.value()->second).update(info);
+
+                       models[info.index]->updateDevice();
+                   });
+}
+
+BenchResult BenchSendDeviceInfo(DBusService& service, size_t streams, size_t events)
+{
+    // One flush per the given number of events, like a burst of the server events between two main loop iterations
+    const size_t flushEvery = streams;
+
+    return Measure("DBusService::sendDeviceInfo",
+                   streams,
+                   events,
+                   [&service, streams, flushEvery](size_t event)
+                   {
+                       service.sendDeviceInfo({.index = event % streams,
+                                               .type = IAudioControlBackend::IDevice::Type::SinkInput,
+                                               .name = InternedString{"bench-stream"},
+                                               .volume = Volume::fromPercents(event % (Volume::Max + 1)),
+                                               .isMuted = false,
+                                               .isDefault = false,
+                                               .eventType = IAudioControlBackend::EventType::Update,
+                                               .generation = event + 1});
+
+                       if ((event + 1) % flushEvery == 0)
+                           while (Glib::MainContext::get_default()->iteration(false))
+                               ;
+                   });
+}
+
+DBusService::DeviceInfo CreateDeviceInfo(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info)
+{
+    if (!info.ptr)
+        return {.index = info.index,
+                .type = info.type,
+                .name = InternedString{"Deleted"},
+                .volume = Volume::fromPercents(0U),
+                .isMuted = false,
+                .isDefault = false,
+                .eventType = info.eventType,
+                .generation = info.generation};
+
+    const auto state = info.ptr->getState();
+    const bool isHardwareDevice = info.type == IAudioControlBackend::IDevice::Type::Sink || info.type == IAudioControlBackend::IDevice::Type::Source;
+
+    return {.index = info.index,
+            .type = info.type,
+            .name = isHardwareDevice ? state->description : state->name,
+            .volume = state->volume,
+            .isMuted = state->isMuted,
+            .isDefault = isHardwareDevice && state->isDefault,
+            .eventType = info.eventType,
+            .generation = info.generation};
+}
+
+// Feeds a trace recorded with --record_trace through the backend and the D-Bus service, as the app gets it from the server
+int Replay(DBusService& service, const std::string& path, bool isMaxSpeed)
+{
+    TraceReader trace{path};
+    AudioControlBackend backend{""};
+
+    size_t notifications = 0;
+    const auto onDevice = [&service, &notifications](const IAudioControlBackend::OnSignalMapChangeSignalInfo& info)
+    {
+        ++notifications;
+        service.sendDeviceInfo(CreateDeviceInfo(info));
+    };
+
+    ConnectionContainer connections{backend.onDevicesChanged().connect(onDevice)};
+
+    const auto mainContext = Glib::MainContext::get_default();
+    const auto dispatchPending = [&mainContext]
+    {
+        while (mainContext->iteration(false))
+            ;
+    };
+
+    backend.startReplay();
+
+    size_t records = 0;
+    std::chrono::nanoseconds previousTimestamp{0};
+
+    const auto allocationsBefore = Allocations.load(std::memory_order_relaxed);
+    const auto startTime = std::chrono::steady_clock::now();
+
+    while (const auto record = trace.next())
+    {
+        if (!isMaxSpeed)
+        {
+            dispatchPending();
+            std::this_thread::sleep_until(startTime + record->timestamp);
+        }
+        else if (record->timestamp - previousTimestamp > ReplayBurstGap)
+            dispatchPending();
+
+        previousTimestamp = record->timestamp;
+
+        backend.replay(*record);
+        ++records;
+    }
+
+    dispatchPending();
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime);
+    const auto allocations = Allocations.load(std::memory_order_relaxed) - allocationsBefore;
+    const auto perRecord = [records](auto value) { return records == 0 ? 0.0 : static_cast<double>(value) / static_cast<double>(records); };
+
+    std::cout << std::format("Replayed {} records of {:.1f} s in {:.1f} ms, at the {} speed\n",
+                             records,
+                             std::chrono::duration<double>(previousTimestamp).count(),
+                             static_cast<double>(elapsed.count()) / 1000.0,
+                             isMaxSpeed ? "maximum" : "original");
+
+    std::cout << std::format("{} device notifications, {:.0f} ns/record, {:.2f} allocs/record\n", notifications, perRecord(elapsed.count() * 1000), perRecord(allocations));
+    std::cout << Metrics::ToPrometheusText();
+
+    backend.stop();
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Gio::init();
+    Logger::setLevel(Logger::LogLevel::ERROR);
+
+    DBusService service;
+    service.setUpdatesFlushInterval(std::chrono::milliseconds::zero());
+
+    // GhafAudioControlBench [--replay <trace file> [--max-speed]]
+    if (argc > 2 && std::string_view{argv[1]} == "--replay")
+    {
+        try
+        {
+            return Replay(service, argv[2], argc > 3 && std::string_view{argv[3]} == "--max-speed");
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << "Replay has failed: " << ex.what() << '\n';
+            return 1;
+        }
+    }
+
+    OfflineContext context;
+
+    std::cout << std::format("{:<40} {:>7} {:>8} {:>12} {:>12} {:>10}\n", "benchmark", "streams", "events", "ns/event", "events/s", "allocs/ev");
+
+    for (const size_t streams : StreamCounts)
+    {
+        const size_t events = std::max(MinEventCount, streams * 10);
+
+        Print(BenchDeviceInfo(context, streams, events));
+        Print(BenchSignalMapUpdate(context, streams, events));
+        Print(BenchDeviceModelUpdate(context, streams, events));
+        Print(BenchSendDeviceInfo(service, streams, events));
+    }
+
+    return 0;
+}
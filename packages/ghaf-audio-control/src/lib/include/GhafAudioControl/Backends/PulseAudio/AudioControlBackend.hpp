@@ -5,101 +5,196 @@
 
 #pragma once
 
+#include <GhafAudioControl/Backends/PulseAudio/DeviceFilter.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/PeakMeter.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/ProfileStore.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/Sink.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/SinkInput.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/Source.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/SourceOutput.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/Trace.hpp>
 #include <GhafAudioControl/IAudioControlBackend.hpp>
-#include <GhafAudioControl/utils/RaiiWrap.hpp>
+#include <GhafAudioControl/utils/UniqueHandle.hpp>
 
 #include <pulse/glib-mainloop.h>
 #include <pulse/introspect.h>
+#include <pulse/subscribe.h>
 #include <pulse/thread-mainloop.h>
 
+#include <glibmm/main.h>
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
+using MainloopHandle = UniqueHandle<pa_glib_mainloop, FunctionDeleter<pa_glib_mainloop_free>>;
+
 class AudioControlBackend final : public IAudioControlBackend
 {
 public:
+    // All the ramps step together, at most this often
+    static constexpr std::chrono::milliseconds VolumeRampInterval{20};
+
     explicit AudioControlBackend(std::string pulseAudioServerAddress);
-    ~AudioControlBackend() override = default;
 
-    const std::string& getServerAddress() const noexcept
+    // One context per server, all on the same main loop. The devices of all the servers share the maps, see MakeDeviceIndex().
+    // Everything the backend does runs on the given main context, the signals are emitted from the thread running it
+    explicit AudioControlBackend(std::vector<std::string> pulseAudioServerAddresses,
+                                 Glib::RefPtr<Glib::MainContext> mainContext = Glib::MainContext::get_default());
+    ~AudioControlBackend() override;
+
+    [[nodiscard]] size_t getServersCount() const noexcept
     {
-        return m_serverAddress;
+        return m_servers.size();
     }
 
     void start() override;
     void stop() override;
 
-    void setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume) override;
-    void setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute) override;
+    // Writes the server events and the info payloads to the given recorder. Set before start(), so the trace has the initial lists
+    void setTraceRecorder(std::unique_ptr<TraceRecorder> recorder);
+
+    // The devices matching the filter are never created. The monitor sources by default. Set before start()
+    void setDeviceFilter(DeviceFilter filter);
+
+    // Restores the saved volume and mute of the AppVM streams as they come, and saves their changes. Set before start()
+    void setProfileStore(std::unique_ptr<ProfileStore> store);
+
+    // Takes the devices from a recorded trace instead of the servers: the records are passed to replay() one by one.
+    // Don't use with start(). The changes requested from the devices fail, as there is no server to send them to
+    void startReplay();
+    void replay(const TraceReader::Record& record);
 
-    void makeDeviceDefault(IDevice::IntexT index, IDevice::Type type) override;
+    void setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume, ResultCallback onDone = {}) override;
+    void adjustDeviceVolume(IDevice::IntexT index, IDevice::Type type, int delta, ResultCallback onDone = {}) override;
+    void setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute, ResultCallback onDone = {}) override;
+
+    // The ramps share one timer, running while any of them is. Each step is sent only if it changes the volume
+    void rampDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume target, std::chrono::milliseconds duration,
+                          ResultCallback onDone = {}) override;
+
+    void makeDeviceDefault(IDevice::IntexT index, IDevice::Type type, ResultCallback onDone = {}) override;
+
+    void setDevicesState(const std::vector<DeviceStateRequest>& requests, ResultsCallback onDone) override;
+
+    void moveDevice(IDevice::IntexT index, IDevice::Type type, IDevice::IntexT targetIndex, ResultCallback onDone = {}) override;
+    void moveDevices(const std::vector<DeviceMoveRequest>& requests, ResultsCallback onDone) override;
 
     std::vector<IAudioControlBackend::IDevice::Ptr> getAllDevices() const override;
 
-    Sinks::OnChangeSignal onSinksChanged() const override
+    Generation getGeneration() const override
     {
-        return m_sinks.onChange();
+        return m_generation;
     }
 
-    Sources::OnChangeSignal onSourcesChanged() const override
+    OnDevicesChangeSignal& onDevicesChanged() override
     {
-        return m_sources.onChange();
+        return m_onDevicesChanged;
     }
 
-    SinkInputs::OnChangeSignal onSinkInputsChanged() const override
+    OnErrorSignal onError() const override
     {
-        return m_sinkInputs.onChange();
+        return m_onError;
     }
 
-    SourceOutputs::OnChangeSignal onSourceOutputsChanged() const override
+    State getState() const override
     {
-        return m_sourceOutputs.onChange();
+        return m_state;
     }
 
-    OnErrorSignal onError() const override
+    OnStateChangeSignal onStateChange() const override
     {
-        return m_onError;
+        return m_onStateChange;
+    }
+
+    // Not in a replay, there are no streams to record from
+    void setPeakMeteringEnabled(bool enabled) override;
+
+    OnPeaksSignal onPeaks() const override
+    {
+        return m_peakMeter.onPeaks();
     }
 
 private:
-    static void subscribeCallback(pa_context* context, pa_subscription_event_type_t type, uint32_t index, void* data);
-    static void contextStateCallback(pa_context* context, void* data);
-    static void sinkInfoCallback(pa_context* context, const pa_sink_info* info, int eol, void* data);
-    static void sourceInfoCallback(pa_context* context, const pa_source_info* info, int eol, void* data);
-    static void sinkInputInfoCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* data);
-    static void sourceOutputInfoCallback(pa_context* context, const pa_source_output_info* info, int eol, void* data);
-    static void serverInfoCallback(pa_context* context, const pa_server_info* info, void* data);
-    static void cardInfoCallback(pa_context* context, const pa_card_info* info, int eol, void* data);
+    // A context with everything received from its server. Defined in the source file
+    class Server;
+
+    struct VolumeRamp
+    {
+        uint64_t id; // A ramp replaced while its last step is on the way is not the one to remove
+        Index index;
+        IDevice::Type type;
+        Volume from;
+        Volume target;
+        Volume sent;
+        std::chrono::steady_clock::time_point startTime;
+        std::chrono::milliseconds duration;
+        ResultCallback onDone;
+        bool isFinishing = false; // The target is sent, the ramp is done once the server confirms it
+    };
 
-    void onSinkInfo(const pa_sink_info& info);
-    void deleteSink(Sinks::IndexT index);
+    void setDeviceState(const DeviceStateRequest& request, ResultCallback onDone);
 
-    void onSourceInfo(const pa_source_info& info);
-    void deleteSource(Sources::IndexT index);
+    // Calls the function with the map of the device type
+    template<class FunctionT>
+    void visitMap(IDevice::Type type, FunctionT&& function);
 
-    void onSinkInputInfo(const pa_sink_input_info& info);
-    void deleteSinkInput(SinkInputs::IndexT index);
+    void sendDeviceVolume(Index index, IDevice::Type type, Volume volume, ResultCallback onDone);
 
-    void onSourceOutputInfo(const pa_source_output_info& info);
-    void deleteSourceOutput(SourceOutputs::IndexT index);
+    // Marks the profile of a stream to be saved once the server has confirmed the change of its volume or mute
+    [[nodiscard]] ResultCallback trackProfileChange(Index index, IDevice::Type type, ResultCallback onDone);
 
-    void onServerInfo(const pa_server_info& info);
+    // The target of the ramp of the device, if any. The server reports the steps before it as the updates with RampStep
+    [[nodiscard]] std::optional<Volume> getVolumeRampTarget(Index index, IDevice::Type type) const noexcept;
+
+    // A new change of the volume of the device replaces its ramp
+    void cancelVolumeRamp(Index index, IDevice::Type type);
+    void finishVolumeRamp(uint64_t id, Result result);
+    bool stepVolumeRamps();
+
+    // The backend state follows the states of all the servers
+    void updateState();
 
 private:
-    Sinks m_sinks;
-    Sources m_sources;
-    SinkInputs m_sinkInputs;
-    SourceOutputs m_sourceOutputs;
+    Generation m_generation = 0;
+    OnDevicesChangeSignal m_onDevicesChanged;
+
+    // The concrete devices, so the events are dispatched without casts. The signal gives them out as the interfaces
+    SignalMap<Sink> m_sinks{m_generation, m_onDevicesChanged};
+    SignalMap<Source> m_sources{m_generation, m_onDevicesChanged};
+    SignalMap<SinkInput> m_sinkInputs{m_generation, m_onDevicesChanged};
+    SignalMap<SourceOutput> m_sourceOutputs{m_generation, m_onDevicesChanged};
 
     OnErrorSignal m_onError;
 
-    std::string m_serverAddress;
-    std::string m_defaultSinkName;
-    std::string m_defaultSourceName;
+    State m_state = State::Disconnected;
+    OnStateChangeSignal m_onStateChange;
+
+    Glib::RefPtr<Glib::MainContext> m_mainContext;
+    MainloopHandle m_mainloop;
+    pa_mainloop_api* m_mainloopApi; // Owned by the main loop
+
+    std::vector<std::unique_ptr<Server>> m_servers;
+    bool m_isReplaying = false;
+
+    // After the servers, so the streams are gone before the contexts
+    PeakMeter m_peakMeter;
+    bool m_isPeakMeteringEnabled = false;
+
+    std::vector<VolumeRamp> m_volumeRamps;
+    uint64_t m_nextVolumeRampId = 0;
+    sigc::connection m_volumeRampTimer;
 
-    RaiiWrap<pa_glib_mainloop*> m_mainloop;
-    RaiiWrap<pa_mainloop_api*> m_mainloopApi;
-    std::optional<RaiiWrap<pa_context*>> m_context;
+    std::unique_ptr<TraceRecorder> m_traceRecorder;
+    std::unique_ptr<ProfileStore> m_profileStore;
+    std::set<Index> m_changedProfiles; // The streams changed through the backend, saved with their next info
+    DeviceFilter m_deviceFilter = DeviceFilter::CreateDefault();
 };
 
 } // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/IAudioControlBackend.hpp>
+
+#include <pulse/introspect.h>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+// Port availability of a card, precomputed once per pa_card_info so devices don't rescan the card ports
+class CardPorts final
+{
+public:
+    explicit CardPorts(const pa_card_info& info);
+
+    [[nodiscard]] uint32_t getCardIndex() const noexcept
+    {
+        return m_cardIndex;
+    }
+
+    [[nodiscard]] std::optional<bool> isPortEnabled(std::string_view portName) const;
+
+    // Fallback for devices without an active port: matches the port by the device description suffix
+    [[nodiscard]] std::optional<bool> isEnabledByDescription(std::string_view deviceDescription) const;
+
+private:
+    struct StringHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view value) const noexcept
+        {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
+    uint32_t m_cardIndex;
+
+    std::unordered_map<std::string, bool, StringHash, std::equal_to<>> m_enabledByPortName;
+    std::vector<std::pair<std::string, bool>> m_enabledByPortDescription;
+};
+
+// Card index -> sinks and sources living on that card
+class CardDeviceIndex final
+{
+public:
+    struct Devices
+    {
+        std::vector<Index> sinks;
+        std::vector<Index> sources;
+    };
+
+    void set(IAudioControlBackend::IDevice::Type type, Index device, uint32_t cardIndex);
+    void remove(IAudioControlBackend::IDevice::Type type, Index device);
+
+    [[nodiscard]] const Devices* find(uint32_t cardIndex) const;
+
+private:
+    [[nodiscard]] std::unordered_map<Index, uint32_t>& getCards(IAudioControlBackend::IDevice::Type type);
+    [[nodiscard]] static std::vector<Index>& GetDevices(Devices& devices, IAudioControlBackend::IDevice::Type type);
+
+private:
+    std::unordered_map<uint32_t, Devices> m_devicesByCard;
+
+    std::unordered_map<Index, uint32_t> m_sinkCards;
+    std::unordered_map<Index, uint32_t> m_sourceCards;
+};
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/IAudioControlBackend.hpp>
+
+#include <pulse/introspect.h>
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+// A glob with '*' matching any characters, split at the stars once, so a match doesn't allocate
+class DevicePattern final
+{
+public:
+    explicit DevicePattern(std::string_view pattern);
+
+    [[nodiscard]] bool matches(std::string_view value) const noexcept;
+
+private:
+    std::vector<std::string> m_segments;
+    bool m_hasStar = false;
+};
+
+// The devices the backend ignores: it doesn't create them, so they are neither kept, logged nor sent to the clients.
+// A rule is [type:]field=pattern, e.g. "source:description=Monitor *" or "sinkinput:property.media.role=event".
+// The type is sink, source, sinkinput or sourceoutput, all the types if it's omitted. The field is name, description, appvm
+// or property.<key>. The rules are sorted by the type up front, so a device is checked against its own ones only
+class DeviceFilter final
+{
+public:
+    using Type = IAudioControlBackend::IDevice::Type;
+
+    enum class Field
+    {
+        Name,
+        Description,
+        AppVm,
+        Property
+    };
+
+    struct Rule
+    {
+        std::optional<Type> type;
+        Field field;
+        std::string propertyKey;
+        DevicePattern pattern;
+    };
+
+    // Throws std::runtime_error with the reason on a malformed rule
+    [[nodiscard]] static Rule ParseRule(std::string_view rule);
+
+    // The monitor sources, which the UI and the clients don't show
+    [[nodiscard]] static DeviceFilter CreateDefault();
+
+    void addRule(const Rule& rule);
+
+    [[nodiscard]] bool isIgnored(const pa_sink_info& info) const;
+    [[nodiscard]] bool isIgnored(const pa_source_info& info) const;
+    [[nodiscard]] bool isIgnored(const pa_sink_input_info& info) const;
+    [[nodiscard]] bool isIgnored(const pa_source_output_info& info) const;
+
+private:
+    // The streams have no description
+    [[nodiscard]] bool isIgnored(Type type, const char* name, const char* description, const pa_proplist* proplist) const;
+
+private:
+    std::array<std::vector<Rule>, 4> m_rulesByType;
+};
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -5,9 +5,12 @@
 
 #pragma once
 
+#include <GhafAudioControl/Backends/PulseAudio/CardIndex.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/Volume.hpp>
 #include <GhafAudioControl/IAudioControlBackend.hpp>
 
 #include <GhafAudioControl/Volume.hpp>
+#include <GhafAudioControl/utils/MemoryCharge.hpp>
 
 #include <sigc++/signal.h>
 
@@ -15,33 +18,87 @@
 #include <pulse/introspect.h>
 #include <pulse/volume.h>
 
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include <string>
 
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
+struct DeviceState final : IAudioControlBackend::IDevice::State
+{
+    uint32_t cardIndex = PA_INVALID_INDEX;
+    InternedString activePortName;
+
+    pa_channel_map channelMap{};
+    pa_cvolume pulseVolume{};
+
+    // The volume is of this curve, and so are the volumes made of it
+    VolumeCurve volumeCurve = VolumeCurve::Linear;
+};
+
+// A backend with several servers keeps the devices of all of them in the same maps, so the server number is stored above the
+// PulseAudio index. The first server keeps the PulseAudio indices, and all of them fit into the 32 bit ids of the D-Bus API
+constexpr uint32_t DeviceIndexServerShift = 24;
+constexpr uint32_t MaxServerDeviceIndex = (1U << DeviceIndexServerShift) - 1;
+constexpr uint32_t MaxServers = 1U << (31 - DeviceIndexServerShift);
+
+[[nodiscard]] constexpr Index MakeDeviceIndex(uint32_t server, uint32_t index) noexcept
+{
+    return (static_cast<Index>(server) << DeviceIndexServerShift) | index;
+}
+
+[[nodiscard]] constexpr uint32_t GetDeviceIndexServer(Index index) noexcept
+{
+    return static_cast<uint32_t>(index >> DeviceIndexServerShift);
+}
+
+// The PulseAudio index, as the server knows the device
+[[nodiscard]] constexpr uint32_t GetServerDeviceIndex(Index index) noexcept
+{
+    return static_cast<uint32_t>(index) & MaxServerDeviceIndex;
+}
+
+// The host the stream comes from, set by the AppVMs. Null for the local streams
+[[nodiscard]] const char* GetAppVmNameProperty(const pa_proplist* proplist) noexcept;
+
+// Readers load the current DeviceState snapshot without locking. Updates are made from the PulseAudio main loop only:
+// they copy the current snapshot, modify the copy and publish it with an atomic swap
 class GeneralDeviceImpl final
 {
 public:
-    GeneralDeviceImpl(const pa_sink_info& info, bool isDefault, pa_context& context);
-    GeneralDeviceImpl(const pa_source_info& info, bool isDefault, pa_context& context);
-    GeneralDeviceImpl(const pa_sink_input_info& info, pa_context& context);
-    GeneralDeviceImpl(const pa_source_output_info& info, pa_context& context);
+    using StatePtr = std::shared_ptr<const DeviceState>;
+
+    GeneralDeviceImpl(const pa_sink_info& info, bool isDefault, pa_context& context, uint32_t server);
+    GeneralDeviceImpl(const pa_source_info& info, bool isDefault, pa_context& context, uint32_t server);
+    GeneralDeviceImpl(const pa_sink_input_info& info, pa_context& context, uint32_t server);
+    GeneralDeviceImpl(const pa_source_output_info& info, pa_context& context, uint32_t server);
 
     bool operator==(const GeneralDeviceImpl& other) const
     {
-        return m_index == other.m_index;
+        return m_index == other.m_index && m_server == other.m_server;
     }
 
+    // The index on the server, for the requests sent to it
     [[nodiscard]] uint32_t getIndex() const noexcept
     {
         return m_index;
     }
 
+    // The index in the backend, see MakeDeviceIndex()
+    [[nodiscard]] Index getDeviceIndex() const noexcept
+    {
+        return MakeDeviceIndex(m_server, m_index);
+    }
+
+    [[nodiscard]] StatePtr getState() const noexcept
+    {
+        return m_state.load();
+    }
+
     [[nodiscard]] uint32_t getCardIndex() const noexcept;
 
-    virtual void setDefault(bool value);
+    ChangeMask setDefault(bool value);
     [[nodiscard]] bool isDefault() const noexcept;
 
     [[nodiscard]] bool isDeleted() const noexcept;
@@ -50,53 +107,72 @@ public:
 
     [[nodiscard]] Volume getVolume() const;
 
+    [[nodiscard]] ChannelVolume getChannelVolume() const;
+
     [[nodiscard]] pa_volume_t getPulseVolume() const;
     [[nodiscard]] pa_cvolume getPulseChannelVolume() const noexcept;
 
-    [[nodiscard]] std::optional<std::string> getAppVmName() const noexcept;
+    // Compute the new volume from the current one, to be sent to the server by the owner
+    [[nodiscard]] pa_cvolume makeScaledVolume(Volume volume) const noexcept;
+    [[nodiscard]] pa_cvolume makeAdjustedVolume(int delta) const noexcept;
+    [[nodiscard]] pa_cvolume makeBalancedVolume(float balance) const;
+    [[nodiscard]] pa_cvolume makeChannelVolume(const ChannelVolume& volume) const;
+
+    [[nodiscard]] std::optional<InternedString> getAppVmName() const noexcept;
 
-    [[nodiscard]] std::string getName() const;
-    [[nodiscard]] std::string getDescription() const;
+    [[nodiscard]] InternedString getName() const noexcept;
+    [[nodiscard]] InternedString getDescription() const noexcept;
 
     [[nodiscard]] pa_context& getContext() const noexcept
     {
-        return m_context;
+        return *m_context;
+    }
+
+    // The backend gives the devices it keeps over a reconnect the new context
+    void setContext(pa_context& context) noexcept
+    {
+        m_context = &context;
     }
 
-    void update(const pa_sink_info& info);
-    void update(const pa_source_info& info);
-    void update(const pa_sink_input_info& info);
-    void update(const pa_source_output_info& info);
+    // The updates return the fields they have changed. An unchanged state is not published
+    ChangeMask update(const pa_sink_info& info);
+    ChangeMask update(const pa_source_info& info);
+    ChangeMask update(const pa_sink_input_info& info);
+    ChangeMask update(const pa_source_output_info& info);
 
-    void update(const pa_card_info& info);
+    ChangeMask update(const CardPorts& ports);
 
     void markDeleted();
 
     [[nodiscard]] std::string toString() const;
 
 private:
-    void deleteCheck();
+    template<class ModifierT>
+    ChangeMask publish(ModifierT&& modifier);
 
 private:
     const uint32_t m_index;
-    uint32_t m_cardIndex;
-
-    bool m_isDefault = false;
-    bool m_isDeleted = false;
-    bool m_isEnabled = false;
+    const uint32_t m_server;
 
-    std::optional<std::string> m_appVmName;
+    pa_context* m_context;
 
-    std::string m_name;
-    std::string m_description;
-
-    pa_context& m_context;
+    std::atomic<StatePtr> m_state;
+    std::atomic_bool m_isDeleted = false;
+};
 
-    pa_channel_map m_channel_map;
-    pa_cvolume m_volume;
-    bool m_isMuted;
+// The memory of a device of the backend, with one state snapshot: an update replaces it with another of the same size.
+// A base, so the charge has the size of the whole device
+template<class DeviceT>
+class DeviceMemoryCharge
+{
+protected:
+    DeviceMemoryCharge() noexcept
+        : m_memory(MemorySubsystem::BackendDevices, sizeof(DeviceT) + sizeof(DeviceState))
+    {
+    }
 
-    mutable std::mutex m_mutex;
+private:
+    MemoryCharge m_memory;
 };
 
 } // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -5,47 +5,85 @@
 
 #pragma once
 
+#include <GhafAudioControl/IAudioControlBackend.hpp>
 #include <GhafAudioControl/Volume.hpp>
+#include <GhafAudioControl/utils/LatencyHistogram.hpp>
 #include <GhafAudioControl/utils/Logger.hpp>
-#include <GhafAudioControl/utils/RaiiWrap.hpp>
+#include <GhafAudioControl/utils/UniqueHandle.hpp>
 
 #include <pulse/context.h>
+#include <pulse/operation.h>
 #include <pulse/volume.h>
 
 #include <string_view>
-
-#define DEBUG 1
+#include <tuple>
 
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
+struct OperationTraits final
+{
+    static void ref(pa_operation* operation) noexcept
+    {
+        std::ignore = pa_operation_ref(operation);
+    }
+
+    static void unref(pa_operation* operation) noexcept
+    {
+        pa_operation_unref(operation);
+    }
+};
+
+using OperationHandle = RefHandle<pa_operation, OperationTraits>;
+
 template<class Fx, class... ArgsT>
 void ExecutePulseFuncPrivate(Fx fx, ArgsT... args)
 {
-    RaiiWrap<pa_operation*> wrap{[fx, args...](pa_operation*& op)
-                                 {
-                                     if (op = fx(args...); op == nullptr)
-                                         Logger::error("Pulseaudio function failed");
-                                 },
-                                 [](pa_operation*& op)
-                                 {
-                                     pa_operation_unref(op);
-                                 }};
+    // Nobody waits for the operation, the reference is dropped right away. The callback still comes
+    if (const OperationHandle operation{fx(args...)}; !operation)
+        Logger::error("Pulseaudio function failed");
+}
+
+#define ExecutePulseFunc(FX, ARGS...)               \
+    {                                               \
+        Logger::debug("ExecutePulseFunc: {}", #FX); \
+        ExecutePulseFuncPrivate(FX, ARGS);          \
+    }
+
+struct PendingOperation;
+
+[[nodiscard]] PendingOperation* CreatePendingOperation(std::string_view name, LatencyHistogram& latencyHistogram, IAudioControlBackend::ResultCallback onDone);
+void OnPendingOperationSuccess(pa_context* context, int success, void* data);
+
+// Takes the ownership of the pending operation. It completes with the server reply, or with a failure if the operation is never sent or is cancelled
+void WatchPendingOperation(pa_operation* operation, PendingOperation* pending);
+
+[[nodiscard]] LatencyHistogram& CreateOperationLatencyHistogram(std::string_view name);
+
+// One per the function, resolved on its first operation so the next ones record without a lookup in the registry
+template<auto Fx>
+[[nodiscard]] LatencyHistogram& GetOperationLatencyHistogram(std::string_view name)
+{
+    static LatencyHistogram& histogram = CreateOperationLatencyHistogram(name);
+    return histogram;
 }
 
-#if defined(DEBUG)
-    #define ExecutePulseFunc(FX, ARGS...)               \
-        {                                               \
-            Logger::debug("ExecutePulseFunc: {}", #FX); \
-            ExecutePulseFuncPrivate(FX, ARGS);          \
-        }
-#else
 template<class Fx, class... ArgsT>
-void ExecutePulseFunc(Fx fx, ArgsT&&... args)
+void ExecutePulseOperationPrivate(std::string_view name, LatencyHistogram& latencyHistogram, IAudioControlBackend::ResultCallback onDone, Fx fx,
+                                  ArgsT... args)
+{
+    PendingOperation* pending = CreatePendingOperation(name, latencyHistogram, std::move(onDone));
+    WatchPendingOperation(fx(args..., &OnPendingOperationSuccess, pending), pending);
+}
+
+// Like ExecutePulseFunc, for the functions with a success callback. The latency is recorded into a histogram per the function name
+#define ExecutePulseOperation(ONDONE, FX, ARGS...) ExecutePulseOperationPrivate(#FX, GetOperationLatencyHistogram<FX>(#FX), ONDONE, FX, ARGS)
+
+inline void CompleteOperation(const IAudioControlBackend::ResultCallback& onDone, IAudioControlBackend::Result result)
 {
-    ExecutePulseFuncPrivate(fx, args...);
+    if (onDone)
+        onDone(result);
 }
-#endif
 
 bool PulseCallbackCheck(const pa_context* context, int eol, std::string_view callbackName);
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/IAudioControlBackend.hpp>
+
+#include <pulse/context.h>
+#include <pulse/stream.h>
+
+#include <glibmm/main.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+// The loudest absolute sample, clamped to [0, 1]
+[[nodiscard]] float ComputePeak(std::span<const float> samples) noexcept;
+
+// Peak levels of the devices, from the record streams on the monitor sources. The server does the peak detection, and sends a few
+// values per second only. The levels are emitted together, at most once per flush interval, and only those which have changed
+class PeakMeter final
+{
+public:
+    using Key = std::pair<IAudioControlBackend::IDevice::Type, Index>;
+
+    static constexpr auto FlushInterval = std::chrono::milliseconds{100};
+
+    explicit PeakMeter(Glib::RefPtr<Glib::MainContext> mainContext);
+    ~PeakMeter();
+
+    PeakMeter(const PeakMeter&) = delete;
+    PeakMeter& operator=(const PeakMeter&) = delete;
+
+    // Records from the source. With a sink input index, only that sink input of the sink whose monitor the source is.
+    // Nothing happens if the device is watched with the same source already, the stream is restarted otherwise.
+    // Returns whether a stream has been started
+    [[nodiscard]] bool watch(pa_context& context, Key key, uint32_t sourceIndex, std::optional<uint32_t> sinkInputIndex = std::nullopt);
+    void unwatch(const Key& key);
+
+    // The streams of the context, before it goes away
+    void unwatchAll(const pa_context& context);
+    void unwatchAll();
+
+    [[nodiscard]] IAudioControlBackend::OnPeaksSignal onPeaks() const
+    {
+        return m_onPeaks;
+    }
+
+private:
+    // A stream with its levels. Defined in the source file
+    struct Meter;
+
+    static void readCallback(pa_stream* stream, size_t length, void* data);
+    static void suspendedCallback(pa_stream* stream, void* data);
+
+    void scheduleFlush();
+    void flush();
+
+private:
+    Glib::RefPtr<Glib::MainContext> m_mainContext;
+
+    std::map<Key, std::unique_ptr<Meter>> m_meters;
+    sigc::connection m_flushTimer;
+
+    IAudioControlBackend::OnPeaksSignal m_onPeaks;
+};
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
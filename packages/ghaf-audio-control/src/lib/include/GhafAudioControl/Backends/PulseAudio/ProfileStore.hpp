@@ -0,0 +1,58 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <pulse/volume.h>
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+// The last volume and mute of the AppVM streams, by the AppVM and the stream name, kept over the restarts of the AppVMs and of
+// the service. The file is a fixed size hash table, mapped into memory: a lookup is a probe in the mapping, and a save writes the
+// slot in place and leaves the write back to the kernel. The profiles are never removed, a full table takes no new ones
+class ProfileStore final
+{
+public:
+    struct Profile
+    {
+        pa_volume_t volume; // The loudest channel, the balance of the stream is kept
+        bool isMuted;
+
+        bool operator==(const Profile& other) const = default;
+    };
+
+    static constexpr size_t Capacity = 1024;
+
+    // Creates the file if it doesn't exist. A file of another format or version is started anew. Throws if the file can't be mapped
+    explicit ProfileStore(const std::string& path);
+    ~ProfileStore();
+
+    ProfileStore(const ProfileStore&) = delete;
+    ProfileStore& operator=(const ProfileStore&) = delete;
+
+    [[nodiscard]] std::optional<Profile> find(std::string_view appVmName, std::string_view streamName) const noexcept;
+
+    // Returns false if the names are too long or the table is full
+    bool save(std::string_view appVmName, std::string_view streamName, Profile profile) noexcept;
+
+private:
+    // Defined in the source file
+    struct Slot;
+
+    [[nodiscard]] Slot* findSlot(std::string_view appVmName, std::string_view streamName, bool forInsert) const noexcept;
+
+private:
+    std::span<std::byte> m_mapping;
+    std::span<Slot> m_slots;
+};
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
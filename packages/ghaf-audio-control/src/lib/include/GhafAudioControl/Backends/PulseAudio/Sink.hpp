@@ -14,19 +14,21 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-class Sink final : public IAudioControlBackend::ISink
+class Sink final
+    : public IAudioControlBackend::ISink
+    , private DeviceMemoryCharge<Sink>
 {
 public:
-    Sink(const pa_sink_info& info, bool isDefault, pa_context& context);
+    Sink(const pa_sink_info& info, bool isDefault, pa_context& context, uint32_t server = 0);
 
     bool operator==(const IDevice& other) const override;
 
     [[nodiscard]] Index getIndex() const override
     {
-        return m_device.getIndex();
+        return m_device.getDeviceIndex();
     }
 
-    [[nodiscard]] std::string getName() const override
+    [[nodiscard]] InternedString getName() const override
     {
         return m_device.getName();
     }
@@ -46,43 +48,62 @@ public:
         return m_device.isMuted();
     }
 
-    void setMuted(bool mute) override;
+    void setMuted(bool mute, ResultCallback onDone = {}) override;
 
     [[nodiscard]] Volume getVolume() const override
     {
         return m_device.getVolume();
     }
 
-    void setVolume(Volume volume) override;
+    void setVolume(Volume volume, ResultCallback onDone = {}) override;
+
+    [[nodiscard]] ChannelVolume getChannelVolume() const override
+    {
+        return m_device.getChannelVolume();
+    }
+
+    void setChannelVolume(const ChannelVolume& volume, ResultCallback onDone = {}) override;
+    void setBalance(float balance, ResultCallback onDone = {}) override;
+    void adjustVolume(int delta, ResultCallback onDone = {}) override;
 
     [[nodiscard]] uint32_t getCardIndex() const noexcept
     {
         return m_device.getCardIndex();
     }
 
+    [[nodiscard]] StatePtr getState() const override
+    {
+        return m_device.getState();
+    }
+
     [[nodiscard]] std::string toString() const override;
 
-    [[nodiscard]] std::string getDescription() const override
+    [[nodiscard]] InternedString getDescription() const override
     {
         return m_device.getDescription();
     }
 
-    void update(const pa_sink_info& info);
-    void update(const pa_card_info& info);
+    ChangeMask update(const pa_sink_info& info); // Notifies about and returns the changed fields
+    ChangeMask update(const CardPorts& ports);
 
     void markDeleted();
 
-    [[nodiscard]] OnUpdateSignal onUpdate() const override
+    void setContext(pa_context& context) noexcept
+    {
+        m_device.setContext(context);
+    }
+
+    [[nodiscard]] OnUpdateSignal& onUpdate() override
     {
         return m_onUpdate;
     }
 
-    [[nodiscard]] OnDeleteSignal onDelete() const override
+    [[nodiscard]] OnDeleteSignal& onDelete() override
     {
         return m_onDelete;
     }
 
-    void setDefault(bool value) override;
+    void setDefault(bool value, ResultCallback onDone = {}) override;
 
     [[nodiscard]] bool isDefault() const override
     {
@@ -93,6 +114,7 @@ public:
 
 private:
     void deleteCheck();
+    void setPulseVolume(const pa_cvolume& volume, ResultCallback onDone);
 
 private:
     GeneralDeviceImpl m_device;
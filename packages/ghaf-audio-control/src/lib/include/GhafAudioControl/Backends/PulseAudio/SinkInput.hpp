@@ -14,24 +14,26 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-class SinkInput final : public IAudioControlBackend::ISinkInput
+class SinkInput final
+    : public IAudioControlBackend::ISinkInput
+    , private DeviceMemoryCharge<SinkInput>
 {
 public:
-    SinkInput(const pa_sink_input_info& info, pa_context& context);
+    SinkInput(const pa_sink_input_info& info, pa_context& context, uint32_t server = 0);
 
     bool operator==(const IDevice& other) const override;
 
     Index getIndex() const override
     {
-        return m_device.getIndex();
+        return m_device.getDeviceIndex();
     }
 
-    std::string getName() const override
+    InternedString getName() const override
     {
         return m_device.getName();
     }
 
-    [[nodiscard]] std::string getDescription() const override
+    [[nodiscard]] InternedString getDescription() const override
     {
         return m_device.getDescription();
     }
@@ -51,43 +53,66 @@ public:
         return m_device.isMuted();
     }
 
-    void setMuted(bool mute) override;
+    void setMuted(bool mute, ResultCallback onDone = {}) override;
 
     Volume getVolume() const override
     {
         return m_device.getVolume();
     }
 
-    void setVolume(Volume volume) override;
+    void setVolume(Volume volume, ResultCallback onDone = {}) override;
+
+    [[nodiscard]] ChannelVolume getChannelVolume() const override
+    {
+        return m_device.getChannelVolume();
+    }
+
+    void setChannelVolume(const ChannelVolume& volume, ResultCallback onDone = {}) override;
+    void setBalance(float balance, ResultCallback onDone = {}) override;
+    void adjustVolume(int delta, ResultCallback onDone = {}) override;
+
+    // The sink index is the PulseAudio one, of the same server
+    void moveTo(uint32_t sinkIndex, ResultCallback onDone = {});
 
     uint32_t getCardIndex() const noexcept
     {
         return m_device.getCardIndex();
     }
 
+    [[nodiscard]] StatePtr getState() const override
+    {
+        return m_device.getState();
+    }
+
     std::string toString() const override;
 
-    std::optional<std::string> getAppVmName() const
+    std::optional<InternedString> getAppVmName() const
     {
         return m_device.getAppVmName();
     }
 
-    void update(const pa_sink_input_info& info);
+    ChangeMask update(const pa_sink_input_info& info); // Notifies about and returns the changed fields
 
     void markDeleted();
 
-    OnUpdateSignal onUpdate() const override
+    void setContext(pa_context& context) noexcept
+    {
+        m_device.setContext(context);
+    }
+
+    OnUpdateSignal& onUpdate() override
     {
         return m_onUpdate;
     }
 
-    OnDeleteSignal onDelete() const override
+    OnDeleteSignal& onDelete() override
     {
         return m_onDelete;
     }
 
 private:
     void deleteCheck();
+    void setPulseVolume(const pa_cvolume& volume, ResultCallback onDone);
 
 private:
     GeneralDeviceImpl m_device;
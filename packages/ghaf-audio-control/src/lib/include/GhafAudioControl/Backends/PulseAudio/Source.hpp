@@ -14,24 +14,26 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-class Source final : public IAudioControlBackend::ISource
+class Source final
+    : public IAudioControlBackend::ISource
+    , private DeviceMemoryCharge<Source>
 {
 public:
-    Source(const pa_source_info& info, bool isDefault, pa_context& context);
+    Source(const pa_source_info& info, bool isDefault, pa_context& context, uint32_t server = 0);
 
     bool operator==(const IDevice& other) const override;
 
     Index getIndex() const override
     {
-        return m_device.getIndex();
+        return m_device.getDeviceIndex();
     }
 
-    std::string getName() const override
+    InternedString getName() const override
     {
         return m_device.getName();
     }
 
-    [[nodiscard]] std::string getDescription() const override
+    [[nodiscard]] InternedString getDescription() const override
     {
         return m_device.getDescription();
     }
@@ -51,35 +53,54 @@ public:
         return m_device.isMuted();
     }
 
-    void setMuted(bool mute) override;
+    void setMuted(bool mute, ResultCallback onDone = {}) override;
 
     Volume getVolume() const override
     {
         return m_device.getVolume();
     }
 
-    void setVolume(Volume volume) override;
+    void setVolume(Volume volume, ResultCallback onDone = {}) override;
+
+    [[nodiscard]] ChannelVolume getChannelVolume() const override
+    {
+        return m_device.getChannelVolume();
+    }
+
+    void setChannelVolume(const ChannelVolume& volume, ResultCallback onDone = {}) override;
+    void setBalance(float balance, ResultCallback onDone = {}) override;
+    void adjustVolume(int delta, ResultCallback onDone = {}) override;
+
+    [[nodiscard]] StatePtr getState() const override
+    {
+        return m_device.getState();
+    }
 
     std::string toString() const override;
 
     uint32_t getCardIndex() const;
 
-    void update(const pa_source_info& info);
-    void update(const pa_card_info& info);
+    ChangeMask update(const pa_source_info& info); // Notifies about and returns the changed fields
+    ChangeMask update(const CardPorts& ports);
 
     void markDeleted();
 
-    OnUpdateSignal onUpdate() const override
+    void setContext(pa_context& context) noexcept
+    {
+        m_device.setContext(context);
+    }
+
+    OnUpdateSignal& onUpdate() override
     {
         return m_onUpdate;
     }
 
-    OnDeleteSignal onDelete() const override
+    OnDeleteSignal& onDelete() override
     {
         return m_onDelete;
     }
 
-    void setDefault(bool value) override;
+    void setDefault(bool value, ResultCallback onDone = {}) override;
 
     [[nodiscard]] bool isDefault() const override;
 
@@ -87,6 +108,7 @@ public:
 
 private:
     void deleteCheck();
+    void setPulseVolume(const pa_cvolume& volume, ResultCallback onDone);
 
 private:
     GeneralDeviceImpl m_device;
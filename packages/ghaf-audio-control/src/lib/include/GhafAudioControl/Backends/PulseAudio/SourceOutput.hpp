@@ -14,24 +14,26 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-class SourceOutput final : public IAudioControlBackend::ISourceOutput
+class SourceOutput final
+    : public IAudioControlBackend::ISourceOutput
+    , private DeviceMemoryCharge<SourceOutput>
 {
 public:
-    SourceOutput(const pa_source_output_info& info, pa_context& context);
+    SourceOutput(const pa_source_output_info& info, pa_context& context, uint32_t server = 0);
 
     bool operator==(const IDevice& other) const override;
 
     Index getIndex() const override
     {
-        return m_device.getIndex();
+        return m_device.getDeviceIndex();
     }
 
-    std::string getName() const override
+    InternedString getName() const override
     {
         return m_device.getName();
     }
 
-    [[nodiscard]] std::string getDescription() const override
+    [[nodiscard]] InternedString getDescription() const override
     {
         return m_device.getDescription();
     }
@@ -51,14 +53,31 @@ public:
         return m_device.isMuted();
     }
 
-    void setMuted(bool mute) override;
+    void setMuted(bool mute, ResultCallback onDone = {}) override;
 
     Volume getVolume() const override
     {
         return m_device.getVolume();
     }
 
-    void setVolume(Volume volume) override;
+    void setVolume(Volume volume, ResultCallback onDone = {}) override;
+
+    [[nodiscard]] ChannelVolume getChannelVolume() const override
+    {
+        return m_device.getChannelVolume();
+    }
+
+    void setChannelVolume(const ChannelVolume& volume, ResultCallback onDone = {}) override;
+    void setBalance(float balance, ResultCallback onDone = {}) override;
+    void adjustVolume(int delta, ResultCallback onDone = {}) override;
+
+    // The source index is the PulseAudio one, of the same server
+    void moveTo(uint32_t sourceIndex, ResultCallback onDone = {});
+
+    [[nodiscard]] StatePtr getState() const override
+    {
+        return m_device.getState();
+    }
 
     std::string toString() const override;
 
@@ -67,26 +86,41 @@ public:
         return m_device.getCardIndex();
     }
 
-    void update(const pa_source_output_info& info)
+    std::optional<InternedString> getAppVmName() const
     {
-        m_device.update(info);
-        m_onUpdate();
+        return m_device.getAppVmName();
+    }
+
+    ChangeMask update(const pa_source_output_info& info)
+    {
+        const ChangeMask changes = m_device.update(info);
+
+        if (changes)
+            m_onUpdate(changes);
+
+        return changes;
     }
 
     void markDeleted();
 
-    OnUpdateSignal onUpdate() const override
+    void setContext(pa_context& context) noexcept
+    {
+        m_device.setContext(context);
+    }
+
+    OnUpdateSignal& onUpdate() override
     {
         return m_onUpdate;
     }
 
-    OnDeleteSignal onDelete() const override
+    OnDeleteSignal& onDelete() override
     {
         return m_onDelete;
     }
 
 private:
     void deleteCheck();
+    void setPulseVolume(const pa_cvolume& volume, ResultCallback onDone);
 
 private:
     GeneralDeviceImpl m_device;
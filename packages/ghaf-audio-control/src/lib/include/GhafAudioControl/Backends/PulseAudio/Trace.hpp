@@ -0,0 +1,116 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <pulse/introspect.h>
+#include <pulse/subscribe.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+// A trace file is a header followed by records. A record is a fixed header and a payload with the fields the backend uses,
+// in the native byte order. The strings are length prefixed. The file is read in place, through a memory mapping.
+// Every record has the number of the server it came from, 0 for a backend with a single server
+enum class TraceRecordKind : uint16_t
+{
+    SubscriptionEvent = 1,
+    ServerInfo,
+    SinkInfo,
+    SourceInfo,
+    SinkInputInfo,
+    SourceOutputInfo,
+    CardInfo,
+    ListEnd
+};
+
+// Receives the records of a trace as if they came from the server
+class ITraceHandler
+{
+public:
+    virtual ~ITraceHandler() = default;
+
+    virtual void onSubscriptionEvent(pa_subscription_event_type_t type, uint32_t index) = 0;
+    virtual void onServerInfo(const pa_server_info& info) = 0;
+    virtual void onSinkInfo(const pa_sink_info& info) = 0;
+    virtual void onSourceInfo(const pa_source_info& info) = 0;
+    virtual void onSinkInputInfo(const pa_sink_input_info& info) = 0;
+    virtual void onSourceOutputInfo(const pa_source_output_info& info) = 0;
+    virtual void onCardInfo(const pa_card_info& info) = 0;
+    virtual void onListEnd() = 0;
+};
+
+class TraceRecorder final
+{
+public:
+    explicit TraceRecorder(const std::string& path);
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    void record(uint16_t server, pa_subscription_event_type_t type, uint32_t index);
+    void record(uint16_t server, const pa_server_info& info);
+    void record(uint16_t server, const pa_sink_info& info);
+    void record(uint16_t server, const pa_source_info& info);
+    void record(uint16_t server, const pa_sink_input_info& info);
+    void record(uint16_t server, const pa_source_output_info& info);
+    void record(uint16_t server, const pa_card_info& info);
+    void recordListEnd(uint16_t server);
+
+private:
+    void write(uint16_t server, TraceRecordKind kind);
+
+private:
+    std::ofstream m_file;
+    std::string m_payload; // Reused, so a record doesn't allocate once the buffer has grown
+    std::chrono::steady_clock::time_point m_startTime;
+};
+
+class TraceReader final
+{
+public:
+    struct Record
+    {
+        TraceRecordKind kind;
+        uint16_t server;
+        std::chrono::nanoseconds timestamp; // Since the start of the recording
+        std::span<const std::byte> payload;
+    };
+
+    explicit TraceReader(const std::string& path);
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    // The wall clock time the recording started at
+    [[nodiscard]] std::chrono::system_clock::time_point getStartTime() const noexcept
+    {
+        return m_startTime;
+    }
+
+    // The records are views into the mapping, valid as long as the reader. A truncated last record ends the trace
+    [[nodiscard]] std::optional<Record> next();
+    void rewind() noexcept;
+
+    // Decodes the record and passes it to the matching handler method. Throws on a malformed payload
+    static void Dispatch(const Record& record, ITraceHandler& handler);
+
+private:
+    std::span<const std::byte> m_data;
+    size_t m_offset = 0;
+    std::chrono::system_clock::time_point m_startTime;
+};
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
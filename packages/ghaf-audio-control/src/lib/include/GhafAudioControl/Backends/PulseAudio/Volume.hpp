@@ -5,14 +5,58 @@
 
 #pragma once
 
+#include <GhafAudioControl/ChannelVolume.hpp>
 #include <GhafAudioControl/Volume.hpp>
 
+#include <pulse/channelmap.h>
 #include <pulse/volume.h>
 
+#include <optional>
+#include <string_view>
+
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-[[nodiscard]] pa_volume_t ToPulseAudioVolume(Volume volume) noexcept;
-[[nodiscard]] Volume FromPulseAudioVolume(pa_volume_t pulseVolume) noexcept(false);
+// How the percents of the UI and the D-Bus API map to the volume of the server:
+//  - Linear: the percents of PA_VOLUME_NORM, as pavucontrol shows them. The volume of the server is already close to the loudness
+//  - Cubic: the percents are the linear amplitude, see pa_sw_volume_from_linear()
+//  - Decibel: the percents are linear in dB, from -DecibelCurveRange at 0% up to 0 dB at 100%. 0% itself is muted
+enum class VolumeCurve
+{
+    Linear,
+    Cubic,
+    Decibel
+};
+
+constexpr double DecibelCurveRange = 60.0;
+
+[[nodiscard]] std::optional<VolumeCurve> VolumeCurveFromString(std::string_view value) noexcept;
+
+// The curve is the same for all the devices of the process. Linear by default. Set before the backend starts
+void SetVolumeCurve(VolumeCurve curve) noexcept;
+[[nodiscard]] VolumeCurve GetVolumeCurve() noexcept;
+
+// The curve of a device. The cubic and the dB curves need the volume of the device to be in dB: the streams are scaled in software,
+// but the hardware volume of a device without the dB information is a position of the mixer, so its curve stays linear
+[[nodiscard]] VolumeCurve GetDeviceVolumeCurve(bool hasDecibelVolume) noexcept;
+
+// The conversions are a load of a precomputed table of the percents, interpolated for the steps between them
+[[nodiscard]] pa_volume_t ToPulseAudioVolume(Volume volume, VolumeCurve curve) noexcept;
+
+// The volumes above PA_VOLUME_NORM are 100%
+[[nodiscard]] Volume FromPulseAudioVolume(pa_volume_t pulseVolume, VolumeCurve curve) noexcept;
+
+[[nodiscard]] ChannelVolume FromPulseAudioChannelVolume(const pa_cvolume& volume, const pa_channel_map& channelMap, VolumeCurve curve);
+
+// A single channel volume is applied to all the channels. Otherwise the number of channels must match the channel map
+[[nodiscard]] pa_cvolume ToPulseAudioChannelVolume(const ChannelVolume& volume, const pa_channel_map& channelMap, VolumeCurve curve) noexcept(false);
+
+// Scale all the channels, so the loudest one gets the volume, keeping the balance between them
+[[nodiscard]] pa_cvolume ScalePulseAudioChannelVolume(pa_cvolume volume, Volume max, VolumeCurve curve) noexcept;
+
+// Change the loudest channel by delta percents of the curve, clamping the result to [0, 100], and scale the rest with it
+[[nodiscard]] pa_cvolume AdjustPulseAudioChannelVolume(pa_cvolume volume, int delta, VolumeCurve curve) noexcept;
+
+[[nodiscard]] pa_cvolume BalancePulseAudioChannelVolume(pa_cvolume volume, const pa_channel_map& channelMap, float balance) noexcept(false);
 
 } // namespace ghaf::AudioControl::Backend::PulseAudio
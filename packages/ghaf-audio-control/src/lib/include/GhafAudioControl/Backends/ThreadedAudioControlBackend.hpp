@@ -0,0 +1,122 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/IAudioControlBackend.hpp>
+
+#include <glibmm/main.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace ghaf::AudioControl::Backend
+{
+
+// Runs a backend on a thread of its own, with its own main context, so the server events don't compete with the UI rendering.
+// The methods and the signals are for the UI thread: the calls are passed to the backend thread, the events and the results come
+// back through a lock-free queue drained when the UI main loop is idle. The devices given out are proxies working the same way
+class ThreadedAudioControlBackend final : public IAudioControlBackend
+{
+public:
+    // Called on the constructing thread. The backend must attach everything it runs to the given main context
+    using Factory = std::function<std::shared_ptr<IAudioControlBackend>(Glib::RefPtr<Glib::MainContext>)>;
+
+    explicit ThreadedAudioControlBackend(const Factory& factory);
+    ~ThreadedAudioControlBackend() override;
+
+    ThreadedAudioControlBackend(const ThreadedAudioControlBackend&) = delete;
+    ThreadedAudioControlBackend& operator=(const ThreadedAudioControlBackend&) = delete;
+
+    void start() override;
+    void stop() override;
+
+    void setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume, ResultCallback onDone = {}) override;
+    void adjustDeviceVolume(IDevice::IntexT index, IDevice::Type type, int delta, ResultCallback onDone = {}) override;
+    void setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute, ResultCallback onDone = {}) override;
+
+    void rampDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume target, std::chrono::milliseconds duration,
+                          ResultCallback onDone = {}) override;
+
+    void makeDeviceDefault(IDevice::IntexT index, IDevice::Type type, ResultCallback onDone = {}) override;
+
+    void setDevicesState(const std::vector<DeviceStateRequest>& requests, ResultsCallback onDone) override;
+
+    void moveDevice(IDevice::IntexT index, IDevice::Type type, IDevice::IntexT targetIndex, ResultCallback onDone = {}) override;
+    void moveDevices(const std::vector<DeviceMoveRequest>& requests, ResultsCallback onDone) override;
+
+    // The devices as of the last event delivered to the UI thread
+    std::vector<IAudioControlBackend::IDevice::Ptr> getAllDevices() const override;
+
+    Generation getGeneration() const override
+    {
+        return m_generation;
+    }
+
+    OnDevicesChangeSignal& onDevicesChanged() override
+    {
+        return m_onDevicesChanged;
+    }
+
+    OnErrorSignal onError() const override
+    {
+        return m_onError;
+    }
+
+    State getState() const override
+    {
+        return m_state;
+    }
+
+    OnStateChangeSignal onStateChange() const override
+    {
+        return m_onStateChange;
+    }
+
+    void setPeakMeteringEnabled(bool enabled) override;
+
+    OnPeaksSignal onPeaks() const override
+    {
+        return m_onPeaks;
+    }
+
+private:
+    // The queues between the threads. Defined in the source file, as are the device proxies
+    class Bridge;
+
+    template<class InterfaceT>
+    class DeviceProxy;
+
+    template<class InterfaceT>
+    class DefaultableDeviceProxy;
+
+    void runOnBackend(std::function<void(IAudioControlBackend&)> function);
+
+    void onDeviceChange(OnSignalMapChangeSignalInfo info);
+
+private:
+    Glib::RefPtr<Glib::MainContext> m_context;
+    Glib::RefPtr<Glib::MainLoop> m_loop;
+
+    std::shared_ptr<IAudioControlBackend> m_backend;
+    std::shared_ptr<Bridge> m_bridge;
+
+    std::thread m_thread;
+
+    // The UI thread view of the backend
+    std::map<std::pair<IDevice::Type, Index>, IDevice::Ptr> m_devices;
+    Generation m_generation = 0;
+    State m_state = State::Disconnected;
+
+    OnDevicesChangeSignal m_onDevicesChanged;
+
+    OnErrorSignal m_onError;
+    OnStateChangeSignal m_onStateChange;
+    OnPeaksSignal m_onPeaks;
+};
+
+} // namespace ghaf::AudioControl::Backend
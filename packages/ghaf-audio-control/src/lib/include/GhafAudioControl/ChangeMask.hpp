@@ -0,0 +1,100 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace ghaf::AudioControl
+{
+
+// The fields of a device state an update may change
+enum class DeviceField : uint32_t
+{
+    Volume = 1U << 0,
+    Mute = 1U << 1,
+    Name = 1U << 2, // The name, the description and the AppVM name
+    Default = 1U << 3,
+    Enabled = 1U << 4,
+    ChannelMap = 1U << 5, // The channels and their volumes, so also the balance
+    Metadata = 1U << 6,   // The application name, the icon, the media role and the binary of a stream
+
+    Last = Metadata,
+
+    // Not a field, so not in ChangeMask::All(): set along with Volume when the volume is an intermediate step of a ramp,
+    // which the subscribers that only need the final volume can skip
+    RampStep = 1U << 7
+};
+
+// Set of the changed fields. An empty mask means that nothing a subscriber could see has changed
+class ChangeMask final
+{
+public:
+    constexpr ChangeMask() noexcept = default;
+
+    constexpr ChangeMask(DeviceField field) noexcept
+        : m_bits(static_cast<uint32_t>(field))
+    {
+    }
+
+    [[nodiscard]] static constexpr ChangeMask All() noexcept
+    {
+        return ChangeMask{(static_cast<uint32_t>(DeviceField::Last) << 1U) - 1U};
+    }
+
+    [[nodiscard]] constexpr bool has(DeviceField field) const noexcept
+    {
+        return (m_bits & static_cast<uint32_t>(field)) != 0;
+    }
+
+    [[nodiscard]] constexpr bool intersects(ChangeMask other) const noexcept
+    {
+        return (m_bits & other.m_bits) != 0;
+    }
+
+    [[nodiscard]] constexpr bool isEmpty() const noexcept
+    {
+        return m_bits == 0;
+    }
+
+    constexpr explicit operator bool() const noexcept
+    {
+        return !isEmpty();
+    }
+
+    constexpr ChangeMask& operator|=(ChangeMask other) noexcept
+    {
+        m_bits |= other.m_bits;
+        return *this;
+    }
+
+    [[nodiscard]] constexpr ChangeMask operator|(ChangeMask other) const noexcept
+    {
+        return ChangeMask{m_bits | other.m_bits};
+    }
+
+    [[nodiscard]] constexpr ChangeMask operator&(ChangeMask other) const noexcept
+    {
+        return ChangeMask{m_bits & other.m_bits};
+    }
+
+    constexpr bool operator==(const ChangeMask& other) const noexcept = default;
+
+private:
+    constexpr explicit ChangeMask(uint32_t bits) noexcept
+        : m_bits(bits)
+    {
+    }
+
+private:
+    uint32_t m_bits = 0;
+};
+
+[[nodiscard]] constexpr ChangeMask operator|(DeviceField first, DeviceField second) noexcept
+{
+    return ChangeMask{first} | second;
+}
+
+} // namespace ghaf::AudioControl
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/Volume.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace ghaf::AudioControl
+{
+
+class ChannelVolume final
+{
+public:
+    enum class Position
+    {
+        Mono,
+        Left,
+        Right,
+        Center,
+        Other
+    };
+
+    struct Channel
+    {
+        Position position;
+        Volume volume;
+    };
+
+    using Channels = std::vector<Channel>;
+
+public:
+    ChannelVolume() = default;
+
+    ChannelVolume(Channels channels, float balance)
+        : m_channels(std::move(channels))
+        , m_balance(std::clamp(balance, -1.0F, 1.0F))
+    {
+    }
+
+    [[nodiscard]] const Channels& getChannels() const noexcept
+    {
+        return m_channels;
+    }
+
+    // -1.0 is fully left, 1.0 is fully right
+    [[nodiscard]] float getBalance() const noexcept
+    {
+        return m_balance;
+    }
+
+    [[nodiscard]] Volume getMax() const noexcept
+    {
+        const auto it = std::ranges::max_element(m_channels, {}, [](const Channel& channel) { return channel.volume.getPercents(); });
+        return it == m_channels.end() ? Volume::fromPercents(0U) : it->volume;
+    }
+
+private:
+    Channels m_channels;
+    float m_balance = 0.0F;
+};
+
+} // namespace ghaf::AudioControl
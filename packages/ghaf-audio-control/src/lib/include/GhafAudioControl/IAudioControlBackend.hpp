@@ -5,12 +5,23 @@
 
 #pragma once
 
+#include <GhafAudioControl/ChangeMask.hpp>
+#include <GhafAudioControl/ChannelVolume.hpp>
 #include <GhafAudioControl/Volume.hpp>
+#include <GhafAudioControl/utils/FlatSignal.hpp>
+#include <GhafAudioControl/utils/InternedString.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
-#include <map>
+#include <initializer_list>
 #include <memory>
 #include <optional>
+#include <ranges>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <sigc++/signal.h>
 
@@ -22,12 +33,27 @@ using Index = uint64_t;
 class IAudioControlBackend
 {
 public:
+    enum class Result
+    {
+        Ok,
+        NoSuchDevice,
+        InvalidArgument,
+        Failed
+    };
+
+    // Called once the server has confirmed or rejected a change. Never called for a change that has not been sent
+    using ResultCallback = std::function<void(Result)>;
+    using ResultsCallback = std::function<void(std::vector<Result>)>;
+
     class IDevice
     {
     public:
         using Ptr = std::shared_ptr<IDevice>;
         using IntexT = Index;
 
+        using Result = IAudioControlBackend::Result;
+        using ResultCallback = IAudioControlBackend::ResultCallback;
+
         enum class Type
         {
             Sink,
@@ -36,7 +62,38 @@ public:
             SourceOutput
         };
 
-        using OnUpdateSignal = sigc::signal<void()>;
+        // Immutable snapshot of the device. A new one is published on every change, so all the fields are consistent with each other
+        struct State
+        {
+            uint64_t version = 0;
+
+            // Interned, so the unchanged strings are compared and copied without touching them
+            InternedString name;
+            InternedString description;
+            std::optional<InternedString> appVmName;
+
+            Volume volume = Volume::fromPercents(0U);
+            bool isMuted = false;
+            bool isDefault = false; // Makes sense only for a Sink and a Source
+            bool isEnabled = false;
+
+            // The proplist keys of a stream the clients show instead of the name. Empty for a Sink and a Source, and for the missing keys
+            struct Metadata
+            {
+                InternedString applicationName;
+                InternedString iconName;
+                InternedString mediaRole;
+                InternedString processBinary;
+
+                bool operator==(const Metadata& other) const = default;
+            };
+
+            Metadata metadata;
+        };
+
+        using StatePtr = std::shared_ptr<const State>;
+
+        using OnUpdateSignal = sigc::signal<void(ChangeMask)>; // Emitted only with a non-empty mask
         using OnDeleteSignal = sigc::signal<void()>;
 
         virtual ~IDevice() = default;
@@ -45,22 +102,31 @@ public:
 
         [[nodiscard]] virtual Index getIndex() const = 0;
 
-        [[nodiscard]] virtual std::string getName() const = 0;
-        [[nodiscard]] virtual std::string getDescription() const = 0;
+        [[nodiscard]] virtual InternedString getName() const = 0;
+        [[nodiscard]] virtual InternedString getDescription() const = 0;
         [[nodiscard]] virtual Type getType() const = 0;
 
         [[nodiscard]] virtual bool isEnabled() const = 0;
 
         [[nodiscard]] virtual bool isMuted() const = 0;
-        virtual void setMuted(bool mute) = 0;
+        virtual void setMuted(bool mute, ResultCallback onDone = {}) = 0;
 
         [[nodiscard]] virtual Volume getVolume() const = 0;
-        virtual void setVolume(Volume volume) = 0;
+        virtual void setVolume(Volume volume, ResultCallback onDone = {}) = 0; // Scales all the channels, keeping the balance
+
+        [[nodiscard]] virtual ChannelVolume getChannelVolume() const = 0;
+        virtual void setChannelVolume(const ChannelVolume& volume, ResultCallback onDone = {}) = 0;
+        virtual void setBalance(float balance, ResultCallback onDone = {}) = 0;
+
+        // Relative change of all the channels in percents
+        virtual void adjustVolume(int delta, ResultCallback onDone = {}) = 0;
+
+        [[nodiscard]] virtual StatePtr getState() const = 0;
 
         [[nodiscard]] virtual std::string toString() const = 0;
 
-        [[nodiscard]] virtual OnUpdateSignal onUpdate() const = 0;
-        [[nodiscard]] virtual OnDeleteSignal onDelete() const = 0;
+        [[nodiscard]] virtual OnUpdateSignal& onUpdate() = 0;
+        [[nodiscard]] virtual OnDeleteSignal& onDelete() = 0;
     };
 
     class IDefaultable
@@ -68,7 +134,7 @@ public:
     public:
         virtual ~IDefaultable() = default;
 
-        virtual void setDefault(bool value) = 0;
+        virtual void setDefault(bool value, ResultCallback onDone = {}) = 0;
         [[nodiscard]] virtual bool isDefault() const = 0;
 
         virtual void updateDefault(bool value) = 0;
@@ -94,6 +160,23 @@ public:
     {
     };
 
+    // A device of the Sink type is an ISink, and a Source an ISource, so the type tells the defaultable ones without a cast
+    [[nodiscard]] static IDefaultable* AsDefaultable(IDevice& device) noexcept
+    {
+        switch (device.getType())
+        {
+        case IDevice::Type::Sink:
+            return &static_cast<ISink&>(device);
+        case IDevice::Type::Source:
+            return &static_cast<ISource&>(device);
+        case IDevice::Type::SinkInput:
+        case IDevice::Type::SourceOutput:
+            break;
+        }
+
+        return nullptr;
+    }
+
     enum class EventType
     {
         Add,
@@ -101,14 +184,88 @@ public:
         Delete
     };
 
+    // Monotonic number of the changes made to all the devices of a backend
+    using Generation = uint64_t;
+
     struct OnSignalMapChangeSignalInfo
     {
         EventType eventType;
         Index index;
         IDevice::Type type;
         IDevice::Ptr ptr;
+        Generation generation;
+        ChangeMask changes = ChangeMask::All(); // What an update has changed. All the fields for an add and a delete
+    };
+
+    // The changes of all the device types go through one signal. A subscriber picks the ones it is called for with a filter
+    using OnDevicesChangeSignal = FlatSignal<void(const OnSignalMapChangeSignalInfo&)>;
+
+    // The device types and the event types a subscriber of onDevicesChanged() is called for. All of them by default
+    class DeviceChangeFilter final
+    {
+    public:
+        using Mask = OnDevicesChangeSignal::Mask;
+
+        constexpr DeviceChangeFilter() = default;
+
+        [[nodiscard]] static constexpr DeviceChangeFilter Types(std::initializer_list<IDevice::Type> types) noexcept
+        {
+            Mask mask = AllEvents;
+
+            for (const IDevice::Type type : types)
+                mask |= TypeBit(type);
+
+            return DeviceChangeFilter{mask};
+        }
+
+        [[nodiscard]] constexpr DeviceChangeFilter events(std::initializer_list<EventType> eventTypes) const noexcept
+        {
+            Mask mask = m_mask & AllTypes;
+
+            for (const EventType eventType : eventTypes)
+                mask |= EventBit(eventType);
+
+            return DeviceChangeFilter{mask};
+        }
+
+        [[nodiscard]] constexpr Mask mask() const noexcept
+        {
+            return m_mask;
+        }
+
+        // What a change is emitted with
+        [[nodiscard]] static constexpr Mask Key(IDevice::Type type, EventType eventType) noexcept
+        {
+            return TypeBit(type) | EventBit(eventType);
+        }
+
+    private:
+        explicit constexpr DeviceChangeFilter(Mask mask) noexcept
+            : m_mask(mask)
+        {
+        }
+
+        [[nodiscard]] static constexpr Mask TypeBit(IDevice::Type type) noexcept
+        {
+            return 1U << static_cast<unsigned>(type);
+        }
+
+        [[nodiscard]] static constexpr Mask EventBit(EventType eventType) noexcept
+        {
+            return 1U << (EventsShift + static_cast<unsigned>(eventType));
+        }
+
+    private:
+        static constexpr unsigned EventsShift = 4;
+        static constexpr Mask AllTypes = (1U << EventsShift) - 1;
+        static constexpr Mask AllEvents = 0b111U << EventsShift;
+
+        Mask m_mask = AllTypes | AllEvents;
     };
 
+    // T is the device type stored: an interface, or the concrete type of a backend, so the backend needs no casts.
+    // The update callables take a T& and return the ChangeMask of the device, the predicates take a const T&.
+    // The maps of a backend share the generation counter and the change signal
     template<class T>
     class SignalMap final
     {
@@ -116,41 +273,46 @@ public:
         using IndexT = Index;
         using PtrT = std::shared_ptr<T>;
 
-        using UpdateFunction = std::function<bool(T&)>; // returns true, if changed
-        using Predicate = std::function<bool(const T&)>;
-
     private:
-        using MapType = std::map<Index, PtrT>;
+        using Entry = std::pair<Index, PtrT>;
+        using ContainerType = std::vector<Entry>; // Sorted by the index
 
     public:
-        using Iter = MapType::iterator;
-        using OnChangeSignal = sigc::signal<void(OnSignalMapChangeSignalInfo)>;
+        using Iter = ContainerType::iterator;
 
-        SignalMap() = default;
+        // Every change notification bumps the generation
+        SignalMap(Generation& generation, OnDevicesChangeSignal& onChange)
+            : m_generation(generation)
+            , m_onChange(onChange)
+        {
+        }
 
         void add(Index key, PtrT&& data)
         {
-            auto result = m_map.emplace(key, std::move(data));
-            auto iter = result.first;
+            auto iter = lowerBound(key);
 
-            m_onChange({EventType::Add, iter->first, iter->second->getType(), iter->second});
+            if (iter == m_entries.end() || iter->first != key)
+                iter = m_entries.emplace(iter, key, std::move(data));
+
+            notify(EventType::Add, iter->first, iter->second->getType(), iter->second);
         }
 
         [[nodiscard]] std::optional<Iter> findByKey(Index key)
         {
-            if (auto iter = m_map.find(key); iter != m_map.end())
+            if (auto iter = lowerBound(key); iter != m_entries.end() && iter->first == key)
                 return iter;
 
             return std::nullopt;
         }
 
-        [[nodiscard]] std::vector<Iter> findByPredicate(Predicate predicate)
+        template<class PredicateT>
+        [[nodiscard]] std::vector<Iter> findByPredicate(PredicateT&& predicate)
         {
             std::vector<Iter> iterators;
 
-            for (Iter it = m_map.begin(); it != m_map.end(); ++it)
+            for (Iter it = m_entries.begin(); it != m_entries.end(); ++it)
             {
-                if (const PtrT ptr = it->second; predicate(*ptr))
+                if (predicate(*it->second))
                     iterators.push_back(it);
             }
 
@@ -159,52 +321,136 @@ public:
 
         [[nodiscard]] std::vector<PtrT> getAllValues() const
         {
-            std::vector<PtrT> iterators;
+            std::vector<PtrT> values;
+            values.reserve(m_entries.size());
 
-            for (auto it = m_map.cbegin(); it != m_map.cend(); ++it)
-                iterators.push_back(it->second);
+            for (const PtrT& value : getValues())
+                values.push_back(value);
 
-            return iterators;
+            return values;
         }
 
-        void update(Iter iter, UpdateFunction updateFunction)
+        // Non-owning view over the stored values, valid until the next add() or remove()
+        [[nodiscard]] auto getValues() const noexcept
         {
-            PtrT ptr = iter->second;
+            return std::views::values(m_entries);
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return m_entries.size();
+        }
 
-            if (updateFunction(*ptr))
-                m_onChange({EventType::Update, iter->first, iter->second->getType(), ptr});
+        template<class UpdateFunctionT>
+        void update(Iter iter, UpdateFunctionT&& updateFunction)
+        {
+            const PtrT& ptr = iter->second;
+
+            if (const ChangeMask changes = updateFunction(*ptr))
+                notify(EventType::Update, iter->first, ptr->getType(), ptr, changes);
         }
 
-        void forEach(UpdateFunction updateFunction)
+        template<class PredicateT, class UpdateFunctionT>
+        void updateIf(PredicateT&& predicate, UpdateFunctionT&& updateFunction)
         {
-            for (auto iter = m_map.begin(); iter != m_map.end(); ++iter)
+            for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter)
             {
-                if (updateFunction(*iter->second))
-                    m_onChange({EventType::Update, iter->first, iter->second->getType(), iter->second});
+                if (predicate(*iter->second))
+                    update(iter, updateFunction);
             }
         }
 
-        void remove(Iter iter, UpdateFunction deleteFunction)
+        template<class UpdateFunctionT>
+        void forEach(UpdateFunctionT&& updateFunction)
+        {
+            for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+                update(iter, updateFunction);
+        }
+
+        template<class DeleteFunctionT>
+        void remove(Iter iter, DeleteFunctionT&& deleteFunction)
         {
-            PtrT ptr = iter->second;
+            const PtrT ptr = iter->second;
             const auto type = ptr->getType();
+            const auto key = iter->first;
 
             deleteFunction(*ptr);
 
-            const auto key = iter->first;
-            std::ignore = m_map.erase(key);
+            std::ignore = m_entries.erase(iter);
+
+            notify(EventType::Delete, key, type, nullptr);
+        }
+
+    private:
+        void notify(EventType eventType, Index key, IDevice::Type type, const PtrT& ptr, ChangeMask changes = ChangeMask::All())
+        {
+            GetEventsCounter(eventType).increment();
 
-            m_onChange({EventType::Delete, key, type, nullptr});
+            if (eventType == EventType::Update)
+                CountChanges(changes);
+
+            const Generation generation = ++m_generation;
+            const auto eventKey = DeviceChangeFilter::Key(type, eventType);
+
+            // Nobody to tell, so the info isn't built, and the device isn't referenced once more
+            if (!m_onChange.hasSubscribers(eventKey))
+                return;
+
+            const OnSignalMapChangeSignalInfo info{eventType, key, type, ptr, generation, changes};
+            m_onChange.emit(eventKey, info);
+        }
+
+        static void CountChanges(ChangeMask changes)
+        {
+            static Metrics::Counter& volume = Metrics::GetCounter("device_changes_total{field=\"volume\"}");
+            static Metrics::Counter& mute = Metrics::GetCounter("device_changes_total{field=\"mute\"}");
+            static Metrics::Counter& name = Metrics::GetCounter("device_changes_total{field=\"name\"}");
+            static Metrics::Counter& isDefault = Metrics::GetCounter("device_changes_total{field=\"default\"}");
+            static Metrics::Counter& enabled = Metrics::GetCounter("device_changes_total{field=\"enabled\"}");
+            static Metrics::Counter& channelMap = Metrics::GetCounter("device_changes_total{field=\"channel_map\"}");
+
+            const std::pair<DeviceField, Metrics::Counter&> counters[] = {{DeviceField::Volume, volume},
+                                                                           {DeviceField::Mute, mute},
+                                                                           {DeviceField::Name, name},
+                                                                           {DeviceField::Default, isDefault},
+                                                                           {DeviceField::Enabled, enabled},
+                                                                           {DeviceField::ChannelMap, channelMap}};
+
+            for (const auto& [field, counter] : counters)
+            {
+                if (changes.has(field))
+                    counter.increment();
+            }
         }
 
-        [[nodiscard]] OnChangeSignal onChange() const
+        [[nodiscard]] static Metrics::Counter& GetEventsCounter(EventType eventType)
         {
-            return m_onChange;
+            static Metrics::Counter& added = Metrics::GetCounter("device_events_total{event=\"add\"}");
+            static Metrics::Counter& updated = Metrics::GetCounter("device_events_total{event=\"update\"}");
+            static Metrics::Counter& deleted = Metrics::GetCounter("device_events_total{event=\"delete\"}");
+
+            switch (eventType)
+            {
+            case EventType::Add:
+                return added;
+            case EventType::Update:
+                return updated;
+            case EventType::Delete:
+                break;
+            }
+
+            return deleted;
+        }
+
+        [[nodiscard]] Iter lowerBound(Index key)
+        {
+            return std::ranges::lower_bound(m_entries, key, {}, &Entry::first);
         }
 
     private:
-        MapType m_map;
-        OnChangeSignal m_onChange;
+        ContainerType m_entries;
+        Generation& m_generation;
+        OnDevicesChangeSignal& m_onChange;
     };
 
     using Sinks = SignalMap<ISink>;
@@ -212,26 +458,114 @@ public:
     using SinkInputs = SignalMap<ISinkInput>;
     using SourceOutputs = SignalMap<ISourceOutput>;
 
+    // The errors the backend can't recover from. A lost connection is not one of them, see State::Reconnecting
     using OnErrorSignal = sigc::signal<void(std::string)>;
 
+    enum class State
+    {
+        Disconnected,
+        Connected,    // The server is ready, the devices are being listed
+        Synchronized, // All the devices have been listed
+        Reconnecting, // The connection has been lost. The devices are kept, stale, until the server is back and they are listed again
+    };
+
+    using OnStateChangeSignal = sigc::signal<void(State)>;
+
+    // The loudest sample since the previous level of the device, linear, in [0, 1]
+    struct PeakLevel
+    {
+        IDevice::IntexT index;
+        IDevice::Type type;
+        float peak;
+    };
+
+    // The changed levels, all at once, a few times per second at most
+    using OnPeaksSignal = sigc::signal<void(const std::vector<PeakLevel>&)>;
+
+    // An empty field leaves the corresponding property unchanged
+    struct DeviceStateRequest
+    {
+        IDevice::IntexT index;
+        IDevice::Type type;
+        std::optional<bool> mute;
+        std::optional<Volume> volume;
+    };
+
+    // A SinkInput to a Sink, or a SourceOutput to a Source, of the same server
+    struct DeviceMoveRequest
+    {
+        IDevice::IntexT index;
+        IDevice::Type type;
+        IDevice::IntexT targetIndex;
+    };
+
+    // The same change for all the devices, to be applied with setDevicesState
+    template<class DevicesT>
+    [[nodiscard]] static std::vector<DeviceStateRequest> MakeGroupRequests(const DevicesT& devices, std::optional<bool> mute, std::optional<Volume> volume)
+    {
+        std::vector<DeviceStateRequest> requests;
+        requests.reserve(std::size(devices));
+
+        for (const auto& device : devices)
+            requests.push_back({device->getIndex(), device->getType(), mute, volume});
+
+        return requests;
+    }
+
+    // All the devices to the same target, to be applied with moveDevices
+    template<class DevicesT>
+    [[nodiscard]] static std::vector<DeviceMoveRequest> MakeGroupMoveRequests(const DevicesT& devices, IDevice::IntexT targetIndex)
+    {
+        std::vector<DeviceMoveRequest> requests;
+        requests.reserve(std::size(devices));
+
+        for (const auto& device : devices)
+            requests.push_back({device->getIndex(), device->getType(), targetIndex});
+
+        return requests;
+    }
+
     virtual ~IAudioControlBackend() = default;
 
     virtual void start() = 0;
     virtual void stop() = 0;
 
-    virtual void setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume) = 0;
-    virtual void setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute) = 0;
+    virtual void setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume, ResultCallback onDone = {}) = 0;
+    virtual void adjustDeviceVolume(IDevice::IntexT index, IDevice::Type type, int delta, ResultCallback onDone = {}) = 0;
+    virtual void setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute, ResultCallback onDone = {}) = 0;
 
-    virtual void makeDeviceDefault(IDevice::IntexT index, IDevice::Type type) = 0;
+    // Moves the volume from the current one to the target over the duration. The result is of the last step. A ramp is replaced
+    // by another ramp of the device or a change of its volume, and fails then. The updates before the last step have RampStep
+    virtual void rampDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume target, std::chrono::milliseconds duration,
+                                  ResultCallback onDone = {}) = 0;
+
+    virtual void makeDeviceDefault(IDevice::IntexT index, IDevice::Type type, ResultCallback onDone = {}) = 0;
+
+    // Applies all the requests in one go. Reports a result per request, in the same order, once all of them are done
+    virtual void setDevicesState(const std::vector<DeviceStateRequest>& requests, ResultsCallback onDone) = 0;
+
+    // InvalidArgument for a device that can't be moved to the target, NoSuchDevice if either of them is missing
+    virtual void moveDevice(IDevice::IntexT index, IDevice::Type type, IDevice::IntexT targetIndex, ResultCallback onDone = {}) = 0;
+
+    // Like setDevicesState: the moves leave together, and a result per request is reported once all of them are done
+    virtual void moveDevices(const std::vector<DeviceMoveRequest>& requests, ResultsCallback onDone) = 0;
 
     [[nodiscard]] virtual std::vector<IDevice::Ptr> getAllDevices() const = 0;
 
-    [[nodiscard]] virtual Sinks::OnChangeSignal onSinksChanged() const = 0;
-    [[nodiscard]] virtual Sources::OnChangeSignal onSourcesChanged() const = 0;
-    [[nodiscard]] virtual SinkInputs::OnChangeSignal onSinkInputsChanged() const = 0;
-    [[nodiscard]] virtual SourceOutputs::OnChangeSignal onSourceOutputsChanged() const = 0;
+    // The generation the current devices state corresponds to
+    [[nodiscard]] virtual Generation getGeneration() const = 0;
+
+    // Connect with a DeviceChangeFilter mask to be called for some of the device types or event types only
+    [[nodiscard]] virtual OnDevicesChangeSignal& onDevicesChanged() = 0;
 
     [[nodiscard]] virtual OnErrorSignal onError() const = 0;
+
+    [[nodiscard]] virtual State getState() const = 0;
+    [[nodiscard]] virtual OnStateChangeSignal onStateChange() const = 0;
+
+    // The levels of the sinks and the sink inputs. Off by default, as it takes a record stream per device
+    virtual void setPeakMeteringEnabled(bool enabled) = 0;
+    [[nodiscard]] virtual OnPeaksSignal onPeaks() const = 0;
 };
 
 } // namespace ghaf::AudioControl
@@ -15,44 +15,61 @@ namespace ghaf::AudioControl
 template<typename T>
 concept NumericType = std::unsigned_integral<T> || std::floating_point<T>;
 
+// The volume is kept in the hundredths of a percent, so the ramps and the volumes of the server don't lose the steps between
+// the percents. The UI and the D-Bus API take the rounded percents
 class Volume
 {
 public:
     using InternalT = uint8_t;
+    using StepT = uint16_t;
 
     static constexpr InternalT Min = 0;
     static constexpr InternalT Max = 100;
 
+    static constexpr StepT StepsPerPercent = 100;
+    static constexpr StepT MaxSteps = Max * StepsPerPercent;
+
 private:
-    explicit Volume(NumericType auto value)
-        : m_volume(trunkate(value))
+    explicit constexpr Volume(StepT steps) noexcept
+        : m_steps(steps)
     {
     }
 
 public:
-    [[nodiscard]] static Volume fromPercents(NumericType auto percents) noexcept
+    // The fractions of the floating point percents are kept up to a hundredth
+    [[nodiscard]] static constexpr Volume fromPercents(NumericType auto percents) noexcept
     {
-        return Volume{percents};
+        if (!(percents > Min))
+            return Volume{StepT{0}};
+
+        if (percents >= Max)
+            return Volume{MaxSteps};
+
+        if constexpr (std::floating_point<decltype(percents)>)
+            return Volume{static_cast<StepT>(percents * StepsPerPercent + 0.5)};
+        else
+            return Volume{static_cast<StepT>(percents * StepsPerPercent)};
     }
 
-    [[nodiscard]] InternalT getPercents() const noexcept
+    [[nodiscard]] static constexpr Volume fromSteps(std::unsigned_integral auto steps) noexcept
     {
-        return m_volume;
+        return Volume{steps < MaxSteps ? static_cast<StepT>(steps) : MaxSteps};
     }
 
-private:
-    [[nodiscard]] InternalT trunkate(NumericType auto value) const noexcept
+    [[nodiscard]] constexpr InternalT getPercents() const noexcept
     {
-        if (value < Min)
-            return Min;
-
-        if (value > Max)
-            return Max;
+        return static_cast<InternalT>((m_steps + StepsPerPercent / 2) / StepsPerPercent);
+    }
 
-        return value;
+    [[nodiscard]] constexpr StepT getSteps() const noexcept
+    {
+        return m_steps;
     }
 
-    InternalT m_volume;
+    [[nodiscard]] constexpr bool operator==(const Volume& other) const noexcept = default;
+
+private:
+    StepT m_steps;
 };
 
 } // namespace ghaf::AudioControl
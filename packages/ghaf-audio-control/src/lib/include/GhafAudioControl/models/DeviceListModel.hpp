@@ -7,26 +7,41 @@
 
 #include <GhafAudioControl/IAudioControlBackend.hpp>
 #include <GhafAudioControl/models/DeviceModel.hpp>
+#include <GhafAudioControl/utils/MemoryCharge.hpp>
 
 #include <glibmm/object.h>
 #include <glibmm/property.h>
 
 #include <giomm/liststore.h>
 
+#include <array>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
 namespace ghaf::AudioControl
 {
 
 class DeviceListModel final : public Glib::Object
 {
+public:
+    using OnDeviceActivitySignal = sigc::signal<void(Index)>;
+    using OnDeviceRemovedSignal = sigc::signal<void(Index)>;
+
 private:
-    explicit DeviceListModel(std::string name, std::string namePrefix = "");
+    DeviceListModel(std::string name, std::string namePrefix, std::weak_ptr<IAudioControlBackend> backend);
 
 public:
-    static Glib::RefPtr<DeviceListModel> create(std::string name, std::string namePrefix = "");
+    ~DeviceListModel() override;
+
+    // The backend is needed for the group controls only
+    static Glib::RefPtr<DeviceListModel> create(std::string name, std::string namePrefix = "", std::weak_ptr<IAudioControlBackend> backend = {});
 
     static int compare(const Glib::RefPtr<const DeviceListModel>& a, const Glib::RefPtr<const DeviceListModel>& b);
 
-    void addDevice(IAudioControlBackend::ISink::Ptr device);
+    // Appends the devices with a single change of the list, so its view is laid out once
+    void addDevices(std::vector<IAudioControlBackend::IDevice::Ptr> devices);
 
     [[nodiscard]] Glib::RefPtr<Gio::ListStore<DeviceModel>> getDeviceModels() noexcept
     {
@@ -43,12 +58,90 @@ public:
         return m_namePrefix;
     }
 
+    // The group controls. The volume is the one of the loudest device, and the group is muted when all its devices are
+    [[nodiscard]] Glib::PropertyProxy_ReadOnly<double> getVolumeProperty() const
+    {
+        return m_volume.get_proxy();
+    }
+
+    [[nodiscard]] Glib::PropertyProxy_ReadOnly<bool> getIsMutedProperty() const
+    {
+        return m_isMuted.get_proxy();
+    }
+
+    // Sent to all the devices of the group in one batch. Reports a result per device
+    void setVolume(Volume volume, IAudioControlBackend::ResultsCallback onDone = {});
+    void setMuted(bool mute, IAudioControlBackend::ResultsCallback onDone = {});
+
+    // All the devices to the sink or the source, in one batch
+    void moveTo(Index targetIndex, IAudioControlBackend::ResultsCallback onDone = {});
+
+    // The levels of the other devices are ignored
+    void updatePeaks(const std::vector<IAudioControlBackend::PeakLevel>& levels);
+
+    // Emitted when a device comes, when its volume or mute changes, hidden or not, and while it plays with its row shown
+    [[nodiscard]] OnDeviceActivitySignal& onDeviceActivity() noexcept
+    {
+        return m_onDeviceActivity;
+    }
+
+    [[nodiscard]] OnDeviceRemovedSignal& onDeviceRemoved() noexcept
+    {
+        return m_onDeviceRemoved;
+    }
+
+    // Only the row goes, with its model and widget: the device stays in the group controls. Its model is made anew when it's shown
+    void hideDevice(Index index);
+    void showDevice(Index index);
+
+private:
+    struct DeviceEntry;
+
+    [[nodiscard]] Glib::RefPtr<DeviceModel> createEntry(IAudioControlBackend::IDevice::Ptr device);
+    void onDeviceUpdate(Index index, ChangeMask changes);
+
+    // Kept incrementally as the devices come, change and go
+    void addToGroup(const DeviceEntry& entry);
+    void removeFromGroup(const DeviceEntry& entry);
+    void updateGroupProperties();
+
+    void updateMemory() noexcept;
+
+    void setGroupState(std::optional<bool> mute, std::optional<Volume> volume, IAudioControlBackend::ResultsCallback onDone);
+    [[nodiscard]] std::vector<IAudioControlBackend::IDevice::Ptr> getDevices() const;
+
 private:
     Glib::Property<Glib::ustring> m_name;
     std::string m_namePrefix;
 
+    std::weak_ptr<IAudioControlBackend> m_backend;
+
+    struct DeviceEntry
+    {
+        IAudioControlBackend::IDevice::Ptr device;
+        Glib::RefPtr<DeviceModel> model; // Null while the device is hidden
+        sigc::connection onDelete;
+        sigc::connection onUpdate;
+
+        // As accounted in the group
+        Volume::InternalT volume = 0;
+        bool isMuted = false;
+    };
+
     Glib::RefPtr<Gio::ListStore<DeviceModel>> m_devices;
-    std::map<IAudioControlBackend::IDevice::IntexT, sigc::connection> m_deviceConnections;
+    std::unordered_map<IAudioControlBackend::IDevice::IntexT, DeviceEntry> m_deviceEntries; // m_devices and the hidden ones
+
+    // The number of the devices per volume, so the loudest one is known after it goes too
+    std::array<size_t, Volume::Max + 1> m_volumeCounts{};
+    size_t m_mutedCount = 0;
+
+    Glib::Property<double> m_volume{*this, "volume", 0.0};
+    Glib::Property<bool> m_isMuted{*this, "isMuted", false};
+
+    OnDeviceActivitySignal m_onDeviceActivity;
+    OnDeviceRemovedSignal m_onDeviceRemoved;
+
+    MemoryCharge m_memory{MemorySubsystem::Models};
 };
 
 } // namespace ghaf::AudioControl
@@ -7,6 +7,7 @@
 
 #include <GhafAudioControl/IAudioControlBackend.hpp>
 #include <GhafAudioControl/utils/ConnectionContainer.hpp>
+#include <GhafAudioControl/utils/MemoryCharge.hpp>
 
 #include <glibmm/binding.h>
 #include <glibmm/object.h>
@@ -22,6 +23,7 @@ public:
 
 public:
     explicit DeviceModel(IAudioControlBackend::IDevice::Ptr device);
+    ~DeviceModel() override;
 
     static Glib::RefPtr<DeviceModel> create(IAudioControlBackend::IDevice::Ptr device);
 
@@ -69,13 +71,40 @@ public:
         return m_soundVolume.get_proxy();
     }
 
+    [[nodiscard]] Glib::PropertyProxy_ReadOnly<double> getPeakProperty() const
+    {
+        return m_peak.get_proxy();
+    }
+
+    // False till the first level comes, so there is no meter if the backend doesn't measure the device
+    [[nodiscard]] Glib::PropertyProxy_ReadOnly<bool> getHasPeakProperty() const
+    {
+        return m_hasPeak.get_proxy();
+    }
+
+    void setPeak(float peak);
+
 private:
+    // Backend updates are applied once per main loop iteration, before GTK redraws
+    void scheduleUpdate(ChangeMask changes);
+
     void onDefaultChange();
     void onSoundEnabledChange();
     void onSoundVolumeChange();
 
+    // At most one volume write is in flight. Values coming meanwhile replace each other, only the latest is sent once it is done
+    void writeVolume(Volume volume);
+    void onVolumeWriteDone(uint64_t writeId, IAudioControlBackend::Result result);
+
 private:
     IAudioControlBackend::IDevice::Ptr m_device;
+    IAudioControlBackend::IDevice::StatePtr m_appliedState;
+    sigc::connection m_pendingUpdate;
+
+    bool m_isVolumeWriteInFlight = false;
+    uint64_t m_lastVolumeWriteId = 0;
+    std::optional<Volume> m_pendingVolume;
+    sigc::connection m_volumeWriteTimeout;
 
     Glib::Property<bool> m_isEnabled;
     Glib::Property<bool> m_isDefault{*this, "m_isDefault", false};
@@ -87,6 +116,11 @@ private:
     Glib::Property<bool> m_isSoundEnabled{*this, "m_isSoundEnabled", false};
     Glib::Property<double> m_soundVolume{*this, "m_soundVolume", 0};
 
+    Glib::Property<double> m_peak{*this, "m_peak", 0};
+    Glib::Property<bool> m_hasPeak{*this, "m_hasPeak", false};
+
     ConnectionContainer m_connections;
+
+    MemoryCharge m_memory{MemorySubsystem::Models};
 };
 } // namespace ghaf::AudioControl
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/utils/ScopeExit.hpp>
+
+#include <sigc++/connection.h>
+#include <sigc++/slot.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ghaf::AudioControl
+{
+
+template<class T_Signature>
+class FlatSignal;
+
+// A signal for the frequent notifications with several subscribers. The masks are kept inline in a vector, so an emission picks
+// the subscribers without touching the slots, and calls only the ones whose mask has all the bits of the emitted key.
+// The arguments are passed through as they are: with a signature of const references nothing is copied per slot.
+// The connections are plain sigc::connection, so they are blocked, disconnected and tracked the same way as the sigc::signal ones
+template<class... Args>
+class FlatSignal<void(Args...)> final
+{
+public:
+    using Mask = uint32_t;
+    using SlotType = sigc::slot<void(Args...)>;
+
+    static constexpr Mask AllMask = ~Mask{0};
+
+    FlatSignal() = default;
+
+    // The connections point at the slots it owns
+    FlatSignal(const FlatSignal&) = delete;
+    FlatSignal& operator=(const FlatSignal&) = delete;
+
+    sigc::connection connect(SlotType slot, Mask mask = AllMask)
+    {
+        // The slots disconnected since are dropped here, not during an emission
+        if (m_emissions == 0)
+            std::erase_if(m_entries, [](const Entry& entry) { return entry.slot->empty(); });
+
+        const Entry& entry = m_entries.emplace_back(mask, std::make_unique<SlotType>(std::move(slot)));
+        return sigc::connection{*entry.slot};
+    }
+
+    // Whether an emission with the key calls anyone, so an emitter can skip building the arguments
+    [[nodiscard]] bool hasSubscribers(Mask key) const noexcept
+    {
+        return std::ranges::any_of(m_entries, [key](const Entry& entry) { return entry.matches(key) && !entry.slot->empty(); });
+    }
+
+    // A slot connected during the emission is called from the next one on
+    void emit(Mask key, Args... args)
+    {
+        ++m_emissions;
+        const ScopeExit emitted{[this] { --m_emissions; }};
+
+        const size_t size = m_entries.size();
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (!m_entries[i].matches(key))
+                continue;
+
+            // The entry may move if a slot connects another one, the slot itself stays
+            SlotType& slot = *m_entries[i].slot;
+
+            if (!slot.empty() && !slot.blocked())
+                slot(args...);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        Mask mask;
+        std::unique_ptr<SlotType> slot;
+
+        Entry(Mask mask, std::unique_ptr<SlotType> slot)
+            : mask(mask)
+            , slot(std::move(slot))
+        {
+        }
+
+        [[nodiscard]] bool matches(Mask key) const noexcept
+        {
+            return (mask & key) == key;
+        }
+    };
+
+private:
+    std::vector<Entry> m_entries;
+    unsigned m_emissions = 0;
+};
+
+} // namespace ghaf::AudioControl
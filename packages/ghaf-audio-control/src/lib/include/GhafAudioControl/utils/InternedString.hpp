@@ -0,0 +1,109 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace ghaf::AudioControl
+{
+
+// Handle to a string kept once in a process wide table. Equal strings get the same entry, so the comparison is a pointer
+// comparison, and a copy only counts a reference. Looking up a string that is already in the table doesn't allocate.
+// The entry is dropped with its last handle. Thread safe
+class InternedString final
+{
+public:
+    InternedString() noexcept = default;
+    explicit InternedString(std::string_view value);
+    explicit InternedString(const char* value);
+    explicit InternedString(const std::string& value);
+
+    InternedString(const InternedString& other) noexcept
+        : m_entry(other.m_entry)
+    {
+        addReference();
+    }
+
+    InternedString(InternedString&& other) noexcept
+        : m_entry(std::exchange(other.m_entry, nullptr))
+    {
+    }
+
+    ~InternedString()
+    {
+        release();
+    }
+
+    InternedString& operator=(const InternedString& other) noexcept
+    {
+        if (m_entry != other.m_entry)
+        {
+            release();
+            m_entry = other.m_entry;
+            addReference();
+        }
+
+        return *this;
+    }
+
+    InternedString& operator=(InternedString&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_entry = std::exchange(other.m_entry, nullptr);
+        }
+
+        return *this;
+    }
+
+    bool operator==(const InternedString& other) const noexcept
+    {
+        return m_entry == other.m_entry;
+    }
+
+    bool operator==(std::string_view other) const noexcept
+    {
+        return str() == other;
+    }
+
+    [[nodiscard]] const std::string& str() const noexcept;
+
+    operator const std::string&() const noexcept
+    {
+        return str();
+    }
+
+    [[nodiscard]] const char* c_str() const noexcept
+    {
+        return str().c_str();
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_entry == nullptr;
+    }
+
+    // The number of the distinct strings in the table
+    [[nodiscard]] static size_t GetTableSize();
+
+private:
+    // Defined in the source file, along with the table
+    friend struct InternedStringTable;
+    struct Entry;
+
+    void addReference() const noexcept;
+    void release() noexcept;
+
+private:
+    // Null for the empty string, so it needs no entry
+    Entry* m_entry = nullptr;
+};
+
+} // namespace ghaf::AudioControl
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace ghaf::AudioControl
+{
+
+// Log-scale histogram: bucket N counts the latencies below FirstBucketBound * 2^N, the last one counts everything above.
+// The fields are relaxed atomics, so it may be recorded on one thread and read on another, each value being exact on its own
+class LatencyHistogram final
+{
+public:
+    static constexpr size_t BucketCount = 16;
+    static constexpr std::chrono::microseconds FirstBucketBound{100};
+
+    void record(std::chrono::microseconds latency) noexcept;
+
+    [[nodiscard]] uint64_t getCount() const noexcept
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::chrono::microseconds getSum() const noexcept
+    {
+        return std::chrono::microseconds{m_sum.load(std::memory_order_relaxed)};
+    }
+
+    [[nodiscard]] std::chrono::microseconds getMax() const noexcept
+    {
+        return std::chrono::microseconds{m_max.load(std::memory_order_relaxed)};
+    }
+
+    [[nodiscard]] uint64_t getBucket(size_t bucket) const noexcept
+    {
+        return m_buckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    // Upper bound of the latency the given share of the samples fits below, e.g. 0.99 for p99. Zero when empty
+    [[nodiscard]] std::chrono::microseconds getPercentile(double share) const noexcept;
+
+    [[nodiscard]] static std::chrono::microseconds GetBucketBound(size_t bucket) noexcept;
+
+    [[nodiscard]] std::string toString() const;
+
+private:
+    std::array<std::atomic<uint64_t>, BucketCount> m_buckets{};
+    std::atomic<uint64_t> m_count = 0;
+    std::atomic<int64_t> m_sum = 0; // In microseconds
+    std::atomic<int64_t> m_max = 0;
+};
+
+} // namespace ghaf::AudioControl
@@ -5,46 +5,131 @@
 
 #pragma once
 
+#include <atomic>
+#include <concepts>
 #include <format>
+#include <optional>
 #include <string_view>
+#include <tuple>
+
+// The lowest level compiled in: 0 is debug, 1 is info, 2 is error. The calls below it are removed by the compiler
+#if !defined(GHAF_AUDIO_CONTROL_MIN_LOG_LEVEL)
+    #define GHAF_AUDIO_CONTROL_MIN_LOG_LEVEL 0
+#endif
 
 namespace ghaf::AudioControl
 {
 
 class Logger
 {
-private:
+public:
+    // Ordered by severity
     enum class LogLevel
     {
         DEBUG,
-        ERROR,
-        INFO
+        INFO,
+        ERROR
     };
 
-public:
+    enum class Output
+    {
+        Stderr,
+        Journald // Through a bounded buffer and a writer thread, so logging never waits for the journal
+    };
+
+    static constexpr LogLevel MinCompiledLevel = static_cast<LogLevel>(GHAF_AUDIO_CONTROL_MIN_LOG_LEVEL);
+
+    // An argument computed only if the message is going to be written
+    template<std::invocable Fx>
+    struct Lazy
+    {
+        Fx fx;
+    };
+
+    template<std::invocable Fx>
+    [[nodiscard]] static Lazy<Fx> lazy(Fx fx)
+    {
+        return {std::move(fx)};
+    }
+
     template<class... ArgsT>
-    static void debug(std::string_view message, ArgsT... args)
+    static void debug(std::string_view message, const ArgsT&... args)
     {
-        log(std::vformat(message, std::make_format_args(args...)), LogLevel::DEBUG);
+        write<LogLevel::DEBUG>(message, args...);
     }
 
     template<class... ArgsT>
-    static void error(std::string_view message, ArgsT... args)
+    static void error(std::string_view message, const ArgsT&... args)
     {
-        log(std::vformat(message, std::make_format_args(args...)), LogLevel::ERROR);
+        write<LogLevel::ERROR>(message, args...);
     }
 
     template<class... ArgsT>
-    static void info(std::string_view message, ArgsT... args)
+    static void info(std::string_view message, const ArgsT&... args)
+    {
+        write<LogLevel::INFO>(message, args...);
+    }
+
+    [[nodiscard]] static bool isEnabled(LogLevel logLevel) noexcept
+    {
+        return logLevel >= MinCompiledLevel && logLevel >= m_level.load(std::memory_order_relaxed);
+    }
+
+    static void setLevel(LogLevel logLevel) noexcept
     {
-        log(std::vformat(message, std::make_format_args(args...)), LogLevel::INFO);
+        m_level.store(logLevel, std::memory_order_relaxed);
     }
 
+    static void setOutput(Output output);
+
+    [[nodiscard]] static std::optional<LogLevel> logLevelFromString(std::string_view value);
+    [[nodiscard]] static std::optional<Output> outputFromString(std::string_view value);
+
 private:
+    template<class T>
+    struct IsLazy : std::false_type
+    {
+    };
+
+    template<class Fx>
+    struct IsLazy<Lazy<Fx>> : std::true_type
+    {
+    };
+
+    template<class T>
+    static decltype(auto) evaluate(const T& arg)
+    {
+        if constexpr (IsLazy<T>::value)
+            return arg.fx();
+        else
+            return (arg);
+    }
+
+    template<LogLevel Level, class... ArgsT>
+    static void write(std::string_view message, const ArgsT&... args)
+    {
+        if constexpr (Level >= MinCompiledLevel)
+        {
+            if (!isEnabled(Level))
+                return;
+
+            auto values = std::tuple{evaluate(args)...};
+            const auto format = [message](auto&... evaluated)
+            {
+                return std::vformat(message, std::make_format_args(evaluated...));
+            };
+
+            log(std::apply(format, values), Level);
+        }
+    }
+
     static std::string logLevelToString(LogLevel logLevel);
     static void log(std::string_view message, LogLevel logLevel);
 
     Logger();
+
+private:
+    static inline std::atomic<LogLevel> m_level = LogLevel::INFO;
 };
 
 } // namespace ghaf::AudioControl
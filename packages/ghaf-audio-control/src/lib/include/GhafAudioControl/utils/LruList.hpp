@@ -0,0 +1,71 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <optional>
+
+namespace ghaf::AudioControl
+{
+
+// Keys in the order of their last use, the most recent one last. A use and a removal are O(log n), whatever the position of the key
+template<class Key>
+class LruList final
+{
+public:
+    // Returns whether the key is new
+    bool touch(const Key& key)
+    {
+        if (const auto iter = m_positions.find(key); iter != m_positions.end())
+        {
+            m_keys.splice(m_keys.end(), m_keys, iter->second);
+            return false;
+        }
+
+        m_positions.emplace(key, m_keys.insert(m_keys.end(), key));
+        return true;
+    }
+
+    void erase(const Key& key)
+    {
+        if (const auto iter = m_positions.find(key); iter != m_positions.end())
+        {
+            m_keys.erase(iter->second);
+            m_positions.erase(iter);
+        }
+    }
+
+    [[nodiscard]] std::optional<Key> popOldest()
+    {
+        if (m_keys.empty())
+            return std::nullopt;
+
+        Key key = std::move(m_keys.front());
+        m_keys.pop_front();
+        m_positions.erase(key);
+
+        return key;
+    }
+
+    void clear() noexcept
+    {
+        m_keys.clear();
+        m_positions.clear();
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return m_keys.size();
+    }
+
+private:
+    std::list<Key> m_keys;
+    std::map<Key, typename std::list<Key>::iterator> m_positions;
+};
+
+} // namespace ghaf::AudioControl
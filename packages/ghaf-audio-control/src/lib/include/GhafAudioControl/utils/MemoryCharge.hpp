@@ -0,0 +1,57 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Glib
+{
+class ObjectBase;
+}
+
+namespace ghaf::AudioControl
+{
+
+// The parts of the service whose memory grows with the number of the devices
+enum class MemorySubsystem
+{
+    BackendDevices, // The devices of the backend with their state snapshots
+    Models,         // The GObject models the widgets are bound to
+    Widgets,        // The rows of the devices
+    DBusBuffers,    // The pending updates, the journal and the queued calls of the D-Bus service
+    PoolFreeBlocks, // Freed by the objects of the other subsystems, and kept by the pools for the next ones
+};
+
+// Memory held by a subsystem, published as the memory_bytes and memory_objects gauges with the subsystem label. The sizes are
+// estimates: the objects and their GObject instances, not the heap blocks of the slots and the interned strings they share
+class MemoryCharge final
+{
+public:
+    explicit MemoryCharge(MemorySubsystem subsystem, size_t bytes = 0, size_t objects = 1) noexcept;
+    ~MemoryCharge();
+
+    // A copy would be charged twice
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+    void resize(size_t bytes, size_t objects = 1) noexcept;
+
+    [[nodiscard]] size_t getBytes() const noexcept
+    {
+        return m_bytes;
+    }
+
+private:
+    MemorySubsystem m_subsystem;
+    size_t m_bytes;
+    size_t m_objects;
+};
+
+// The size of the GObject instance behind a wrapper, which is allocated apart from it
+[[nodiscard]] size_t GetInstanceSize(const Glib::ObjectBase& object) noexcept;
+
+} // namespace ghaf::AudioControl
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/utils/LatencyHistogram.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace ghaf::AudioControl
+{
+
+// Process wide registry of named counters, gauges and latency histograms. The names follow Prometheus: a metric name with optional labels,
+// e.g. dbus_signals_emitted_total{signal="DeviceUpdated"}. The returned references stay valid till the exit, so callers may keep them
+class Metrics final
+{
+public:
+    class Counter final
+    {
+    public:
+        void increment(uint64_t value = 1) noexcept
+        {
+            m_value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] uint64_t get() const noexcept
+        {
+            return m_value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> m_value = 0;
+    };
+
+    // A value that goes both ways, e.g. the bytes held by a subsystem
+    class Gauge final
+    {
+    public:
+        void add(int64_t value) noexcept
+        {
+            m_value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        void set(int64_t value) noexcept
+        {
+            m_value.store(value, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] int64_t get() const noexcept
+        {
+            return m_value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<int64_t> m_value = 0;
+    };
+
+    [[nodiscard]] static Counter& GetCounter(std::string_view name);
+    [[nodiscard]] static Gauge& GetGauge(std::string_view name);
+
+    // Like the counters and the gauges, a histogram may be recorded on the backend thread while it is read on the main loop
+    [[nodiscard]] static LatencyHistogram& GetHistogram(std::string_view name);
+
+    [[nodiscard]] static std::map<std::string, uint64_t> GetCounterValues();
+    [[nodiscard]] static std::map<std::string, int64_t> GetGaugeValues();
+
+    // Prometheus text exposition format. The histogram values are in microseconds
+    [[nodiscard]] static std::string ToPrometheusText();
+
+private:
+    Metrics();
+};
+
+} // namespace ghaf::AudioControl
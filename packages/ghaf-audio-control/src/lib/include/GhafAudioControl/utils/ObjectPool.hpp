@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/utils/MemoryCharge.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+namespace ghaf::AudioControl
+{
+
+// Free list of blocks of one size. The freed blocks are kept for the next allocation and never given back, so a steady churn
+// of objects doesn't reach the heap. Synchronized: an object may be released on another thread than the one created it.
+// The free blocks are charged to a subsystem of their own, the one of the freed object no longer has them
+class BlockPool final
+{
+public:
+    BlockPool(size_t blockSize, size_t alignment) noexcept;
+    ~BlockPool();
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    [[nodiscard]] void* allocate();
+    void deallocate(void* block) noexcept;
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    const size_t m_blockSize;
+    const size_t m_alignment;
+
+    std::mutex m_mutex;
+    FreeBlock* m_freeBlocks = nullptr;
+    size_t m_freeBlockCount = 0;
+    MemoryCharge m_freeMemory{MemorySubsystem::PoolFreeBlocks, 0, 0};
+};
+
+// Takes single objects from a pool per type, larger requests from the heap. Stateless, so all the instances are interchangeable
+template<class T>
+class PoolAllocator final
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+
+    template<class U>
+    PoolAllocator([[maybe_unused]] const PoolAllocator<U>& other) noexcept
+    {
+    }
+
+    [[nodiscard]] T* allocate(size_t count)
+    {
+        if (count != 1)
+            return std::allocator<T>{}.allocate(count);
+
+        return static_cast<T*>(GetPool().allocate());
+    }
+
+    void deallocate(T* object, size_t count) noexcept
+    {
+        if (count != 1)
+            std::allocator<T>{}.deallocate(object, count);
+        else
+            GetPool().deallocate(object);
+    }
+
+    template<class U>
+    bool operator==([[maybe_unused]] const PoolAllocator<U>& other) const noexcept
+    {
+        return true;
+    }
+
+private:
+    // Never destroyed: the objects may outlive the static destruction
+    [[nodiscard]] static BlockPool& GetPool()
+    {
+        static auto* pool = new BlockPool(sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T), alignof(T) < alignof(void*) ? alignof(void*) : alignof(T));
+        return *pool;
+    }
+};
+
+// std::make_shared with the object and its control block in one pooled block
+template<class T, class... Args>
+[[nodiscard]] std::shared_ptr<T> MakePooled(Args&&... args)
+{
+    return std::allocate_shared<T>(PoolAllocator<T>{}, std::forward<Args>(args)...);
+}
+
+} // namespace ghaf::AudioControl
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace ghaf::AudioControl
+{
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. The capacity is rounded up to a power of two
+template<class T>
+class SpscQueue final
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : m_slots(std::bit_ceil(capacity))
+        , m_mask(m_slots.size() - 1)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only. Moves the value in, unless the queue is full
+    [[nodiscard]] bool tryPush(T& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+            return false;
+
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer only
+    [[nodiscard]] std::optional<T> tryPop()
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_tail.load(std::memory_order_acquire))
+            return std::nullopt;
+
+        // The slot is reset, so what the value holds is released by the consumer and not when the slot is reused
+        std::optional<T> value{std::move(m_slots[head & m_mask])};
+        m_slots[head & m_mask] = T{};
+
+        m_head.store(head + 1, std::memory_order_release);
+
+        return value;
+    }
+
+    // Exact for the consumer. The producer may see a queue that is being emptied as not empty yet
+    [[nodiscard]] bool isEmpty() const noexcept
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t CacheLineSize = 64;
+
+    std::vector<T> m_slots;
+    const size_t m_mask;
+
+    // Each index is written by one side only. Apart, so the sides don't invalidate each other's cache line
+    alignas(CacheLineSize) std::atomic<size_t> m_head = 0;
+    alignas(CacheLineSize) std::atomic<size_t> m_tail = 0;
+};
+
+} // namespace ghaf::AudioControl
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <utility>
+
+namespace ghaf::AudioControl
+{
+
+// Calls the function on a handle. For the C libraries, whose release functions take the handle only
+template<auto Function>
+struct FunctionDeleter final
+{
+    template<class T>
+    void operator()(T* handle) const noexcept
+    {
+        Function(handle);
+    }
+};
+
+// An owned handle of a C library. The deleter is a stateless type, so the handle is a plain pointer: no allocation and
+// no type erased call, unlike a std::function destructor
+template<class T, class Deleter>
+class UniqueHandle final
+{
+public:
+    UniqueHandle() noexcept = default;
+
+    explicit UniqueHandle(T* handle) noexcept
+        : m_handle(handle)
+    {
+    }
+
+    ~UniqueHandle()
+    {
+        reset();
+    }
+
+    UniqueHandle(const UniqueHandle&) = delete;
+    UniqueHandle& operator=(const UniqueHandle&) = delete;
+
+    UniqueHandle(UniqueHandle&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr))
+    {
+    }
+
+    UniqueHandle& operator=(UniqueHandle&& other) noexcept
+    {
+        if (this != &other)
+            reset(other.release());
+
+        return *this;
+    }
+
+    void reset(T* handle = nullptr) noexcept
+    {
+        if (T* previous = std::exchange(m_handle, handle))
+            Deleter{}(previous);
+    }
+
+    [[nodiscard]] T* release() noexcept
+    {
+        return std::exchange(m_handle, nullptr);
+    }
+
+    [[nodiscard]] T* get() const noexcept
+    {
+        return m_handle;
+    }
+
+    T& operator*() const noexcept
+    {
+        return *m_handle;
+    }
+
+    T* operator->() const noexcept
+    {
+        return m_handle;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_handle != nullptr;
+    }
+
+private:
+    T* m_handle = nullptr;
+};
+
+// A handle of a reference counted object. The traits give the static ref() and unref() functions. A handle made of a pointer
+// takes over the reference the pointer came with, as returned by the C functions
+template<class T, class Traits>
+class RefHandle final
+{
+public:
+    RefHandle() noexcept = default;
+
+    explicit RefHandle(T* handle) noexcept
+        : m_handle(handle)
+    {
+    }
+
+    ~RefHandle()
+    {
+        reset();
+    }
+
+    RefHandle(const RefHandle& other) noexcept
+        : m_handle(other.m_handle)
+    {
+        if (m_handle != nullptr)
+            Traits::ref(m_handle);
+    }
+
+    RefHandle& operator=(const RefHandle& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (other.m_handle != nullptr)
+                Traits::ref(other.m_handle);
+
+            reset(other.m_handle);
+        }
+
+        return *this;
+    }
+
+    RefHandle(RefHandle&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr))
+    {
+    }
+
+    RefHandle& operator=(RefHandle&& other) noexcept
+    {
+        if (this != &other)
+            reset(std::exchange(other.m_handle, nullptr));
+
+        return *this;
+    }
+
+    // Takes over the reference of the handle
+    void reset(T* handle = nullptr) noexcept
+    {
+        if (T* previous = std::exchange(m_handle, handle))
+            Traits::unref(previous);
+    }
+
+    [[nodiscard]] T* get() const noexcept
+    {
+        return m_handle;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_handle != nullptr;
+    }
+
+private:
+    T* m_handle = nullptr;
+};
+
+} // namespace ghaf::AudioControl
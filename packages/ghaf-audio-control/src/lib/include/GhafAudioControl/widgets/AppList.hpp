@@ -6,6 +6,8 @@
 #pragma once
 
 #include <GhafAudioControl/models/DeviceListModel.hpp>
+#include <GhafAudioControl/utils/ConnectionContainer.hpp>
+#include <GhafAudioControl/utils/LruList.hpp>
 
 #include <gtkmm/box.h>
 #include <gtkmm/cssprovider.h>
@@ -15,22 +17,50 @@
 
 #include <glibmm/binding.h>
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <unordered_map>
+
 namespace ghaf::AudioControl
 {
 
 class AppList final : public Gtk::Box
 {
 public:
-    AppList();
+    // The backend takes the group controls of the AppVMs. The prefix is shown before the name of every group
+    explicit AppList(std::weak_ptr<IAudioControlBackend> backend, std::string namePrefix = "AppVM");
 
     void addVm(std::string appVmName);
-    void addDevice(IAudioControlBackend::ISinkInput::Ptr device);
+    // Groups the streams by AppVM, so every group and the list of the AppVMs change once
+    void addDevices(std::vector<IAudioControlBackend::IDevice::Ptr> devices);
 
     void removeAllApps();
 
+    void updatePeaks(const std::vector<IAudioControlBackend::PeakLevel>& levels);
+
+    // At most this many stream rows of all the AppVMs, 0 for no limit. The rows of the streams inactive for the longest go first,
+    // and come back once the streams change: playing only keeps a shown row. The streams stay in the group controls meanwhile
+    void setMaxStreamRows(size_t count);
+
+private:
+    using StreamRow = std::pair<DeviceListModel*, Index>;
+
+    void watchApp(const Glib::RefPtr<DeviceListModel>& appModel);
+    void onStreamActivity(DeviceListModel& appModel, Index index);
+    void evictStreamRows();
+
 private:
+    std::weak_ptr<IAudioControlBackend> m_backend;
+    std::string m_namePrefix;
+
     Gtk::ListBox m_listBox;
     Glib::RefPtr<Gio::ListStore<DeviceListModel>> m_appsModel;
+    std::unordered_map<std::string, Glib::RefPtr<DeviceListModel>> m_appModelsByName; // Mirrors m_appsModel
+
+    size_t m_maxStreamRows = 0;
+    LruList<StreamRow> m_shownStreamRows;
+    ConnectionContainer m_appConnections; // Of the apps in m_appModelsByName, a widget may keep a model a while after
 };
 
 } // namespace ghaf::AudioControl
@@ -9,6 +9,7 @@
 #include <GhafAudioControl/widgets/AppList.hpp>
 #include <GhafAudioControl/widgets/DeviceListWidget.hpp>
 
+#include <gtkmm/label.h>
 #include <gtkmm/menubutton.h>
 #include <gtkmm/popover.h>
 #include <gtkmm/separator.h>
@@ -19,11 +20,13 @@
 namespace ghaf::AudioControl
 {
 
+// The backend is owned and started by the caller, AudioControl only subscribes to its changes. The rows of the AppVM streams and of
+// their microphones are capped at maxStreamRows each, see AppList::setMaxStreamRows()
 class AudioControl final : public Gtk::Box
 {
 public:
-    AudioControl(std::shared_ptr<IAudioControlBackend> backend, const std::vector<std::string>& appVmsList);
-    ~AudioControl() override = default;
+    AudioControl(std::shared_ptr<IAudioControlBackend> backend, const std::vector<std::string>& appVmsList, size_t maxStreamRows = 0);
+    ~AudioControl() override;
 
     AudioControl(AudioControl&) = delete;
     AudioControl(AudioControl&&) = delete;
@@ -33,18 +36,27 @@ public:
 
 private:
     void init();
+    void hydrate();
 
-    void onPulseSinksChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info);
-    void onPulseSourcesChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info);
-    void onPulseSinkInputsChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info);
-    void onPulseSourcesOutputsChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info);
+    void onPulseSinksChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info);
+    void onPulseSourcesChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info);
+    void onPulseSinkInputsChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info);
+    void onPulseSourcesOutputsChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info);
 
+    // The devices come in bursts, the initial listing above all, and are added to the models a burst at a time
+    void scheduleDevicesFlush();
+    void flushPendingDevices();
+
+    void onPulseStateChange(IAudioControlBackend::State state);
     void onPulseError(std::string_view error);
+    void onPulsePeaks(const std::vector<IAudioControlBackend::PeakLevel>& levels);
 
 private:
     std::shared_ptr<IAudioControlBackend> m_audioControl;
 
+    Gtk::Label m_reconnectingLabel;
     AppList m_appList;
+    AppList m_appMicrophones; // The recording streams of the AppVMs, so it's seen which of them use a microphone
 
     Glib::RefPtr<DeviceListModel> m_sinksModel;
     DeviceListWidget m_sinks;
@@ -52,6 +64,12 @@ private:
     Glib::RefPtr<DeviceListModel> m_sourcesModel;
     DeviceListWidget m_sources;
 
+    std::vector<IAudioControlBackend::IDevice::Ptr> m_pendingSinks;
+    std::vector<IAudioControlBackend::IDevice::Ptr> m_pendingSources;
+    std::vector<IAudioControlBackend::IDevice::Ptr> m_pendingSinkInputs;
+    std::vector<IAudioControlBackend::IDevice::Ptr> m_pendingSourceOutputs;
+    sigc::connection m_pendingDevicesFlush;
+
     ConnectionContainer m_connections;
 };
 
@@ -6,12 +6,12 @@
 #pragma once
 
 #include <GhafAudioControl/models/DeviceListModel.hpp>
+#include <GhafAudioControl/widgets/DeviceRowList.hpp>
 
 #include <gtkmm/box.h>
 #include <gtkmm/button.h>
 #include <gtkmm/cssprovider.h>
 #include <gtkmm/label.h>
-#include <gtkmm/listbox.h>
 #include <gtkmm/revealer.h>
 #include <gtkmm/separator.h>
 #include <gtkmm/stack.h>
@@ -24,12 +24,15 @@ namespace ghaf::AudioControl
 class DeviceListWidget : public Gtk::Box
 {
 public:
-    explicit DeviceListWidget(Glib::RefPtr<DeviceListModel> devicesModel);
+    // Rows of a collapsed widget are not created until it's revealed for the first time
+    explicit DeviceListWidget(Glib::RefPtr<DeviceListModel> devicesModel, bool isRevealed = true);
 
     void reveal(bool reveal = true);
 
 private:
     void onDeviceChange(guint position, guint removed, guint added);
+    void updateEmptyListLabel();
+    void bindModel();
 
     std::string getName() const;
 
@@ -37,12 +40,14 @@ private:
     Glib::RefPtr<DeviceListModel> m_model;
 
     Gtk::Box m_revealerBox;
-    Gtk::ListBox m_listBox;
+    DeviceRowList m_rows;
 
     Gtk::Label m_emptyListLabel;
     Gtk::Button m_appNameButton;
     Gtk::Revealer m_revealer;
 
+    bool m_isModelBound = false;
+
     ConnectionContainer m_connections;
 };
 
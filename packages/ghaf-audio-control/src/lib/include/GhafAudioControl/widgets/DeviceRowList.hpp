@@ -0,0 +1,58 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <GhafAudioControl/models/DeviceModel.hpp>
+#include <GhafAudioControl/utils/ConnectionContainer.hpp>
+#include <GhafAudioControl/widgets/DeviceWidget.hpp>
+
+#include <gtkmm/layout.h>
+#include <gtkmm/scrolledwindow.h>
+
+#include <giomm/liststore.h>
+
+#include <vector>
+
+namespace ghaf::AudioControl
+{
+
+// The rows of a list of devices, made only for the devices in the viewport. The rows are of the same height and are kept in a pool:
+// a scroll binds the rows that go out of the view to the devices that come in, so the number of the widgets doesn't grow with
+// the number of the devices. The list is as high as its rows, up to MaxVisibleRows, and scrolls beyond
+class DeviceRowList final : public Gtk::ScrolledWindow
+{
+public:
+    static constexpr guint MaxVisibleRows = 8;
+
+    DeviceRowList();
+    ~DeviceRowList() override;
+
+    // A null list unbinds the rows
+    void bindModel(Glib::RefPtr<Gio::ListStore<DeviceModel>> models);
+
+private:
+    // The changes of the list coming in one main loop iteration are laid out at once
+    void scheduleLayout();
+    void layoutRows();
+
+    [[nodiscard]] DeviceWidget& getRow(size_t slot, DeviceModel::Ptr model);
+
+private:
+    Gtk::Layout m_layout;
+    Glib::RefPtr<Gio::ListStore<DeviceModel>> m_models;
+
+    std::vector<DeviceWidget*> m_rows; // Managed by m_layout
+    int m_rowHeight = 0;               // The tallest row so far, 0 till the first one is made
+    int m_rowWidth = 0;
+    bool m_isLayingOut = false;
+
+    sigc::connection m_modelChanges;
+    sigc::connection m_pendingLayout;
+
+    ConnectionContainer m_connections;
+};
+
+} // namespace ghaf::AudioControl
@@ -8,11 +8,13 @@
 #include <GhafAudioControl/IAudioControlBackend.hpp>
 #include <GhafAudioControl/models/DeviceModel.hpp>
 #include <GhafAudioControl/utils/ConnectionContainer.hpp>
+#include <GhafAudioControl/utils/MemoryCharge.hpp>
 #include <GhafAudioControl/utils/ScopeExit.hpp>
 
 #include <gtkmm/box.h>
 #include <gtkmm/checkbutton.h>
 #include <gtkmm/label.h>
+#include <gtkmm/levelbar.h>
 #include <gtkmm/scale.h>
 #include <gtkmm/switch.h>
 
@@ -28,6 +30,12 @@ class DeviceWidget : public Gtk::Box
 public:
     explicit DeviceWidget(DeviceModel::Ptr model);
 
+    // Rebinds the controls, so a row is reused for another device. A null model unbinds them
+    void setModel(DeviceModel::Ptr model);
+
+private:
+    void bindModel();
+
 private:
     DeviceModel::Ptr m_model;
 
@@ -35,8 +43,11 @@ private:
     Gtk::Label* m_nameLabel;
     Gtk::Switch* m_switch;
     Gtk::Scale* m_scale;
+    Gtk::LevelBar* m_peakBar;
 
     std::vector<Glib::RefPtr<Glib::Binding>> m_bindings;
+
+    MemoryCharge m_memory{MemorySubsystem::Widgets};
 };
 
 } // namespace ghaf::AudioControl
@@ -5,6 +5,8 @@
 
 #include <GhafAudioControl/Backends/PulseAudio/AudioControlBackend.hpp>
 
+#include <GhafAudioControl/Backends/PulseAudio/CardIndex.hpp>
+#include <GhafAudioControl/Backends/PulseAudio/GeneralDevice.hpp>
 #include <GhafAudioControl/Backends/PulseAudio/Helpers.hpp>
 #include <GhafAudioControl/Backends/PulseAudio/Sink.hpp>
 #include <GhafAudioControl/Backends/PulseAudio/SinkInput.hpp>
@@ -12,6 +14,8 @@
 #include <GhafAudioControl/Backends/PulseAudio/SourceOutput.hpp>
 
 #include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
+#include <GhafAudioControl/utils/ObjectPool.hpp>
 
 #include <pulse/error.h>
 #include <pulse/glib-mainloop.h>
@@ -20,7 +24,15 @@
 
 #include <glibmm/main.h>
 
+#include <sigc++/connection.h>
+
+#include <algorithm>
+#include <chrono>
 #include <format>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <utility>
 
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
@@ -28,47 +40,78 @@ namespace ghaf::AudioControl::Backend::PulseAudio
 namespace
 {
 
-template<class DeviceT, class InfoT, class IDeviceT>
-void OnPulseDeviceInfo(const InfoT& info, bool isDefault, IAudioControlBackend::SignalMap<IDeviceT>& map, pa_context& context)
+template<class DeviceT>
+void DeletePulseDevice(IAudioControlBackend::SignalMap<DeviceT>& map, Index index);
+
+template<class DeviceT, class InfoT>
+void OnPulseDeviceInfo(const InfoT& info, bool isDefault, bool isResync, std::optional<Volume> rampTarget, IAudioControlBackend::SignalMap<DeviceT>& map,
+                       pa_context& context, uint32_t server)
 {
-    const Index index = info.index;
+    constexpr bool IsDefaultable = std::is_base_of_v<IAudioControlBackend::IDefaultable, DeviceT>;
+    const Index index = MakeDeviceIndex(server, info.index);
 
     if (auto deviceIt = map.findByKey(index))
     {
-        const IDeviceT& device = *deviceIt.value()->second;
+        const DeviceT& device = *deviceIt.value()->second;
 
-        map.update(*deviceIt,
-                   [&info, isDefault](IDeviceT& device)
-                   {
-                       dynamic_cast<DeviceT&>(device).update(info);
+        // A restarted server may give the index of a cached device to another one
+        if (!isResync || device.getName() == info.name)
+        {
+            map.update(*deviceIt,
+                       [&info, isDefault, rampTarget](DeviceT& device)
+                       {
+                           ChangeMask changes = device.update(info);
 
-                       if (auto* defaultable = dynamic_cast<IAudioControlBackend::IDefaultable*>(&device))
-                           defaultable->updateDefault(isDefault);
+                           if (rampTarget && changes.has(DeviceField::Volume) && device.getVolume() != *rampTarget)
+                               changes |= DeviceField::RampStep;
 
-                       return true;
-                   });
+                           if constexpr (IsDefaultable)
+                           {
+                               if (device.isDefault() != isDefault)
+                                   changes |= DeviceField::Default;
 
-        Logger::debug("Updating... {}", device.toString());
+                               device.updateDefault(isDefault);
+                           }
+
+                           return changes;
+                       });
+
+            Logger::debug("Updating... {}", Logger::lazy([&device] { return device.toString(); }));
+            return;
+        }
+
+        DeletePulseDevice(map, index);
     }
+
+    if constexpr (IsDefaultable)
+        map.add(index, MakePooled<DeviceT>(info, isDefault, context, server));
     else
-    {
-        if constexpr (std::is_base_of_v<IAudioControlBackend::IDefaultable, IDeviceT>)
-            map.add(index, std::make_shared<DeviceT>(info, isDefault, context));
-        else
-            map.add(index, std::make_shared<DeviceT>(info, context));
-    }
+        map.add(index, MakePooled<DeviceT>(info, context, server));
 }
 
-template<class DeviceT, class IndexT, class IDeviceT>
-void DeletePulseDevice(IAudioControlBackend::SignalMap<IDeviceT>& map, IndexT index)
+template<class DeviceT, class PredicateT>
+void SetDevicesContext(IAudioControlBackend::SignalMap<DeviceT>& map, pa_context& context, PredicateT&& isOwned)
+{
+    map.forEach(
+        [&context, &isOwned](DeviceT& device)
+        {
+            if (isOwned(device.getIndex()))
+                device.setContext(context);
+
+            return ChangeMask{};
+        });
+}
+
+template<class DeviceT>
+void DeletePulseDevice(IAudioControlBackend::SignalMap<DeviceT>& map, Index index)
 {
     if (auto deviceIt = map.findByKey(index))
     {
         Logger::debug("AudioControlBackend::DeletePulseDevice: delete device with id: {}", index);
         map.remove(*deviceIt,
-                   [](IDeviceT& device)
+                   [](DeviceT& device)
                    {
-                       dynamic_cast<DeviceT&>(device).markDeleted();
+                       device.markDeleted();
                        return true;
                    });
     }
@@ -76,6 +119,58 @@ void DeletePulseDevice(IAudioControlBackend::SignalMap<IDeviceT>& map, IndexT in
         Logger::error("AudioControlBackend::DeletePulseDevice: no device with id: {}", index);
 }
 
+struct StringHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view value) const noexcept
+    {
+        return std::hash<std::string_view>{}(value);
+    }
+};
+
+// The defaults come from the server by name
+using DeviceIndicesByName = std::unordered_map<std::string, Index, StringHash, std::equal_to<>>;
+
+void SetDeviceIndexByName(DeviceIndicesByName& indices, std::string_view name, Index index)
+{
+    if (auto it = indices.find(name); it != indices.end())
+        it->second = index;
+    else
+        indices.emplace(name, index);
+}
+
+void RemoveDeviceIndexByName(DeviceIndicesByName& indices, Index index)
+{
+    std::erase_if(indices, [index](const auto& entry) { return entry.second == index; });
+}
+
+// Updates the only device that has the name, if any
+template<class DeviceT>
+void UpdateDefaultDevice(IAudioControlBackend::SignalMap<DeviceT>& map, const DeviceIndicesByName& indices, std::string_view name, bool isDefault)
+{
+    const auto indexIt = indices.find(name);
+    if (indexIt == indices.end())
+        return;
+
+    if (auto deviceIt = map.findByKey(indexIt->second))
+        map.update(*deviceIt,
+                   [name, isDefault](DeviceT& device)
+                   {
+                       // A renamed device keeps its old name in the map until it's deleted
+                       if (device.getName() != name || device.isDefault() == isDefault)
+                           return ChangeMask{};
+
+                       device.updateDefault(isDefault);
+                       return ChangeMask{DeviceField::Default};
+                   });
+}
+
+[[nodiscard]] std::string_view GetNameOrEmpty(const char* name) noexcept
+{
+    return name == nullptr ? std::string_view{} : std::string_view{name};
+}
+
 std::string ToString(const pa_card_port_info& port)
 {
     return std::format("Port. Name: {}, descript: {}, available: {}", port.name, port.description, port.available);
@@ -93,459 +188,1704 @@ constexpr pa_subscription_mask SubscriptionMask = GetSubscriptionMask(pa_subscri
                                                                       pa_subscription_mask::PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT,
                                                                       pa_subscription_mask::PA_SUBSCRIPTION_MASK_CARD);
 
-[[nodiscard]] RaiiWrap<pa_glib_mainloop*> InitMainloop()
+[[nodiscard]] MainloopHandle InitMainloop(Glib::MainContext& mainContext)
 {
-    return {[](pa_glib_mainloop*& mainloop)
-            {
-                if (mainloop = pa_glib_mainloop_new(Glib::MainContext::get_default().get()->gobj()); mainloop == nullptr)
-                    throw std::runtime_error("pa_glib_mainloop_new() failed.");
-            },
-            [](pa_glib_mainloop*& mainloop)
-            {
-                pa_glib_mainloop_free(mainloop);
-            }};
-}
+    MainloopHandle mainloop{pa_glib_mainloop_new(mainContext.gobj())};
+    if (!mainloop)
+        throw std::runtime_error("pa_glib_mainloop_new() failed.");
 
-[[nodiscard]] RaiiWrap<pa_mainloop_api*> InitApi(pa_glib_mainloop& mainloop)
-{
-    return {[&mainloop](pa_mainloop_api*& api)
-            {
-                if (api = pa_glib_mainloop_get_api(&mainloop); api == nullptr)
-                    throw std::runtime_error("pa_glib_mainloop_get_api() failed.");
-            },
-            RaiiWrap<pa_mainloop_api*>::Destructor()};
+    return mainloop;
 }
 
-[[nodiscard]] RaiiWrap<pa_context*> InitContext(pa_mainloop_api& api, pa_context_notify_cb_t contextCallback, AudioControlBackend& self)
+// Owned by the main loop
+[[nodiscard]] pa_mainloop_api* InitApi(pa_glib_mainloop& mainloop)
 {
-    const auto constructor = [&api, &contextCallback, &self](pa_context*& context)
-    {
-        const auto propListConstructor = [](pa_proplist*& proplist)
-        {
-            proplist = pa_proplist_new();
-            std::ignore = pa_proplist_sets(proplist, PA_PROP_APPLICATION_NAME, "Ghaf Audio Control");
-            std::ignore = pa_proplist_sets(proplist, PA_PROP_APPLICATION_ID, "org.ghaf.audiocontrol");
-            std::ignore = pa_proplist_sets(proplist, PA_PROP_APPLICATION_ICON_NAME, "audio-card");
-        };
-
-        const auto propListDestructor = [](pa_proplist*& proplist)
-        {
-            pa_proplist_free(proplist);
-        };
-
-        const RaiiWrap<pa_proplist*> propList(propListConstructor, propListDestructor);
-
-        if (context = pa_context_new_with_proplist(&api, "GhafAudioControl", propList); context == nullptr)
-            throw std::runtime_error("pa_context_new_with_proplist() failed.");
-
-        pa_context_set_state_callback(context, contextCallback, &self);
-
-        if (const auto& server = self.getServerAddress(); pa_context_connect(context, server.empty() ? nullptr : server.c_str(), PA_CONTEXT_NOFAIL, nullptr) < 0)
-            throw std::runtime_error(std::format("pa_context_connect() failed: {}", pa_strerror(pa_context_errno(context))));
-    };
+    pa_mainloop_api* api = pa_glib_mainloop_get_api(&mainloop);
+    if (api == nullptr)
+        throw std::runtime_error("pa_glib_mainloop_get_api() failed.");
 
-    const auto destructor = [](pa_context*& context)
-    {
-        pa_context_disconnect(context);
-    };
-
-    return {constructor, destructor};
+    return api;
 }
 
-} // namespace
+constexpr auto ApplicationId = "org.ghaf.audiocontrol";
 
-AudioControlBackend::AudioControlBackend(std::string pulseAudioServerAddress)
-    : m_serverAddress(std::move(pulseAudioServerAddress))
-    , m_mainloop(InitMainloop())
-    , m_mainloopApi(InitApi(*m_mainloop))
+// The record streams of the peak meters are source outputs as well. They aren't the devices to control
+[[nodiscard]] bool IsOwnStream(const pa_proplist* proplist)
 {
+    const char* applicationId = pa_proplist_gets(proplist, PA_PROP_APPLICATION_ID);
+    return applicationId != nullptr && std::string_view{applicationId} == ApplicationId;
 }
 
-void AudioControlBackend::start()
+// No callbacks from the context being destroyed: the disconnect would report it as terminated. A context that has never
+// been connected isn't disconnected again
+struct ContextDeleter final
 {
-    Logger::info("PulseAudio::AudioControlBackend: starting with server: {}", m_serverAddress);
-    m_context = InitContext(*m_mainloopApi, contextStateCallback, *this);
-}
+    void operator()(pa_context* context) const noexcept
+    {
+        pa_context_set_state_callback(context, nullptr, nullptr);
+        pa_context_set_subscribe_callback(context, nullptr, nullptr);
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+    }
+};
 
-void AudioControlBackend::stop()
-{
-    m_context.reset();
-}
+using ContextHandle = UniqueHandle<pa_context, ContextDeleter>;
+using ProplistHandle = UniqueHandle<pa_proplist, FunctionDeleter<pa_proplist_free>>;
 
-void AudioControlBackend::setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume)
+[[nodiscard]] ContextHandle InitContext(pa_mainloop_api& api, const std::string& server, pa_context_notify_cb_t contextCallback, void* userdata)
 {
-    const auto update = [index, volume](auto& map)
-    {
-        if (auto iterator = map.findByKey(index))
-            map.update(*iterator,
-                       [volume](auto& device)
-                       {
-                           device.setVolume(volume);
-                           return true;
-                       });
-        else
-            Logger::error("AudioControlBackend::setDeviceVolume: no such a device with id: {}", index);
-    };
+    const ProplistHandle propList{pa_proplist_new()};
+    std::ignore = pa_proplist_sets(propList.get(), PA_PROP_APPLICATION_NAME, "Ghaf Audio Control");
+    std::ignore = pa_proplist_sets(propList.get(), PA_PROP_APPLICATION_ID, ApplicationId);
+    std::ignore = pa_proplist_sets(propList.get(), PA_PROP_APPLICATION_ICON_NAME, "audio-card");
 
-    switch (type)
-    {
-    case IAudioControlBackend::IDevice::Type::Sink:
-        update(m_sinks);
-        break;
+    ContextHandle context{pa_context_new_with_proplist(&api, "GhafAudioControl", propList.get())};
+    if (!context)
+        throw std::runtime_error("pa_context_new_with_proplist() failed.");
 
-    case IAudioControlBackend::IDevice::Type::Source:
-        update(m_sources);
-        break;
+    pa_context_set_state_callback(context.get(), contextCallback, userdata);
 
-    case IAudioControlBackend::IDevice::Type::SinkInput:
-        update(m_sinkInputs);
-        break;
+    if (pa_context_connect(context.get(), server.empty() ? nullptr : server.c_str(), PA_CONTEXT_NOFAIL, nullptr) < 0)
+        throw std::runtime_error(std::format("pa_context_connect() failed: {}", pa_strerror(pa_context_errno(context.get()))));
 
-    case IAudioControlBackend::IDevice::Type::SourceOutput:
-        update(m_sourceOutputs);
-        break;
-    }
+    return context;
 }
 
-void AudioControlBackend::setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute)
+// A context that is never connected, for the devices of a replay. They only keep a reference to it
+[[nodiscard]] ContextHandle InitOfflineContext(pa_mainloop_api& api)
 {
-    const auto update = [index, mute](auto& map)
-    {
-        if (auto iterator = map.findByKey(index))
-            map.update(*iterator,
-                       [mute](auto& device)
-                       {
-                           device.setMuted(mute);
-                           return true;
-                       });
-        else
-            Logger::error("AudioControlBackend::setDeviceMute: no such a device with id: {}", index);
-    };
-
-    switch (type)
-    {
-    case IAudioControlBackend::IDevice::Type::Sink:
-        update(m_sinks);
-        break;
+    ContextHandle context{pa_context_new(&api, "GhafAudioControlReplay")};
+    if (!context)
+        throw std::runtime_error("pa_context_new() failed.");
 
-    case IAudioControlBackend::IDevice::Type::Source:
-        update(m_sources);
-        break;
+    return context;
+}
 
-    case IAudioControlBackend::IDevice::Type::SinkInput:
-        update(m_sinkInputs);
-        break;
+constexpr auto InitialReconnectDelay = std::chrono::milliseconds{100};
+constexpr auto MaxReconnectDelay = std::chrono::milliseconds{5000};
 
-    case IAudioControlBackend::IDevice::Type::SourceOutput:
-        update(m_sourceOutputs);
-        break;
-    }
-}
+Metrics::Counter& IntrospectionSentCounter = Metrics::GetCounter("pulse_introspection_requests_total{result=\"sent\"}");
+Metrics::Counter& IntrospectionCoalescedCounter = Metrics::GetCounter("pulse_introspection_requests_total{result=\"coalesced\"}");
+Metrics::Counter& IgnoredDevicesCounter = Metrics::GetCounter("pulse_ignored_devices_total");
 
-void AudioControlBackend::makeDeviceDefault(IDevice::IntexT index, IDevice::Type type)
+Metrics::Counter& GetSubscriptionEventsCounter(pa_subscription_event_type_t facility)
 {
-    const auto update = [index](auto& map)
+    const auto get = [](std::string_view facilityName) -> Metrics::Counter&
     {
-        if (auto iterator = map.findByKey(index))
-            map.update(*iterator,
-                       [](auto& device)
-                       {
-                           device.setDefault(true);
-                           return true;
-                       });
-        else
-            Logger::error("AudioControlBackend::makeDeviceDefault: no such a device with id: {}", index);
+        return Metrics::GetCounter(std::format("pulse_subscription_events_total{{facility=\"{}\"}}", facilityName));
     };
 
-    switch (type)
-    {
-    case IAudioControlBackend::IDevice::Type::Sink:
-        update(m_sinks);
-        break;
-
-    case IAudioControlBackend::IDevice::Type::Source:
-        update(m_sources);
-        break;
+    static Metrics::Counter& server = get("server");
+    static Metrics::Counter& card = get("card");
+    static Metrics::Counter& sink = get("sink");
+    static Metrics::Counter& sinkInput = get("sink_input");
+    static Metrics::Counter& source = get("source");
+    static Metrics::Counter& sourceOutput = get("source_output");
+    static Metrics::Counter& other = get("other");
 
+    switch (facility)
+    {
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SERVER:
+        return server;
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_CARD:
+        return card;
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK:
+        return sink;
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+        return sinkInput;
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE:
+        return source;
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+        return sourceOutput;
     default:
-        break;
+        return other;
     }
 }
 
-std::vector<IAudioControlBackend::IDevice::Ptr> AudioControlBackend::getAllDevices() const
+// Reports the first failure of the given number of operations, or Ok once all of them are done
+IAudioControlBackend::ResultCallback JoinResults(size_t count, IAudioControlBackend::ResultCallback onDone)
 {
-    std::vector<IAudioControlBackend::IDevice::Ptr> result;
+    using Result = IAudioControlBackend::Result;
 
-    const auto copyToResult = [&result](const auto& vec)
+    struct Join
     {
-        result.insert(result.begin(), vec.begin(), vec.end());
+        size_t pending;
+        Result result = Result::Ok;
+        IAudioControlBackend::ResultCallback onDone;
     };
 
-    copyToResult(m_sinks.getAllValues());
-    copyToResult(m_sources.getAllValues());
-    copyToResult(m_sinkInputs.getAllValues());
-    copyToResult(m_sourceOutputs.getAllValues());
+    auto join = std::make_shared<Join>(Join{.pending = count, .onDone = std::move(onDone)});
 
-    return result;
-}
+    return [join](Result result)
+    {
+        if (join->result == Result::Ok)
+            join->result = result;
 
-void AudioControlBackend::onSinkInfo(const pa_sink_info& info)
-{
-    OnPulseDeviceInfo<Sink>(info, m_defaultSinkName == info.name, m_sinks, *m_context->get());
+        if (--join->pending == 0)
+            CompleteOperation(join->onDone, join->result);
+    };
 }
 
-void AudioControlBackend::deleteSink(Sinks::IndexT index)
+// The operations are all queued on the context by the loop, so they leave in the same main loop iteration.
+// The batch reports once the last of them is done. One extra pending slot keeps it open while the requests are being sent
+template<class RequestT, class RunT>
+void RunBatch(const std::vector<RequestT>& requests, IAudioControlBackend::ResultsCallback onDone, RunT&& run)
 {
-    DeletePulseDevice<Sink>(m_sinks, index);
-}
+    using Result = IAudioControlBackend::Result;
 
-void AudioControlBackend::onSourceInfo(const pa_source_info& info)
-{
-    OnPulseDeviceInfo<Source>(info, m_defaultSourceName == info.name, m_sources, *m_context->get());
-}
+    struct Batch
+    {
+        std::vector<Result> results;
+        size_t pending;
+        IAudioControlBackend::ResultsCallback onDone;
 
-void AudioControlBackend::deleteSource(Sources::IndexT index)
-{
-    DeletePulseDevice<Source>(m_sources, index);
-}
+        void finishOne()
+        {
+            if (--pending == 0 && onDone)
+                onDone(std::move(results));
+        }
+    };
 
-void AudioControlBackend::onSinkInputInfo(const pa_sink_input_info& info)
-{
-    OnPulseDeviceInfo<SinkInput>(info, false, m_sinkInputs, *m_context->get());
-}
+    auto batch = std::make_shared<Batch>(Batch{.results = std::vector<Result>(requests.size(), Result::Ok), .pending = requests.size() + 1, .onDone = std::move(onDone)});
 
-void AudioControlBackend::deleteSinkInput(SinkInputs::IndexT index)
-{
-    DeletePulseDevice<SinkInput>(m_sinkInputs, index);
-}
+    for (size_t i = 0; i < requests.size(); ++i)
+        run(requests[i],
+            [batch, i](Result result)
+            {
+                batch->results[i] = result;
+                batch->finishOne();
+            });
 
-void AudioControlBackend::onSourceOutputInfo(const pa_source_output_info& info)
-{
-    OnPulseDeviceInfo<SourceOutput>(info, false, m_sourceOutputs, *m_context->get());
+    batch->finishOne();
 }
 
-void AudioControlBackend::deleteSourceOutput(SourceOutputs::IndexT index)
-{
-    DeletePulseDevice<SourceOutput>(m_sourceOutputs, index);
-}
+} // namespace
 
-void AudioControlBackend::onServerInfo(const pa_server_info& info)
+class AudioControlBackend::Server final : private ITraceHandler
 {
-    const auto updateSinkFunction = [defaultName = m_defaultSinkName](ISink& sink)
+public:
+    Server(AudioControlBackend& backend, uint16_t id, std::string address);
+    ~Server() override;
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    [[nodiscard]] State getState() const noexcept
     {
-        const bool shouldBeDefault = sink.getName() == defaultName;
+        return m_state;
+    }
 
-        if (sink.isDefault() == shouldBeDefault)
-            return false;
+    void start();
+    void stop();
 
-        dynamic_cast<Sink&>(sink).updateDefault(shouldBeDefault);
+    void startReplay();
+    void replay(const TraceReader::Record& record);
 
-        return true;
-    };
+    // Follows m_isPeakMeteringEnabled of the backend
+    void updatePeakMeters();
 
-    const auto updateSourceFunction = [defaultName = m_defaultSourceName](ISource& source)
-    {
-        const bool shouldBeDefault = source.getName() == defaultName;
+private:
+    static void subscribeCallback(pa_context* context, pa_subscription_event_type_t type, uint32_t index, void* data);
+    static void contextStateCallback(pa_context* context, void* data);
+    static void sinkInfoCallback(pa_context* context, const pa_sink_info* info, int eol, void* data);
+    static void sourceInfoCallback(pa_context* context, const pa_source_info* info, int eol, void* data);
+    static void sinkInputInfoCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* data);
+    static void sourceOutputInfoCallback(pa_context* context, const pa_source_output_info* info, int eol, void* data);
+    static void serverInfoCallback(pa_context* context, const pa_server_info* info, void* data);
+    static void cardInfoCallback(pa_context* context, const pa_card_info* info, int eol, void* data);
 
-        if (source.isDefault() == shouldBeDefault)
-            return false;
+    // Only the initial lists end a list: the queries by index share the info callbacks, and each of their replies has an end too
+    static void sinkInfoListCallback(pa_context* context, const pa_sink_info* info, int eol, void* data);
+    static void sourceInfoListCallback(pa_context* context, const pa_source_info* info, int eol, void* data);
+    static void sinkInputInfoListCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* data);
+    static void sourceOutputInfoListCallback(pa_context* context, const pa_source_output_info* info, int eol, void* data);
+    static void cardInfoListCallback(pa_context* context, const pa_card_info* info, int eol, void* data);
 
-        dynamic_cast<Source&>(source).updateDefault(shouldBeDefault);
+    // ITraceHandler. The server callbacks go through the same methods, so a replay follows the live path
+    void onSubscriptionEvent(pa_subscription_event_type_t type, uint32_t index) override;
 
-        return true;
-    };
+    void onSinkInfo(const pa_sink_info& info) override;
+    void deleteSink(Index index);
 
-    if (m_defaultSinkName != info.default_sink_name)
-    {
-        Logger::info("AudioControlBackend::onServerInfo: default sink set to: {}", info.default_sink_name);
+    void onSourceInfo(const pa_source_info& info) override;
+    void deleteSource(Index index);
 
-        m_defaultSinkName = info.default_sink_name;
-        // m_sinks.forEach(updateSinkFunction);
-    }
+    // Returns whether the device is ignored. A kept device which a change has made ignored, e.g. by a new name, is removed
+    template<class DeviceT>
+    [[nodiscard]] bool updateIgnored(IDevice::Type type, Index index, bool isIgnored, SignalMap<DeviceT>& map, void (Server::*deleteDevice)(Index));
+    // Returns whether the device has been ignored, so there is nothing to delete
+    [[nodiscard]] bool forgetIgnored(IDevice::Type type, Index index);
 
-    if (m_defaultSourceName != info.default_source_name)
-    {
-        Logger::info("AudioControlBackend::onServerInfo: default source set to: {}", info.default_source_name);
+    void onSinkInputInfo(const pa_sink_input_info& info) override;
+    void deleteSinkInput(Index index);
 
-        m_defaultSourceName = info.default_source_name;
-        // m_sources.forEach(updateSourceFunction);
-    }
-}
+    // Sends the saved volume and mute of a new AppVM stream to the server. Returns the info with them, so the device starts with
+    // the restored state and the echo of the change doesn't update it
+    [[nodiscard]] std::optional<pa_sink_input_info> restoreProfile(const pa_sink_input_info& info);
+    void saveProfile(const pa_sink_input_info& info);
 
-void AudioControlBackend::subscribeCallback(pa_context* context, pa_subscription_event_type_t type, uint32_t index, void* data)
-{
-    auto* self = static_cast<AudioControlBackend*>(data);
-    const bool needRemove = (type & pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_TYPE_MASK) == pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_REMOVE;
-    const auto eventType = static_cast<pa_subscription_event_type>(type & pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_FACILITY_MASK);
+    void onSourceOutputInfo(const pa_source_output_info& info) override;
+    void deleteSourceOutput(Index index);
 
-    switch (eventType)
-    {
-    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SERVER:
-        ExecutePulseFunc(pa_context_get_server_info, context, serverInfoCallback, data);
-        break;
+    void onServerInfo(const pa_server_info& info) override;
+    void requestLists();
+    void onCardInfo(const pa_card_info& info) override;
+    void onListEnd() override;
 
-    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK:
-        if (needRemove)
-            self->deleteSink(index);
-        else
-            ExecutePulseFunc(pa_context_get_sink_info_by_index, context, index, sinkInfoCallback, data);
+    void setState(State state);
+    void removeStaleDevices();
+    void recordListEnd(bool isComplete); // Records and handles the end of a list
 
-        break;
+    void connect();
+    void onConnectionLost();
+    void scheduleReconnect();
 
-    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK_INPUT:
-        if (needRemove)
-            self->deleteSinkInput(index);
-        else
-            ExecutePulseFunc(pa_context_get_sink_input_info, context, index, sinkInputInfoCallback, data);
+    void scheduleIntrospection(pa_subscription_event_type_t facility, uint32_t index);
+    void flushPendingIntrospection();
 
-        break;
+    // The sink inputs of the sink are watched as well, they record from its monitor
+    void watchSinkPeaks(Index sinkIndex);
+    void watchSinkInputPeaks(Index sinkInputIndex);
+    void unwatchPeaks();
 
-    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE:
-        if (needRemove)
-            self->deleteSource(index);
-        else
-            ExecutePulseFunc(pa_context_get_source_info_by_index, context, index, sourceInfoCallback, data);
+    [[nodiscard]] Index makeIndex(uint32_t index) const noexcept
+    {
+        return MakeDeviceIndex(m_id, index);
+    }
 
-        break;
+    // With several servers, an index that doesn't fit below the server number would collide with another server's device
+    [[nodiscard]] bool isIndexSupported(uint32_t index) const;
+    [[nodiscard]] bool ownsDevice(Index index) const noexcept;
 
-    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
-        if (needRemove)
-            self->deleteSourceOutput(index);
-        else
-            ExecutePulseFunc(pa_context_get_source_output_info, context, index, sourceOutputInfoCallback, data);
+    [[nodiscard]] TraceRecorder* getTraceRecorder() const noexcept
+    {
+        return m_backend.m_traceRecorder.get();
+    }
 
-        break;
+private:
+    AudioControlBackend& m_backend;
+    const uint16_t m_id;
+    const std::string m_address;
 
-    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_CARD:
-        ExecutePulseFunc(pa_context_get_card_info_by_index, context, index, cardInfoCallback, data);
-        break;
+    State m_state = State::Disconnected;
+    size_t m_pendingLists = 0; // The initial lists the server has not finished yet
 
-    default:
-        Logger::error("subscribeCallback: unknown eventType: {0}", static_cast<int>(eventType));
-        break;
-    };
-}
+    std::string m_defaultSinkName;
+    std::string m_defaultSourceName;
 
-void AudioControlBackend::contextStateCallback(pa_context* context, void* data)
-{
-    auto* self = static_cast<AudioControlBackend*>(data);
+    DeviceIndicesByName m_sinkIndicesByName;
+    DeviceIndicesByName m_sourceIndicesByName;
 
-    switch (const auto state = pa_context_get_state(context))
-    {
-    case pa_context_state_t::PA_CONTEXT_TERMINATED:
-        self->m_onError("pa_context_state_t::PA_CONTEXT_TERMINATED");
-        break;
+    ContextHandle m_context;
+    bool m_isReplaying = false;
 
-    case pa_context_state_t::PA_CONTEXT_READY:
-        ExecutePulseFunc(pa_context_get_server_info, context, serverInfoCallback, data);
-        pa_context_set_subscribe_callback(context, subscribeCallback, data);
-        ExecutePulseFunc(pa_context_subscribe, context, SubscriptionMask, nullptr, nullptr);
-        break;
+    sigc::connection m_reconnectTimer;
+    std::chrono::milliseconds m_reconnectDelay = InitialReconnectDelay;
 
-    case pa_context_state_t::PA_CONTEXT_FAILED:
-        self->m_onError(std::format("Connection to the server '{}' has failed", self->getServerAddress()));
-        break;
+    // After a reconnect, the cached devices the server lists again. The rest are gone and are removed once all the lists have ended
+    bool m_isResyncing = false;
+    bool m_hasFailedList = false; // Of the current listing
+    std::set<std::pair<IDevice::Type, Index>> m_resyncedDevices;
 
-    case pa_context_state_t::PA_CONTEXT_CONNECTING:
-    case pa_context_state_t::PA_CONTEXT_AUTHORIZING:
-    case pa_context_state_t::PA_CONTEXT_SETTING_NAME:
-        break;
+    CardDeviceIndex m_cardDevices;
+    std::unordered_map<uint32_t, CardPorts> m_cardPorts;
 
-    default:
-        Logger::error("contextStateCb: unknown state: {0}", static_cast<int>(state));
-        break;
-    }
-}
+    // The sources the peaks are recorded from: the monitor source of every sink, and the sink of every sink input
+    std::unordered_map<Index, uint32_t> m_sinkMonitorSources;
+    std::unordered_map<Index, Index> m_sinkInputSinks;
 
-void AudioControlBackend::sinkInfoCallback(pa_context* context, const pa_sink_info* info, int eol, void* data)
+    // The devices the filter ignores and the own streams, not added to the maps. Their removals aren't looked for there
+    std::set<std::pair<IDevice::Type, Index>> m_ignoredDevices;
+
+    // Objects reported as changed since the last flush. Repeated events for the same object collapse into one introspection query
+    std::set<std::pair<pa_subscription_event_type_t, uint32_t>> m_pendingIntrospection;
+    sigc::connection m_pendingIntrospectionFlush;
+};
+
+AudioControlBackend::Server::Server(AudioControlBackend& backend, uint16_t id, std::string address)
+    : m_backend(backend)
+    , m_id(id)
+    , m_address(std::move(address))
 {
-    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
-        return;
+}
 
-    static_cast<AudioControlBackend*>(data)->onSinkInfo(*info);
+AudioControlBackend::Server::~Server()
+{
+    m_pendingIntrospectionFlush.disconnect();
+    m_reconnectTimer.disconnect();
 }
 
-void AudioControlBackend::sourceInfoCallback(pa_context* context, const pa_source_info* info, int eol, void* data)
+void AudioControlBackend::Server::start()
 {
-    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
-        return;
+    Logger::info("PulseAudio::AudioControlBackend: starting with server: {}", m_address);
 
-    static_cast<AudioControlBackend*>(data)->onSourceInfo(*info);
+    connect();
 }
 
-void AudioControlBackend::sinkInputInfoCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* data)
+void AudioControlBackend::Server::stop()
 {
-    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
-        return;
+    m_reconnectTimer.disconnect();
+    unwatchPeaks();
+
+    m_pendingIntrospectionFlush.disconnect();
+    m_pendingIntrospection.clear();
+
+    m_context.reset();
+    m_isReplaying = false;
+    m_isResyncing = false;
+    m_resyncedDevices.clear();
+    m_ignoredDevices.clear();
 
-    static_cast<AudioControlBackend*>(data)->onSinkInputInfo(*info);
+    setState(State::Disconnected);
 }
 
-void AudioControlBackend::sourceOutputInfoCallback(pa_context* context, const pa_source_output_info* info, int eol, void* data)
+void AudioControlBackend::Server::connect()
 {
-    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
-        return;
+    auto context = InitContext(*m_backend.m_mainloopApi, m_address, contextStateCallback, this);
+    const auto isOwned = [this](Index index) { return ownsDevice(index); };
+
+    // The cached devices send their changes to the new context from now on
+    SetDevicesContext(m_backend.m_sinks, *context, isOwned);
+    SetDevicesContext(m_backend.m_sources, *context, isOwned);
+    SetDevicesContext(m_backend.m_sinkInputs, *context, isOwned);
+    SetDevicesContext(m_backend.m_sourceOutputs, *context, isOwned);
 
-    static_cast<AudioControlBackend*>(data)->onSourceOutputInfo(*info);
+    unwatchPeaks();
+    m_context = std::move(context);
 }
 
-void AudioControlBackend::serverInfoCallback(pa_context* context, const pa_server_info* info, void* data)
+void AudioControlBackend::Server::onConnectionLost()
 {
-    if (info == nullptr)
-        return;
+    Logger::error("AudioControlBackend: the connection to the server '{}' has been lost, reconnecting in {} ms", m_address, m_reconnectDelay.count());
+
+    // The queries of the lost context won't be answered. The devices are kept till the new lists are compared against them
+    m_pendingIntrospectionFlush.disconnect();
+    m_pendingIntrospection.clear();
+
+    // Started again as the new lists come
+    unwatchPeaks();
 
-    static_cast<AudioControlBackend*>(data)->onServerInfo(*info);
+    m_isResyncing = true;
+    m_resyncedDevices.clear();
+    m_ignoredDevices.clear();
 
-    ExecutePulseFunc(pa_context_get_sink_info_list, context, sinkInfoCallback, data);
-    ExecutePulseFunc(pa_context_get_source_info_list, context, sourceInfoCallback, data);
-    ExecutePulseFunc(pa_context_get_sink_input_info_list, context, sinkInputInfoCallback, data);
-    ExecutePulseFunc(pa_context_get_source_output_info_list, context, sourceOutputInfoCallback, data);
-    ExecutePulseFunc(pa_context_get_card_info_list, context, cardInfoCallback, data);
+    setState(State::Reconnecting);
+    scheduleReconnect();
 }
 
-void AudioControlBackend::cardInfoCallback(pa_context* context, const pa_card_info* info, int eol, void* data)
+void AudioControlBackend::Server::scheduleReconnect()
 {
+    if (m_reconnectTimer.connected())
+        return;
+
+    const auto delay = std::exchange(m_reconnectDelay, std::min(m_reconnectDelay * 2, MaxReconnectDelay));
+
+    m_reconnectTimer = m_backend.m_mainContext->signal_timeout().connect(
+        [this]
+        {
+            // Released, so a failure below can schedule the next attempt. The timer itself ends with the return
+            m_reconnectTimer = {};
+
+            try
+            {
+                connect();
+            }
+            catch (const std::exception& ex)
+            {
+                Logger::error("AudioControlBackend: reconnect to the server '{}' has failed: {}, retrying in {} ms", m_address, ex.what(), m_reconnectDelay.count());
+                scheduleReconnect();
+            }
+
+            return false;
+        },
+        static_cast<unsigned int>(delay.count()));
+}
+
+void AudioControlBackend::Server::startReplay()
+{
+    m_context = InitOfflineContext(*m_backend.m_mainloopApi);
+    m_isReplaying = true;
+
+    setState(State::Connected);
+}
+
+void AudioControlBackend::Server::replay(const TraceReader::Record& record)
+{
+    TraceReader::Dispatch(record, *this);
+}
+
+bool AudioControlBackend::Server::isIndexSupported(uint32_t index) const
+{
+    if (m_backend.m_servers.size() == 1 || index <= MaxServerDeviceIndex)
+        return true;
+
+    Logger::error("AudioControlBackend: the server '{}' has reported the index {}, too big for several servers. Ignoring the device", m_address, index);
+    return false;
+}
+
+bool AudioControlBackend::Server::ownsDevice(Index index) const noexcept
+{
+    return m_backend.m_servers.size() == 1 || GetDeviceIndexServer(index) == m_id;
+}
+
+void AudioControlBackend::Server::onSinkInfo(const pa_sink_info& info)
+{
+    if (!isIndexSupported(info.index))
+        return;
+
+    const Index index = makeIndex(info.index);
+
+    if (updateIgnored(IDevice::Type::Sink, index, m_backend.m_deviceFilter.isIgnored(info), m_backend.m_sinks, &Server::deleteSink))
+        return;
+
+    if (m_isResyncing)
+        m_resyncedDevices.emplace(IDevice::Type::Sink, index);
+
+    m_cardDevices.set(IDevice::Type::Sink, index, info.card);
+    SetDeviceIndexByName(m_sinkIndicesByName, info.name, index);
+    const auto rampTarget = m_backend.getVolumeRampTarget(index, IDevice::Type::Sink);
+    OnPulseDeviceInfo(info, m_defaultSinkName == info.name, m_isResyncing, rampTarget, m_backend.m_sinks, *m_context.get(), m_id);
+
+    m_sinkMonitorSources[index] = info.monitor_source;
+    watchSinkPeaks(index);
+}
+
+void AudioControlBackend::Server::deleteSink(Index index)
+{
+    if (forgetIgnored(IDevice::Type::Sink, index))
+        return;
+
+    if (m_sinkMonitorSources.erase(index) != 0)
+        m_backend.m_peakMeter.unwatch({IDevice::Type::Sink, index});
+
+    m_cardDevices.remove(IDevice::Type::Sink, index);
+    RemoveDeviceIndexByName(m_sinkIndicesByName, index);
+    DeletePulseDevice(m_backend.m_sinks, index);
+}
+
+void AudioControlBackend::Server::onSourceInfo(const pa_source_info& info)
+{
+    if (!isIndexSupported(info.index))
+        return;
+
+    const Index index = makeIndex(info.index);
+
+    if (updateIgnored(IDevice::Type::Source, index, m_backend.m_deviceFilter.isIgnored(info), m_backend.m_sources, &Server::deleteSource))
+        return;
+
+    if (m_isResyncing)
+        m_resyncedDevices.emplace(IDevice::Type::Source, index);
+
+    m_cardDevices.set(IDevice::Type::Source, index, info.card);
+    SetDeviceIndexByName(m_sourceIndicesByName, info.name, index);
+    const auto rampTarget = m_backend.getVolumeRampTarget(index, IDevice::Type::Source);
+    OnPulseDeviceInfo(info, m_defaultSourceName == info.name, m_isResyncing, rampTarget, m_backend.m_sources, *m_context.get(), m_id);
+}
+
+void AudioControlBackend::Server::deleteSource(Index index)
+{
+    if (forgetIgnored(IDevice::Type::Source, index))
+        return;
+
+    m_cardDevices.remove(IDevice::Type::Source, index);
+    RemoveDeviceIndexByName(m_sourceIndicesByName, index);
+    DeletePulseDevice(m_backend.m_sources, index);
+}
+
+void AudioControlBackend::Server::onSinkInputInfo(const pa_sink_input_info& info)
+{
+    if (!isIndexSupported(info.index))
+        return;
+
+    const Index index = makeIndex(info.index);
+
+    if (updateIgnored(IDevice::Type::SinkInput, index, m_backend.m_deviceFilter.isIgnored(info), m_backend.m_sinkInputs, &Server::deleteSinkInput))
+        return;
+
+    if (m_isResyncing)
+        m_resyncedDevices.emplace(IDevice::Type::SinkInput, index);
+
+    // The same check OnPulseDeviceInfo() makes for a device to be added
+    bool isNew = true;
+    if (const auto deviceIt = m_backend.m_sinkInputs.findByKey(index))
+        isNew = m_isResyncing && deviceIt.value()->second->getName() != info.name;
+
+    const auto rampTarget = m_backend.getVolumeRampTarget(index, IDevice::Type::SinkInput);
+
+    if (const auto restored = isNew ? restoreProfile(info) : std::nullopt)
+        OnPulseDeviceInfo(*restored, false, m_isResyncing, rampTarget, m_backend.m_sinkInputs, *m_context.get(), m_id);
+    else
+        OnPulseDeviceInfo(info, false, m_isResyncing, rampTarget, m_backend.m_sinkInputs, *m_context.get(), m_id);
+
+    // Only a change made through the backend is saved, with the first info after the server has confirmed it. An info on the way
+    // before that may still have the state from before a restore. A new stream without a profile keeps the server defaults
+    if (!isNew && m_backend.m_changedProfiles.erase(index) != 0)
+        saveProfile(info);
+
+    // A moved sink input records from the monitor of its new sink
+    const Index sinkIndex = makeIndex(info.sink);
+
+    m_sinkInputSinks[index] = sinkIndex;
+    watchSinkInputPeaks(index);
+}
+
+std::optional<pa_sink_input_info> AudioControlBackend::Server::restoreProfile(const pa_sink_input_info& info)
+{
+    if (!m_backend.m_profileStore || !m_context || m_isReplaying)
+        return std::nullopt;
+
+    const char* appVmName = GetAppVmNameProperty(info.proplist);
+    if (appVmName == nullptr || info.name == nullptr)
+        return std::nullopt;
+
+    const auto profile = m_backend.m_profileStore->find(appVmName, info.name);
+    if (!profile)
+        return std::nullopt;
+
+    pa_sink_input_info restored = info;
+
+    if (info.has_volume != 0 && info.volume_writable != 0 && pa_cvolume_max(&info.volume) != profile->volume)
+    {
+        pa_cvolume_scale(&restored.volume, profile->volume);
+        ExecutePulseOperation({}, pa_context_set_sink_input_volume, m_context.get(), info.index, &restored.volume);
+    }
+
+    if ((info.mute != 0) != profile->isMuted)
+    {
+        restored.mute = profile->isMuted ? 1 : 0;
+        ExecutePulseOperation({}, pa_context_set_sink_input_mute, m_context.get(), info.index, restored.mute);
+    }
+
+    Logger::debug("AudioControlBackend: restored the profile of the stream: {} of the AppVM: {}", info.name, appVmName);
+    return restored;
+}
+
+void AudioControlBackend::Server::saveProfile(const pa_sink_input_info& info)
+{
+    if (!m_backend.m_profileStore || m_isReplaying)
+        return;
+
+    const char* appVmName = GetAppVmNameProperty(info.proplist);
+    if (appVmName == nullptr || info.name == nullptr)
+        return;
+
+    const ProfileStore::Profile profile{.volume = pa_cvolume_max(&info.volume), .isMuted = info.mute != 0};
+
+    if (m_backend.m_profileStore->find(appVmName, info.name) != profile)
+        std::ignore = m_backend.m_profileStore->save(appVmName, info.name, profile);
+}
+
+void AudioControlBackend::Server::deleteSinkInput(Index index)
+{
+    m_backend.m_changedProfiles.erase(index);
+
+    if (forgetIgnored(IDevice::Type::SinkInput, index))
+        return;
+
+    if (m_sinkInputSinks.erase(index) != 0)
+        m_backend.m_peakMeter.unwatch({IDevice::Type::SinkInput, index});
+
+    DeletePulseDevice(m_backend.m_sinkInputs, index);
+}
+
+void AudioControlBackend::Server::onSourceOutputInfo(const pa_source_output_info& info)
+{
+    if (!isIndexSupported(info.index))
+        return;
+
+    const Index index = makeIndex(info.index);
+    const bool isIgnored = IsOwnStream(info.proplist) || m_backend.m_deviceFilter.isIgnored(info);
+
+    if (updateIgnored(IDevice::Type::SourceOutput, index, isIgnored, m_backend.m_sourceOutputs, &Server::deleteSourceOutput))
+        return;
+
+    if (m_isResyncing)
+        m_resyncedDevices.emplace(IDevice::Type::SourceOutput, index);
+
+    const auto rampTarget = m_backend.getVolumeRampTarget(index, IDevice::Type::SourceOutput);
+    OnPulseDeviceInfo(info, false, m_isResyncing, rampTarget, m_backend.m_sourceOutputs, *m_context.get(), m_id);
+}
+
+void AudioControlBackend::Server::deleteSourceOutput(Index index)
+{
+    if (forgetIgnored(IDevice::Type::SourceOutput, index))
+        return;
+
+    DeletePulseDevice(m_backend.m_sourceOutputs, index);
+}
+
+template<class DeviceT>
+bool AudioControlBackend::Server::updateIgnored(IDevice::Type type, Index index, bool isIgnored, SignalMap<DeviceT>& map, void (Server::*deleteDevice)(Index))
+{
+    if (!isIgnored)
+    {
+        // It may have been ignored before the change
+        std::ignore = forgetIgnored(type, index);
+        return false;
+    }
+
+    if (map.findByKey(index))
+        (this->*deleteDevice)(index);
+
+    if (m_ignoredDevices.emplace(type, index).second)
+        IgnoredDevicesCounter.increment();
+
+    return true;
+}
+
+bool AudioControlBackend::Server::forgetIgnored(IDevice::Type type, Index index)
+{
+    return m_ignoredDevices.erase({type, index}) != 0;
+}
+
+void AudioControlBackend::Server::onServerInfo(const pa_server_info& info)
+{
+    // Only the previous and the new default change, found by name
+    if (const auto defaultSinkName = GetNameOrEmpty(info.default_sink_name); m_defaultSinkName != defaultSinkName)
+    {
+        Logger::info("AudioControlBackend::onServerInfo: default sink of the server '{}' set to: {}", m_address, defaultSinkName);
+
+        const auto previous = std::exchange(m_defaultSinkName, defaultSinkName);
+        UpdateDefaultDevice(m_backend.m_sinks, m_sinkIndicesByName, previous, false);
+        UpdateDefaultDevice(m_backend.m_sinks, m_sinkIndicesByName, m_defaultSinkName, true);
+    }
+
+    if (const auto defaultSourceName = GetNameOrEmpty(info.default_source_name); m_defaultSourceName != defaultSourceName)
+    {
+        Logger::info("AudioControlBackend::onServerInfo: default source of the server '{}' set to: {}", m_address, defaultSourceName);
+
+        const auto previous = std::exchange(m_defaultSourceName, defaultSourceName);
+        UpdateDefaultDevice(m_backend.m_sources, m_sourceIndicesByName, previous, false);
+        UpdateDefaultDevice(m_backend.m_sources, m_sourceIndicesByName, m_defaultSourceName, true);
+    }
+
+    // The first server info of a connection starts the listing. The later ones, on the server events, list nothing
+    if (m_state == State::Connected && m_pendingLists == 0)
+        requestLists();
+}
+
+void AudioControlBackend::Server::requestLists()
+{
+    m_pendingLists = 5;
+    m_hasFailedList = false;
+
+    // A replay has the lists recorded after the server info
+    if (!m_context || m_isReplaying)
+        return;
+
+    pa_context* context = m_context.get();
+
+    ExecutePulseFunc(pa_context_get_sink_info_list, context, sinkInfoListCallback, this);
+    ExecutePulseFunc(pa_context_get_source_info_list, context, sourceInfoListCallback, this);
+    ExecutePulseFunc(pa_context_get_sink_input_info_list, context, sinkInputInfoListCallback, this);
+    ExecutePulseFunc(pa_context_get_source_output_info_list, context, sourceOutputInfoListCallback, this);
+    ExecutePulseFunc(pa_context_get_card_info_list, context, cardInfoListCallback, this);
+}
+
+void AudioControlBackend::Server::scheduleIntrospection(pa_subscription_event_type_t facility, uint32_t index)
+{
+    if (!m_pendingIntrospection.emplace(facility, index).second)
+    {
+        IntrospectionCoalescedCounter.increment();
+        return;
+    }
+
+    // Flush on the next main loop iteration, after the rest of the already received events have been dispatched
+    if (!m_pendingIntrospectionFlush.connected())
+        m_pendingIntrospectionFlush = m_backend.m_mainContext->signal_idle().connect(
+            [this]()
+            {
+                flushPendingIntrospection();
+                return false;
+            },
+            Glib::PRIORITY_DEFAULT);
+}
+
+void AudioControlBackend::Server::flushPendingIntrospection()
+{
+    const auto pending = std::exchange(m_pendingIntrospection, {});
+
+    // A replay has the info payloads recorded after the events, nothing to query
+    if (!m_context || m_isReplaying)
+        return;
+
+    pa_context* context = m_context.get();
+    IntrospectionSentCounter.increment(pending.size());
+
+    for (const auto& [facility, index] : pending)
+    {
+        switch (facility)
+        {
+        case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SERVER:
+            ExecutePulseFunc(pa_context_get_server_info, context, serverInfoCallback, this);
+            break;
+
+        case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK:
+            ExecutePulseFunc(pa_context_get_sink_info_by_index, context, index, sinkInfoCallback, this);
+            break;
+
+        case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            ExecutePulseFunc(pa_context_get_sink_input_info, context, index, sinkInputInfoCallback, this);
+            break;
+
+        case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE:
+            ExecutePulseFunc(pa_context_get_source_info_by_index, context, index, sourceInfoCallback, this);
+            break;
+
+        case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            ExecutePulseFunc(pa_context_get_source_output_info, context, index, sourceOutputInfoCallback, this);
+            break;
+
+        case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_CARD:
+            ExecutePulseFunc(pa_context_get_card_info_by_index, context, index, cardInfoCallback, this);
+            break;
+
+        default:
+            Logger::error("AudioControlBackend::flushPendingIntrospection: unknown facility: {}", static_cast<int>(facility));
+            break;
+        }
+    }
+}
+
+void AudioControlBackend::Server::updatePeakMeters()
+{
+    if (!m_backend.m_isPeakMeteringEnabled)
+    {
+        unwatchPeaks();
+        return;
+    }
+
+    for (const Index sinkIndex : m_sinkMonitorSources | std::views::keys)
+        watchSinkPeaks(sinkIndex);
+}
+
+void AudioControlBackend::Server::watchSinkPeaks(Index sinkIndex)
+{
+    if (!m_backend.m_isPeakMeteringEnabled || !m_context || m_isReplaying)
+        return;
+
+    const auto iter = m_sinkMonitorSources.find(sinkIndex);
+    if (iter == m_sinkMonitorSources.end() || iter->second == PA_INVALID_INDEX)
+        return;
+
+    if (!m_backend.m_peakMeter.watch(*m_context.get(), {IDevice::Type::Sink, sinkIndex}, iter->second))
+        return;
+
+    for (const auto& [sinkInputIndex, sinkInputSink] : m_sinkInputSinks)
+    {
+        if (sinkInputSink == sinkIndex)
+            watchSinkInputPeaks(sinkInputIndex);
+    }
+}
+
+void AudioControlBackend::Server::watchSinkInputPeaks(Index sinkInputIndex)
+{
+    if (!m_backend.m_isPeakMeteringEnabled || !m_context || m_isReplaying)
+        return;
+
+    const auto sinkIter = m_sinkInputSinks.find(sinkInputIndex);
+    if (sinkIter == m_sinkInputSinks.end())
+        return;
+
+    // The sink may come later, the sink input is watched along with it then
+    const auto sourceIter = m_sinkMonitorSources.find(sinkIter->second);
+    if (sourceIter == m_sinkMonitorSources.end() || sourceIter->second == PA_INVALID_INDEX)
+        return;
+
+    std::ignore = m_backend.m_peakMeter.watch(*m_context.get(), {IDevice::Type::SinkInput, sinkInputIndex}, sourceIter->second,
+                                              GetServerDeviceIndex(sinkInputIndex));
+}
+
+void AudioControlBackend::Server::unwatchPeaks()
+{
+    if (m_context)
+        m_backend.m_peakMeter.unwatchAll(*m_context.get());
+}
+
+void AudioControlBackend::Server::subscribeCallback([[maybe_unused]] pa_context* context, pa_subscription_event_type_t type, uint32_t index, void* data)
+{
+    auto* self = static_cast<Server*>(data);
+
+    if (auto* recorder = self->getTraceRecorder())
+        recorder->record(self->m_id, type, index);
+
+    self->onSubscriptionEvent(type, index);
+}
+
+void AudioControlBackend::Server::onSubscriptionEvent(pa_subscription_event_type_t type, uint32_t index)
+{
+    const bool needRemove = (type & pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_TYPE_MASK) == pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_REMOVE;
+    const auto eventType = static_cast<pa_subscription_event_type>(type & pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_FACILITY_MASK);
+
+    GetSubscriptionEventsCounter(eventType).increment();
+
+    if (needRemove)
+        std::ignore = m_pendingIntrospection.erase({eventType, index});
+
+    switch (eventType)
+    {
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SERVER:
+        scheduleIntrospection(eventType, index);
+        break;
+
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_CARD:
+        if (needRemove)
+            std::ignore = m_cardPorts.erase(index);
+        else
+            scheduleIntrospection(eventType, index);
+
+        break;
+
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK:
+        if (needRemove)
+            deleteSink(makeIndex(index));
+        else
+            scheduleIntrospection(eventType, index);
+
+        break;
+
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+        if (needRemove)
+            deleteSinkInput(makeIndex(index));
+        else
+            scheduleIntrospection(eventType, index);
+
+        break;
+
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE:
+        if (needRemove)
+            deleteSource(makeIndex(index));
+        else
+            scheduleIntrospection(eventType, index);
+
+        break;
+
+    case pa_subscription_event_type::PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+        if (needRemove)
+            deleteSourceOutput(makeIndex(index));
+        else
+            scheduleIntrospection(eventType, index);
+
+        break;
+
+    default:
+        Logger::error("subscribeCallback: unknown eventType: {0}", static_cast<int>(eventType));
+        break;
+    };
+}
+
+void AudioControlBackend::Server::contextStateCallback(pa_context* context, void* data)
+{
+    auto* self = static_cast<Server*>(data);
+
+    switch (const auto state = pa_context_get_state(context))
+    {
+    case pa_context_state_t::PA_CONTEXT_TERMINATED:
+    case pa_context_state_t::PA_CONTEXT_FAILED:
+        self->onConnectionLost();
+        break;
+
+    case pa_context_state_t::PA_CONTEXT_READY:
+        self->m_reconnectDelay = InitialReconnectDelay;
+        self->setState(State::Connected);
+
+        ExecutePulseFunc(pa_context_get_server_info, context, serverInfoCallback, data);
+        pa_context_set_subscribe_callback(context, subscribeCallback, data);
+        ExecutePulseFunc(pa_context_subscribe, context, SubscriptionMask, nullptr, nullptr);
+        break;
+
+    case pa_context_state_t::PA_CONTEXT_CONNECTING:
+    case pa_context_state_t::PA_CONTEXT_AUTHORIZING:
+    case pa_context_state_t::PA_CONTEXT_SETTING_NAME:
+        break;
+
+    default:
+        Logger::error("contextStateCb: unknown state: {0}", static_cast<int>(state));
+        break;
+    }
+}
+
+void AudioControlBackend::Server::sinkInfoCallback(pa_context* context, const pa_sink_info* info, int eol, void* data)
+{
+    auto* self = static_cast<Server*>(data);
+
+    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
+        return;
+
+    if (auto* recorder = self->getTraceRecorder())
+        recorder->record(self->m_id, *info);
+
+    self->onSinkInfo(*info);
+}
+
+void AudioControlBackend::Server::sourceInfoCallback(pa_context* context, const pa_source_info* info, int eol, void* data)
+{
+    auto* self = static_cast<Server*>(data);
+
+    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
+        return;
+
+    if (auto* recorder = self->getTraceRecorder())
+        recorder->record(self->m_id, *info);
+
+    self->onSourceInfo(*info);
+}
+
+void AudioControlBackend::Server::sinkInputInfoCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* data)
+{
+    auto* self = static_cast<Server*>(data);
+
+    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
+        return;
+
+    if (auto* recorder = self->getTraceRecorder())
+        recorder->record(self->m_id, *info);
+
+    self->onSinkInputInfo(*info);
+}
+
+void AudioControlBackend::Server::sourceOutputInfoCallback(pa_context* context, const pa_source_output_info* info, int eol, void* data)
+{
+    auto* self = static_cast<Server*>(data);
+
+    if (!PulseCallbackCheck(context, eol, __FUNCTION__) || info == nullptr)
+        return;
+
+    if (auto* recorder = self->getTraceRecorder())
+        recorder->record(self->m_id, *info);
+
+    self->onSourceOutputInfo(*info);
+}
+
+void AudioControlBackend::Server::serverInfoCallback([[maybe_unused]] pa_context* context, const pa_server_info* info, void* data)
+{
+    if (info == nullptr)
+        return;
+
+    auto* self = static_cast<Server*>(data);
+
+    if (auto* recorder = self->getTraceRecorder())
+        recorder->record(self->m_id, *info);
+
+    self->onServerInfo(*info);
+}
+
+void AudioControlBackend::Server::cardInfoCallback(pa_context* context, const pa_card_info* info, int eol, void* data)
+{
+    auto* self = static_cast<Server*>(data);
+
     if (!PulseCallbackCheck(context, eol, __FUNCTION__))
         return;
 
-    if (info == nullptr)
+    if (info == nullptr)
+        return;
+
+    const auto ports = [info]
+    {
+        std::string result;
+
+        for (size_t i = 0; i < info->n_ports; ++i)
+            result += std::format("\n    {}", ToString(*info->ports[i]));
+
+        return result;
+    };
+
+    Logger::debug("Card. index: {}, name: {}, ports:{}", info->index, info->name, Logger::lazy(ports));
+
+    if (auto* recorder = self->getTraceRecorder())
+        recorder->record(self->m_id, *info);
+
+    self->onCardInfo(*info);
+}
+
+void AudioControlBackend::Server::sinkInfoListCallback(pa_context* context, const pa_sink_info* info, int eol, void* data)
+{
+    sinkInfoCallback(context, info, eol, data);
+
+    if (eol != 0)
+        static_cast<Server*>(data)->recordListEnd(eol > 0);
+}
+
+void AudioControlBackend::Server::sourceInfoListCallback(pa_context* context, const pa_source_info* info, int eol, void* data)
+{
+    sourceInfoCallback(context, info, eol, data);
+
+    if (eol != 0)
+        static_cast<Server*>(data)->recordListEnd(eol > 0);
+}
+
+void AudioControlBackend::Server::sinkInputInfoListCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* data)
+{
+    sinkInputInfoCallback(context, info, eol, data);
+
+    if (eol != 0)
+        static_cast<Server*>(data)->recordListEnd(eol > 0);
+}
+
+void AudioControlBackend::Server::sourceOutputInfoListCallback(pa_context* context, const pa_source_output_info* info, int eol, void* data)
+{
+    sourceOutputInfoCallback(context, info, eol, data);
+
+    if (eol != 0)
+        static_cast<Server*>(data)->recordListEnd(eol > 0);
+}
+
+void AudioControlBackend::Server::cardInfoListCallback(pa_context* context, const pa_card_info* info, int eol, void* data)
+{
+    cardInfoCallback(context, info, eol, data);
+
+    if (eol != 0)
+        static_cast<Server*>(data)->recordListEnd(eol > 0);
+}
+
+void AudioControlBackend::Server::setState(State state)
+{
+    if (m_state == state)
+        return;
+
+    if (state == State::Disconnected || state == State::Reconnecting)
+        m_pendingLists = 0;
+
+    m_state = state;
+    m_backend.updateState();
+}
+
+void AudioControlBackend::Server::removeStaleDevices()
+{
+    m_isResyncing = false;
+    const auto resynced = std::exchange(m_resyncedDevices, {});
+
+    const auto getStale = [this, &resynced](const auto& map, IDevice::Type type)
+    {
+        std::vector<Index> stale;
+
+        for (const auto& device : map.getValues())
+        {
+            if (ownsDevice(device->getIndex()) && !resynced.contains({type, device->getIndex()}))
+                stale.push_back(device->getIndex());
+        }
+
+        return stale;
+    };
+
+    for (const Index index : getStale(m_backend.m_sinks, IDevice::Type::Sink))
+        deleteSink(index);
+
+    for (const Index index : getStale(m_backend.m_sources, IDevice::Type::Source))
+        deleteSource(index);
+
+    for (const Index index : getStale(m_backend.m_sinkInputs, IDevice::Type::SinkInput))
+        deleteSinkInput(index);
+
+    for (const Index index : getStale(m_backend.m_sourceOutputs, IDevice::Type::SourceOutput))
+        deleteSourceOutput(index);
+}
+
+void AudioControlBackend::Server::recordListEnd(bool isComplete)
+{
+    if (auto* recorder = getTraceRecorder())
+        recorder->recordListEnd(m_id);
+
+    if (!isComplete)
+        m_hasFailedList = true;
+
+    onListEnd();
+}
+
+void AudioControlBackend::Server::onListEnd()
+{
+    if (m_pendingLists == 0)
+        return;
+
+    if (--m_pendingLists == 0)
+    {
+        // A device missing from a failed list may still exist, so the stale ones are left till the next resync
+        if (m_isResyncing && std::exchange(m_hasFailedList, false))
+        {
+            m_isResyncing = false;
+            m_resyncedDevices.clear();
+        }
+        else if (m_isResyncing)
+            removeStaleDevices();
+
+        setState(State::Synchronized);
+    }
+}
+
+void AudioControlBackend::Server::onCardInfo(const pa_card_info& info)
+{
+    const CardPorts& ports = m_cardPorts.insert_or_assign(info.index, CardPorts{info}).first->second;
+
+    const auto* devices = m_cardDevices.find(info.index);
+    if (devices == nullptr)
+        return;
+
+    auto& sinks = m_backend.m_sinks;
+    auto& sources = m_backend.m_sources;
+
+    for (const Index index : devices->sinks)
+    {
+        if (auto sinkIt = sinks.findByKey(index))
+            sinks.update(*sinkIt, [&ports](Sink& sink) { return sink.update(ports); });
+    }
+
+    for (const Index index : devices->sources)
+    {
+        if (auto sourceIt = sources.findByKey(index))
+            sources.update(*sourceIt, [&ports](Source& source) { return source.update(ports); });
+    }
+}
+
+AudioControlBackend::AudioControlBackend(std::string pulseAudioServerAddress)
+    : AudioControlBackend(std::vector<std::string>{std::move(pulseAudioServerAddress)})
+{
+}
+
+AudioControlBackend::AudioControlBackend(std::vector<std::string> pulseAudioServerAddresses, Glib::RefPtr<Glib::MainContext> mainContext)
+    : m_mainContext(std::move(mainContext))
+    , m_mainloop(InitMainloop(*m_mainContext))
+    , m_mainloopApi(InitApi(*m_mainloop))
+    , m_peakMeter(m_mainContext)
+{
+    if (pulseAudioServerAddresses.empty())
+        pulseAudioServerAddresses.emplace_back(); // The default server
+
+    if (pulseAudioServerAddresses.size() > MaxServers)
+        throw std::runtime_error(std::format("AudioControlBackend: too many servers: {}, the maximum is {}", pulseAudioServerAddresses.size(), MaxServers));
+
+    m_servers.reserve(pulseAudioServerAddresses.size());
+
+    for (auto& address : pulseAudioServerAddresses)
+        m_servers.push_back(std::make_unique<Server>(*this, static_cast<uint16_t>(m_servers.size()), std::move(address)));
+}
+
+AudioControlBackend::~AudioControlBackend()
+{
+    // The contexts run the callbacks of their pending operations as they disconnect, so they go while the rest is still there
+    stop();
+}
+
+void AudioControlBackend::start()
+{
+    for (const auto& server : m_servers)
+        server->start();
+}
+
+void AudioControlBackend::stop()
+{
+    m_volumeRampTimer.disconnect();
+
+    // The last steps on the way won't find their ramps
+    for (const VolumeRamp& ramp : std::exchange(m_volumeRamps, {}))
+        CompleteOperation(ramp.onDone, Result::Failed);
+
+    for (const auto& server : m_servers)
+        server->stop();
+
+    m_isReplaying = false;
+}
+
+void AudioControlBackend::setPeakMeteringEnabled(bool enabled)
+{
+    if (m_isPeakMeteringEnabled == enabled)
+        return;
+
+    Logger::info("PulseAudio::AudioControlBackend: peak metering is {}", enabled ? "enabled" : "disabled");
+
+    m_isPeakMeteringEnabled = enabled;
+
+    for (const auto& server : m_servers)
+        server->updatePeakMeters();
+}
+
+void AudioControlBackend::setTraceRecorder(std::unique_ptr<TraceRecorder> recorder)
+{
+    m_traceRecorder = std::move(recorder);
+}
+
+void AudioControlBackend::setDeviceFilter(DeviceFilter filter)
+{
+    m_deviceFilter = std::move(filter);
+}
+
+void AudioControlBackend::setProfileStore(std::unique_ptr<ProfileStore> store)
+{
+    m_profileStore = std::move(store);
+}
+
+void AudioControlBackend::startReplay()
+{
+    Logger::info("PulseAudio::AudioControlBackend: starting a replay");
+
+    m_isReplaying = true;
+
+    for (const auto& server : m_servers)
+        server->startReplay();
+}
+
+void AudioControlBackend::replay(const TraceReader::Record& record)
+{
+    if (record.server >= MaxServers)
+        throw std::runtime_error(std::format("AudioControlBackend::replay: the server number is too big: {}", record.server));
+
+    // A trace of several servers brings the ones this backend doesn't have yet
+    while (m_servers.size() <= record.server)
+    {
+        m_servers.push_back(std::make_unique<Server>(*this, static_cast<uint16_t>(m_servers.size()), std::string{}));
+
+        if (m_isReplaying)
+            m_servers.back()->startReplay();
+    }
+
+    m_servers[record.server]->replay(record);
+}
+
+void AudioControlBackend::updateState()
+{
+    const auto hasServerInState = [this](State state)
+    {
+        return std::ranges::any_of(m_servers, [state](const auto& server) { return server->getState() == state; });
+    };
+
+    // Still listing while any server is. Reconnecting only if no server is up, the devices of those which are can be used
+    State state = State::Disconnected;
+
+    if (hasServerInState(State::Connected))
+        state = State::Connected;
+    else if (hasServerInState(State::Synchronized))
+        state = State::Synchronized;
+    else if (hasServerInState(State::Reconnecting))
+        state = State::Reconnecting;
+
+    if (m_state == state)
+        return;
+
+    m_state = state;
+    m_onStateChange(state);
+}
+
+template<class FunctionT>
+void AudioControlBackend::visitMap(IDevice::Type type, FunctionT&& function)
+{
+    switch (type)
+    {
+    case IAudioControlBackend::IDevice::Type::Sink:
+        function(m_sinks);
+        break;
+
+    case IAudioControlBackend::IDevice::Type::Source:
+        function(m_sources);
+        break;
+
+    case IAudioControlBackend::IDevice::Type::SinkInput:
+        function(m_sinkInputs);
+        break;
+
+    case IAudioControlBackend::IDevice::Type::SourceOutput:
+        function(m_sourceOutputs);
+        break;
+    }
+}
+
+void AudioControlBackend::setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume, ResultCallback onDone)
+{
+    cancelVolumeRamp(index, type);
+    sendDeviceVolume(index, type, volume, trackProfileChange(index, type, std::move(onDone)));
+}
+
+IAudioControlBackend::ResultCallback AudioControlBackend::trackProfileChange(Index index, IDevice::Type type, ResultCallback onDone)
+{
+    if (!m_profileStore || type != IDevice::Type::SinkInput)
+        return onDone;
+
+    return [this, index, onDone = std::move(onDone)](Result result)
+    {
+        if (result == Result::Ok)
+            m_changedProfiles.insert(index);
+
+        CompleteOperation(onDone, result);
+    };
+}
+
+void AudioControlBackend::sendDeviceVolume(Index index, IDevice::Type type, Volume volume, ResultCallback onDone)
+{
+    visitMap(type,
+             [index, volume, &onDone](auto& map)
+             {
+                 if (auto iterator = map.findByKey(index))
+                     map.update(*iterator,
+                                [volume, &onDone](auto& device)
+                                {
+                                    device.setVolume(volume, std::move(onDone));
+                                    return ChangeMask{}; // Notified once the server reports the change
+                                });
+                 else
+                 {
+                     Logger::error("AudioControlBackend::setDeviceVolume: no such a device with id: {}", index);
+                     CompleteOperation(onDone, Result::NoSuchDevice);
+                 }
+             });
+}
+
+void AudioControlBackend::adjustDeviceVolume(IDevice::IntexT index, IDevice::Type type, int delta, ResultCallback onDone)
+{
+    cancelVolumeRamp(index, type);
+    onDone = trackProfileChange(index, type, std::move(onDone));
+
+    const auto update = [index, delta, &onDone](auto& map)
+    {
+        if (auto iterator = map.findByKey(index))
+            map.update(*iterator,
+                       [delta, &onDone](auto& device)
+                       {
+                           device.adjustVolume(delta, std::move(onDone));
+                           return ChangeMask{};
+                       });
+        else
+        {
+            Logger::error("AudioControlBackend::adjustDeviceVolume: no such a device with id: {}", index);
+            CompleteOperation(onDone, Result::NoSuchDevice);
+        }
+    };
+
+    visitMap(type, update);
+}
+
+void AudioControlBackend::setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute, ResultCallback onDone)
+{
+    onDone = trackProfileChange(index, type, std::move(onDone));
+
+    const auto update = [index, mute, &onDone](auto& map)
+    {
+        if (auto iterator = map.findByKey(index))
+            map.update(*iterator,
+                       [mute, &onDone](auto& device)
+                       {
+                           device.setMuted(mute, std::move(onDone));
+                           return ChangeMask{};
+                       });
+        else
+        {
+            Logger::error("AudioControlBackend::setDeviceMute: no such a device with id: {}", index);
+            CompleteOperation(onDone, Result::NoSuchDevice);
+        }
+    };
+
+    visitMap(type, update);
+}
+
+void AudioControlBackend::rampDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume target, std::chrono::milliseconds duration,
+                                           ResultCallback onDone)
+{
+    std::optional<Volume> from;
+
+    visitMap(type,
+             [index, &from](auto& map)
+             {
+                 if (auto iterator = map.findByKey(index))
+                     from = iterator.value()->second->getVolume();
+             });
+
+    if (!from)
+    {
+        Logger::error("AudioControlBackend::rampDeviceVolume: no such a device with id: {}", index);
+        CompleteOperation(onDone, Result::NoSuchDevice);
+        return;
+    }
+
+    cancelVolumeRamp(index, type);
+    onDone = trackProfileChange(index, type, std::move(onDone)); // Once the ramp has ended
+
+    if (duration <= VolumeRampInterval || *from == target)
+    {
+        sendDeviceVolume(index, type, target, std::move(onDone));
+        return;
+    }
+
+    m_volumeRamps.push_back({.id = ++m_nextVolumeRampId,
+                             .index = index,
+                             .type = type,
+                             .from = *from,
+                             .target = target,
+                             .sent = *from,
+                             .startTime = std::chrono::steady_clock::now(),
+                             .duration = duration,
+                             .onDone = std::move(onDone)});
+
+    if (!m_volumeRampTimer.connected())
+        m_volumeRampTimer = m_mainContext->signal_timeout().connect(sigc::mem_fun(*this, &AudioControlBackend::stepVolumeRamps),
+                                                                    static_cast<unsigned>(VolumeRampInterval.count()));
+}
+
+std::optional<Volume> AudioControlBackend::getVolumeRampTarget(Index index, IDevice::Type type) const noexcept
+{
+    // A few ramps at most, and none most of the time
+    for (const VolumeRamp& ramp : m_volumeRamps)
+    {
+        if (ramp.index == index && ramp.type == type)
+            return ramp.target;
+    }
+
+    return std::nullopt;
+}
+
+void AudioControlBackend::cancelVolumeRamp(Index index, IDevice::Type type)
+{
+    const auto it = std::ranges::find_if(m_volumeRamps, [index, type](const VolumeRamp& ramp) { return ramp.index == index && ramp.type == type; });
+    if (it == m_volumeRamps.end())
+        return;
+
+    Logger::debug("AudioControlBackend::cancelVolumeRamp: the ramp of the device with id: {} is replaced", index);
+
+    // Even a finishing one: its last step won't find the ramp anymore, so it can't report it
+    CompleteOperation(it->onDone, Result::Failed);
+    m_volumeRamps.erase(it);
+}
+
+void AudioControlBackend::finishVolumeRamp(uint64_t id, Result result)
+{
+    const auto it = std::ranges::find(m_volumeRamps, id, &VolumeRamp::id);
+    if (it == m_volumeRamps.end())
+        return;
+
+    const VolumeRamp ramp = std::move(*it);
+    m_volumeRamps.erase(it);
+
+    // The server has reported the last step before confirming it, and the step didn't reach the target exactly, so has been
+    // marked as an intermediate one. The subscribers get the volume it has stopped at
+    visitMap(ramp.type,
+             [&ramp](auto& map)
+             {
+                 if (auto iterator = map.findByKey(ramp.index))
+                     map.update(*iterator,
+                                [&ramp](const auto& device) { return device.getVolume() == ramp.target ? ChangeMask{} : ChangeMask{DeviceField::Volume}; });
+             });
+
+    CompleteOperation(ramp.onDone, result);
+}
+
+bool AudioControlBackend::stepVolumeRamps()
+{
+    static Metrics::Counter& stepsCounter = Metrics::GetCounter("volume_ramp_steps_total");
+
+    struct Step
+    {
+        Index index;
+        IDevice::Type type;
+        Volume volume;
+        ResultCallback onDone;
+    };
+
+    const auto now = std::chrono::steady_clock::now();
+
+    // Sent once all the ramps are stepped: a failure to send is reported right away, and the last step removes its ramp then
+    std::vector<Step> steps;
+
+    for (VolumeRamp& ramp : m_volumeRamps)
+    {
+        if (ramp.isFinishing)
+            continue;
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - ramp.startTime);
+
+        if (elapsed >= ramp.duration)
+        {
+            ramp.isFinishing = true;
+            ramp.sent = ramp.target;
+
+            steps.push_back({ramp.index, ramp.type, ramp.target, [this, id = ramp.id](Result result) { finishVolumeRamp(id, result); }});
+            continue;
+        }
+
+        const int64_t from = ramp.from.getSteps();
+        const int64_t delta = (ramp.target.getSteps() - from) * elapsed.count() / ramp.duration.count();
+        const Volume volume = Volume::fromSteps(static_cast<uint64_t>(from + delta));
+
+        if (volume == ramp.sent)
+            continue;
+
+        ramp.sent = volume;
+        steps.push_back({ramp.index, ramp.type, volume, {}});
+    }
+
+    // The steps leave in the same main loop iteration, so the server gets them together
+    for (Step& step : steps)
+        sendDeviceVolume(step.index, step.type, step.volume, std::move(step.onDone));
+
+    stepsCounter.increment(steps.size());
+
+    return std::ranges::any_of(m_volumeRamps, [](const VolumeRamp& ramp) { return !ramp.isFinishing; });
+}
+
+void AudioControlBackend::makeDeviceDefault(IDevice::IntexT index, IDevice::Type type, ResultCallback onDone)
+{
+    const auto update = [index, &onDone](auto& map)
+    {
+        if (auto iterator = map.findByKey(index))
+            map.update(*iterator,
+                       [&onDone](auto& device)
+                       {
+                           device.setDefault(true, std::move(onDone));
+                           return ChangeMask{};
+                       });
+        else
+        {
+            Logger::error("AudioControlBackend::makeDeviceDefault: no such a device with id: {}", index);
+            CompleteOperation(onDone, Result::NoSuchDevice);
+        }
+    };
+
+    if (type != IAudioControlBackend::IDevice::Type::Sink && type != IAudioControlBackend::IDevice::Type::Source)
+    {
+        CompleteOperation(onDone, Result::InvalidArgument);
+        return;
+    }
+
+    visitMap(type, update);
+}
+
+void AudioControlBackend::setDevicesState(const std::vector<DeviceStateRequest>& requests, ResultsCallback onDone)
+{
+    RunBatch(requests, std::move(onDone), [this](const DeviceStateRequest& request, ResultCallback done) { setDeviceState(request, std::move(done)); });
+}
+
+void AudioControlBackend::moveDevice(IDevice::IntexT index, IDevice::Type type, IDevice::IntexT targetIndex, ResultCallback onDone)
+{
+    const auto move = [index, targetIndex, &onDone](auto& map, auto& targets)
+    {
+        auto iterator = map.findByKey(index);
+        if (!iterator || !targets.findByKey(targetIndex))
+        {
+            Logger::error("AudioControlBackend::moveDevice: no such a device with id: {} or target with id: {}", index, targetIndex);
+            CompleteOperation(onDone, Result::NoSuchDevice);
+            return;
+        }
+
+        // A server knows nothing about the devices of the others
+        if (GetDeviceIndexServer(index) != GetDeviceIndexServer(targetIndex))
+        {
+            Logger::error("AudioControlBackend::moveDevice: the device with id: {} and the target with id: {} are on different servers", index, targetIndex);
+            CompleteOperation(onDone, Result::InvalidArgument);
+            return;
+        }
+
+        // The device is updated when the server reports the move, so don't notify here
+        map.update(*iterator,
+                   [targetIndex, &onDone](auto& device)
+                   {
+                       device.moveTo(GetServerDeviceIndex(targetIndex), std::move(onDone));
+                       return ChangeMask{};
+                   });
+    };
+
+    try
+    {
+        switch (type)
+        {
+        case IAudioControlBackend::IDevice::Type::SinkInput:
+            move(m_sinkInputs, m_sinks);
+            return;
+
+        case IAudioControlBackend::IDevice::Type::SourceOutput:
+            move(m_sourceOutputs, m_sources);
+            return;
+
+        case IAudioControlBackend::IDevice::Type::Sink:
+        case IAudioControlBackend::IDevice::Type::Source:
+            break;
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        Logger::error("AudioControlBackend::moveDevice: {}", ex.what());
+        CompleteOperation(onDone, Result::Failed);
         return;
+    }
+
+    Logger::error("AudioControlBackend::moveDevice: only a SinkInput or a SourceOutput can be moved, id: {}", index);
+    CompleteOperation(onDone, Result::InvalidArgument);
+}
+
+void AudioControlBackend::moveDevices(const std::vector<DeviceMoveRequest>& requests, ResultsCallback onDone)
+{
+    RunBatch(requests, std::move(onDone),
+             [this](const DeviceMoveRequest& request, ResultCallback done) { moveDevice(request.index, request.type, request.targetIndex, std::move(done)); });
+}
 
-    Logger::debug("###############################################");
-    Logger::debug("Card. index: {}, name: {}", info->index, info->name);
+void AudioControlBackend::setDeviceState(const DeviceStateRequest& request, ResultCallback onDone)
+{
+    const size_t operations = (request.mute ? 1 : 0) + (request.volume ? 1 : 0);
 
-    for (size_t i = 0; i < info->n_ports; ++i)
-        Logger::info(ToString(*info->ports[i]));
+    if (operations == 0)
+    {
+        CompleteOperation(onDone, Result::Ok);
+        return;
+    }
 
-    Logger::debug("###############################################\n");
+    if (request.volume)
+        cancelVolumeRamp(request.index, request.type);
 
-    auto* self = static_cast<AudioControlBackend*>(data);
+    onDone = trackProfileChange(request.index, request.type, std::move(onDone));
 
-    const auto sinkPredicate = [&info](const ISink& sink)
+    const auto update = [&request, &onDone, operations](auto& map)
     {
-        return dynamic_cast<const Sink&>(sink).getCardIndex() == info->index;
+        auto iterator = map.findByKey(request.index);
+        if (!iterator)
+        {
+            CompleteOperation(onDone, Result::NoSuchDevice);
+            return;
+        }
+
+        const auto done = JoinResults(operations, std::move(onDone));
+
+        // Every operation completes exactly once, either with the server reply or with the failure to send it
+        const auto execute = [&done](auto&& operation)
+        {
+            try
+            {
+                operation();
+            }
+            catch (const std::exception& ex)
+            {
+                Logger::error("AudioControlBackend::setDeviceState: {}", ex.what());
+                done(Result::Failed);
+            }
+        };
+
+        // The devices are updated when the server reports the change, so don't notify here
+        map.update(*iterator,
+                   [&request, &done, &execute](auto& device)
+                   {
+                       if (request.mute)
+                           execute([&] { device.setMuted(*request.mute, done); });
+
+                       if (request.volume)
+                           execute([&] { device.setVolume(*request.volume, done); });
+
+                       return ChangeMask{};
+                   });
     };
 
-    for (auto it : self->m_sinks.findByPredicate(sinkPredicate))
-        self->m_sinks.update(it,
-                             [&info](ISink& sink)
-                             {
-                                 dynamic_cast<Sink&>(sink).update(*info);
-                                 return true;
-                             });
+    visitMap(request.type, update);
+}
+
+std::vector<IAudioControlBackend::IDevice::Ptr> AudioControlBackend::getAllDevices() const
+{
+    std::vector<IAudioControlBackend::IDevice::Ptr> result;
+    result.reserve(m_sinks.size() + m_sources.size() + m_sinkInputs.size() + m_sourceOutputs.size());
 
-    const auto sourcePredicate = [&info](const ISource& source)
+    const auto copyToResult = [&result](const auto& map)
     {
-        return dynamic_cast<const Source&>(source).getCardIndex() == info->index;
+        for (const auto& device : map.getValues())
+            result.push_back(device);
     };
 
-    for (auto it : self->m_sources.findByPredicate(sourcePredicate))
-        self->m_sources.update(it,
-                               [&info](ISource& source)
-                               {
-                                   dynamic_cast<Source&>(source).update(*info);
-                                   return true;
-                               });
+    copyToResult(m_sinks);
+    copyToResult(m_sources);
+    copyToResult(m_sinkInputs);
+    copyToResult(m_sourceOutputs);
+
+    return result;
 }
 
 } // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/Backends/PulseAudio/CardIndex.hpp>
+
+#include <GhafAudioControl/utils/Check.hpp>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+namespace
+{
+
+bool IsPortEnabled(const pa_card_port_info& port)
+{
+    switch (port.type)
+    {
+    case pa_device_port_type::PA_DEVICE_PORT_TYPE_HDMI:
+        return port.available == pa_port_available::PA_PORT_AVAILABLE_YES;
+
+    default:
+        return true;
+    }
+}
+
+} // namespace
+
+CardPorts::CardPorts(const pa_card_info& info)
+    : m_cardIndex(info.index)
+{
+    m_enabledByPortName.reserve(info.n_ports);
+    m_enabledByPortDescription.reserve(info.n_ports);
+
+    for (size_t i = 0; i < info.n_ports; ++i)
+    {
+        const pa_card_port_info& port = *info.ports[i];
+        const bool isEnabled = IsPortEnabled(port);
+
+        m_enabledByPortName.emplace(port.name, isEnabled);
+        m_enabledByPortDescription.emplace_back(port.description, isEnabled);
+    }
+}
+
+std::optional<bool> CardPorts::isPortEnabled(std::string_view portName) const
+{
+    if (const auto it = m_enabledByPortName.find(portName); it != m_enabledByPortName.end())
+        return it->second;
+
+    return std::nullopt;
+}
+
+std::optional<bool> CardPorts::isEnabledByDescription(std::string_view deviceDescription) const
+{
+    for (const auto& [description, isEnabled] : m_enabledByPortDescription)
+    {
+        if (deviceDescription.ends_with(description))
+            return isEnabled;
+    }
+
+    return std::nullopt;
+}
+
+void CardDeviceIndex::set(IAudioControlBackend::IDevice::Type type, Index device, uint32_t cardIndex)
+{
+    auto& cards = getCards(type);
+
+    if (const auto it = cards.find(device); it != cards.end())
+    {
+        if (it->second == cardIndex)
+            return;
+
+        remove(type, device);
+    }
+
+    if (cardIndex == PA_INVALID_INDEX)
+        return;
+
+    cards.emplace(device, cardIndex);
+    GetDevices(m_devicesByCard[cardIndex], type).push_back(device);
+}
+
+void CardDeviceIndex::remove(IAudioControlBackend::IDevice::Type type, Index device)
+{
+    auto& cards = getCards(type);
+
+    const auto cardIt = cards.find(device);
+    if (cardIt == cards.end())
+        return;
+
+    if (const auto devicesIt = m_devicesByCard.find(cardIt->second); devicesIt != m_devicesByCard.end())
+    {
+        std::erase(GetDevices(devicesIt->second, type), device);
+
+        if (devicesIt->second.sinks.empty() && devicesIt->second.sources.empty())
+            m_devicesByCard.erase(devicesIt);
+    }
+
+    cards.erase(cardIt);
+}
+
+const CardDeviceIndex::Devices* CardDeviceIndex::find(uint32_t cardIndex) const
+{
+    if (const auto it = m_devicesByCard.find(cardIndex); it != m_devicesByCard.end())
+        return &it->second;
+
+    return nullptr;
+}
+
+std::unordered_map<Index, uint32_t>& CardDeviceIndex::getCards(IAudioControlBackend::IDevice::Type type)
+{
+    Check(type == IAudioControlBackend::IDevice::Type::Sink || type == IAudioControlBackend::IDevice::Type::Source, "Only sinks and sources have a card");
+    return type == IAudioControlBackend::IDevice::Type::Sink ? m_sinkCards : m_sourceCards;
+}
+
+std::vector<Index>& CardDeviceIndex::GetDevices(Devices& devices, IAudioControlBackend::IDevice::Type type)
+{
+    return type == IAudioControlBackend::IDevice::Type::Sink ? devices.sinks : devices.sources;
+}
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
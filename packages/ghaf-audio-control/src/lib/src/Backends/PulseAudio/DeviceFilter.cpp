@@ -0,0 +1,195 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/Backends/PulseAudio/DeviceFilter.hpp>
+
+#include <GhafAudioControl/Backends/PulseAudio/GeneralDevice.hpp>
+
+#include <pulse/proplist.h>
+
+#include <format>
+#include <stdexcept>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+namespace
+{
+
+constexpr std::string_view PropertyFieldPrefix = "property.";
+
+[[nodiscard]] std::optional<DeviceFilter::Type> TypeFromString(std::string_view type)
+{
+    if (type == "sink")
+        return DeviceFilter::Type::Sink;
+
+    if (type == "source")
+        return DeviceFilter::Type::Source;
+
+    if (type == "sinkinput")
+        return DeviceFilter::Type::SinkInput;
+
+    if (type == "sourceoutput")
+        return DeviceFilter::Type::SourceOutput;
+
+    return std::nullopt;
+}
+
+} // namespace
+
+DevicePattern::DevicePattern(std::string_view pattern)
+{
+    size_t start = 0;
+
+    while (true)
+    {
+        const size_t star = pattern.find('*', start);
+        m_segments.emplace_back(pattern.substr(start, star == std::string_view::npos ? std::string_view::npos : star - start));
+
+        if (star == std::string_view::npos)
+            break;
+
+        m_hasStar = true;
+        start = star + 1;
+    }
+}
+
+bool DevicePattern::matches(std::string_view value) const noexcept
+{
+    if (!m_hasStar)
+        return value == m_segments.front();
+
+    // The first segment is a prefix and the last one is a suffix. The ones between are found in order, the leftmost match is as good as any
+    const std::string_view first = m_segments.front();
+    const std::string_view last = m_segments.back();
+
+    if (value.size() < first.size() + last.size() || !value.starts_with(first) || !value.ends_with(last))
+        return false;
+
+    std::string_view middle = value.substr(first.size(), value.size() - first.size() - last.size());
+
+    for (size_t i = 1; i + 1 < m_segments.size(); ++i)
+    {
+        const size_t position = middle.find(m_segments[i]);
+        if (position == std::string_view::npos)
+            return false;
+
+        middle.remove_prefix(position + m_segments[i].size());
+    }
+
+    return true;
+}
+
+DeviceFilter::Rule DeviceFilter::ParseRule(std::string_view rule)
+{
+    const size_t equals = rule.find('=');
+    if (equals == std::string_view::npos)
+        throw std::runtime_error(std::format("DeviceFilter: the rule has no '=': {}", rule));
+
+    std::string_view field = rule.substr(0, equals);
+    std::optional<Type> type;
+
+    if (const size_t colon = field.find(':'); colon != std::string_view::npos)
+    {
+        type = TypeFromString(field.substr(0, colon));
+        if (!type)
+            throw std::runtime_error(std::format("DeviceFilter: the rule has an unknown device type: {}", rule));
+
+        field.remove_prefix(colon + 1);
+    }
+
+    Rule result{.type = type, .field = Field::Name, .propertyKey = {}, .pattern = DevicePattern{rule.substr(equals + 1)}};
+
+    if (field == "name")
+        result.field = Field::Name;
+    else if (field == "description")
+        result.field = Field::Description;
+    else if (field == "appvm")
+        result.field = Field::AppVm;
+    else if (field.starts_with(PropertyFieldPrefix) && field.size() > PropertyFieldPrefix.size())
+    {
+        result.field = Field::Property;
+        result.propertyKey = field.substr(PropertyFieldPrefix.size());
+    }
+    else
+        throw std::runtime_error(std::format("DeviceFilter: the rule has an unknown field: {}", rule));
+
+    return result;
+}
+
+DeviceFilter DeviceFilter::CreateDefault()
+{
+    DeviceFilter filter;
+    filter.addRule(ParseRule("source:description=Monitor *"));
+
+    return filter;
+}
+
+void DeviceFilter::addRule(const Rule& rule)
+{
+    if (rule.type)
+    {
+        m_rulesByType[static_cast<size_t>(*rule.type)].push_back(rule);
+        return;
+    }
+
+    for (auto& rules : m_rulesByType)
+        rules.push_back(rule);
+}
+
+bool DeviceFilter::isIgnored(const pa_sink_info& info) const
+{
+    return isIgnored(Type::Sink, info.name, info.description, info.proplist);
+}
+
+bool DeviceFilter::isIgnored(const pa_source_info& info) const
+{
+    return isIgnored(Type::Source, info.name, info.description, info.proplist);
+}
+
+bool DeviceFilter::isIgnored(const pa_sink_input_info& info) const
+{
+    return isIgnored(Type::SinkInput, info.name, nullptr, info.proplist);
+}
+
+bool DeviceFilter::isIgnored(const pa_source_output_info& info) const
+{
+    return isIgnored(Type::SourceOutput, info.name, nullptr, info.proplist);
+}
+
+bool DeviceFilter::isIgnored(Type type, const char* name, const char* description, const pa_proplist* proplist) const
+{
+    for (const Rule& rule : m_rulesByType[static_cast<size_t>(type)])
+    {
+        const char* value = nullptr;
+
+        switch (rule.field)
+        {
+        case Field::Name:
+            value = name;
+            break;
+
+        case Field::Description:
+            value = description;
+            break;
+
+        case Field::AppVm:
+            value = GetAppVmNameProperty(proplist);
+            break;
+
+        case Field::Property:
+            value = pa_proplist_gets(proplist, rule.propertyKey.c_str());
+            break;
+        }
+
+        // A missing field matches nothing, not even "*"
+        if (value != nullptr && rule.pattern.matches(value))
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -7,224 +7,359 @@
 
 #include <GhafAudioControl/Backends/PulseAudio/Volume.hpp>
 
+#include <pulse/proplist.h>
+
 #include <format>
 
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-constexpr auto PropertyAppVmName = "application.process.host";
+namespace
+{
+
+// Compares the characters first, so an unchanged string is not looked up in the table
+void SetString(InternedString& target, const char* value)
+{
+    const std::string_view view = value == nullptr ? std::string_view{} : std::string_view{value};
+
+    if (target != view)
+        target = InternedString{view};
+}
+
+template<class InfoT>
+const char* GetActivePortName(const InfoT& info)
+{
+    if (info.active_port == nullptr)
+        return nullptr;
+
+    return info.active_port->name;
+}
+
+std::optional<InternedString> GetAppVmName(const pa_proplist* proplist)
+{
+    if (const char* appVmName = GetAppVmNameProperty(proplist))
+        return InternedString{appVmName};
+
+    return std::nullopt;
+}
+
+bool HasDecibelVolume(const pa_sink_info& info)
+{
+    return (info.flags & PA_SINK_DECIBEL_VOLUME) != 0;
+}
+
+bool HasDecibelVolume(const pa_source_info& info)
+{
+    return (info.flags & PA_SOURCE_DECIBEL_VOLUME) != 0;
+}
+
+void SetVolume(DeviceState& state, const pa_channel_map& channelMap, const pa_cvolume& volume, int mute, bool hasDecibelVolume)
+{
+    state.channelMap = channelMap;
+    state.pulseVolume = volume;
+    state.volumeCurve = GetDeviceVolumeCurve(hasDecibelVolume);
+    state.volume = FromPulseAudioVolume(pa_cvolume_max(&volume), state.volumeCurve);
+    state.isMuted = static_cast<bool>(mute);
+}
+
+// The volume derives from the pulse volume, so a change of the pulse volume alone is a change of the balance
+ChangeMask GetChanges(const DeviceState& first, const DeviceState& second)
+{
+    ChangeMask changes;
+
+    if (first.volume != second.volume)
+        changes |= DeviceField::Volume;
+
+    if (first.isMuted != second.isMuted)
+        changes |= DeviceField::Mute;
+
+    if (first.name != second.name || first.description != second.description || first.appVmName != second.appVmName)
+        changes |= DeviceField::Name;
+
+    if (first.isDefault != second.isDefault)
+        changes |= DeviceField::Default;
+
+    if (first.isEnabled != second.isEnabled)
+        changes |= DeviceField::Enabled;
+
+    if (pa_channel_map_equal(&first.channelMap, &second.channelMap) == 0 || pa_cvolume_equal(&first.pulseVolume, &second.pulseVolume) == 0)
+        changes |= DeviceField::ChannelMap;
+
+    if (first.metadata != second.metadata)
+        changes |= DeviceField::Metadata;
+
+    return changes;
+}
+
+bool IsSameState(const DeviceState& first, const DeviceState& second)
+{
+    return first.name == second.name && first.description == second.description && first.appVmName == second.appVmName && first.isMuted == second.isMuted &&
+           first.isDefault == second.isDefault && first.isEnabled == second.isEnabled && first.cardIndex == second.cardIndex &&
+           first.activePortName == second.activePortName && first.metadata == second.metadata && first.volumeCurve == second.volumeCurve &&
+           pa_channel_map_equal(&first.channelMap, &second.channelMap) != 0 && pa_cvolume_equal(&first.pulseVolume, &second.pulseVolume) != 0;
+}
+
+template<class InfoT>
+void SetHardwareDevice(DeviceState& state, const InfoT& info)
+{
+    state.cardIndex = info.card;
+    SetString(state.name, info.name);
+    SetString(state.description, info.description);
+    SetString(state.activePortName, GetActivePortName(info));
+
+    SetVolume(state, info.channel_map, info.volume, info.mute, HasDecibelVolume(info));
+}
+
+// The proplist is a hash table, so these are a few lookups. Only a changed value is interned again
+void SetMetadata(DeviceState::Metadata& metadata, const pa_proplist* proplist)
+{
+    SetString(metadata.applicationName, pa_proplist_gets(proplist, PA_PROP_APPLICATION_NAME));
+    SetString(metadata.iconName, pa_proplist_gets(proplist, PA_PROP_APPLICATION_ICON_NAME));
+    SetString(metadata.mediaRole, pa_proplist_gets(proplist, PA_PROP_MEDIA_ROLE));
+    SetString(metadata.processBinary, pa_proplist_gets(proplist, PA_PROP_APPLICATION_PROCESS_BINARY));
+}
+
+template<class InfoT>
+void SetStream(DeviceState& state, const InfoT& info)
+{
+    SetString(state.name, info.name);
+    SetMetadata(state.metadata, info.proplist);
+
+    // The streams are scaled in software, which is in dB
+    SetVolume(state, info.channel_map, info.volume, info.mute, true);
+}
+
+template<class InfoT>
+GeneralDeviceImpl::StatePtr MakeHardwareDeviceState(const InfoT& info, bool isDefault)
+{
+    auto state = std::make_shared<DeviceState>();
+    state->isDefault = isDefault;
+
+    SetHardwareDevice(*state, info);
+
+    return state;
+}
+
+template<class InfoT>
+GeneralDeviceImpl::StatePtr MakeStreamState(const InfoT& info, std::optional<InternedString> appVmName)
+{
+    auto state = std::make_shared<DeviceState>();
+    state->cardIndex = 0;
+    state->appVmName = std::move(appVmName);
+
+    SetStream(*state, info);
+
+    return state;
+}
+
+} // namespace
 
-GeneralDeviceImpl::GeneralDeviceImpl(const pa_sink_info& info, bool isDefault, pa_context& context)
+const char* GetAppVmNameProperty(const pa_proplist* proplist) noexcept
+{
+    return pa_proplist_gets(proplist, "application.process.host");
+}
+
+GeneralDeviceImpl::GeneralDeviceImpl(const pa_sink_info& info, bool isDefault, pa_context& context, uint32_t server)
     : m_index(info.index)
-    , m_cardIndex(info.card)
-    , m_isDefault(isDefault)
-    , m_name(info.name)
-    , m_description(info.description)
-    , m_context(context)
-    , m_channel_map(info.channel_map)
-    , m_volume(info.volume)
-    , m_isMuted(static_cast<bool>(info.mute))
+    , m_server(server)
+    , m_context(&context)
+    , m_state(MakeHardwareDeviceState(info, isDefault))
 {
 }
 
-GeneralDeviceImpl::GeneralDeviceImpl(const pa_source_info& info, bool isDefault, pa_context& context)
+GeneralDeviceImpl::GeneralDeviceImpl(const pa_source_info& info, bool isDefault, pa_context& context, uint32_t server)
     : m_index(info.index)
-    , m_cardIndex(info.card)
-    , m_isDefault(isDefault)
-    , m_name(info.name)
-    , m_description(info.description)
-    , m_context(context)
-    , m_channel_map(info.channel_map)
-    , m_volume(info.volume)
-    , m_isMuted(static_cast<bool>(info.mute))
+    , m_server(server)
+    , m_context(&context)
+    , m_state(MakeHardwareDeviceState(info, isDefault))
 {
 }
 
-GeneralDeviceImpl::GeneralDeviceImpl(const pa_sink_input_info& info, pa_context& context)
+GeneralDeviceImpl::GeneralDeviceImpl(const pa_sink_input_info& info, pa_context& context, uint32_t server)
     : m_index(info.index)
-    , m_cardIndex(0)
-    , m_appVmName(pa_proplist_gets(info.proplist, PropertyAppVmName))
-    , m_name(info.name)
-    , m_context(context)
-    , m_channel_map(info.channel_map)
-    , m_volume(info.volume)
-    , m_isMuted(static_cast<bool>(info.mute))
+    , m_server(server)
+    , m_context(&context)
+    , m_state(MakeStreamState(info, GetAppVmName(info.proplist)))
 {
 }
 
-GeneralDeviceImpl::GeneralDeviceImpl(const pa_source_output_info& info, pa_context& context)
+GeneralDeviceImpl::GeneralDeviceImpl(const pa_source_output_info& info, pa_context& context, uint32_t server)
     : m_index(info.index)
-    , m_cardIndex(0)
-    , m_name(info.name)
-    , m_context(context)
-    , m_channel_map(info.channel_map)
-    , m_volume(info.volume)
-    , m_isMuted(static_cast<bool>(info.mute))
+    , m_server(server)
+    , m_context(&context)
+    , m_state(MakeStreamState(info, GetAppVmName(info.proplist)))
 {
 }
 
+template<class ModifierT>
+ChangeMask GeneralDeviceImpl::publish(ModifierT&& modifier)
+{
+    const auto current = m_state.load();
+
+    // Modified on the stack: the strings are handles, so an update that changes nothing doesn't allocate
+    DeviceState state = *current;
+    modifier(state);
+
+    if (IsSameState(state, *current))
+        return {};
+
+    // The card and the port are kept for the updates of the enabled state, but nobody watches them
+    const ChangeMask changes = GetChanges(state, *current);
+
+    ++state.version;
+    m_state.store(std::make_shared<DeviceState>(std::move(state)));
+
+    return changes;
+}
+
 [[nodiscard]] uint32_t GeneralDeviceImpl::getCardIndex() const noexcept
 {
-    const std::lock_guard l{m_mutex};
-    return m_cardIndex;
+    return getState()->cardIndex;
 }
 
-void GeneralDeviceImpl::setDefault(bool value)
+ChangeMask GeneralDeviceImpl::setDefault(bool value)
 {
-    const std::lock_guard l{m_mutex};
-    m_isDefault = value;
+    return publish([value](DeviceState& state) { state.isDefault = value; });
 }
 
 bool GeneralDeviceImpl::isDefault() const noexcept
 {
-    const std::lock_guard l{m_mutex};
-    return m_isDefault;
+    return getState()->isDefault;
 }
 
 [[nodiscard]] bool GeneralDeviceImpl::isDeleted() const noexcept
 {
-    const std::lock_guard l{m_mutex};
     return m_isDeleted;
 }
 
 [[nodiscard]] bool GeneralDeviceImpl::isEnabled() const noexcept
 {
-    const std::lock_guard l{m_mutex};
-    return m_isEnabled;
+    return getState()->isEnabled;
 }
 
 [[nodiscard]] bool GeneralDeviceImpl::isMuted() const
 {
-    const std::lock_guard l{m_mutex};
-    return m_isMuted;
+    return getState()->isMuted;
 }
 
 [[nodiscard]] Volume GeneralDeviceImpl::getVolume() const
 {
-    return FromPulseAudioVolume(getPulseVolume());
+    return getState()->volume;
+}
+
+[[nodiscard]] ChannelVolume GeneralDeviceImpl::getChannelVolume() const
+{
+    const auto state = getState();
+    return FromPulseAudioChannelVolume(state->pulseVolume, state->channelMap, state->volumeCurve);
 }
 
 [[nodiscard]] pa_volume_t GeneralDeviceImpl::getPulseVolume() const
 {
-    const std::lock_guard l{m_mutex};
-    return m_volume.values[0];
+    return pa_cvolume_max(&getState()->pulseVolume);
 }
 
 [[nodiscard]] pa_cvolume GeneralDeviceImpl::getPulseChannelVolume() const noexcept
 {
-    const std::lock_guard l{m_mutex};
-    return m_volume;
+    return getState()->pulseVolume;
 }
 
-std::optional<std::string> GeneralDeviceImpl::getAppVmName() const noexcept
+[[nodiscard]] pa_cvolume GeneralDeviceImpl::makeScaledVolume(Volume volume) const noexcept
 {
-    const std::lock_guard l{m_mutex};
-    return m_appVmName;
+    const auto state = getState();
+    return ScalePulseAudioChannelVolume(state->pulseVolume, volume, state->volumeCurve);
 }
 
-[[nodiscard]] std::string GeneralDeviceImpl::getName() const
+[[nodiscard]] pa_cvolume GeneralDeviceImpl::makeAdjustedVolume(int delta) const noexcept
 {
-    const std::lock_guard l{m_mutex};
-    return m_name;
+    const auto state = getState();
+    return AdjustPulseAudioChannelVolume(state->pulseVolume, delta, state->volumeCurve);
 }
 
-[[nodiscard]] std::string GeneralDeviceImpl::getDescription() const
+[[nodiscard]] pa_cvolume GeneralDeviceImpl::makeBalancedVolume(float balance) const
 {
-    const std::lock_guard l{m_mutex};
-    return m_description;
+    const auto state = getState();
+    return BalancePulseAudioChannelVolume(state->pulseVolume, state->channelMap, balance);
 }
 
-void GeneralDeviceImpl::update(const pa_sink_info& info)
+[[nodiscard]] pa_cvolume GeneralDeviceImpl::makeChannelVolume(const ChannelVolume& volume) const
 {
-    const std::lock_guard l{m_mutex};
-
-    m_cardIndex = info.card;
-    m_name = info.name;
-    m_description = info.description;
-    m_channel_map = info.channel_map;
-    m_volume = info.volume;
-    m_isMuted = static_cast<bool>(info.mute);
+    const auto state = getState();
+    return ToPulseAudioChannelVolume(volume, state->channelMap, state->volumeCurve);
 }
 
-void GeneralDeviceImpl::update(const pa_source_info& info)
+std::optional<InternedString> GeneralDeviceImpl::getAppVmName() const noexcept
 {
-    const std::lock_guard l{m_mutex};
-
-    m_cardIndex = info.card;
-    m_name = info.name;
-    m_description = info.description;
-    m_channel_map = info.channel_map;
-    m_volume = info.volume;
-    m_isMuted = static_cast<bool>(info.mute);
+    return getState()->appVmName;
 }
 
-void GeneralDeviceImpl::update(const pa_sink_input_info& info)
+[[nodiscard]] InternedString GeneralDeviceImpl::getName() const noexcept
 {
-    const std::lock_guard l{m_mutex};
+    return getState()->name;
+}
 
-    m_name = info.name;
-    m_channel_map = info.channel_map;
-    m_volume = info.volume;
-    m_isMuted = static_cast<bool>(info.mute);
+[[nodiscard]] InternedString GeneralDeviceImpl::getDescription() const noexcept
+{
+    return getState()->description;
 }
 
-void GeneralDeviceImpl::update(const pa_source_output_info& info)
+ChangeMask GeneralDeviceImpl::update(const pa_sink_info& info)
 {
-    const std::lock_guard l{m_mutex};
+    return publish([&info](DeviceState& state) { SetHardwareDevice(state, info); });
+}
 
-    m_name = info.name;
-    m_channel_map = info.channel_map;
-    m_volume = info.volume;
-    m_isMuted = static_cast<bool>(info.mute);
+ChangeMask GeneralDeviceImpl::update(const pa_source_info& info)
+{
+    return publish([&info](DeviceState& state) { SetHardwareDevice(state, info); });
 }
 
-void GeneralDeviceImpl::update(const pa_card_info& info)
+ChangeMask GeneralDeviceImpl::update(const pa_sink_input_info& info)
 {
-    const std::lock_guard l{m_mutex};
+    return publish([&info](DeviceState& state) { SetStream(state, info); });
+}
 
-    m_isEnabled = false;
+ChangeMask GeneralDeviceImpl::update(const pa_source_output_info& info)
+{
+    return publish([&info](DeviceState& state) { SetStream(state, info); });
+}
 
-    if (m_cardIndex != info.index)
-        return;
+ChangeMask GeneralDeviceImpl::update(const CardPorts& ports)
+{
+    return publish(
+        [&ports](DeviceState& state)
+        {
+            state.isEnabled = false;
 
-    for (size_t i = 0; i < info.n_ports; ++i)
-    {
-        const pa_card_port_info& port = *info.ports[i];
+            if (state.cardIndex != ports.getCardIndex())
+                return;
 
-        if (m_description.ends_with(port.description))
-        {
-            switch (port.type)
+            if (!state.activePortName.empty())
             {
-            case pa_device_port_type::PA_DEVICE_PORT_TYPE_HDMI:
-                m_isEnabled = port.available == pa_port_available::PA_PORT_AVAILABLE_YES;
-                break;
-
-            default:
-                m_isEnabled = true;
-                break;
+                if (const auto isEnabled = ports.isPortEnabled(state.activePortName.str()))
+                {
+                    state.isEnabled = *isEnabled;
+                    return;
+                }
             }
 
-            break;
-        }
-    }
+            state.isEnabled = ports.isEnabledByDescription(state.description.str()).value_or(false);
+        });
 }
 
 void GeneralDeviceImpl::markDeleted()
 {
-    const std::lock_guard l{m_mutex};
     m_isDeleted = true;
 }
 
 [[nodiscard]] std::string GeneralDeviceImpl::toString() const
 {
-    const std::lock_guard l{m_mutex};
+    const auto state = getState();
     return std::format("index: {}, name: {}, volume: {}, isMuted: {}, cardId: {}, description: {}",
-                       m_index,
-                       m_name,
-                       m_volume.values[0],
-                       m_isMuted,
-                       m_cardIndex,
-                       m_description);
+                       getDeviceIndex(),
+                       state->name.str(),
+                       pa_cvolume_max(&state->pulseVolume),
+                       state->isMuted,
+                       state->cardIndex,
+                       state->description.str());
 }
 
 } // namespace ghaf::AudioControl::Backend::PulseAudio
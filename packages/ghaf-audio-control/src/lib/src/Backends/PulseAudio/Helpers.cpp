@@ -5,13 +5,111 @@
 
 #include <GhafAudioControl/Backends/PulseAudio/Helpers.hpp>
 
+#include <GhafAudioControl/utils/Metrics.hpp>
+
 #include <pulse/error.h>
+#include <pulse/operation.h>
 
+#include <chrono>
 #include <format>
+#include <memory>
 
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
+struct PendingOperation
+{
+    std::string_view name;
+    LatencyHistogram& latencyHistogram;
+    std::chrono::steady_clock::time_point startTime;
+    IAudioControlBackend::ResultCallback onDone;
+    IAudioControlBackend::Result result = IAudioControlBackend::Result::Failed;
+};
+
+namespace
+{
+
+void FinishPendingOperation(const PendingOperation& pending)
+{
+    // Called from the C code of the main loop, so nothing may escape
+    try
+    {
+        CompleteOperation(pending.onDone, pending.result);
+    }
+    catch (const std::exception& ex)
+    {
+        Logger::error("Pulseaudio operation {}: the completion callback failed: {}", pending.name, ex.what());
+    }
+}
+
+void OnPendingOperationState(pa_operation* operation, void* data)
+{
+    const auto state = pa_operation_get_state(operation);
+    if (state == PA_OPERATION_RUNNING)
+        return;
+
+    const std::unique_ptr<PendingOperation> pending{static_cast<PendingOperation*>(data)};
+
+    if (state == PA_OPERATION_DONE)
+    {
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pending->startTime);
+        pending->latencyHistogram.record(latency);
+
+        Logger::debug("Pulseaudio operation {} is done in {}", pending->name, latency);
+    }
+    else
+    {
+        Logger::error("Pulseaudio operation {} has been cancelled", pending->name);
+        pending->result = IAudioControlBackend::Result::Failed;
+    }
+
+    FinishPendingOperation(*pending);
+}
+
+} // namespace
+
+LatencyHistogram& CreateOperationLatencyHistogram(std::string_view name)
+{
+    return Metrics::GetHistogram(std::format("pulse_operation_duration_microseconds{{operation=\"{}\"}}", name));
+}
+
+PendingOperation* CreatePendingOperation(std::string_view name, LatencyHistogram& latencyHistogram, IAudioControlBackend::ResultCallback onDone)
+{
+    return new PendingOperation{.name = name, .latencyHistogram = latencyHistogram, .startTime = std::chrono::steady_clock::now(), .onDone = std::move(onDone)};
+}
+
+void OnPendingOperationSuccess(pa_context* context, int success, void* data)
+{
+    using Result = IAudioControlBackend::Result;
+
+    auto* pending = static_cast<PendingOperation*>(data);
+
+    if (success != 0)
+        pending->result = Result::Ok;
+    else
+        pending->result = pa_context_errno(context) == PA_ERR_NOENTITY ? Result::NoSuchDevice : Result::Failed;
+}
+
+void WatchPendingOperation(pa_operation* operation, PendingOperation* pending)
+{
+    if (operation == nullptr)
+    {
+        const std::unique_ptr<PendingOperation> owner{pending};
+
+        Logger::error("Pulseaudio function {} failed", owner->name);
+        FinishPendingOperation(*owner);
+
+        return;
+    }
+
+    Logger::debug("ExecutePulseOperation: {}", pending->name);
+
+    const OperationHandle owner{operation};
+
+    // The state callback fires right after the success one, and also when the context drops the operation
+    pa_operation_set_state_callback(owner.get(), &OnPendingOperationState, pending);
+}
+
 bool PulseCallbackCheck(const pa_context* context, int eol, std::string_view callbackName)
 {
     if (context == nullptr)
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/Backends/PulseAudio/PeakMeter.hpp>
+
+#include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
+
+#include <pulse/error.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <ranges>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+namespace
+{
+
+// Peaks per second the server sends for a stream. Enough for a meter, and cheap for the server
+constexpr uint32_t PeakRate = 25;
+
+// Smaller changes aren't visible on a meter, so they aren't sent
+constexpr float MinPeakChange = 0.01F;
+
+Metrics::Counter& StartedStreamsCounter = Metrics::GetCounter("peak_meter_streams_total{result=\"started\"}");
+Metrics::Counter& FailedStreamsCounter = Metrics::GetCounter("peak_meter_streams_total{result=\"failed\"}");
+Metrics::Counter& EmittedLevelsCounter = Metrics::GetCounter("peak_meter_levels_total{result=\"emitted\"}");
+Metrics::Counter& SkippedLevelsCounter = Metrics::GetCounter("peak_meter_levels_total{result=\"skipped\"}");
+
+} // namespace
+
+float ComputePeak(std::span<const float> samples) noexcept
+{
+    // Independent lanes, so the compiler keeps them in a vector register. A single running maximum is a dependency chain,
+    // which it doesn't vectorize without -ffast-math
+    constexpr size_t Lanes = 8;
+
+    std::array<float, Lanes> peaks{};
+    size_t i = 0;
+
+    for (; i + Lanes <= samples.size(); i += Lanes)
+    {
+        for (size_t lane = 0; lane < Lanes; ++lane)
+        {
+            const float value = std::fabs(samples[i + lane]);
+            peaks[lane] = peaks[lane] < value ? value : peaks[lane];
+        }
+    }
+
+    float peak = 0.0F;
+
+    for (const float lanePeak : peaks)
+        peak = std::max(peak, lanePeak);
+
+    for (; i < samples.size(); ++i)
+        peak = std::max(peak, std::fabs(samples[i]));
+
+    return std::min(peak, 1.0F);
+}
+
+struct PeakMeter::Meter
+{
+    Meter(PeakMeter& owner, Key key, pa_context& context, uint32_t sourceIndex, std::optional<uint32_t> sinkInputIndex)
+        : owner(owner)
+        , key(key)
+        , context(&context)
+        , sourceIndex(sourceIndex)
+        , sinkInputIndex(sinkInputIndex)
+    {
+    }
+
+    ~Meter()
+    {
+        if (stream == nullptr)
+            return;
+
+        pa_stream_set_read_callback(stream, nullptr, nullptr);
+        pa_stream_set_suspended_callback(stream, nullptr, nullptr);
+
+        std::ignore = pa_stream_disconnect(stream);
+        pa_stream_unref(stream);
+    }
+
+    Meter(const Meter&) = delete;
+    Meter& operator=(const Meter&) = delete;
+
+    [[nodiscard]] bool start()
+    {
+        const pa_sample_spec spec{.format = PA_SAMPLE_FLOAT32NE, .rate = PeakRate, .channels = 1};
+
+        // A fragment of a single sample, so every peak is delivered as soon as the server has it
+        constexpr auto Default = std::numeric_limits<uint32_t>::max();
+        const pa_buffer_attr attributes{.maxlength = Default, .tlength = Default, .prebuf = Default, .minreq = Default, .fragsize = sizeof(float)};
+
+        stream = pa_stream_new(context, "Peak meter", &spec, nullptr);
+        if (stream == nullptr)
+        {
+            Logger::error("PeakMeter: pa_stream_new() failed: {}", pa_strerror(pa_context_errno(context)));
+            return false;
+        }
+
+        if (sinkInputIndex && pa_stream_set_monitor_stream(stream, *sinkInputIndex) < 0)
+        {
+            Logger::error("PeakMeter: pa_stream_set_monitor_stream() failed: {}", pa_strerror(pa_context_errno(context)));
+            return false;
+        }
+
+        pa_stream_set_read_callback(stream, &PeakMeter::readCallback, this);
+        pa_stream_set_suspended_callback(stream, &PeakMeter::suspendedCallback, this);
+
+        // The meter follows the device, and doesn't keep an idle sink awake
+        const auto flags = static_cast<pa_stream_flags_t>(PA_STREAM_DONT_MOVE | PA_STREAM_PEAK_DETECT | PA_STREAM_ADJUST_LATENCY |
+                                                          PA_STREAM_DONT_INHIBIT_AUTO_SUSPEND);
+
+        if (pa_stream_connect_record(stream, std::to_string(sourceIndex).c_str(), &attributes, flags) < 0)
+        {
+            Logger::error("PeakMeter: pa_stream_connect_record() failed: {}", pa_strerror(pa_context_errno(context)));
+            return false;
+        }
+
+        return true;
+    }
+
+    void onPeak(float peak)
+    {
+        pending = std::max(pending, peak);
+        owner.scheduleFlush();
+    }
+
+    PeakMeter& owner;
+    const Key key;
+    pa_context* const context;
+    const uint32_t sourceIndex;
+    const std::optional<uint32_t> sinkInputIndex;
+
+    pa_stream* stream = nullptr;
+
+    float pending = -1.0F; // The loudest since the last flush, negative if nothing has come
+    float reported = 0.0F;
+};
+
+PeakMeter::PeakMeter(Glib::RefPtr<Glib::MainContext> mainContext)
+    : m_mainContext(std::move(mainContext))
+{
+}
+
+PeakMeter::~PeakMeter()
+{
+    m_flushTimer.disconnect();
+}
+
+bool PeakMeter::watch(pa_context& context, Key key, uint32_t sourceIndex, std::optional<uint32_t> sinkInputIndex)
+{
+    if (const auto iter = m_meters.find(key); iter != m_meters.end())
+    {
+        const auto& meter = *iter->second;
+
+        if (meter.context == &context && meter.sourceIndex == sourceIndex && meter.sinkInputIndex == sinkInputIndex)
+            return false;
+
+        m_meters.erase(iter);
+    }
+
+    auto meter = std::make_unique<Meter>(*this, key, context, sourceIndex, sinkInputIndex);
+
+    if (!meter->start())
+    {
+        FailedStreamsCounter.increment();
+        return false;
+    }
+
+    StartedStreamsCounter.increment();
+    Logger::debug("PeakMeter: watching the device with index: {} on the source: {}", key.second, sourceIndex);
+
+    m_meters.emplace(key, std::move(meter));
+    return true;
+}
+
+void PeakMeter::unwatch(const Key& key)
+{
+    m_meters.erase(key);
+}
+
+void PeakMeter::unwatchAll(const pa_context& context)
+{
+    std::erase_if(m_meters, [&context](const auto& item) { return item.second->context == &context; });
+}
+
+void PeakMeter::unwatchAll()
+{
+    m_meters.clear();
+    m_flushTimer.disconnect();
+}
+
+void PeakMeter::readCallback(pa_stream* stream, [[maybe_unused]] size_t length, void* data)
+{
+    auto& meter = *static_cast<Meter*>(data);
+
+    while (true)
+    {
+        const void* samples = nullptr;
+        size_t size = 0;
+
+        if (pa_stream_peek(stream, &samples, &size) < 0)
+        {
+            Logger::error("PeakMeter: pa_stream_peek() failed: {}", pa_strerror(pa_context_errno(meter.context)));
+            return;
+        }
+
+        if (size == 0)
+            return;
+
+        // A hole in the buffer has no data, but still has to be dropped
+        if (samples != nullptr)
+            meter.onPeak(ComputePeak({static_cast<const float*>(samples), size / sizeof(float)}));
+
+        std::ignore = pa_stream_drop(stream);
+    }
+}
+
+void PeakMeter::suspendedCallback(pa_stream* stream, void* data)
+{
+    // A suspended source sends nothing, so its meter would freeze on the last level
+    if (pa_stream_is_suspended(stream) <= 0)
+        return;
+
+    auto& meter = *static_cast<Meter*>(data);
+
+    meter.pending = 0.0F;
+    meter.owner.scheduleFlush();
+}
+
+void PeakMeter::scheduleFlush()
+{
+    if (m_flushTimer.connected())
+        return;
+
+    m_flushTimer = m_mainContext->signal_timeout().connect(
+        [this]
+        {
+            m_flushTimer = {};
+            flush();
+
+            return false;
+        },
+        static_cast<unsigned int>(FlushInterval.count()));
+}
+
+void PeakMeter::flush()
+{
+    std::vector<IAudioControlBackend::PeakLevel> levels;
+
+    for (const auto& meter : m_meters | std::views::values)
+    {
+        if (meter->pending < 0.0F)
+            continue;
+
+        const float peak = std::exchange(meter->pending, -1.0F);
+
+        // Silence is always sent, so a meter doesn't stay a bit above zero
+        if (std::abs(peak - meter->reported) < MinPeakChange && (peak != 0.0F || meter->reported == 0.0F))
+        {
+            SkippedLevelsCounter.increment();
+            continue;
+        }
+
+        meter->reported = peak;
+        levels.push_back({.index = meter->key.second, .type = meter->key.first, .peak = peak});
+    }
+
+    if (levels.empty())
+        return;
+
+    EmittedLevelsCounter.increment(levels.size());
+    m_onPeaks(levels);
+}
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/Backends/PulseAudio/ProfileStore.hpp>
+
+#include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
+#include <GhafAudioControl/utils/ScopeExit.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> Magic = {'G', 'A', 'C', 'P', 'R', 'O', 'F', 'S'};
+constexpr uint32_t FormatVersion = 1;
+
+struct FileHeader
+{
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t capacity;
+};
+
+Metrics::Counter& HitLookupsCounter = Metrics::GetCounter("profile_store_lookups_total{result=\"hit\"}");
+Metrics::Counter& MissedLookupsCounter = Metrics::GetCounter("profile_store_lookups_total{result=\"miss\"}");
+Metrics::Counter& SavedProfilesCounter = Metrics::GetCounter("profile_store_saves_total{result=\"saved\"}");
+Metrics::Counter& RejectedProfilesCounter = Metrics::GetCounter("profile_store_saves_total{result=\"rejected\"}");
+
+// FNV-1a, with a separator so the names can't run into each other. Zero marks an empty slot
+[[nodiscard]] uint64_t HashKey(std::string_view appVmName, std::string_view streamName) noexcept
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    const auto add = [&hash](char value)
+    {
+        hash ^= static_cast<unsigned char>(value);
+        hash *= 1099511628211ULL;
+    };
+
+    for (const char value : appVmName)
+        add(value);
+
+    add('\0');
+
+    for (const char value : streamName)
+        add(value);
+
+    return hash == 0 ? 1 : hash;
+}
+
+} // namespace
+
+struct ProfileStore::Slot
+{
+    static constexpr size_t MaxNamesSize = 240;
+
+    uint64_t hash; // Written last, so a slot is either empty or complete
+    uint32_t volume;
+    uint8_t isMuted;
+    uint8_t appVmNameSize;
+    uint8_t streamNameSize;
+    uint8_t reserved;
+    std::array<char, MaxNamesSize> names; // The AppVM name followed by the stream name
+
+    [[nodiscard]] bool hasKey(std::string_view appVmName, std::string_view streamName) const noexcept
+    {
+        return appVmNameSize == appVmName.size() && streamNameSize == streamName.size() &&
+               std::string_view{names.data(), appVmNameSize} == appVmName &&
+               std::string_view{names.data() + appVmNameSize, streamNameSize} == streamName;
+    }
+};
+
+ProfileStore::ProfileStore(const std::string& path)
+{
+    static_assert(sizeof(Slot) == 256);
+    static_assert(std::is_trivially_copyable_v<FileHeader> && std::is_trivially_copyable_v<Slot>);
+
+    const int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (file < 0)
+        throw std::runtime_error(std::format("ProfileStore: couldn't open the file: {}: {}", path, std::strerror(errno)));
+
+    const ScopeExit closeFile{[file] { ::close(file); }};
+
+    struct stat status{};
+    if (::fstat(file, &status) != 0)
+        throw std::runtime_error(std::format("ProfileStore: couldn't stat the file: {}: {}", path, std::strerror(errno)));
+
+    const FileHeader expectedHeader{.magic = Magic, .version = FormatVersion, .capacity = Capacity};
+    const size_t size = sizeof(FileHeader) + Capacity * sizeof(Slot);
+
+    FileHeader header{};
+    const bool isValid = static_cast<size_t>(status.st_size) == size && ::pread(file, &header, sizeof(header), 0) == sizeof(header) &&
+                         header.magic == Magic && header.version == FormatVersion && header.capacity == Capacity;
+
+    if (!isValid)
+    {
+        if (status.st_size != 0)
+            Logger::error("ProfileStore: the file has another format or version, starting it anew: {}", path);
+
+        // Truncated first, so the table is all zeros, i.e. empty
+        if (::ftruncate(file, 0) != 0 || ::ftruncate(file, static_cast<off_t>(size)) != 0 ||
+            ::pwrite(file, &expectedHeader, sizeof(expectedHeader), 0) != sizeof(expectedHeader))
+            throw std::runtime_error(std::format("ProfileStore: couldn't initialize the file: {}: {}", path, std::strerror(errno)));
+    }
+
+    void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::format("ProfileStore: couldn't map the file: {}: {}", path, std::strerror(errno)));
+
+    m_mapping = {static_cast<std::byte*>(mapping), size};
+    m_slots = {reinterpret_cast<Slot*>(m_mapping.data() + sizeof(FileHeader)), Capacity};
+
+    Logger::info("ProfileStore: using the file: {}", path);
+}
+
+ProfileStore::~ProfileStore()
+{
+    ::munmap(m_mapping.data(), m_mapping.size());
+}
+
+std::optional<ProfileStore::Profile> ProfileStore::find(std::string_view appVmName, std::string_view streamName) const noexcept
+{
+    const Slot* slot = findSlot(appVmName, streamName, false);
+
+    if (slot == nullptr)
+    {
+        MissedLookupsCounter.increment();
+        return std::nullopt;
+    }
+
+    HitLookupsCounter.increment();
+    return Profile{.volume = slot->volume, .isMuted = slot->isMuted != 0};
+}
+
+bool ProfileStore::save(std::string_view appVmName, std::string_view streamName, Profile profile) noexcept
+{
+    Slot* slot = appVmName.size() + streamName.size() <= Slot::MaxNamesSize ? findSlot(appVmName, streamName, true) : nullptr;
+
+    if (slot == nullptr)
+    {
+        RejectedProfilesCounter.increment();
+        Logger::debug("ProfileStore: no place for the stream: {} of the AppVM: {}", streamName, appVmName);
+
+        return false;
+    }
+
+    slot->volume = profile.volume;
+    slot->isMuted = profile.isMuted ? 1 : 0;
+
+    if (slot->hash == 0)
+    {
+        slot->appVmNameSize = static_cast<uint8_t>(appVmName.size());
+        slot->streamNameSize = static_cast<uint8_t>(streamName.size());
+
+        std::memcpy(slot->names.data(), appVmName.data(), appVmName.size());
+        std::memcpy(slot->names.data() + appVmName.size(), streamName.data(), streamName.size());
+
+        slot->hash = HashKey(appVmName, streamName);
+    }
+
+    SavedProfilesCounter.increment();
+    return true;
+}
+
+ProfileStore::Slot* ProfileStore::findSlot(std::string_view appVmName, std::string_view streamName, bool forInsert) const noexcept
+{
+    const uint64_t hash = HashKey(appVmName, streamName);
+
+    // Linear probing. Nothing is removed, so the first empty slot ends the chain
+    for (size_t i = 0; i < Capacity; ++i)
+    {
+        Slot& slot = m_slots[(hash + i) % Capacity];
+
+        if (slot.hash == 0)
+            return forInsert ? &slot : nullptr;
+
+        if (slot.hash == hash && slot.hasKey(appVmName, streamName))
+            return &slot;
+    }
+
+    return nullptr;
+}
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
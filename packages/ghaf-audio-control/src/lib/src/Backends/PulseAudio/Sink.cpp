@@ -13,33 +13,40 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-Sink::Sink(const pa_sink_info& info, bool isDefault, pa_context& context)
-    : m_device(info, isDefault, context)
+Sink::Sink(const pa_sink_info& info, bool isDefault, pa_context& context, uint32_t server)
+    : m_device(info, isDefault, context, server)
 {
 }
 
 bool Sink::operator==(const IDevice& other) const
 {
-    if (const Sink* otherSink = dynamic_cast<const Sink*>(&other))
-        return m_device == otherSink->m_device;
-
-    return false;
+    return other.getType() == Type::Sink && other.getIndex() == getIndex();
 }
 
-void Sink::setMuted(bool mute)
+void Sink::setMuted(bool mute, ResultCallback onDone)
 {
     deleteCheck();
-    ExecutePulseFunc(pa_context_set_sink_mute_by_index, &m_device.getContext(), m_device.getIndex(), mute, nullptr, nullptr);
+    ExecutePulseOperation(std::move(onDone), pa_context_set_sink_mute_by_index, &m_device.getContext(), m_device.getIndex(), mute);
 }
 
-void Sink::setVolume(Volume volume)
+void Sink::setVolume(Volume volume, ResultCallback onDone)
 {
-    deleteCheck();
+    setPulseVolume(m_device.makeScaledVolume(volume), std::move(onDone));
+}
 
-    pa_cvolume paChannelVolume;
-    std::ignore = pa_cvolume_set(&paChannelVolume, m_device.getPulseChannelVolume().channels, ToPulseAudioVolume(volume));
+void Sink::setChannelVolume(const ChannelVolume& volume, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeChannelVolume(volume), std::move(onDone));
+}
 
-    ExecutePulseFunc(pa_context_set_sink_volume_by_index, &m_device.getContext(), m_device.getIndex(), &paChannelVolume, nullptr, nullptr);
+void Sink::setBalance(float balance, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeBalancedVolume(balance), std::move(onDone));
+}
+
+void Sink::adjustVolume(int delta, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeAdjustedVolume(delta), std::move(onDone));
 }
 
 std::string Sink::toString() const
@@ -53,14 +60,17 @@ void Sink::markDeleted()
     m_onDelete();
 }
 
-void Sink::setDefault(bool value)
+void Sink::setDefault(bool value, ResultCallback onDone)
 {
     deleteCheck();
 
     if (m_device.isDefault() == value)
+    {
+        CompleteOperation(onDone, Result::Ok);
         return;
+    }
 
-    ExecutePulseFunc(pa_context_set_default_sink, &m_device.getContext(), m_device.getName().c_str(), nullptr, nullptr);
+    ExecutePulseOperation(std::move(onDone), pa_context_set_default_sink, &m_device.getContext(), m_device.getName().c_str());
 }
 
 void Sink::deleteCheck()
@@ -69,24 +79,38 @@ void Sink::deleteCheck()
         throw std::logic_error{std::format("Using deleted device: {}", toString())};
 }
 
+void Sink::setPulseVolume(const pa_cvolume& volume, ResultCallback onDone)
+{
+    deleteCheck();
+    ExecutePulseOperation(std::move(onDone), pa_context_set_sink_volume_by_index, &m_device.getContext(), m_device.getIndex(), &volume);
+}
+
 void Sink::updateDefault(bool value)
 {
     if (m_device.isDefault() == value)
         return;
 
-    m_device.setDefault(value);
-    m_onUpdate();
+    if (const ChangeMask changes = m_device.setDefault(value))
+        m_onUpdate(changes);
 }
 
-void Sink::update(const pa_sink_info& info)
+ChangeMask Sink::update(const pa_sink_info& info)
 {
-    m_device.update(info);
-    m_onUpdate();
+    const ChangeMask changes = m_device.update(info);
+
+    if (changes)
+        m_onUpdate(changes);
+
+    return changes;
 }
 
-void Sink::update(const pa_card_info& info)
+ChangeMask Sink::update(const CardPorts& ports)
 {
-    m_device.update(info);
-    m_onUpdate();
+    const ChangeMask changes = m_device.update(ports);
+
+    if (changes)
+        m_onUpdate(changes);
+
+    return changes;
 }
 } // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -13,33 +13,46 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-SinkInput::SinkInput(const pa_sink_input_info& info, pa_context& context)
-    : m_device(info, context)
+SinkInput::SinkInput(const pa_sink_input_info& info, pa_context& context, uint32_t server)
+    : m_device(info, context, server)
 {
 }
 
 bool SinkInput::operator==(const IDevice& other) const
 {
-    if (const auto* otherSink = dynamic_cast<const SinkInput*>(&other))
-        return m_device == otherSink->m_device;
-
-    return false;
+    return other.getType() == Type::SinkInput && other.getIndex() == getIndex();
 }
 
-void SinkInput::setMuted(bool mute)
+void SinkInput::setMuted(bool mute, ResultCallback onDone)
 {
     deleteCheck();
-    ExecutePulseFunc(pa_context_set_sink_input_mute, &m_device.getContext(), m_device.getIndex(), mute, nullptr, nullptr);
+    ExecutePulseOperation(std::move(onDone), pa_context_set_sink_input_mute, &m_device.getContext(), m_device.getIndex(), mute);
 }
 
-void SinkInput::setVolume(Volume volume)
+void SinkInput::setVolume(Volume volume, ResultCallback onDone)
 {
-    deleteCheck();
+    setPulseVolume(m_device.makeScaledVolume(volume), std::move(onDone));
+}
+
+void SinkInput::setChannelVolume(const ChannelVolume& volume, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeChannelVolume(volume), std::move(onDone));
+}
 
-    pa_cvolume paChannelVolume;
-    std::ignore = pa_cvolume_set(&paChannelVolume, m_device.getPulseChannelVolume().channels, ToPulseAudioVolume(volume));
+void SinkInput::setBalance(float balance, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeBalancedVolume(balance), std::move(onDone));
+}
 
-    ExecutePulseFunc(pa_context_set_sink_input_volume, &m_device.getContext(), m_device.getIndex(), &paChannelVolume, nullptr, nullptr);
+void SinkInput::adjustVolume(int delta, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeAdjustedVolume(delta), std::move(onDone));
+}
+
+void SinkInput::moveTo(uint32_t sinkIndex, ResultCallback onDone)
+{
+    deleteCheck();
+    ExecutePulseOperation(std::move(onDone), pa_context_move_sink_input_by_index, &m_device.getContext(), m_device.getIndex(), sinkIndex);
 }
 
 std::string SinkInput::toString() const
@@ -47,10 +60,14 @@ std::string SinkInput::toString() const
     return std::format("PulseSinkInput: [ {} ]", m_device.toString());
 }
 
-void SinkInput::update(const pa_sink_input_info& info)
+ChangeMask SinkInput::update(const pa_sink_input_info& info)
 {
-    m_device.update(info);
-    m_onUpdate();
+    const ChangeMask changes = m_device.update(info);
+
+    if (changes)
+        m_onUpdate(changes);
+
+    return changes;
 }
 
 void SinkInput::markDeleted()
@@ -65,4 +82,10 @@ void SinkInput::deleteCheck()
         throw std::logic_error{std::format("Using deleted device: {}", toString())};
 }
 
+void SinkInput::setPulseVolume(const pa_cvolume& volume, ResultCallback onDone)
+{
+    deleteCheck();
+    ExecutePulseOperation(std::move(onDone), pa_context_set_sink_input_volume, &m_device.getContext(), m_device.getIndex(), &volume);
+}
+
 } // namespace ghaf::AudioControl::Backend::PulseAudio
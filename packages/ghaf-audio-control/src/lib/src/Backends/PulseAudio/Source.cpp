@@ -13,33 +13,40 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-Source::Source(const pa_source_info& info, bool isDefault, pa_context& context)
-    : m_device(info, isDefault, context)
+Source::Source(const pa_source_info& info, bool isDefault, pa_context& context, uint32_t server)
+    : m_device(info, isDefault, context, server)
 {
 }
 
 bool Source::operator==(const IDevice& other) const
 {
-    if (const auto* otherSource = dynamic_cast<const Source*>(&other))
-        return m_device == otherSource->m_device;
-
-    return false;
+    return other.getType() == Type::Source && other.getIndex() == getIndex();
 }
 
-void Source::setMuted(bool mute)
+void Source::setMuted(bool mute, ResultCallback onDone)
 {
     deleteCheck();
-    ExecutePulseFunc(pa_context_set_source_mute_by_index, &m_device.getContext(), m_device.getIndex(), mute, nullptr, nullptr);
+    ExecutePulseOperation(std::move(onDone), pa_context_set_source_mute_by_index, &m_device.getContext(), m_device.getIndex(), mute);
 }
 
-void Source::setVolume(Volume volume)
+void Source::setVolume(Volume volume, ResultCallback onDone)
 {
-    deleteCheck();
+    setPulseVolume(m_device.makeScaledVolume(volume), std::move(onDone));
+}
 
-    pa_cvolume paChannelVolume;
-    std::ignore = pa_cvolume_set(&paChannelVolume, m_device.getPulseChannelVolume().channels, ToPulseAudioVolume(volume));
+void Source::setChannelVolume(const ChannelVolume& volume, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeChannelVolume(volume), std::move(onDone));
+}
 
-    ExecutePulseFunc(pa_context_set_source_volume_by_index, &m_device.getContext(), m_device.getIndex(), &paChannelVolume, nullptr, nullptr);
+void Source::setBalance(float balance, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeBalancedVolume(balance), std::move(onDone));
+}
+
+void Source::adjustVolume(int delta, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeAdjustedVolume(delta), std::move(onDone));
 }
 
 std::string Source::toString() const
@@ -53,12 +60,15 @@ void Source::markDeleted()
     m_onDelete();
 }
 
-void Source::setDefault(bool value)
+void Source::setDefault(bool value, ResultCallback onDone)
 {
     if (m_device.isDefault() == value)
+    {
+        CompleteOperation(onDone, Result::Ok);
         return;
+    }
 
-    ExecutePulseFunc(pa_context_set_default_source, &m_device.getContext(), m_device.getName().c_str(), nullptr, nullptr);
+    ExecutePulseOperation(std::move(onDone), pa_context_set_default_source, &m_device.getContext(), m_device.getName().c_str());
 }
 
 bool Source::isDefault() const
@@ -72,6 +82,12 @@ void Source::deleteCheck()
         throw std::logic_error{std::format("Using deleted device: {}", toString())};
 }
 
+void Source::setPulseVolume(const pa_cvolume& volume, ResultCallback onDone)
+{
+    deleteCheck();
+    ExecutePulseOperation(std::move(onDone), pa_context_set_source_volume_by_index, &m_device.getContext(), m_device.getIndex(), &volume);
+}
+
 uint32_t Source::getCardIndex() const
 {
     return m_device.getCardIndex();
@@ -82,20 +98,28 @@ void Source::updateDefault(bool value)
     if (m_device.isDefault() == value)
         return;
 
-    m_device.setDefault(value);
-    m_onUpdate();
+    if (const ChangeMask changes = m_device.setDefault(value))
+        m_onUpdate(changes);
 }
 
-void Source::update(const pa_source_info& info)
+ChangeMask Source::update(const pa_source_info& info)
 {
-    m_device.update(info);
-    m_onUpdate();
+    const ChangeMask changes = m_device.update(info);
+
+    if (changes)
+        m_onUpdate(changes);
+
+    return changes;
 }
 
-void Source::update(const pa_card_info& info)
+ChangeMask Source::update(const CardPorts& ports)
 {
-    m_device.update(info);
-    m_onUpdate();
+    const ChangeMask changes = m_device.update(ports);
+
+    if (changes)
+        m_onUpdate(changes);
+
+    return changes;
 }
 
 } // namespace ghaf::AudioControl::Backend::PulseAudio
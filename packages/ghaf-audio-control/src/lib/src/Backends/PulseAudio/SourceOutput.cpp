@@ -13,33 +13,46 @@
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-SourceOutput::SourceOutput(const pa_source_output_info& info, pa_context& context)
-    : m_device(info, context)
+SourceOutput::SourceOutput(const pa_source_output_info& info, pa_context& context, uint32_t server)
+    : m_device(info, context, server)
 {
 }
 
 bool SourceOutput::operator==(const IDevice& other) const
 {
-    if (const auto* otherSource = dynamic_cast<const SourceOutput*>(&other))
-        return m_device == otherSource->m_device;
-
-    return false;
+    return other.getType() == Type::SourceOutput && other.getIndex() == getIndex();
 }
 
-void SourceOutput::setMuted(bool mute)
+void SourceOutput::setMuted(bool mute, ResultCallback onDone)
 {
     deleteCheck();
-    ExecutePulseFunc(pa_context_set_source_output_mute, &m_device.getContext(), m_device.getIndex(), mute, nullptr, nullptr);
+    ExecutePulseOperation(std::move(onDone), pa_context_set_source_output_mute, &m_device.getContext(), m_device.getIndex(), mute);
 }
 
-void SourceOutput::setVolume(Volume volume)
+void SourceOutput::setVolume(Volume volume, ResultCallback onDone)
 {
-    deleteCheck();
+    setPulseVolume(m_device.makeScaledVolume(volume), std::move(onDone));
+}
 
-    pa_cvolume paChannelVolume;
-    std::ignore = pa_cvolume_set(&paChannelVolume, m_device.getPulseChannelVolume().channels, ToPulseAudioVolume(volume));
+void SourceOutput::setChannelVolume(const ChannelVolume& volume, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeChannelVolume(volume), std::move(onDone));
+}
 
-    ExecutePulseFunc(pa_context_set_source_output_volume, &m_device.getContext(), m_device.getIndex(), &paChannelVolume, nullptr, nullptr);
+void SourceOutput::setBalance(float balance, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeBalancedVolume(balance), std::move(onDone));
+}
+
+void SourceOutput::adjustVolume(int delta, ResultCallback onDone)
+{
+    setPulseVolume(m_device.makeAdjustedVolume(delta), std::move(onDone));
+}
+
+void SourceOutput::moveTo(uint32_t sourceIndex, ResultCallback onDone)
+{
+    deleteCheck();
+    ExecutePulseOperation(std::move(onDone), pa_context_move_source_output_by_index, &m_device.getContext(), m_device.getIndex(), sourceIndex);
 }
 
 std::string SourceOutput::toString() const
@@ -59,4 +72,10 @@ void SourceOutput::deleteCheck()
         throw std::logic_error{std::format("Using deleted device: {}", toString())};
 }
 
+void SourceOutput::setPulseVolume(const pa_cvolume& volume, ResultCallback onDone)
+{
+    deleteCheck();
+    ExecutePulseOperation(std::move(onDone), pa_context_set_source_output_volume, &m_device.getContext(), m_device.getIndex(), &volume);
+}
+
 } // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -0,0 +1,519 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/Backends/PulseAudio/Trace.hpp>
+
+#include <GhafAudioControl/utils/ScopeExit.hpp>
+#include <GhafAudioControl/utils/UniqueHandle.hpp>
+
+#include <pulse/proplist.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace ghaf::AudioControl::Backend::PulseAudio
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> Magic = {'G', 'A', 'C', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t FormatVersion = 1;
+
+struct FileHeader
+{
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t reserved;
+    int64_t startTimeNs; // system_clock
+};
+
+struct RecordHeader
+{
+    uint32_t payloadSize;
+    uint16_t kind;
+    uint16_t server; // Zero in the traces of the single server backends, so they keep the version
+    int64_t timestampNs; // Since the start of the recording
+};
+
+static_assert(std::is_trivially_copyable_v<FileHeader> && std::is_trivially_copyable_v<RecordHeader>);
+
+template<class T>
+void Put(std::string& out, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void PutString(std::string& out, const char* value)
+{
+    const std::string_view view = value == nullptr ? "" : value;
+
+    Put(out, static_cast<uint32_t>(view.size()));
+    out.append(view);
+}
+
+void PutVolume(std::string& out, const pa_channel_map& channelMap, const pa_cvolume& volume, int mute)
+{
+    // Only the used channels, not the whole fixed size arrays
+    Put(out, channelMap.channels);
+    for (uint8_t i = 0; i < channelMap.channels && i < PA_CHANNELS_MAX; ++i)
+        Put(out, static_cast<int8_t>(channelMap.map[i]));
+
+    Put(out, volume.channels);
+    for (uint8_t i = 0; i < volume.channels && i < PA_CHANNELS_MAX; ++i)
+        Put(out, volume.values[i]);
+
+    Put(out, static_cast<uint8_t>(mute != 0));
+}
+
+// Only the string properties, the ones the backend reads
+void PutProplist(std::string& out, const pa_proplist* proplist)
+{
+    const size_t countOffset = out.size();
+    uint32_t count = 0;
+
+    Put(out, count);
+
+    void* state = nullptr;
+    while (proplist != nullptr)
+    {
+        const char* key = pa_proplist_iterate(proplist, &state);
+        if (key == nullptr)
+            break;
+
+        if (const char* value = pa_proplist_gets(proplist, key))
+        {
+            PutString(out, key);
+            PutString(out, value);
+            ++count;
+        }
+    }
+
+    std::memcpy(out.data() + countOffset, &count, sizeof(count));
+}
+
+template<class InfoT>
+void PutHardwareDevice(std::string& out, const InfoT& info)
+{
+    Put(out, info.index);
+    Put(out, info.card);
+    PutString(out, info.name);
+    PutString(out, info.description);
+    PutString(out, info.active_port == nullptr ? nullptr : info.active_port->name);
+    PutVolume(out, info.channel_map, info.volume, info.mute);
+}
+
+template<class InfoT>
+void PutStream(std::string& out, const InfoT& info)
+{
+    Put(out, info.index);
+    PutString(out, info.name);
+    PutVolume(out, info.channel_map, info.volume, info.mute);
+    PutProplist(out, info.proplist);
+}
+
+class Cursor final
+{
+public:
+    explicit Cursor(std::span<const std::byte> data)
+        : m_data(data)
+    {
+    }
+
+    template<class T>
+    [[nodiscard]] T get()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        check(sizeof(T));
+
+        T value;
+        std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+
+        return value;
+    }
+
+    [[nodiscard]] std::string getString()
+    {
+        const auto size = get<uint32_t>();
+        check(size);
+
+        std::string value(reinterpret_cast<const char*>(m_data.data() + m_offset), size);
+        m_offset += size;
+
+        return value;
+    }
+
+    void getVolume(pa_channel_map& channelMap, pa_cvolume& volume, int& mute)
+    {
+        channelMap.channels = getChannels();
+        for (uint8_t i = 0; i < channelMap.channels; ++i)
+            channelMap.map[i] = static_cast<pa_channel_position_t>(get<int8_t>());
+
+        volume.channels = getChannels();
+        for (uint8_t i = 0; i < volume.channels; ++i)
+            volume.values[i] = get<pa_volume_t>();
+
+        mute = get<uint8_t>();
+    }
+
+    void getProplist(pa_proplist& proplist)
+    {
+        for (auto count = get<uint32_t>(); count > 0; --count)
+        {
+            const auto key = getString();
+            const auto value = getString();
+
+            std::ignore = pa_proplist_sets(&proplist, key.c_str(), value.c_str());
+        }
+    }
+
+private:
+    [[nodiscard]] uint8_t getChannels()
+    {
+        const auto channels = get<uint8_t>();
+        if (channels > PA_CHANNELS_MAX)
+            throw std::runtime_error(std::format("TraceReader: invalid number of channels: {}", channels));
+
+        return channels;
+    }
+
+    void check(size_t size) const
+    {
+        if (m_data.size() - m_offset < size)
+            throw std::runtime_error("TraceReader: the record payload is truncated");
+    }
+
+private:
+    std::span<const std::byte> m_data;
+    size_t m_offset = 0;
+};
+
+template<class InfoT, class PortT, class Fx>
+void GetHardwareDevice(Cursor& cursor, Fx&& fx)
+{
+    InfoT info{};
+    info.index = cursor.get<uint32_t>();
+    info.card = cursor.get<uint32_t>();
+
+    const auto name = cursor.getString();
+    const auto description = cursor.getString();
+    const auto activePortName = cursor.getString();
+
+    cursor.getVolume(info.channel_map, info.volume, info.mute);
+
+    PortT activePort{};
+    activePort.name = activePortName.c_str();
+
+    info.name = name.c_str();
+    info.description = description.c_str();
+    info.active_port = activePortName.empty() ? nullptr : &activePort;
+
+    fx(info);
+}
+
+template<class InfoT, class Fx>
+void GetStream(Cursor& cursor, Fx&& fx)
+{
+    InfoT info{};
+    info.index = cursor.get<uint32_t>();
+
+    const auto name = cursor.getString();
+    cursor.getVolume(info.channel_map, info.volume, info.mute);
+
+    const UniqueHandle<pa_proplist, FunctionDeleter<pa_proplist_free>> proplist{pa_proplist_new()};
+    cursor.getProplist(*proplist);
+
+    info.name = name.c_str();
+    info.proplist = proplist.get();
+
+    fx(info);
+}
+
+void GetCard(Cursor& cursor, ITraceHandler& handler)
+{
+    pa_card_info info{};
+    info.index = cursor.get<uint32_t>();
+
+    const auto name = cursor.getString();
+    const auto portCount = cursor.get<uint32_t>();
+
+    struct PortStrings
+    {
+        std::string name;
+        std::string description;
+    };
+
+    // All the strings are read first, so the pointers taken below stay valid
+    std::vector<PortStrings> strings;
+    std::vector<pa_card_port_info> ports;
+
+    for (uint32_t i = 0; i < portCount; ++i)
+    {
+        auto portName = cursor.getString();
+        auto portDescription = cursor.getString();
+        strings.push_back({.name = std::move(portName), .description = std::move(portDescription)});
+
+        pa_card_port_info& port = ports.emplace_back();
+        port.type = cursor.get<uint32_t>();
+        port.available = cursor.get<int32_t>();
+    }
+
+    std::vector<pa_card_port_info*> portPointers;
+    portPointers.reserve(ports.size());
+
+    for (size_t i = 0; i < ports.size(); ++i)
+    {
+        ports[i].name = strings[i].name.c_str();
+        ports[i].description = strings[i].description.c_str();
+        portPointers.push_back(&ports[i]);
+    }
+
+    info.name = name.c_str();
+    info.n_ports = portCount;
+    info.ports = portPointers.data();
+
+    handler.onCardInfo(info);
+}
+
+} // namespace
+
+TraceRecorder::TraceRecorder(const std::string& path)
+    : m_file(path, std::ios::binary | std::ios::trunc)
+    , m_startTime(std::chrono::steady_clock::now())
+{
+    if (!m_file)
+        throw std::runtime_error(std::format("TraceRecorder: couldn't open the file: {}", path));
+
+    const auto startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch());
+    const FileHeader header{.magic = Magic, .version = FormatVersion, .reserved = 0, .startTimeNs = startTime.count()};
+
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    m_file.flush();
+}
+
+void TraceRecorder::record(uint16_t server, pa_subscription_event_type_t type, uint32_t index)
+{
+    m_payload.clear();
+
+    Put(m_payload, static_cast<uint32_t>(type));
+    Put(m_payload, index);
+
+    write(server, TraceRecordKind::SubscriptionEvent);
+}
+
+void TraceRecorder::record(uint16_t server, const pa_server_info& info)
+{
+    m_payload.clear();
+
+    PutString(m_payload, info.default_sink_name);
+    PutString(m_payload, info.default_source_name);
+
+    write(server, TraceRecordKind::ServerInfo);
+}
+
+void TraceRecorder::record(uint16_t server, const pa_sink_info& info)
+{
+    m_payload.clear();
+    PutHardwareDevice(m_payload, info);
+    write(server, TraceRecordKind::SinkInfo);
+}
+
+void TraceRecorder::record(uint16_t server, const pa_source_info& info)
+{
+    m_payload.clear();
+    PutHardwareDevice(m_payload, info);
+    write(server, TraceRecordKind::SourceInfo);
+}
+
+void TraceRecorder::record(uint16_t server, const pa_sink_input_info& info)
+{
+    m_payload.clear();
+    PutStream(m_payload, info);
+    write(server, TraceRecordKind::SinkInputInfo);
+}
+
+void TraceRecorder::record(uint16_t server, const pa_source_output_info& info)
+{
+    m_payload.clear();
+    PutStream(m_payload, info);
+    write(server, TraceRecordKind::SourceOutputInfo);
+}
+
+void TraceRecorder::record(uint16_t server, const pa_card_info& info)
+{
+    m_payload.clear();
+
+    Put(m_payload, info.index);
+    PutString(m_payload, info.name);
+    Put(m_payload, info.n_ports);
+
+    for (uint32_t i = 0; i < info.n_ports; ++i)
+    {
+        const pa_card_port_info& port = *info.ports[i];
+
+        PutString(m_payload, port.name);
+        PutString(m_payload, port.description);
+        Put(m_payload, static_cast<uint32_t>(port.type));
+        Put(m_payload, static_cast<int32_t>(port.available));
+    }
+
+    write(server, TraceRecordKind::CardInfo);
+}
+
+void TraceRecorder::recordListEnd(uint16_t server)
+{
+    m_payload.clear();
+    write(server, TraceRecordKind::ListEnd);
+}
+
+void TraceRecorder::write(uint16_t server, TraceRecordKind kind)
+{
+    const auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime);
+    const RecordHeader header{.payloadSize = static_cast<uint32_t>(m_payload.size()),
+                              .kind = static_cast<uint16_t>(kind),
+                              .server = server,
+                              .timestampNs = timestamp.count()};
+
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.write(m_payload.data(), static_cast<std::streamsize>(m_payload.size()));
+}
+
+TraceReader::TraceReader(const std::string& path)
+{
+    const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        throw std::runtime_error(std::format("TraceReader: couldn't open the file: {}: {}", path, std::strerror(errno)));
+
+    const ScopeExit closeFile{[file] { ::close(file); }};
+
+    struct stat status{};
+    if (::fstat(file, &status) != 0)
+        throw std::runtime_error(std::format("TraceReader: couldn't stat the file: {}: {}", path, std::strerror(errno)));
+
+    const auto size = static_cast<size_t>(status.st_size);
+    if (size < sizeof(FileHeader))
+        throw std::runtime_error(std::format("TraceReader: the file is not a trace: {}", path));
+
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::format("TraceReader: couldn't map the file: {}: {}", path, std::strerror(errno)));
+
+    FileHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+
+    if (header.magic != Magic || header.version != FormatVersion)
+    {
+        ::munmap(mapping, size);
+        throw std::runtime_error(std::format("TraceReader: the file is not a trace or has an unsupported version: {}", path));
+    }
+
+    m_data = {static_cast<const std::byte*>(mapping), size};
+    m_offset = sizeof(FileHeader);
+    m_startTime = std::chrono::system_clock::time_point{std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds{header.startTimeNs})};
+}
+
+TraceReader::~TraceReader()
+{
+    ::munmap(const_cast<std::byte*>(m_data.data()), m_data.size());
+}
+
+std::optional<TraceReader::Record> TraceReader::next()
+{
+    if (m_data.size() - m_offset < sizeof(RecordHeader))
+        return std::nullopt;
+
+    RecordHeader header;
+    std::memcpy(&header, m_data.data() + m_offset, sizeof(header));
+
+    const size_t payloadOffset = m_offset + sizeof(RecordHeader);
+    if (m_data.size() - payloadOffset < header.payloadSize)
+        return std::nullopt;
+
+    m_offset = payloadOffset + header.payloadSize;
+
+    return Record{.kind = static_cast<TraceRecordKind>(header.kind),
+                  .server = header.server,
+                  .timestamp = std::chrono::nanoseconds{header.timestampNs},
+                  .payload = m_data.subspan(payloadOffset, header.payloadSize)};
+}
+
+void TraceReader::rewind() noexcept
+{
+    m_offset = sizeof(FileHeader);
+}
+
+void TraceReader::Dispatch(const Record& record, ITraceHandler& handler)
+{
+    Cursor cursor{record.payload};
+
+    switch (record.kind)
+    {
+    case TraceRecordKind::SubscriptionEvent:
+    {
+        const auto type = static_cast<pa_subscription_event_type_t>(cursor.get<uint32_t>());
+        handler.onSubscriptionEvent(type, cursor.get<uint32_t>());
+        break;
+    }
+
+    case TraceRecordKind::ServerInfo:
+    {
+        const auto defaultSinkName = cursor.getString();
+        const auto defaultSourceName = cursor.getString();
+
+        pa_server_info info{};
+        info.default_sink_name = defaultSinkName.c_str();
+        info.default_source_name = defaultSourceName.c_str();
+
+        handler.onServerInfo(info);
+        break;
+    }
+
+    case TraceRecordKind::SinkInfo:
+        GetHardwareDevice<pa_sink_info, pa_sink_port_info>(cursor, [&handler](const pa_sink_info& info) { handler.onSinkInfo(info); });
+        break;
+
+    case TraceRecordKind::SourceInfo:
+        GetHardwareDevice<pa_source_info, pa_source_port_info>(cursor, [&handler](const pa_source_info& info) { handler.onSourceInfo(info); });
+        break;
+
+    case TraceRecordKind::SinkInputInfo:
+        GetStream<pa_sink_input_info>(cursor, [&handler](const pa_sink_input_info& info) { handler.onSinkInputInfo(info); });
+        break;
+
+    case TraceRecordKind::SourceOutputInfo:
+        GetStream<pa_source_output_info>(cursor, [&handler](const pa_source_output_info& info) { handler.onSourceOutputInfo(info); });
+        break;
+
+    case TraceRecordKind::CardInfo:
+        GetCard(cursor, handler);
+        break;
+
+    case TraceRecordKind::ListEnd:
+        handler.onListEnd();
+        break;
+
+    default:
+        throw std::runtime_error(std::format("TraceReader: unknown record kind: {}", static_cast<int>(record.kind)));
+    }
+}
+
+} // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -5,20 +5,265 @@
 
 #include <GhafAudioControl/Backends/PulseAudio/Volume.hpp>
 
-#include <cmath>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <stdexcept>
 
 namespace ghaf::AudioControl::Backend::PulseAudio
 {
 
-pa_volume_t ToPulseAudioVolume(Volume volume) noexcept
+namespace
 {
-    const double coeff = volume.getPercents() / static_cast<double>(Volume::Max);
-    return PA_VOLUME_NORM * coeff;
+
+ChannelVolume::Position FromPulseAudioPosition(pa_channel_position_t position) noexcept
+{
+    switch (position)
+    {
+    case PA_CHANNEL_POSITION_MONO:
+        return ChannelVolume::Position::Mono;
+
+    case PA_CHANNEL_POSITION_FRONT_LEFT:
+    case PA_CHANNEL_POSITION_REAR_LEFT:
+    case PA_CHANNEL_POSITION_SIDE_LEFT:
+    case PA_CHANNEL_POSITION_FRONT_LEFT_OF_CENTER:
+    case PA_CHANNEL_POSITION_TOP_FRONT_LEFT:
+    case PA_CHANNEL_POSITION_TOP_REAR_LEFT:
+        return ChannelVolume::Position::Left;
+
+    case PA_CHANNEL_POSITION_FRONT_RIGHT:
+    case PA_CHANNEL_POSITION_REAR_RIGHT:
+    case PA_CHANNEL_POSITION_SIDE_RIGHT:
+    case PA_CHANNEL_POSITION_FRONT_RIGHT_OF_CENTER:
+    case PA_CHANNEL_POSITION_TOP_FRONT_RIGHT:
+    case PA_CHANNEL_POSITION_TOP_REAR_RIGHT:
+        return ChannelVolume::Position::Right;
+
+    case PA_CHANNEL_POSITION_FRONT_CENTER:
+    case PA_CHANNEL_POSITION_REAR_CENTER:
+    case PA_CHANNEL_POSITION_TOP_CENTER:
+    case PA_CHANNEL_POSITION_TOP_FRONT_CENTER:
+    case PA_CHANNEL_POSITION_TOP_REAR_CENTER:
+        return ChannelVolume::Position::Center;
+
+    default:
+        return ChannelVolume::Position::Other;
+    }
+}
+
+// The <cmath> functions are not constexpr yet. The tables need a few digits only, in the ranges of the curves
+[[nodiscard]] constexpr double ConstexprCbrt(double value) noexcept
+{
+    if (value <= 0.0)
+        return 0.0;
+
+    double result = value < 1.0 ? 1.0 : value;
+
+    for (int i = 0; i < 64; ++i)
+        result -= (result * result * result - value) / (3.0 * result * result);
+
+    return result;
+}
+
+// For the exponents of [-1, 0]: the series converges well before the last term
+[[nodiscard]] constexpr double ConstexprExp10(double exponent) noexcept
+{
+    constexpr double Ln10 = 2.302585092994046;
+
+    const double power = exponent * Ln10;
+
+    double result = 1.0;
+    double term = 1.0;
+
+    for (int i = 1; i < 40; ++i)
+    {
+        term *= power / i;
+        result += term;
+    }
+
+    return result;
+}
+
+using CurveTable = std::array<pa_volume_t, Volume::Max + 1>;
+
+// The volume of the server of each percent, rounded as pa_sw_volume_from_linear() does
+template<class CurveT>
+[[nodiscard]] constexpr CurveTable MakeCurveTable(CurveT curve) noexcept
+{
+    CurveTable table{};
+
+    for (size_t percents = 0; percents < table.size(); ++percents)
+        table[percents] = static_cast<pa_volume_t>(PA_VOLUME_NORM * curve(static_cast<double>(percents) / Volume::Max) + 0.5);
+
+    return table;
+}
+
+// FromPulseAudioVolume() searches the table, so every percent has to be louder than the previous one
+[[nodiscard]] constexpr bool IsIncreasing(const CurveTable& table) noexcept
+{
+    return std::ranges::adjacent_find(table, std::ranges::greater_equal{}) == table.end();
+}
+
+constexpr CurveTable LinearCurveTable = MakeCurveTable([](double level) { return level; });
+
+constexpr CurveTable CubicCurveTable = MakeCurveTable([](double level) { return ConstexprCbrt(level); });
+
+// pa_sw_volume_from_dB() is the cube root of the amplitude: PA_VOLUME_NORM * 10^(dB / 60)
+constexpr CurveTable DecibelCurveTable =
+    MakeCurveTable([](double level) { return level == 0.0 ? 0.0 : ConstexprExp10((level - 1.0) * DecibelCurveRange / 60.0); });
+
+static_assert(IsIncreasing(LinearCurveTable) && IsIncreasing(CubicCurveTable) && IsIncreasing(DecibelCurveTable));
+static_assert(LinearCurveTable.back() == PA_VOLUME_NORM && CubicCurveTable.back() == PA_VOLUME_NORM && DecibelCurveTable.back() == PA_VOLUME_NORM);
+
+const CurveTable& GetCurveTable(VolumeCurve curve) noexcept
+{
+    switch (curve)
+    {
+    case VolumeCurve::Cubic:
+        return CubicCurveTable;
+    case VolumeCurve::Decibel:
+        return DecibelCurveTable;
+
+    case VolumeCurve::Linear:
+    default:
+        return LinearCurveTable;
+    }
+}
+
+std::atomic<VolumeCurve> SelectedVolumeCurve{VolumeCurve::Linear};
+
+} // namespace
+
+std::optional<VolumeCurve> VolumeCurveFromString(std::string_view value) noexcept
+{
+    if (value == "linear")
+        return VolumeCurve::Linear;
+
+    if (value == "cubic")
+        return VolumeCurve::Cubic;
+
+    if (value == "db")
+        return VolumeCurve::Decibel;
+
+    return std::nullopt;
+}
+
+void SetVolumeCurve(VolumeCurve curve) noexcept
+{
+    SelectedVolumeCurve.store(curve, std::memory_order_relaxed);
+}
+
+VolumeCurve GetVolumeCurve() noexcept
+{
+    return SelectedVolumeCurve.load(std::memory_order_relaxed);
+}
+
+VolumeCurve GetDeviceVolumeCurve(bool hasDecibelVolume) noexcept
+{
+    return hasDecibelVolume ? GetVolumeCurve() : VolumeCurve::Linear;
 }
 
-Volume FromPulseAudioVolume(pa_volume_t pulseVolume) noexcept(false)
+pa_volume_t ToPulseAudioVolume(Volume volume, VolumeCurve curve) noexcept
 {
-    return Volume::fromPercents(std::round((pulseVolume * Volume::Max) / (double)PA_VOLUME_NORM));
+    const CurveTable& table = GetCurveTable(curve);
+
+    const unsigned percents = volume.getSteps() / Volume::StepsPerPercent;
+    const unsigned fraction = volume.getSteps() % Volume::StepsPerPercent;
+
+    if (fraction == 0)
+        return table[percents];
+
+    const uint64_t span = table[percents + 1] - table[percents];
+    return table[percents] + static_cast<pa_volume_t>((span * fraction + Volume::StepsPerPercent / 2) / Volume::StepsPerPercent);
+}
+
+Volume FromPulseAudioVolume(pa_volume_t pulseVolume, VolumeCurve curve) noexcept
+{
+    const CurveTable& table = GetCurveTable(curve);
+
+    if (pulseVolume >= table.back())
+        return Volume::fromSteps(Volume::MaxSteps);
+
+    // The first entry is 0, so the upper one is never the first
+    const auto upper = std::ranges::upper_bound(table, pulseVolume);
+    const auto lower = std::prev(upper);
+
+    const auto percents = static_cast<unsigned>(lower - table.begin());
+    const uint64_t span = *upper - *lower;
+    const uint64_t fraction = ((pulseVolume - *lower) * uint64_t{Volume::StepsPerPercent} + span / 2) / span;
+
+    return Volume::fromSteps(percents * Volume::StepsPerPercent + static_cast<unsigned>(fraction));
+}
+
+ChannelVolume FromPulseAudioChannelVolume(const pa_cvolume& volume, const pa_channel_map& channelMap, VolumeCurve curve)
+{
+    ChannelVolume::Channels channels;
+    channels.reserve(volume.channels);
+
+    for (uint8_t channel = 0; channel < volume.channels; ++channel)
+    {
+        const auto position = channel < channelMap.channels ? FromPulseAudioPosition(channelMap.map[channel]) : ChannelVolume::Position::Other;
+        channels.push_back({position, FromPulseAudioVolume(volume.values[channel], curve)});
+    }
+
+    return {std::move(channels), pa_cvolume_get_balance(&volume, &channelMap)};
+}
+
+pa_cvolume ToPulseAudioChannelVolume(const ChannelVolume& volume, const pa_channel_map& channelMap, VolumeCurve curve) noexcept(false)
+{
+    const auto& channels = volume.getChannels();
+
+    pa_cvolume result;
+
+    if (channels.size() == 1)
+    {
+        std::ignore = pa_cvolume_set(&result, channelMap.channels, ToPulseAudioVolume(channels.front().volume, curve));
+        return result;
+    }
+
+    if (channels.size() != channelMap.channels)
+        throw std::invalid_argument{std::format("Wrong number of channels: {}, expected: {}", channels.size(), channelMap.channels)};
+
+    pa_cvolume_init(&result);
+    result.channels = channelMap.channels;
+
+    for (uint8_t channel = 0; channel < result.channels; ++channel)
+        result.values[channel] = ToPulseAudioVolume(channels[channel].volume, curve);
+
+    return result;
+}
+
+pa_cvolume ScalePulseAudioChannelVolume(pa_cvolume volume, Volume max, VolumeCurve curve) noexcept
+{
+    // pa_cvolume_scale sets all the channels to the max if the volume is muted, so there is no balance to keep
+    std::ignore = pa_cvolume_scale(&volume, ToPulseAudioVolume(max, curve));
+    return volume;
+}
+
+pa_cvolume AdjustPulseAudioChannelVolume(pa_cvolume volume, int delta, VolumeCurve curve) noexcept
+{
+    if (delta == 0)
+        return volume;
+
+    // A step of the curve is not the same volume of the server at the different levels, so the step is made in the percents
+    const int current = FromPulseAudioVolume(pa_cvolume_max(&volume), curve).getSteps();
+    const int steps = std::clamp(current + delta * Volume::StepsPerPercent, 0, static_cast<int>(Volume::MaxSteps));
+
+    return ScalePulseAudioChannelVolume(volume, Volume::fromSteps(static_cast<unsigned>(steps)), curve);
+}
+
+pa_cvolume BalancePulseAudioChannelVolume(pa_cvolume volume, const pa_channel_map& channelMap, float balance) noexcept(false)
+{
+    if (pa_channel_map_can_balance(&channelMap) == 0)
+        throw std::invalid_argument{"The channel map doesn't support the balance"};
+
+    if (pa_cvolume_set_balance(&volume, &channelMap, std::clamp(balance, -1.0F, 1.0F)) == nullptr)
+        throw std::invalid_argument{std::format("Couldn't set the balance: {}", balance)};
+
+    return volume;
 }
 
 } // namespace ghaf::AudioControl::Backend::PulseAudio
@@ -0,0 +1,525 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/Backends/ThreadedAudioControlBackend.hpp>
+
+#include <GhafAudioControl/utils/Debug.hpp>
+#include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
+#include <GhafAudioControl/utils/SpscQueue.hpp>
+
+#include <glib.h>
+
+#include <atomic>
+
+namespace ghaf::AudioControl::Backend
+{
+
+namespace
+{
+
+constexpr size_t QueueCapacity = 4096;
+
+// Delivered to the UI per main loop iteration. The rest waits for the next one, so a storm doesn't hold the rendering back
+constexpr size_t DrainBatchLimit = 64;
+
+// Below the GTK redraw priority
+constexpr int DrainPriority = G_PRIORITY_DEFAULT_IDLE;
+
+Metrics::Counter& DeliveredCounter = Metrics::GetCounter("backend_thread_events_total{result=\"delivered\"}");
+Metrics::Counter& QueueFullCounter = Metrics::GetCounter("backend_thread_events_total{result=\"queue_full\"}");
+
+} // namespace
+
+class ThreadedAudioControlBackend::Bridge final : public std::enable_shared_from_this<Bridge>
+{
+public:
+    explicit Bridge(Glib::RefPtr<Glib::MainContext> backendContext)
+        : m_backendContext(std::move(backendContext))
+    {
+    }
+
+    // Any thread but the backend one, usually the UI thread
+    void runOnBackend(std::function<void()> function)
+    {
+        if (m_isClosed)
+        {
+            Logger::error("ThreadedAudioControlBackend: the backend is stopped, the call is dropped");
+            return;
+        }
+
+        m_backendContext->invoke(
+            [function = std::move(function)]
+            {
+                try
+                {
+                    function();
+                }
+                catch (const std::exception& ex)
+                {
+                    Logger::error("ThreadedAudioControlBackend: {}", ex.what());
+                }
+
+                return false;
+            });
+    }
+
+    // The UI thread. Nothing is delivered from now on, and the backend thread doesn't wait for the space in the queue anymore
+    void close()
+    {
+        m_isClosed = true;
+
+        while (m_queue.tryPop())
+        {
+        }
+    }
+
+    // The backend thread
+    void postToUi(std::function<void()> item)
+    {
+        while (!m_queue.tryPush(item))
+        {
+            // The UI is behind. Wait rather than drop an event, the UI would miss a device otherwise
+            if (m_isClosed)
+                return;
+
+            QueueFullCounter.increment();
+            std::this_thread::yield();
+        }
+
+        if (!m_isDrainScheduled.exchange(true))
+            std::ignore = g_idle_add_full(DrainPriority, DrainCallback, new std::weak_ptr<Bridge>(weak_from_this()), DeleteCallbackData);
+    }
+
+    // A callback to be called on the backend thread, which calls the given one on the UI thread
+    template<class... Args>
+    [[nodiscard]] std::function<void(Args...)> toUi(std::function<void(Args...)> callback)
+    {
+        if (!callback)
+            return {};
+
+        return [self = shared_from_this(), callback = std::move(callback)](Args... args)
+        { self->postToUi([callback, ... args = std::move(args)] { callback(args...); }); };
+    }
+
+private:
+    static gboolean DrainCallback(gpointer data)
+    {
+        if (auto self = static_cast<std::weak_ptr<Bridge>*>(data)->lock())
+            return self->drain();
+
+        return G_SOURCE_REMOVE;
+    }
+
+    static void DeleteCallbackData(gpointer data)
+    {
+        delete static_cast<std::weak_ptr<Bridge>*>(data);
+    }
+
+    gboolean drain()
+    {
+        for (size_t i = 0; i < DrainBatchLimit; ++i)
+        {
+            if (m_isClosed)
+                return G_SOURCE_REMOVE;
+
+            auto item = m_queue.tryPop();
+            if (!item)
+            {
+                m_isDrainScheduled = false;
+
+                // An item pushed before the flag was cleared has not scheduled a drain: take it here, unless another drain is on the way
+                if (m_queue.isEmpty() || m_isDrainScheduled.exchange(true))
+                    return G_SOURCE_REMOVE;
+
+                continue;
+            }
+
+            (*item)();
+            DeliveredCounter.increment();
+        }
+
+        return G_SOURCE_CONTINUE;
+    }
+
+private:
+    Glib::RefPtr<Glib::MainContext> m_backendContext;
+
+    SpscQueue<std::function<void()>> m_queue{QueueCapacity};
+    std::atomic_bool m_isDrainScheduled = false;
+    std::atomic_bool m_isClosed = false;
+};
+
+// The reads take the device snapshot, which is safe from any thread. The changes are made on the backend thread
+template<class InterfaceT>
+class ThreadedAudioControlBackend::DeviceProxy : public InterfaceT
+{
+public:
+    using Ptr = std::shared_ptr<InterfaceT>;
+
+    using Result = IDevice::Result;
+    using ResultCallback = IDevice::ResultCallback;
+    using Type = IDevice::Type;
+    using StatePtr = IDevice::StatePtr;
+    using OnUpdateSignal = IDevice::OnUpdateSignal;
+    using OnDeleteSignal = IDevice::OnDeleteSignal;
+
+    DeviceProxy(Ptr device, std::shared_ptr<Bridge> bridge)
+        : m_device(std::move(device))
+        , m_bridge(std::move(bridge))
+    {
+    }
+
+    bool operator==(const IDevice& other) const override
+    {
+        return *m_device == other;
+    }
+
+    [[nodiscard]] Index getIndex() const override
+    {
+        return m_device->getIndex();
+    }
+
+    [[nodiscard]] InternedString getName() const override
+    {
+        return m_device->getName();
+    }
+
+    [[nodiscard]] InternedString getDescription() const override
+    {
+        return m_device->getDescription();
+    }
+
+    [[nodiscard]] Type getType() const override
+    {
+        return m_device->getType();
+    }
+
+    [[nodiscard]] bool isEnabled() const override
+    {
+        return m_device->isEnabled();
+    }
+
+    [[nodiscard]] bool isMuted() const override
+    {
+        return m_device->isMuted();
+    }
+
+    void setMuted(bool mute, ResultCallback onDone = {}) override
+    {
+        forward(std::move(onDone), [mute](InterfaceT& device, ResultCallback done) { device.setMuted(mute, std::move(done)); });
+    }
+
+    [[nodiscard]] Volume getVolume() const override
+    {
+        return m_device->getVolume();
+    }
+
+    void setVolume(Volume volume, ResultCallback onDone = {}) override
+    {
+        forward(std::move(onDone), [volume](InterfaceT& device, ResultCallback done) { device.setVolume(volume, std::move(done)); });
+    }
+
+    [[nodiscard]] ChannelVolume getChannelVolume() const override
+    {
+        return m_device->getChannelVolume();
+    }
+
+    void setChannelVolume(const ChannelVolume& volume, ResultCallback onDone = {}) override
+    {
+        forward(std::move(onDone), [volume](InterfaceT& device, ResultCallback done) { device.setChannelVolume(volume, std::move(done)); });
+    }
+
+    void setBalance(float balance, ResultCallback onDone = {}) override
+    {
+        forward(std::move(onDone), [balance](InterfaceT& device, ResultCallback done) { device.setBalance(balance, std::move(done)); });
+    }
+
+    void adjustVolume(int delta, ResultCallback onDone = {}) override
+    {
+        forward(std::move(onDone), [delta](InterfaceT& device, ResultCallback done) { device.adjustVolume(delta, std::move(done)); });
+    }
+
+    [[nodiscard]] StatePtr getState() const override
+    {
+        return m_device->getState();
+    }
+
+    [[nodiscard]] std::string toString() const override
+    {
+        return m_device->toString();
+    }
+
+    // Emitted on the UI thread, when the backend delivers the change
+    [[nodiscard]] OnUpdateSignal& onUpdate() override
+    {
+        return m_onUpdate;
+    }
+
+    [[nodiscard]] OnDeleteSignal& onDelete() override
+    {
+        return m_onDelete;
+    }
+
+protected:
+    // The result is reported on the UI thread. A failure to send the change is reported as well
+    template<class FunctionT>
+    void forward(ResultCallback onDone, FunctionT&& function)
+    {
+        m_bridge->runOnBackend(
+            [device = m_device, done = m_bridge->toUi(std::move(onDone)), function = std::forward<FunctionT>(function)]
+            {
+                try
+                {
+                    function(*device, done);
+                }
+                catch (const std::exception& ex)
+                {
+                    Logger::error("ThreadedAudioControlBackend::DeviceProxy: {}", ex.what());
+
+                    if (done)
+                        done(Result::Failed);
+                }
+            });
+    }
+
+    [[nodiscard]] const Ptr& getDevice() const noexcept
+    {
+        return m_device;
+    }
+
+private:
+    const Ptr m_device;
+    const std::shared_ptr<Bridge> m_bridge;
+
+    OnUpdateSignal m_onUpdate;
+    OnDeleteSignal m_onDelete;
+};
+
+template<class InterfaceT>
+class ThreadedAudioControlBackend::DefaultableDeviceProxy final : public DeviceProxy<InterfaceT>
+{
+public:
+    using DeviceProxy<InterfaceT>::DeviceProxy;
+
+    using typename DeviceProxy<InterfaceT>::ResultCallback;
+
+    void setDefault(bool value, ResultCallback onDone = {}) override
+    {
+        this->forward(std::move(onDone), [value](InterfaceT& device, ResultCallback done) { device.setDefault(value, std::move(done)); });
+    }
+
+    [[nodiscard]] bool isDefault() const override
+    {
+        return this->getDevice()->isDefault();
+    }
+
+    void updateDefault(bool value) override
+    {
+        this->forward({}, [value](InterfaceT& device, [[maybe_unused]] ResultCallback done) { device.updateDefault(value); });
+    }
+};
+
+ThreadedAudioControlBackend::ThreadedAudioControlBackend(const Factory& factory)
+    : m_context(Glib::MainContext::create())
+    , m_loop(Glib::MainLoop::create(m_context))
+    , m_backend(factory(m_context))
+    , m_bridge(std::make_shared<Bridge>(m_context))
+{
+    // Connected before the thread starts, then emitted on it only. The slot is run on the UI thread once the bridge delivers it
+    std::ignore = m_backend->onDevicesChanged().connect([this](const OnSignalMapChangeSignalInfo& info)
+                                                        { m_bridge->postToUi([this, info] { onDeviceChange(info); }); });
+
+    std::ignore = m_backend->onStateChange().connect(
+        [this](State state)
+        {
+            m_bridge->postToUi(
+                [this, state]
+                {
+                    m_state = state;
+                    m_onStateChange(state);
+                });
+        });
+
+    std::ignore = m_backend->onError().connect([this](std::string error) { m_bridge->postToUi([this, error = std::move(error)] { m_onError(error); }); });
+
+    // Rate capped by the backend, so one item per flush only
+    std::ignore = m_backend->onPeaks().connect([this](const std::vector<PeakLevel>& levels)
+                                               { m_bridge->postToUi([this, levels] { m_onPeaks(levels); }); });
+
+    m_thread = std::thread(
+        [this]
+        {
+            g_main_context_push_thread_default(m_context->gobj());
+            m_loop->run();
+            g_main_context_pop_thread_default(m_context->gobj());
+        });
+}
+
+ThreadedAudioControlBackend::~ThreadedAudioControlBackend()
+{
+    m_bridge->close();
+
+    m_context->invoke(
+        [this]
+        {
+            m_backend->stop();
+            m_loop->quit();
+
+            return false;
+        });
+
+    m_thread.join();
+}
+
+void ThreadedAudioControlBackend::start()
+{
+    Logger::info("ThreadedAudioControlBackend: starting the backend on its own thread");
+
+    runOnBackend(
+        [this](IAudioControlBackend& backend)
+        {
+            try
+            {
+                backend.start();
+            }
+            catch (const std::exception& ex)
+            {
+                m_bridge->postToUi([this, error = std::string{ex.what()}] { m_onError(error); });
+            }
+        });
+}
+
+void ThreadedAudioControlBackend::stop()
+{
+    runOnBackend([](IAudioControlBackend& backend) { backend.stop(); });
+}
+
+void ThreadedAudioControlBackend::setDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume volume, ResultCallback onDone)
+{
+    runOnBackend([index, type, volume, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend)
+                 { backend.setDeviceVolume(index, type, volume, done); });
+}
+
+void ThreadedAudioControlBackend::adjustDeviceVolume(IDevice::IntexT index, IDevice::Type type, int delta, ResultCallback onDone)
+{
+    runOnBackend([index, type, delta, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend)
+                 { backend.adjustDeviceVolume(index, type, delta, done); });
+}
+
+void ThreadedAudioControlBackend::setDeviceMute(IDevice::IntexT index, IDevice::Type type, bool mute, ResultCallback onDone)
+{
+    runOnBackend([index, type, mute, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend)
+                 { backend.setDeviceMute(index, type, mute, done); });
+}
+
+void ThreadedAudioControlBackend::rampDeviceVolume(IDevice::IntexT index, IDevice::Type type, Volume target, std::chrono::milliseconds duration,
+                                                   ResultCallback onDone)
+{
+    runOnBackend([index, type, target, duration, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend)
+                 { backend.rampDeviceVolume(index, type, target, duration, done); });
+}
+
+void ThreadedAudioControlBackend::makeDeviceDefault(IDevice::IntexT index, IDevice::Type type, ResultCallback onDone)
+{
+    runOnBackend([index, type, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend) { backend.makeDeviceDefault(index, type, done); });
+}
+
+void ThreadedAudioControlBackend::setDevicesState(const std::vector<DeviceStateRequest>& requests, ResultsCallback onDone)
+{
+    runOnBackend([requests, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend) { backend.setDevicesState(requests, done); });
+}
+
+void ThreadedAudioControlBackend::moveDevice(IDevice::IntexT index, IDevice::Type type, IDevice::IntexT targetIndex, ResultCallback onDone)
+{
+    runOnBackend([index, type, targetIndex, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend)
+                 { backend.moveDevice(index, type, targetIndex, done); });
+}
+
+void ThreadedAudioControlBackend::moveDevices(const std::vector<DeviceMoveRequest>& requests, ResultsCallback onDone)
+{
+    runOnBackend([requests, done = m_bridge->toUi(std::move(onDone))](IAudioControlBackend& backend) { backend.moveDevices(requests, done); });
+}
+
+void ThreadedAudioControlBackend::setPeakMeteringEnabled(bool enabled)
+{
+    runOnBackend([enabled](IAudioControlBackend& backend) { backend.setPeakMeteringEnabled(enabled); });
+}
+
+std::vector<IAudioControlBackend::IDevice::Ptr> ThreadedAudioControlBackend::getAllDevices() const
+{
+    std::vector<IDevice::Ptr> result;
+    result.reserve(m_devices.size());
+
+    for (const auto& device : m_devices | std::views::values)
+        result.push_back(device);
+
+    return result;
+}
+
+void ThreadedAudioControlBackend::runOnBackend(std::function<void(IAudioControlBackend&)> function)
+{
+    // The backend lives as long as this object, and this object joins the thread before going away
+    m_bridge->runOnBackend([this, function = std::move(function)] { function(*m_backend); });
+}
+
+void ThreadedAudioControlBackend::onDeviceChange(OnSignalMapChangeSignalInfo info)
+{
+    CheckUiThread();
+
+    m_generation = info.generation;
+    const std::pair key{info.type, info.index};
+
+    switch (info.eventType)
+    {
+    case EventType::Add:
+    {
+        auto proxy = [this, &info]() -> IDevice::Ptr
+        {
+            switch (info.type)
+            {
+            case IDevice::Type::Sink:
+                return std::make_shared<DefaultableDeviceProxy<ISink>>(std::static_pointer_cast<ISink>(info.ptr), m_bridge);
+            case IDevice::Type::Source:
+                return std::make_shared<DefaultableDeviceProxy<ISource>>(std::static_pointer_cast<ISource>(info.ptr), m_bridge);
+            case IDevice::Type::SinkInput:
+                return std::make_shared<DeviceProxy<ISinkInput>>(std::static_pointer_cast<ISinkInput>(info.ptr), m_bridge);
+            case IDevice::Type::SourceOutput:
+                break;
+            }
+
+            return std::make_shared<DeviceProxy<ISourceOutput>>(std::static_pointer_cast<ISourceOutput>(info.ptr), m_bridge);
+        };
+
+        // A repeated add keeps the proxy the UI has already
+        info.ptr = m_devices.try_emplace(key, proxy()).first->second;
+        break;
+    }
+
+    case EventType::Update:
+        if (auto iter = m_devices.find(key); iter != m_devices.end())
+        {
+            info.ptr = iter->second;
+            info.ptr->onUpdate()(info.changes);
+        }
+        else
+        {
+            Logger::error("ThreadedAudioControlBackend: an update of an unknown device with id: {}", info.index);
+            return;
+        }
+
+        break;
+
+    case EventType::Delete:
+        if (auto node = m_devices.extract(key))
+            node.mapped()->onDelete()();
+
+        break;
+    }
+
+    m_onDevicesChanged.emit(DeviceChangeFilter::Key(info.type, info.eventType), info);
+}
+
+} // namespace ghaf::AudioControl::Backend
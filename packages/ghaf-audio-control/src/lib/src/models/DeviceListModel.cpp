@@ -8,70 +8,277 @@
 #include <GhafAudioControl/utils/Check.hpp>
 #include <GhafAudioControl/utils/Logger.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+
 namespace ghaf::AudioControl
 {
 
 namespace
 {
 
-[[nodiscard]] std::optional<guint> GetDeviceIndex(const Gio::ListStore<DeviceModel>& list, Index index)
+// Positions shift on every removal, so they aren't cached. The lookup compares the object pointers only
+[[nodiscard]] std::optional<guint> FindPosition(Gio::ListStore<DeviceModel>& list, const Glib::RefPtr<DeviceModel>& model)
 {
-    const guint size = list.get_n_items();
+    guint position = 0;
 
-    for (guint i = 0; i < size; i++)
-    {
-        if (list.get_item(i)->getIndex() == index)
-            return i;
-    }
+    if (g_list_store_find(list.gobj(), G_OBJECT(model->gobj()), &position) != FALSE)
+        return position;
 
     return std::nullopt;
 }
 
 } // namespace
 
-DeviceListModel::DeviceListModel(std::string name, std::string namePrefix)
+DeviceListModel::DeviceListModel(std::string name, std::string namePrefix, std::weak_ptr<IAudioControlBackend> backend)
     : Glib::ObjectBase(typeid(DeviceListModel))
     , m_name(*this, "name", std::move(name))
     , m_namePrefix(std::move(namePrefix))
+    , m_backend(std::move(backend))
     , m_devices(Gio::ListStore<DeviceModel>::create())
 {
+    updateMemory();
 }
 
-Glib::RefPtr<DeviceListModel> DeviceListModel::create(std::string name, std::string namePrefix)
+DeviceListModel::~DeviceListModel()
 {
-    return Glib::RefPtr<DeviceListModel>(new DeviceListModel(std::move(name), std::move(namePrefix)));
+    for (auto& entry : m_deviceEntries | std::views::values)
+    {
+        entry.onDelete.disconnect();
+        entry.onUpdate.disconnect();
+    }
 }
 
-void DeviceListModel::addDevice(IAudioControlBackend::IDevice::Ptr device)
+Glib::RefPtr<DeviceListModel> DeviceListModel::create(std::string name, std::string namePrefix, std::weak_ptr<IAudioControlBackend> backend)
 {
-    Check(device != nullptr, "device is nullptr");
+    return Glib::RefPtr<DeviceListModel>(new DeviceListModel(std::move(name), std::move(namePrefix), std::move(backend)));
+}
 
-    const Index deviceIndex = device->getIndex();
+void DeviceListModel::addDevices(std::vector<IAudioControlBackend::IDevice::Ptr> devices)
+{
+    std::vector<Glib::RefPtr<DeviceModel>> models;
+    models.reserve(devices.size());
 
-    if (device->getDescription().starts_with("Monitor "))
+    for (auto& device : devices)
     {
-        Logger::info("Skip a monitor...");
-        return;
+        if (auto model = createEntry(std::move(device)))
+            models.push_back(std::move(model));
     }
 
-    if (GetDeviceIndex(*m_devices.get(), deviceIndex))
+    if (!models.empty())
     {
-        Logger::error("AppVmModel: ignore doubling");
+        m_devices->splice(m_devices->get_n_items(), 0, models);
+        updateGroupProperties();
+
+        // After the splice, so the rows are there to be hidden
+        for (const auto& model : models)
+            m_onDeviceActivity(model->getIndex());
+    }
+}
+
+void DeviceListModel::setVolume(Volume volume, IAudioControlBackend::ResultsCallback onDone)
+{
+    setGroupState(std::nullopt, volume, std::move(onDone));
+}
+
+void DeviceListModel::setMuted(bool mute, IAudioControlBackend::ResultsCallback onDone)
+{
+    setGroupState(mute, std::nullopt, std::move(onDone));
+}
+
+void DeviceListModel::updatePeaks(const std::vector<IAudioControlBackend::PeakLevel>& levels)
+{
+    for (const auto& level : levels)
+    {
+        // A sink and a sink input may have the same index
+        const auto iter = m_deviceEntries.find(level.index);
+        if (iter == m_deviceEntries.end() || iter->second.device->getType() != level.type)
+            continue;
+
+        if (!iter->second.model)
+            continue;
+
+        // Only keeps a shown row, a hidden one playing would evict another on every flush and come back on the next
+        if (level.peak > 0.0F)
+            m_onDeviceActivity(level.index);
+
+        iter->second.model->setPeak(level.peak);
+    }
+}
+
+void DeviceListModel::hideDevice(Index index)
+{
+    const auto iter = m_deviceEntries.find(index);
+    if (iter == m_deviceEntries.end() || !iter->second.model)
         return;
+
+    if (const auto position = FindPosition(*m_devices.get(), iter->second.model))
+        m_devices->remove(*position);
+
+    iter->second.model.reset();
+}
+
+void DeviceListModel::showDevice(Index index)
+{
+    const auto iter = m_deviceEntries.find(index);
+    if (iter == m_deviceEntries.end() || iter->second.model)
+        return;
+
+    iter->second.model = DeviceModel::create(iter->second.device);
+    m_devices->append(iter->second.model);
+}
+
+Glib::RefPtr<DeviceModel> DeviceListModel::createEntry(IAudioControlBackend::IDevice::Ptr device)
+{
+    Check(device != nullptr, "device is nullptr");
+
+    const Index deviceIndex = device->getIndex();
+
+    if (m_deviceEntries.contains(deviceIndex))
+    {
+        Logger::error("AppVmModel: ignore doubling");
+        return {};
     }
 
-    m_devices->append(DeviceModel::create(device));
+    auto model = DeviceModel::create(device);
 
-    m_deviceConnections[deviceIndex] = device->onDelete().connect(
+    auto onDelete = device->onDelete().connect(
         [this, deviceIndex]
         {
-            if (const auto index = GetDeviceIndex(*m_devices.get(), deviceIndex))
-                m_devices->remove(*index);
-            else
+            auto node = m_deviceEntries.extract(deviceIndex);
+            if (node.empty())
+            {
                 Logger::error("DevicesModel::addDevice couldn't found such a device");
+                return;
+            }
 
-            m_deviceConnections.erase(deviceIndex);
+            node.mapped().onUpdate.disconnect();
+            removeFromGroup(node.mapped());
+
+            if (const auto& model = node.mapped().model)
+            {
+                if (const auto position = FindPosition(*m_devices.get(), model))
+                    m_devices->remove(*position);
+            }
+
+            updateGroupProperties();
+            updateMemory();
+
+            m_onDeviceRemoved(deviceIndex);
         });
+
+    auto onUpdate = device->onUpdate().connect([this, deviceIndex](ChangeMask changes) { onDeviceUpdate(deviceIndex, changes); });
+
+    DeviceEntry entry{device, model, std::move(onDelete), std::move(onUpdate), device->getVolume().getPercents(), device->isMuted()};
+    addToGroup(entry);
+
+    m_deviceEntries.emplace(deviceIndex, std::move(entry));
+    updateMemory();
+
+    return model;
+}
+
+void DeviceListModel::onDeviceUpdate(Index index, ChangeMask changes)
+{
+    if (!changes.intersects(DeviceField::Volume | DeviceField::Mute))
+        return;
+
+    const auto iter = m_deviceEntries.find(index);
+    if (iter == m_deviceEntries.end())
+        return;
+
+    auto& entry = iter->second;
+
+    removeFromGroup(entry);
+    entry.volume = entry.device->getVolume().getPercents();
+    entry.isMuted = entry.device->isMuted();
+    addToGroup(entry);
+
+    updateGroupProperties();
+
+    m_onDeviceActivity(index);
+}
+
+void DeviceListModel::addToGroup(const DeviceEntry& entry)
+{
+    ++m_volumeCounts[std::min(entry.volume, Volume::Max)];
+
+    if (entry.isMuted)
+        ++m_mutedCount;
+}
+
+void DeviceListModel::removeFromGroup(const DeviceEntry& entry)
+{
+    --m_volumeCounts[std::min(entry.volume, Volume::Max)];
+
+    if (entry.isMuted)
+        --m_mutedCount;
+}
+
+void DeviceListModel::updateGroupProperties()
+{
+    // At most Volume::Max + 1 steps, whatever the number of the devices
+    const auto loudest = std::find_if(m_volumeCounts.rbegin(), m_volumeCounts.rend(), [](size_t count) { return count != 0; });
+    const double volume = loudest == m_volumeCounts.rend() ? 0.0 : static_cast<double>(std::distance(loudest, m_volumeCounts.rend()) - 1);
+
+    const bool isMuted = !m_deviceEntries.empty() && m_mutedCount == m_deviceEntries.size();
+
+    if (m_volume.get_value() != volume)
+        m_volume = volume;
+
+    if (m_isMuted.get_value() != isMuted)
+        m_isMuted = isMuted;
+}
+
+void DeviceListModel::updateMemory() noexcept
+{
+    // A node of the map has the entry and a pointer of the bucket list
+    constexpr size_t EntrySize = sizeof(decltype(m_deviceEntries)::value_type) + 2 * sizeof(void*);
+    m_memory.resize(sizeof(DeviceListModel) + GetInstanceSize(*this) + (m_deviceEntries.size() * EntrySize));
+}
+
+std::vector<IAudioControlBackend::IDevice::Ptr> DeviceListModel::getDevices() const
+{
+    std::vector<IAudioControlBackend::IDevice::Ptr> devices;
+    devices.reserve(m_deviceEntries.size());
+
+    for (const auto& entry : m_deviceEntries | std::views::values)
+        devices.push_back(entry.device);
+
+    return devices;
+}
+
+void DeviceListModel::moveTo(Index targetIndex, IAudioControlBackend::ResultsCallback onDone)
+{
+    const auto requests = IAudioControlBackend::MakeGroupMoveRequests(getDevices(), targetIndex);
+
+    if (auto backend = m_backend.lock())
+    {
+        backend->moveDevices(requests, std::move(onDone));
+        return;
+    }
+
+    Logger::error("DeviceListModel: no backend for the group {}", m_name.get_value().raw());
+
+    if (onDone)
+        onDone(std::vector(requests.size(), IAudioControlBackend::Result::Failed));
+}
+
+void DeviceListModel::setGroupState(std::optional<bool> mute, std::optional<Volume> volume, IAudioControlBackend::ResultsCallback onDone)
+{
+    const auto requests = IAudioControlBackend::MakeGroupRequests(getDevices(), mute, volume);
+
+    if (auto backend = m_backend.lock())
+    {
+        backend->setDevicesState(requests, std::move(onDone));
+        return;
+    }
+
+    Logger::error("DeviceListModel: no backend for the group {}", m_name.get_value().raw());
+
+    if (onDone)
+        onDone(std::vector(requests.size(), IAudioControlBackend::Result::Failed));
 }
 
 } // namespace ghaf::AudioControl
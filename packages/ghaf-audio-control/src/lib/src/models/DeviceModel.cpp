@@ -6,9 +6,12 @@
 #include <GhafAudioControl/models/DeviceModel.hpp>
 
 #include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
 
 #include <glibmm/main.h>
 
+#include <utility>
+
 namespace ghaf::AudioControl
 {
 
@@ -17,6 +20,18 @@ namespace
 
 constexpr auto CheckMarkSymbol = "✔";
 
+// Higher than GDK_PRIORITY_REDRAW, so all the updates of an iteration are applied before the next frame is drawn
+constexpr auto UpdatePriority = Glib::PRIORITY_HIGH_IDLE + 10;
+
+// The fields the model shows. The devices also change in ways the model doesn't care about
+constexpr ChangeMask ShownFields = DeviceField::Volume | DeviceField::Mute | DeviceField::Name | DeviceField::Default | DeviceField::Metadata;
+
+// A write is done when the server has confirmed or rejected it. The timeout is for a reply that never comes, e.g. from a stopped backend
+constexpr auto VolumeWriteTimeoutMs = 2000;
+
+Metrics::Counter& AppliedUpdatesCounter = Metrics::GetCounter("ui_device_updates_total{result=\"applied\"}");
+Metrics::Counter& SkippedUpdatesCounter = Metrics::GetCounter("ui_device_updates_total{result=\"skipped\"}");
+
 template<class T>
 void LazySet(Glib::Property<T>& property, const typename Glib::Property<T>::PropertyType& newValue)
 {
@@ -35,19 +50,21 @@ auto Bind(const auto& appProp, const auto& widgetProp, bool readonly = false)
     return Glib::Binding::bind_property(appProp, widgetProp, flag);
 }
 
-auto GetDeviceName(const IAudioControlBackend::IDevice& device)
+bool IsHardwareDevice(IAudioControlBackend::IDevice::Type type)
 {
-    bool isDefault = false;
-
-    if (const auto* defaultable = dynamic_cast<const IAudioControlBackend::IDefaultable*>(&device))
-        isDefault = defaultable->isDefault();
+    return type == IAudioControlBackend::IDevice::Type::Sink || type == IAudioControlBackend::IDevice::Type::Source;
+}
 
+auto GetDeviceName(IAudioControlBackend::IDevice::Type type, const IAudioControlBackend::IDevice::State& state)
+{
     // Set description as a name for sinks and sources -- as it's less ugly
-    auto name = (device.getType() == IAudioControlBackend::IDevice::Type::Sink || device.getType() == IAudioControlBackend::IDevice::Type::Source)
-                    ? device.getDescription()
-                    : device.getName();
+    std::string name = IsHardwareDevice(type) ? state.description.str() : state.name.str();
+
+    // The streams are often named just "Playback", the application tells them apart
+    if (const auto& applicationName = state.metadata.applicationName.str(); !applicationName.empty() && applicationName != name)
+        name = applicationName + ": " + name;
 
-    if (isDefault)
+    if (state.isDefault)
         return CheckMarkSymbol + name;
 
     return "   " + name;
@@ -62,11 +79,18 @@ DeviceModel::DeviceModel(IAudioControlBackend::IDevice::Ptr device)
     , m_connections{m_isDefault.get_proxy().signal_changed().connect(sigc::mem_fun(*this, &DeviceModel::onDefaultChange)),
                     m_isSoundEnabled.get_proxy().signal_changed().connect(sigc::mem_fun(*this, &DeviceModel::onSoundEnabledChange)),
                     m_soundVolume.get_proxy().signal_changed().connect(sigc::mem_fun(*this, &DeviceModel::onSoundVolumeChange)),
-                    m_device->onUpdate().connect([this] { updateDevice(); })}
+                    m_device->onUpdate().connect(sigc::mem_fun(*this, &DeviceModel::scheduleUpdate))}
 {
+    m_memory.resize(sizeof(DeviceModel) + GetInstanceSize(*this));
     updateDevice();
 }
 
+DeviceModel::~DeviceModel()
+{
+    m_pendingUpdate.disconnect();
+    m_volumeWriteTimeout.disconnect();
+}
+
 Glib::RefPtr<DeviceModel> DeviceModel::create(IAudioControlBackend::IDevice::Ptr device)
 {
     return Glib::RefPtr<DeviceModel>(new DeviceModel(std::move(device)));
@@ -82,20 +106,62 @@ int DeviceModel::compare(const Glib::RefPtr<const DeviceModel>& a, const Glib::R
 
 void DeviceModel::updateDevice()
 {
-    bool isDefault = false;
+    m_pendingUpdate.disconnect();
 
-    if (auto* defaultable = dynamic_cast<IAudioControlBackend::IDefaultable*>(m_device.get()))
-        isDefault = defaultable->isDefault();
+    // Take one snapshot, so all the properties are consistent even if the device is updated meanwhile
+    const auto state = m_device->getState();
+    const auto previous = std::exchange(m_appliedState, state);
+
+    if (previous && previous->version == state->version)
+    {
+        SkippedUpdatesCounter.increment();
+        return;
+    }
+
+    AppliedUpdatesCounter.increment();
 
     {
         const auto scopeExit = m_connections.blockGuarded();
 
-        LazySet(m_isSoundEnabled, !m_device->isMuted());
-        LazySet(m_soundVolume, m_device->getVolume().getPercents());
-        LazySet(m_isDefault, isDefault);
+        LazySet(m_isSoundEnabled, !state->isMuted);
+        LazySet(m_isDefault, state->isDefault);
+
+        // The slider shows the value being written already. The echoes of the previous writes would make it jump back
+        if (!m_isVolumeWriteInFlight)
+            LazySet(m_soundVolume, state->volume.getPercents());
+    }
+
+    const bool isNameChanged = !previous || previous->name != state->name || previous->description != state->description ||
+                               previous->isDefault != state->isDefault || previous->metadata.applicationName != state->metadata.applicationName;
+
+    if (isNameChanged)
+        LazySet(m_name, GetDeviceName(m_device->getType(), *state));
+}
+
+void DeviceModel::scheduleUpdate(ChangeMask changes)
+{
+    if (!changes.intersects(ShownFields))
+    {
+        SkippedUpdatesCounter.increment();
+        return;
     }
 
-    LazySet(m_name, GetDeviceName(*m_device));
+    if (m_pendingUpdate.connected())
+        return;
+
+    m_pendingUpdate = Glib::signal_idle().connect(
+        [this]
+        {
+            updateDevice();
+            return false;
+        },
+        UpdatePriority);
+}
+
+void DeviceModel::setPeak(float peak)
+{
+    LazySet(m_peak, static_cast<double>(peak));
+    LazySet(m_hasPeak, true);
 }
 
 void DeviceModel::onDefaultChange()
@@ -104,7 +170,7 @@ void DeviceModel::onDefaultChange()
 
     Logger::debug("Default has changed to: {}", isDefault);
 
-    if (auto* defaultable = dynamic_cast<IAudioControlBackend::IDefaultable*>(m_device.get()))
+    if (auto* defaultable = IAudioControlBackend::AsDefaultable(*m_device))
         defaultable->setDefault(isDefault);
 }
 
@@ -119,7 +185,56 @@ void DeviceModel::onSoundEnabledChange()
 void DeviceModel::onSoundVolumeChange()
 {
     Logger::debug("SoundVolume has changed to: {}", m_soundVolume.get_value());
-    m_device->setVolume(Volume::fromPercents(m_soundVolume.get_value()));
+
+    const auto volume = Volume::fromPercents(m_soundVolume.get_value());
+
+    if (m_isVolumeWriteInFlight)
+        m_pendingVolume = volume;
+    else
+        writeVolume(volume);
+}
+
+void DeviceModel::writeVolume(Volume volume)
+{
+    const uint64_t writeId = ++m_lastVolumeWriteId;
+    m_isVolumeWriteInFlight = true;
+
+    m_volumeWriteTimeout.disconnect();
+    m_volumeWriteTimeout = Glib::signal_timeout().connect(
+        [this, writeId]
+        {
+            Logger::error("DeviceModel: the volume write to the device with id: {} has got no reply", getIndex());
+            onVolumeWriteDone(writeId, IAudioControlBackend::Result::Failed);
+            return false;
+        },
+        VolumeWriteTimeoutMs);
+
+    // The reply holds a reference, so it finds the model even if the list has dropped it meanwhile
+    reference();
+    m_device->setVolume(volume, [self = Ptr(this), writeId](IAudioControlBackend::Result result) { self->onVolumeWriteDone(writeId, result); });
+}
+
+void DeviceModel::onVolumeWriteDone(uint64_t writeId, IAudioControlBackend::Result result)
+{
+    // A reply after the timeout, the write in flight is another one or none
+    if (!m_isVolumeWriteInFlight || writeId != m_lastVolumeWriteId)
+        return;
+
+    m_volumeWriteTimeout.disconnect();
+    m_isVolumeWriteInFlight = false;
+
+    if (result != IAudioControlBackend::Result::Ok)
+        Logger::error("DeviceModel: couldn't set the volume of the device with id: {}, the result: {}", getIndex(), static_cast<int>(result));
+
+    if (m_pendingVolume)
+    {
+        writeVolume(*std::exchange(m_pendingVolume, std::nullopt));
+        return;
+    }
+
+    // The slider shows what the device has now: the echoes held back meanwhile, or the volume kept after a failure
+    m_appliedState.reset();
+    updateDevice();
 }
 
 } // namespace ghaf::AudioControl
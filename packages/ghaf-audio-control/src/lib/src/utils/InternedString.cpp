@@ -0,0 +1,125 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/utils/InternedString.hpp>
+
+#include <GhafAudioControl/utils/Metrics.hpp>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ghaf::AudioControl
+{
+
+namespace
+{
+
+Metrics::Counter& AddedCounter = Metrics::GetCounter("interned_strings_total{result=\"added\"}");
+Metrics::Counter& DroppedCounter = Metrics::GetCounter("interned_strings_total{result=\"dropped\"}");
+
+} // namespace
+
+struct InternedString::Entry
+{
+    const std::string value;
+    std::atomic<size_t> references = 1;
+};
+
+struct InternedStringTable
+{
+    using Entry = InternedString::Entry;
+
+    std::mutex mutex;
+
+    // The keys view the values of their entries
+    std::unordered_map<std::string_view, std::unique_ptr<Entry>> entries;
+
+    // Never destroyed: the handles may outlive the static destruction
+    [[nodiscard]] static InternedStringTable& Get()
+    {
+        static auto* table = new InternedStringTable();
+        return *table;
+    }
+};
+
+InternedString::InternedString(std::string_view value)
+{
+    if (value.empty())
+        return;
+
+    auto& table = InternedStringTable::Get();
+    const std::lock_guard lock{table.mutex};
+
+    if (const auto it = table.entries.find(value); it != table.entries.end())
+    {
+        m_entry = it->second.get();
+        addReference();
+        return;
+    }
+
+    auto entry = std::make_unique<Entry>(std::string(value));
+    m_entry = entry.get();
+
+    table.entries.emplace(m_entry->value, std::move(entry));
+    AddedCounter.increment();
+}
+
+InternedString::InternedString(const char* value)
+    : InternedString(value == nullptr ? std::string_view{} : std::string_view{value})
+{
+}
+
+InternedString::InternedString(const std::string& value)
+    : InternedString(std::string_view{value})
+{
+}
+
+const std::string& InternedString::str() const noexcept
+{
+    static const std::string empty;
+    return m_entry == nullptr ? empty : m_entry->value;
+}
+
+size_t InternedString::GetTableSize()
+{
+    auto& table = InternedStringTable::Get();
+    const std::lock_guard lock{table.mutex};
+
+    return table.entries.size();
+}
+
+void InternedString::addReference() const noexcept
+{
+    if (m_entry != nullptr)
+        m_entry->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InternedString::release() noexcept
+{
+    if (m_entry == nullptr)
+        return;
+
+    auto* entry = std::exchange(m_entry, nullptr);
+
+    // Not the last reference: the entry stays, no need for the table
+    for (size_t references = entry->references.load(std::memory_order_relaxed); references > 1;)
+    {
+        if (entry->references.compare_exchange_weak(references, references - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    // Maybe the last one. The lookups take their references under the lock, so the count can be trusted under it too
+    auto& table = InternedStringTable::Get();
+    const std::lock_guard lock{table.mutex};
+
+    if (entry->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    table.entries.erase(table.entries.find(entry->value));
+    DroppedCounter.increment();
+}
+
+} // namespace ghaf::AudioControl
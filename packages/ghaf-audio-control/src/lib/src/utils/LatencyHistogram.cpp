@@ -0,0 +1,68 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/utils/LatencyHistogram.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+
+namespace ghaf::AudioControl
+{
+
+void LatencyHistogram::record(std::chrono::microseconds latency) noexcept
+{
+    latency = std::max(latency, std::chrono::microseconds{0});
+
+    const auto steps = static_cast<uint64_t>(latency / FirstBucketBound);
+    const size_t bucket = std::min<size_t>(std::bit_width(steps), BucketCount - 1);
+
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(latency.count(), std::memory_order_relaxed);
+
+    auto max = m_max.load(std::memory_order_relaxed);
+    while (latency.count() > max && !m_max.compare_exchange_weak(max, latency.count(), std::memory_order_relaxed))
+        ;
+}
+
+std::chrono::microseconds LatencyHistogram::getPercentile(double share) const noexcept
+{
+    // A record may land while this reads, then the count and the buckets differ by it, which moves a percentile one sample at most
+    const uint64_t count = getCount();
+    const auto max = getMax();
+
+    if (count == 0)
+        return std::chrono::microseconds{0};
+
+    const auto threshold = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(share, 0.0, 1.0) * static_cast<double>(count))));
+    uint64_t accumulated = 0;
+
+    for (size_t bucket = 0; bucket < BucketCount - 1; ++bucket)
+    {
+        accumulated += getBucket(bucket);
+
+        if (accumulated >= threshold)
+            return std::min(GetBucketBound(bucket), max);
+    }
+
+    return max;
+}
+
+std::chrono::microseconds LatencyHistogram::GetBucketBound(size_t bucket) noexcept
+{
+    return FirstBucketBound * (int64_t{1} << std::min(bucket, BucketCount - 1));
+}
+
+std::string LatencyHistogram::toString() const
+{
+    const uint64_t count = getCount();
+    const auto average = count == 0 ? std::chrono::microseconds{0} : getSum() / static_cast<int64_t>(count);
+
+    return std::format("count: {} avg: {} p50: {} p99: {} max: {}", count, average, getPercentile(0.5), getPercentile(0.99), getMax());
+}
+
+} // namespace ghaf::AudioControl
@@ -5,35 +5,252 @@
 
 #include <GhafAudioControl/utils/Logger.hpp>
 
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <format>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace ghaf::AudioControl
 {
 
-std::string Logger::logLevelToString(LogLevel logLevel)
+namespace
 {
-    if (logLevel == Logger::LogLevel::DEBUG)
-        return "debug";
 
-    if (logLevel == Logger::LogLevel::ERROR)
-        return "error";
+constexpr auto JournaldSocketPath = "/run/systemd/journal/socket";
+constexpr auto SyslogIdentifier = "ghaf-audio-control";
 
-    if (logLevel == Logger::LogLevel::INFO)
+std::string_view ToString(Logger::LogLevel logLevel)
+{
+    switch (logLevel)
+    {
+    case Logger::LogLevel::DEBUG:
+        return "debug";
+    case Logger::LogLevel::INFO:
         return "info";
+    case Logger::LogLevel::ERROR:
+        return "error";
+    }
 
     return "unknown";
 }
 
-void Logger::log(std::string_view message, LogLevel logLevel)
+int ToSyslogPriority(Logger::LogLevel logLevel)
+{
+    switch (logLevel)
+    {
+    case Logger::LogLevel::DEBUG:
+        return 7;
+    case Logger::LogLevel::INFO:
+        return 6;
+    case Logger::LogLevel::ERROR:
+        return 3;
+    }
+
+    return 6;
+}
+
+void WriteToStderr(std::string_view message, std::string_view logLevel, bool isError)
 {
     const std::chrono::time_point timeNow = std::chrono::system_clock::now();
 
-    if (logLevel == Logger::LogLevel::ERROR)
+    if (isError)
         std::cerr << "\033[31m";
 
-    std::cerr << std::format("[{}] [{:5}] {}", timeNow, logLevelToString(logLevel), message) << "\033[0m" << '\n';
+    std::cerr << std::format("[{}] [{:5}] {}", timeNow, logLevel, message) << "\033[0m" << '\n';
+}
+
+class JournaldWriter;
+std::atomic<JournaldWriter*> JournaldOutput = nullptr;
+
+// Keeps the latest messages in a fixed ring and sends them to the journal from its own thread.
+// Writers only copy the message under the lock. If the journal falls behind, the oldest messages are dropped
+class JournaldWriter final
+{
+public:
+    static constexpr size_t Capacity = 1024;
+
+    JournaldWriter()
+        : m_ring(Capacity)
+        , m_socket(::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0))
+        , m_thread([this] { run(); })
+    {
+    }
+
+    JournaldWriter(const JournaldWriter&) = delete;
+    JournaldWriter& operator=(const JournaldWriter&) = delete;
+
+    ~JournaldWriter()
+    {
+        JournaldOutput = nullptr;
+
+        {
+            const std::lock_guard lock{m_mutex};
+            m_isStopped = true;
+        }
+
+        m_condition.notify_one();
+        m_thread.join();
+
+        if (m_socket >= 0)
+            ::close(m_socket);
+    }
+
+    void push(Logger::LogLevel logLevel, std::string_view message)
+    {
+        {
+            const std::lock_guard lock{m_mutex};
+
+            if (m_size == Capacity)
+            {
+                m_head = (m_head + 1) % Capacity;
+                --m_size;
+                ++m_dropped;
+            }
+
+            auto& entry = m_ring[(m_head + m_size) % Capacity];
+            entry.logLevel = logLevel;
+            entry.message.assign(message);
+
+            ++m_size;
+        }
+
+        m_condition.notify_one();
+    }
+
+private:
+    struct Entry
+    {
+        Logger::LogLevel logLevel = Logger::LogLevel::INFO;
+        std::string message;
+    };
+
+    void run()
+    {
+        std::vector<Entry> batch;
+
+        while (true)
+        {
+            size_t dropped = 0;
+
+            {
+                std::unique_lock lock{m_mutex};
+                m_condition.wait(lock, [this] { return m_isStopped || m_size != 0; });
+
+                if (m_size == 0)
+                    return;
+
+                for (; m_size != 0; --m_size, m_head = (m_head + 1) % Capacity)
+                    batch.push_back(std::move(m_ring[m_head]));
+
+                dropped = std::exchange(m_dropped, 0);
+            }
+
+            if (dropped != 0)
+                send(Logger::LogLevel::ERROR, std::format("Logger: {} messages have been dropped", dropped));
+
+            for (const auto& entry : batch)
+                send(entry.logLevel, entry.message);
+
+            batch.clear();
+        }
+    }
+
+    void send(Logger::LogLevel logLevel, std::string_view message) const
+    {
+        // The length prefixed form of MESSAGE lets it contain new lines
+        std::string datagram = std::format("PRIORITY={}\nSYSLOG_IDENTIFIER={}\nMESSAGE\n", ToSyslogPriority(logLevel), SyslogIdentifier);
+
+        const auto size = static_cast<uint64_t>(message.size());
+        for (size_t byte = 0; byte < sizeof(size); ++byte)
+            datagram.push_back(static_cast<char>((size >> (byte * 8)) & 0xFF));
+
+        datagram.append(message);
+        datagram.push_back('\n');
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, JournaldSocketPath, sizeof(address.sun_path) - 1);
+
+        const auto sent =
+            m_socket < 0 ? -1 : ::sendto(m_socket, datagram.data(), datagram.size(), MSG_NOSIGNAL, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+
+        if (sent < 0)
+            WriteToStderr(message, ToString(logLevel), logLevel == Logger::LogLevel::ERROR);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    std::vector<Entry> m_ring;
+    size_t m_head = 0;
+    size_t m_size = 0;
+    size_t m_dropped = 0;
+    bool m_isStopped = false;
+
+    int m_socket;
+    std::thread m_thread;
+};
+
+} // namespace
+
+void Logger::setOutput(Output output)
+{
+    if (output == Output::Journald)
+    {
+        // Lives till the exit, so the messages in the buffer are still written out
+        static JournaldWriter writer;
+        JournaldOutput = &writer;
+    }
+    else
+        JournaldOutput = nullptr;
+}
+
+std::optional<Logger::LogLevel> Logger::logLevelFromString(std::string_view value)
+{
+    if (value == "debug")
+        return LogLevel::DEBUG;
+
+    if (value == "info")
+        return LogLevel::INFO;
+
+    if (value == "error")
+        return LogLevel::ERROR;
+
+    return std::nullopt;
+}
+
+std::optional<Logger::Output> Logger::outputFromString(std::string_view value)
+{
+    if (value == "stderr")
+        return Output::Stderr;
+
+    if (value == "journald")
+        return Output::Journald;
+
+    return std::nullopt;
+}
+
+std::string Logger::logLevelToString(LogLevel logLevel)
+{
+    return std::string(ToString(logLevel));
+}
+
+void Logger::log(std::string_view message, LogLevel logLevel)
+{
+    if (JournaldWriter* journald = JournaldOutput)
+        journald->push(logLevel, message);
+    else
+        WriteToStderr(message, logLevelToString(logLevel), logLevel == Logger::LogLevel::ERROR);
 }
 
 } // namespace ghaf::AudioControl
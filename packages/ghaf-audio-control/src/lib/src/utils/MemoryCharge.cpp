@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/utils/MemoryCharge.hpp>
+
+#include <GhafAudioControl/utils/Metrics.hpp>
+
+#include <glibmm/objectbase.h>
+
+#include <array>
+
+namespace ghaf::AudioControl
+{
+
+namespace
+{
+
+struct MemoryGauges
+{
+    Metrics::Gauge& bytes;
+    Metrics::Gauge& objects;
+};
+
+// In the order of MemorySubsystem
+std::array<MemoryGauges, 5> Gauges{{
+    {Metrics::GetGauge("memory_bytes{subsystem=\"backend_devices\"}"), Metrics::GetGauge("memory_objects{subsystem=\"backend_devices\"}")},
+    {Metrics::GetGauge("memory_bytes{subsystem=\"models\"}"), Metrics::GetGauge("memory_objects{subsystem=\"models\"}")},
+    {Metrics::GetGauge("memory_bytes{subsystem=\"widgets\"}"), Metrics::GetGauge("memory_objects{subsystem=\"widgets\"}")},
+    {Metrics::GetGauge("memory_bytes{subsystem=\"dbus_buffers\"}"), Metrics::GetGauge("memory_objects{subsystem=\"dbus_buffers\"}")},
+    {Metrics::GetGauge("memory_bytes{subsystem=\"pool_free_blocks\"}"), Metrics::GetGauge("memory_objects{subsystem=\"pool_free_blocks\"}")},
+}};
+
+MemoryGauges& GetGauges(MemorySubsystem subsystem) noexcept
+{
+    return Gauges[static_cast<size_t>(subsystem)];
+}
+
+} // namespace
+
+MemoryCharge::MemoryCharge(MemorySubsystem subsystem, size_t bytes, size_t objects) noexcept
+    : m_subsystem(subsystem)
+    , m_bytes(bytes)
+    , m_objects(objects)
+{
+    auto& gauges = GetGauges(m_subsystem);
+    gauges.bytes.add(static_cast<int64_t>(m_bytes));
+    gauges.objects.add(static_cast<int64_t>(m_objects));
+}
+
+MemoryCharge::~MemoryCharge()
+{
+    auto& gauges = GetGauges(m_subsystem);
+    gauges.bytes.add(-static_cast<int64_t>(m_bytes));
+    gauges.objects.add(-static_cast<int64_t>(m_objects));
+}
+
+void MemoryCharge::resize(size_t bytes, size_t objects) noexcept
+{
+    auto& gauges = GetGauges(m_subsystem);
+    gauges.bytes.add(static_cast<int64_t>(bytes) - static_cast<int64_t>(m_bytes));
+    gauges.objects.add(static_cast<int64_t>(objects) - static_cast<int64_t>(m_objects));
+
+    m_bytes = bytes;
+    m_objects = objects;
+}
+
+size_t GetInstanceSize(const Glib::ObjectBase& object) noexcept
+{
+    GTypeQuery query{};
+    g_type_query(G_OBJECT_TYPE(object.gobj()), &query);
+
+    return query.instance_size;
+}
+
+} // namespace ghaf::AudioControl
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/utils/Metrics.hpp>
+
+#include <format>
+#include <mutex>
+
+namespace ghaf::AudioControl
+{
+
+namespace
+{
+
+struct Registry
+{
+    std::mutex mutex;
+    std::map<std::string, Metrics::Counter, std::less<>> counters;
+    std::map<std::string, Metrics::Gauge, std::less<>> gauges;
+    std::map<std::string, LatencyHistogram, std::less<>> histograms;
+};
+
+Registry& GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+// Splits 'name{labels}' into the name and the labels without the braces
+std::pair<std::string_view, std::string_view> SplitLabels(std::string_view name)
+{
+    const auto brace = name.find('{');
+    if (brace == std::string_view::npos || name.back() != '}')
+        return {name, {}};
+
+    return {name.substr(0, brace), name.substr(brace + 1, name.size() - brace - 2)};
+}
+
+std::string WithLabels(std::string_view name, std::string_view labels, std::string_view extraLabel = {})
+{
+    if (labels.empty() && extraLabel.empty())
+        return std::string(name);
+
+    const auto separator = labels.empty() || extraLabel.empty() ? "" : ",";
+    return std::format("{}{{{}{}{}}}", name, labels, separator, extraLabel);
+}
+
+void AppendType(std::string& text, std::string_view& lastName, std::string_view name, std::string_view type)
+{
+    if (name == lastName)
+        return;
+
+    text += std::format("# TYPE {} {}\n", name, type);
+    lastName = name;
+}
+
+} // namespace
+
+Metrics::Counter& Metrics::GetCounter(std::string_view name)
+{
+    auto& registry = GetRegistry();
+    const std::lock_guard lock{registry.mutex};
+
+    if (auto iter = registry.counters.find(name); iter != registry.counters.end())
+        return iter->second;
+
+    return registry.counters.try_emplace(std::string(name)).first->second;
+}
+
+Metrics::Gauge& Metrics::GetGauge(std::string_view name)
+{
+    auto& registry = GetRegistry();
+    const std::lock_guard lock{registry.mutex};
+
+    if (auto iter = registry.gauges.find(name); iter != registry.gauges.end())
+        return iter->second;
+
+    return registry.gauges.try_emplace(std::string(name)).first->second;
+}
+
+LatencyHistogram& Metrics::GetHistogram(std::string_view name)
+{
+    auto& registry = GetRegistry();
+    const std::lock_guard lock{registry.mutex};
+
+    if (auto iter = registry.histograms.find(name); iter != registry.histograms.end())
+        return iter->second;
+
+    return registry.histograms.try_emplace(std::string(name)).first->second;
+}
+
+std::map<std::string, uint64_t> Metrics::GetCounterValues()
+{
+    auto& registry = GetRegistry();
+    const std::lock_guard lock{registry.mutex};
+
+    std::map<std::string, uint64_t> values;
+
+    for (const auto& [name, counter] : registry.counters)
+        values.emplace(name, counter.get());
+
+    return values;
+}
+
+std::map<std::string, int64_t> Metrics::GetGaugeValues()
+{
+    auto& registry = GetRegistry();
+    const std::lock_guard lock{registry.mutex};
+
+    std::map<std::string, int64_t> values;
+
+    for (const auto& [name, gauge] : registry.gauges)
+        values.emplace(name, gauge.get());
+
+    return values;
+}
+
+std::string Metrics::ToPrometheusText()
+{
+    auto& registry = GetRegistry();
+    const std::lock_guard lock{registry.mutex};
+
+    std::string text;
+    std::string_view lastName;
+
+    // The maps are sorted, so the series of one metric go together under a single TYPE line
+    for (const auto& [fullName, counter] : registry.counters)
+    {
+        const auto [name, labels] = SplitLabels(fullName);
+
+        AppendType(text, lastName, name, "counter");
+        text += std::format("{} {}\n", fullName, counter.get());
+    }
+
+    for (const auto& [fullName, gauge] : registry.gauges)
+    {
+        const auto [name, labels] = SplitLabels(fullName);
+
+        AppendType(text, lastName, name, "gauge");
+        text += std::format("{} {}\n", fullName, gauge.get());
+    }
+
+    for (const auto& [fullName, histogram] : registry.histograms)
+    {
+        const auto [name, labels] = SplitLabels(fullName);
+
+        AppendType(text, lastName, name, "histogram");
+
+        const std::string bucketName = std::format("{}_bucket", name);
+        uint64_t accumulated = 0;
+
+        for (size_t bucket = 0; bucket < LatencyHistogram::BucketCount - 1; ++bucket)
+        {
+            accumulated += histogram.getBucket(bucket);
+
+            const auto bound = std::format("le=\"{}\"", LatencyHistogram::GetBucketBound(bucket).count());
+            text += std::format("{} {}\n", WithLabels(bucketName, labels, bound), accumulated);
+        }
+
+        text += std::format("{} {}\n", WithLabels(bucketName, labels, "le=\"+Inf\""), histogram.getCount());
+        text += std::format("{} {}\n", WithLabels(std::format("{}_sum", name), labels), histogram.getSum().count());
+        text += std::format("{} {}\n", WithLabels(std::format("{}_count", name), labels), histogram.getCount());
+    }
+
+    return text;
+}
+
+} // namespace ghaf::AudioControl
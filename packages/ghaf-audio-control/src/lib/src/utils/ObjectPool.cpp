@@ -0,0 +1,69 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/utils/ObjectPool.hpp>
+
+#include <GhafAudioControl/utils/Metrics.hpp>
+
+#include <new>
+#include <utility>
+
+namespace ghaf::AudioControl
+{
+
+namespace
+{
+
+Metrics::Counter& AllocatedCounter = Metrics::GetCounter("pool_blocks_total{result=\"allocated\"}");
+Metrics::Counter& ReusedCounter = Metrics::GetCounter("pool_blocks_total{result=\"reused\"}");
+
+} // namespace
+
+BlockPool::BlockPool(size_t blockSize, size_t alignment) noexcept
+    : m_blockSize(blockSize)
+    , m_alignment(alignment)
+{
+}
+
+BlockPool::~BlockPool()
+{
+    while (m_freeBlocks != nullptr)
+        ::operator delete(std::exchange(m_freeBlocks, m_freeBlocks->next), m_blockSize, std::align_val_t{m_alignment});
+}
+
+void* BlockPool::allocate()
+{
+    {
+        const std::lock_guard lock{m_mutex};
+
+        if (m_freeBlocks != nullptr)
+        {
+            ReusedCounter.increment();
+
+            --m_freeBlockCount;
+            m_freeMemory.resize(m_freeBlockCount * m_blockSize, m_freeBlockCount);
+
+            return std::exchange(m_freeBlocks, m_freeBlocks->next);
+        }
+    }
+
+    AllocatedCounter.increment();
+    return ::operator new(m_blockSize, std::align_val_t{m_alignment});
+}
+
+void BlockPool::deallocate(void* block) noexcept
+{
+    auto* freeBlock = ::new (block) FreeBlock{};
+
+    const std::lock_guard lock{m_mutex};
+
+    freeBlock->next = m_freeBlocks;
+    m_freeBlocks = freeBlock;
+
+    ++m_freeBlockCount;
+    m_freeMemory.resize(m_freeBlockCount * m_blockSize, m_freeBlockCount);
+}
+
+} // namespace ghaf::AudioControl
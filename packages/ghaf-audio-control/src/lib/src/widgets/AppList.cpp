@@ -3,10 +3,10 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-#include <GhafAudioControl/Backends/PulseAudio/SinkInput.hpp>
 #include <GhafAudioControl/utils/Check.hpp>
 #include <GhafAudioControl/utils/Debug.hpp>
 #include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/Metrics.hpp>
 #include <GhafAudioControl/widgets/AppList.hpp>
 #include <GhafAudioControl/widgets/DeviceListWidget.hpp>
 
@@ -19,30 +19,19 @@
 #include <gtkmm/scale.h>
 #include <gtkmm/switch.h>
 
+#include <map>
+#include <ranges>
+
 namespace ghaf::AudioControl
 {
 
 namespace
 {
 
-constexpr auto AppVmPrefix = "AppVM";
-
-std::optional<size_t> GetIndexByAppId(const Glib::RefPtr<Gio::ListStore<DeviceListModel>>& model, const std::string& id) noexcept
+std::string GetAppNameFromStream(const IAudioControlBackend::IDevice::Ptr& device)
 {
-    for (size_t index = 0; index < model->get_n_items(); ++index)
-        if (id == model->get_item(index)->getAppNameProperty().get_value())
-            return index;
-
-    return std::nullopt;
-}
-
-std::string GetAppNameFromSinkInput(const IAudioControlBackend::ISinkInput::Ptr& device)
-{
-    if (auto sinkInput = std::dynamic_pointer_cast<Backend::PulseAudio::SinkInput>(device))
-    {
-        if (const auto appVmName = sinkInput->getAppVmName())
-            return *appVmName;
-    }
+    if (const auto state = device->getState(); state->appVmName)
+        return *state->appVmName;
 
     return "Other";
 }
@@ -62,13 +51,20 @@ Gtk::Widget* CreateWidgetsForApp(const Glib::RefPtr<Glib::Object>& appVmModelPtr
         return nullptr;
     }
 
-    return Gtk::make_managed<DeviceListWidget>(appVmModel);
+    // AppVMs may have a lot of streams, so their rows are created only when the user expands the list. Shown here, so an add
+    // doesn't walk the rows of the other apps
+    auto* widget = Gtk::make_managed<DeviceListWidget>(appVmModel, false);
+    widget->show_all();
+
+    return widget;
 }
 
 } // namespace
 
-AppList::AppList()
+AppList::AppList(std::weak_ptr<IAudioControlBackend> backend, std::string namePrefix)
     : Gtk::Box(Gtk::ORIENTATION_HORIZONTAL)
+    , m_backend(std::move(backend))
+    , m_namePrefix(std::move(namePrefix))
     , m_appsModel(Gio::ListStore<DeviceListModel>::create())
 {
     m_listBox.bind_model(m_appsModel, &CreateWidgetsForApp);
@@ -80,36 +76,107 @@ AppList::AppList()
 
 void AppList::addVm(std::string appVmName)
 {
-    if (const auto index = GetIndexByAppId(m_appsModel, appVmName))
+    if (m_appModelsByName.contains(appVmName))
         return;
 
-    m_appsModel->append(DeviceListModel::create(std::move(appVmName), AppVmPrefix));
+    auto appVmModel = DeviceListModel::create(appVmName, m_namePrefix, m_backend);
+    watchApp(appVmModel);
+    m_appsModel->append(appVmModel);
+
+    m_appModelsByName.emplace(std::move(appVmName), std::move(appVmModel));
 }
 
-void AppList::addDevice(IAudioControlBackend::ISinkInput::Ptr device)
+void AppList::addDevices(std::vector<IAudioControlBackend::IDevice::Ptr> devices)
 {
-    Check(device != nullptr, "device is nullptr");
+    std::map<std::string, std::vector<IAudioControlBackend::IDevice::Ptr>> devicesByApp;
 
-    const std::string appName = GetAppNameFromSinkInput(device);
+    for (auto& device : devices)
+    {
+        Check(device != nullptr, "device is nullptr");
 
-    if (const auto index = GetIndexByAppId(m_appsModel, appName))
-        m_appsModel->get_item(*index)->addDevice(std::move(device));
-    else
+        std::string appName = GetAppNameFromStream(device);
+        devicesByApp[std::move(appName)].push_back(std::move(device));
+    }
+
+    std::vector<Glib::RefPtr<DeviceListModel>> newAppModels;
+
+    for (auto& [appName, appDevices] : devicesByApp)
     {
-        Logger::info("AppList::addDevice: add new app with name: {}", appName);
+        auto it = m_appModelsByName.find(appName);
+
+        if (it == m_appModelsByName.end())
+        {
+            Logger::info("AppList::addDevices: add new app with name: {}", appName);
+
+            auto appVmModel = DeviceListModel::create(appName, m_namePrefix, m_backend);
+            watchApp(appVmModel);
+            newAppModels.push_back(appVmModel);
 
-        auto appVmModel = DeviceListModel::create(appName, AppVmPrefix);
-        m_appsModel->append(appVmModel);
+            it = m_appModelsByName.emplace(appName, std::move(appVmModel)).first;
+        }
 
-        appVmModel->addDevice(std::move(device));
+        it->second->addDevices(std::move(appDevices));
     }
 
-    show_all_children(true);
+    // The new apps get their devices first, so their rows are created complete
+    if (!newAppModels.empty())
+        m_appsModel->splice(m_appsModel->get_n_items(), 0, newAppModels);
+}
+
+void AppList::updatePeaks(const std::vector<IAudioControlBackend::PeakLevel>& levels)
+{
+    for (const auto& appModel : m_appModelsByName | std::views::values)
+        appModel->updatePeaks(levels);
 }
 
 void AppList::removeAllApps()
 {
+    m_appConnections.clear();
+    m_shownStreamRows.clear();
+
+    m_appModelsByName.clear();
     m_appsModel->remove_all();
 }
 
+void AppList::setMaxStreamRows(size_t count)
+{
+    m_maxStreamRows = count;
+    evictStreamRows();
+}
+
+void AppList::watchApp(const Glib::RefPtr<DeviceListModel>& appModel)
+{
+    DeviceListModel* model = appModel.get();
+
+    m_appConnections += model->onDeviceActivity().connect([this, model](Index index) { onStreamActivity(*model, index); });
+    m_appConnections += model->onDeviceRemoved().connect([this, model](Index index) { m_shownStreamRows.erase({model, index}); });
+}
+
+void AppList::onStreamActivity(DeviceListModel& appModel, Index index)
+{
+    if (!m_shownStreamRows.touch({&appModel, index}))
+        return;
+
+    appModel.showDevice(index);
+    evictStreamRows();
+}
+
+void AppList::evictStreamRows()
+{
+    static Metrics::Counter& evictedCounter = Metrics::GetCounter("stream_rows_evicted_total");
+
+    if (m_maxStreamRows == 0)
+        return;
+
+    while (m_shownStreamRows.size() > m_maxStreamRows)
+    {
+        const auto [appModel, index] = *m_shownStreamRows.popOldest();
+
+        Logger::debug("AppList: hiding the row of the inactive stream {} of {}", index, appModel->getAppNameProperty().get_value().raw());
+        appModel->hideDevice(index);
+
+        evictedCounter.increment();
+    }
+}
+
 } // namespace ghaf::AudioControl
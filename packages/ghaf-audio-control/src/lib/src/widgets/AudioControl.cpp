@@ -15,6 +15,7 @@
 #include <gtkmm/volumebutton.h>
 
 #include <glibmm/binding.h>
+#include <glibmm/main.h>
 
 namespace ghaf::AudioControl
 {
@@ -24,8 +25,16 @@ constexpr auto CssStyle = "button#AppVmNameButton { background-color: transparen
                           "label#EmptyListName { border-radius: 15px; min-height: 40px; }"
                           "*:selected { background-color: transparent; color: inherit; box-shadow: none; outline: none; }";
 
+// Higher than GDK_PRIORITY_REDRAW, so the added devices are shown in the next frame already
+constexpr auto AddedDevicesPriority = Glib::PRIORITY_HIGH_IDLE + 10;
+
+void RemovePendingDevice(std::vector<IAudioControlBackend::IDevice::Ptr>& pendingDevices, Index index)
+{
+    std::erase_if(pendingDevices, [index](const IAudioControlBackend::IDevice::Ptr& device) { return device->getIndex() == index; });
+}
+
 template<class IndexT, class DevicePtrT>
-void OnPulseDeviceChanged(IAudioControlBackend::EventType eventType, IndexT index, DevicePtrT device, AppList& appList)
+void OnPulseDeviceChanged(IAudioControlBackend::EventType eventType, IndexT index, const DevicePtrT& device, std::vector<DevicePtrT>& pendingDevices)
 {
     std::string deviceType;
 
@@ -53,54 +62,85 @@ void OnPulseDeviceChanged(IAudioControlBackend::EventType eventType, IndexT inde
     switch (eventType)
     {
     case IAudioControlBackend::EventType::Add:
-        Logger::debug("OnPulseDeviceChanged: ADD {}: {}", deviceType, device->toString());
-        appList.addDevice(std::move(device));
+        Logger::debug("OnPulseDeviceChanged: ADD {}: {}", deviceType, Logger::lazy([&device] { return device->toString(); }));
+        pendingDevices.push_back(device);
         break;
 
     case IAudioControlBackend::EventType::Update:
-        Logger::debug("OnPulseDeviceChanged: UPDATE {}: {}", deviceType, device->toString());
+        Logger::debug("OnPulseDeviceChanged: UPDATE {}: {}", deviceType, Logger::lazy([&device] { return device->toString(); }));
         break;
 
     case IAudioControlBackend::EventType::Delete:
         Logger::debug("OnPulseDeviceChanged: DELETE {} with index: {}", deviceType, index);
+        RemovePendingDevice(pendingDevices, index);
         break;
     }
 }
 
-AudioControl::AudioControl(std::shared_ptr<IAudioControlBackend> backend, const std::vector<std::string>& appVmsList)
+AudioControl::AudioControl(std::shared_ptr<IAudioControlBackend> backend, const std::vector<std::string>& appVmsList, size_t maxStreamRows)
     : Gtk::Box(Gtk::ORIENTATION_VERTICAL)
     , m_audioControl(std::move(backend))
-    , m_sinksModel(DeviceListModel::create("Speakers"))
+    , m_reconnectingLabel("Reconnecting to the audio server...")
+    , m_appList(m_audioControl)
+    , m_appMicrophones(m_audioControl, "AppVM microphone")
+    , m_sinksModel(DeviceListModel::create("Speakers", "", m_audioControl))
     , m_sinks(m_sinksModel)
-    , m_sourcesModel(DeviceListModel::create("Microphones"))
+    , m_sourcesModel(DeviceListModel::create("Microphones", "", m_audioControl))
     , m_sources(m_sourcesModel)
 {
     set_halign(Gtk::Align::ALIGN_START);
     set_valign(Gtk::Align::ALIGN_START);
 
+    m_appList.setMaxStreamRows(maxStreamRows);
+    m_appMicrophones.setMaxStreamRows(maxStreamRows);
+
     for (const auto& appVm : appVmsList)
         m_appList.addVm(appVm);
 
     init();
 }
 
+AudioControl::~AudioControl()
+{
+    m_pendingDevicesFlush.disconnect();
+}
+
 void AudioControl::init()
 {
     if (m_audioControl)
     {
+        // Shown only while the backend reconnects, over the devices it keeps meanwhile
+        m_reconnectingLabel.set_no_show_all(true);
+
+        pack_start(m_reconnectingLabel);
         pack_start(m_sinks);
         pack_start(m_sources);
         pack_start(m_appList);
+        pack_start(m_appMicrophones);
+
+        using IDevice = IAudioControlBackend::IDevice;
+        using EventType = IAudioControlBackend::EventType;
+        using Filter = IAudioControlBackend::DeviceChangeFilter;
+
+        // The sinks and the sources follow their updates themselves, only the adds and the deletes are of interest here
+        auto& onDevicesChanged = m_audioControl->onDevicesChanged();
 
-        m_connections += m_audioControl->onSinksChanged().connect(sigc::mem_fun(*this, &AudioControl::onPulseSinksChanged));
-        m_connections += m_audioControl->onSourcesChanged().connect(sigc::mem_fun(*this, &AudioControl::onPulseSourcesChanged));
-        m_connections += m_audioControl->onSinkInputsChanged().connect(sigc::mem_fun(*this, &AudioControl::onPulseSinkInputsChanged));
-        // m_connections += m_audioControl->onSourceOutputsChanged().connect(sigc::mem_fun(*this, &AudioControl::onPulseSourcesOutputsChanged));
+        m_connections += onDevicesChanged.connect(sigc::mem_fun(*this, &AudioControl::onPulseSinksChanged),
+                                                  Filter::Types({IDevice::Type::Sink}).events({EventType::Add, EventType::Delete}).mask());
+        m_connections += onDevicesChanged.connect(sigc::mem_fun(*this, &AudioControl::onPulseSourcesChanged),
+                                                  Filter::Types({IDevice::Type::Source}).events({EventType::Add, EventType::Delete}).mask());
+        m_connections += onDevicesChanged.connect(sigc::mem_fun(*this, &AudioControl::onPulseSinkInputsChanged),
+                                                  Filter::Types({IDevice::Type::SinkInput}).mask());
+        m_connections += onDevicesChanged.connect(sigc::mem_fun(*this, &AudioControl::onPulseSourcesOutputsChanged),
+                                                  Filter::Types({IDevice::Type::SourceOutput}).mask());
+        m_connections += m_audioControl->onStateChange().connect(sigc::mem_fun(*this, &AudioControl::onPulseStateChange));
         m_connections += m_audioControl->onError().connect(sigc::mem_fun(*this, &AudioControl::onPulseError));
+        m_connections += m_audioControl->onPeaks().connect(sigc::mem_fun(*this, &AudioControl::onPulsePeaks));
 
-        show_all_children();
+        hydrate();
+        onPulseStateChange(m_audioControl->getState());
 
-        m_audioControl->start();
+        show_all_children();
     }
     else
     {
@@ -114,38 +154,150 @@ void AudioControl::init()
     style_context->add_provider_for_screen(Gdk::Screen::get_default(), cssProvider, GTK_STYLE_PROVIDER_PRIORITY_USER);
 }
 
-void AudioControl::onPulseSinksChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info)
+void AudioControl::hydrate()
+{
+    // The backend may be running for a while already, e.g. when the UI is created on demand
+    const auto generation = m_audioControl->getGeneration();
+
+    for (auto& device : m_audioControl->getAllDevices())
+    {
+        const auto type = device->getType();
+        const IAudioControlBackend::OnSignalMapChangeSignalInfo info{IAudioControlBackend::EventType::Add,
+                                                                     device->getIndex(),
+                                                                     type,
+                                                                     std::move(device),
+                                                                     generation};
+
+        switch (type)
+        {
+        case IAudioControlBackend::IDevice::Type::Sink:
+            onPulseSinksChanged(info);
+            break;
+
+        case IAudioControlBackend::IDevice::Type::Source:
+            onPulseSourcesChanged(info);
+            break;
+
+        case IAudioControlBackend::IDevice::Type::SinkInput:
+            onPulseSinkInputsChanged(info);
+            break;
+
+        case IAudioControlBackend::IDevice::Type::SourceOutput:
+            onPulseSourcesOutputsChanged(info);
+            break;
+        }
+    }
+
+    flushPendingDevices();
+}
+
+void AudioControl::onPulseSinksChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info)
 {
     if (info.eventType == IAudioControlBackend::EventType::Add)
-        m_sinksModel->addDevice(std::move(info.ptr));
+    {
+        m_pendingSinks.push_back(info.ptr);
+        scheduleDevicesFlush();
+    }
+    else if (info.eventType == IAudioControlBackend::EventType::Delete)
+        RemovePendingDevice(m_pendingSinks, info.index);
 }
 
-void AudioControl::onPulseSourcesChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info)
+void AudioControl::onPulseSourcesChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info)
 {
     if (info.eventType == IAudioControlBackend::EventType::Add)
-        m_sourcesModel->addDevice(std::move(info.ptr));
+    {
+        m_pendingSources.push_back(info.ptr);
+        scheduleDevicesFlush();
+    }
+    else if (info.eventType == IAudioControlBackend::EventType::Delete)
+        RemovePendingDevice(m_pendingSources, info.index);
+}
+
+void AudioControl::onPulseSinkInputsChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info)
+{
+    if (info.eventType == IAudioControlBackend::EventType::Add)
+        scheduleDevicesFlush();
+
+    OnPulseDeviceChanged(info.eventType, info.index, info.ptr, m_pendingSinkInputs);
+}
+
+void AudioControl::onPulseSourcesOutputsChanged(const IAudioControlBackend::OnSignalMapChangeSignalInfo& info)
+{
+    if (info.eventType == IAudioControlBackend::EventType::Add)
+        scheduleDevicesFlush();
+
+    OnPulseDeviceChanged(info.eventType, info.index, info.ptr, m_pendingSourceOutputs);
+}
+
+void AudioControl::scheduleDevicesFlush()
+{
+    if (m_pendingDevicesFlush.connected())
+        return;
+
+    m_pendingDevicesFlush = Glib::signal_idle().connect(
+        [this]
+        {
+            flushPendingDevices();
+            return false;
+        },
+        AddedDevicesPriority);
 }
 
-void AudioControl::onPulseSinkInputsChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info)
+void AudioControl::flushPendingDevices()
 {
-    OnPulseDeviceChanged(info.eventType, info.index, std::move(info.ptr), m_appList);
+    m_pendingDevicesFlush.disconnect();
+
+    if (!m_pendingSinks.empty())
+        m_sinksModel->addDevices(std::exchange(m_pendingSinks, {}));
+
+    if (!m_pendingSources.empty())
+        m_sourcesModel->addDevices(std::exchange(m_pendingSources, {}));
+
+    if (!m_pendingSinkInputs.empty())
+        m_appList.addDevices(std::exchange(m_pendingSinkInputs, {}));
+
+    if (!m_pendingSourceOutputs.empty())
+        m_appMicrophones.addDevices(std::exchange(m_pendingSourceOutputs, {}));
 }
 
-void AudioControl::onPulseSourcesOutputsChanged(IAudioControlBackend::OnSignalMapChangeSignalInfo info)
+void AudioControl::onPulseStateChange(IAudioControlBackend::State state)
 {
-    OnPulseDeviceChanged(info.eventType, info.index, std::move(info.ptr), m_appList);
+    // The stale devices can't be changed, there is no server to send the changes to
+    const bool isReconnecting = state == IAudioControlBackend::State::Reconnecting;
+
+    m_reconnectingLabel.set_visible(isReconnecting);
+
+    m_sinks.set_sensitive(!isReconnecting);
+    m_sources.set_sensitive(!isReconnecting);
+    m_appList.set_sensitive(!isReconnecting);
+    m_appMicrophones.set_sensitive(!isReconnecting);
+}
+
+void AudioControl::onPulsePeaks(const std::vector<IAudioControlBackend::PeakLevel>& levels)
+{
+    m_sinksModel->updatePeaks(levels);
+    m_appList.updatePeaks(levels);
 }
 
 void AudioControl::onPulseError(std::string_view error)
 {
+    // Only the view goes: the backend is shared with the other consumers, and its owner decides whether to stop it
     m_connections.clear();
-    m_audioControl->stop();
+
+    m_pendingDevicesFlush.disconnect();
+    m_pendingSinks.clear();
+    m_pendingSources.clear();
+    m_pendingSinkInputs.clear();
+    m_pendingSourceOutputs.clear();
 
     Logger::error(error);
 
     m_appList.removeAllApps();
     remove(m_appList);
 
+    m_appMicrophones.removeAllApps();
+    remove(m_appMicrophones);
+
     auto* errorLabel = Gtk::make_managed<Gtk::Label>();
     errorLabel->set_label(error.data());
     errorLabel->show_all();
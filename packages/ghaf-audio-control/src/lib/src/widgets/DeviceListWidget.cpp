@@ -8,7 +8,6 @@
 #include <GhafAudioControl/Backends/PulseAudio/SinkInput.hpp>
 #include <GhafAudioControl/utils/Debug.hpp>
 #include <GhafAudioControl/utils/Logger.hpp>
-#include <GhafAudioControl/widgets/DeviceWidget.hpp>
 
 #include <gtkmm/adjustment.h>
 #include <gtkmm/button.h>
@@ -35,27 +34,9 @@ constexpr auto CharacterDown = " ∨";
 constexpr auto RevealerTransitionType = Gtk::RevealerTransitionType::REVEALER_TRANSITION_TYPE_SLIDE_DOWN;
 constexpr auto RevealerAnimationTimeMs = 2000;
 
-Gtk::Widget* CreateDeviceWidget(const Glib::RefPtr<Glib::Object>& deviceModelPtr)
-{
-    if (!deviceModelPtr)
-    {
-        Logger::error("DeviceListWidget: deviceModelPtr is nullptr");
-        return nullptr;
-    }
-
-    auto deviceModel = Glib::RefPtr<DeviceModel>::cast_dynamic<Glib::Object>(deviceModelPtr);
-    if (!deviceModel)
-    {
-        Logger::error("DeviceListWidget: deviceModel is not an AppVmModel");
-        return nullptr;
-    }
-
-    return Gtk::make_managed<DeviceWidget>(deviceModel);
-}
-
 } // namespace
 
-DeviceListWidget::DeviceListWidget(Glib::RefPtr<DeviceListModel> model)
+DeviceListWidget::DeviceListWidget(Glib::RefPtr<DeviceListModel> model, bool isRevealed)
     : Gtk::Box(Gtk::Orientation::ORIENTATION_VERTICAL)
     , m_model(std::move(model))
     , m_revealerBox(Gtk::Orientation::ORIENTATION_VERTICAL)
@@ -67,13 +48,17 @@ DeviceListWidget::DeviceListWidget(Glib::RefPtr<DeviceListModel> model)
     m_emptyListLabel.set_name("EmptyListName");
     m_emptyListLabel.set_halign(Gtk::Align::ALIGN_FILL);
 
+    // Follows the list, whatever the owners show
+    m_emptyListLabel.set_no_show_all(true);
+    updateEmptyListLabel();
+
     m_revealerBox.pack_start(m_emptyListLabel);
-    m_revealerBox.pack_end(m_listBox);
+    m_revealerBox.pack_end(m_rows);
 
     m_revealer.add(m_revealerBox);
     m_revealer.set_transition_type(RevealerTransitionType);
     m_revealer.set_transition_duration(RevealerAnimationTimeMs);
-    m_revealer.set_reveal_child();
+    m_revealer.set_reveal_child(isRevealed);
 
     m_appNameButton.set_name("AppVmNameButton");
     m_appNameButton.set_label(getName());
@@ -83,14 +68,29 @@ DeviceListWidget::DeviceListWidget(Glib::RefPtr<DeviceListModel> model)
     pack_start(m_appNameButton);
     pack_start(m_revealer);
 
-    m_listBox.bind_model(m_model->getDeviceModels(), &CreateDeviceWidget);
-    m_listBox.set_can_focus(false);
-    m_listBox.set_selection_mode(Gtk::SelectionMode::SELECTION_SINGLE);
+    m_rows.set_can_focus(false);
+
+    if (isRevealed)
+        bindModel();
+}
+
+void DeviceListWidget::bindModel()
+{
+    if (m_isModelBound)
+        return;
+
+    m_rows.bindModel(m_model->getDeviceModels());
+    m_isModelBound = true;
 }
 
 void DeviceListWidget::onDeviceChange([[maybe_unused]] guint position, [[maybe_unused]] guint removed, [[maybe_unused]] guint added)
 {
-    Glib::signal_idle().connect_once([this]() { m_emptyListLabel.set_visible(m_model->getDeviceModels()->get_n_items() == 0); }, Glib::PRIORITY_DEFAULT);
+    Glib::signal_idle().connect_once([this]() { updateEmptyListLabel(); }, Glib::PRIORITY_DEFAULT);
+}
+
+void DeviceListWidget::updateEmptyListLabel()
+{
+    m_emptyListLabel.set_visible(m_model->getDeviceModels()->get_n_items() == 0);
 }
 
 std::string DeviceListWidget::getName() const
@@ -109,6 +109,9 @@ void DeviceListWidget::reveal(bool reveal)
 {
     CheckUiThread();
 
+    if (reveal)
+        bindModel();
+
     m_revealer.set_reveal_child(reveal);
     m_appNameButton.set_label(getName());
 }
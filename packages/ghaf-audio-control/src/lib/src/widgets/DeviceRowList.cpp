@@ -0,0 +1,166 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/widgets/DeviceRowList.hpp>
+
+#include <GhafAudioControl/utils/ScopeExit.hpp>
+
+#include <gtkmm/adjustment.h>
+
+#include <glibmm/main.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ghaf::AudioControl
+{
+
+namespace
+{
+
+// Before GTK lays out and draws the frame, so the rows of the added devices are in it
+constexpr auto LayoutPriority = Glib::PRIORITY_HIGH_IDLE;
+
+// Tells how many rows are in the viewport till the first row is measured
+constexpr auto DefaultRowHeight = 40;
+
+} // namespace
+
+DeviceRowList::DeviceRowList()
+    : m_connections{get_vadjustment()->signal_value_changed().connect(sigc::mem_fun(*this, &DeviceRowList::layoutRows)),
+                    get_vadjustment()->signal_changed().connect(sigc::mem_fun(*this, &DeviceRowList::scheduleLayout))}
+{
+    set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    set_shadow_type(Gtk::SHADOW_NONE);
+
+    add(m_layout);
+}
+
+DeviceRowList::~DeviceRowList()
+{
+    m_modelChanges.disconnect();
+    m_pendingLayout.disconnect();
+}
+
+void DeviceRowList::bindModel(Glib::RefPtr<Gio::ListStore<DeviceModel>> models)
+{
+    m_modelChanges.disconnect();
+    m_models = std::move(models);
+
+    if (m_models)
+    {
+        m_modelChanges = m_models->signal_items_changed().connect([this]([[maybe_unused]] guint position, [[maybe_unused]] guint removed,
+                                                                         [[maybe_unused]] guint added) { scheduleLayout(); });
+    }
+
+    layoutRows();
+}
+
+void DeviceRowList::scheduleLayout()
+{
+    if (m_pendingLayout.connected())
+        return;
+
+    m_pendingLayout = Glib::signal_idle().connect(
+        [this]
+        {
+            layoutRows();
+            return false;
+        },
+        LayoutPriority);
+}
+
+void DeviceRowList::layoutRows()
+{
+    // The size set below may move the scroll position, which comes back here
+    if (m_isLayingOut)
+    {
+        scheduleLayout();
+        return;
+    }
+
+    m_isLayingOut = true;
+    const ScopeExit laidOut{[this] { m_isLayingOut = false; }};
+
+    m_pendingLayout.disconnect();
+
+    const guint count = m_models ? m_models->get_n_items() : 0;
+    const int rowHeight = m_rowHeight != 0 ? m_rowHeight : DefaultRowHeight;
+
+    const auto adjustment = get_vadjustment();
+    const double pageSize = adjustment->get_page_size() > 0.0 ? adjustment->get_page_size() : static_cast<double>(MaxVisibleRows) * rowHeight;
+
+    // The last row in the viewport may be seen in part only
+    const guint first = std::min(static_cast<guint>(adjustment->get_value() / rowHeight), count);
+    const guint shown = std::min(static_cast<guint>(std::ceil(pageSize / rowHeight)) + 1, count - first);
+
+    // A device keeps its slot while it stays in the viewport, so a scroll by a row rebinds one row only
+    const size_t poolSize = std::max<size_t>(m_rows.size(), shown);
+    m_rows.resize(poolSize, nullptr);
+
+    std::vector<bool> isSlotUsed(poolSize, false);
+    int tallestRow = m_rowHeight;
+
+    for (guint index = first; index < first + shown; ++index)
+    {
+        const size_t slot = index % poolSize;
+        isSlotUsed[slot] = true;
+
+        DeviceWidget& row = getRow(slot, m_models->get_item(index));
+        m_layout.move(row, 0, static_cast<int>(index) * rowHeight);
+        row.show();
+
+        int minimum = 0;
+        int natural = 0;
+
+        row.get_preferred_height(minimum, natural);
+        tallestRow = std::max(tallestRow, minimum);
+
+        row.get_preferred_width(minimum, natural);
+        m_rowWidth = std::max(m_rowWidth, minimum);
+    }
+
+    // The rows out of the viewport let their devices go
+    for (size_t slot = 0; slot < poolSize; ++slot)
+    {
+        if (!isSlotUsed[slot] && m_rows[slot] != nullptr)
+        {
+            m_rows[slot]->hide();
+            m_rows[slot]->setModel({});
+        }
+    }
+
+    set_min_content_width(m_rowWidth);
+    set_min_content_height(static_cast<int>(std::min(count, MaxVisibleRows)) * rowHeight);
+    m_layout.set_size(static_cast<guint>(m_rowWidth), count * static_cast<guint>(rowHeight));
+
+    // A taller row, e.g. with a peak meter, moves the rows apart in the next pass
+    if (tallestRow != m_rowHeight)
+    {
+        m_rowHeight = tallestRow;
+        scheduleLayout();
+    }
+}
+
+DeviceWidget& DeviceRowList::getRow(size_t slot, DeviceModel::Ptr model)
+{
+    if (DeviceWidget* row = m_rows[slot])
+    {
+        row->setModel(std::move(model));
+        return *row;
+    }
+
+    auto* row = Gtk::make_managed<DeviceWidget>(std::move(model));
+
+    // Shown and hidden here only, whatever the owners show
+    row->set_no_show_all(true);
+
+    m_layout.put(*row, 0, 0);
+    m_rows[slot] = row;
+
+    return *row;
+}
+
+} // namespace ghaf::AudioControl
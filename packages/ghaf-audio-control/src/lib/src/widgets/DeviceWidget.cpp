@@ -26,6 +26,8 @@ constexpr auto DeviceWidgetSpacing = 5;
 
 constexpr auto NameLabelLeftMargin = 20;
 
+constexpr auto PeakBarHeight = 4;
+
 auto Bind(const auto& appProp, const auto& widgetProp, bool readonly = false)
 {
     auto flag = Glib::BindingFlags::BINDING_SYNC_CREATE;
@@ -46,6 +48,20 @@ Gtk::Scale* MakeScaleWidget()
     return scale;
 }
 
+Gtk::LevelBar* MakePeakBarWidget()
+{
+    auto* bar = Gtk::make_managed<Gtk::LevelBar>();
+    bar->set_min_value(0.0);
+    bar->set_max_value(1.0);
+    bar->set_mode(Gtk::LEVEL_BAR_MODE_CONTINUOUS);
+    bar->set_size_request(ScaleSize, PeakBarHeight);
+
+    // Shown by the binding, once the device has a level
+    bar->set_no_show_all(true);
+
+    return bar;
+}
+
 } // namespace
 
 DeviceWidget::DeviceWidget(DeviceModel::Ptr model)
@@ -55,11 +71,10 @@ DeviceWidget::DeviceWidget(DeviceModel::Ptr model)
     , m_nameLabel(Gtk::make_managed<Gtk::Label>())
     , m_switch(Gtk::make_managed<Gtk::Switch>())
     , m_scale(MakeScaleWidget())
-    , m_bindings({Bind(m_model->getIsDefaultProperty(), m_defaultButton->property_active()),
-                  Bind(m_model->getNameProperty(), m_nameLabel->property_label(), true),
-                  Bind(m_model->getSoundVolumeProperty(), m_scale->get_adjustment()->property_value()),
-                  Bind(m_model->getSoundEnabledProperty(), m_switch->property_state())})
+    , m_peakBar(MakePeakBarWidget())
 {
+    bindModel();
+
     const auto setup = [](Gtk::Widget& widget)
     {
         widget.set_hexpand(false);
@@ -77,20 +92,68 @@ DeviceWidget::DeviceWidget(DeviceModel::Ptr model)
     setup(*m_switch);
     setup(*m_scale);
 
+    // The meter is under the slider, as wide as it
+    auto* volumeBox = Gtk::make_managed<Gtk::Box>(Gtk::ORIENTATION_VERTICAL);
+    volumeBox->pack_start(*m_scale);
+    volumeBox->pack_start(*m_peakBar);
+    setup(*volumeBox);
+
     // pack_start(*m_defaultButton);
     pack_start(*m_nameLabel);
     pack_start(*m_switch);
-    pack_start(*m_scale);
+    pack_start(*volumeBox);
 
     m_nameLabel->set_margin_left(NameLabelLeftMargin);
     m_nameLabel->set_max_width_chars(50);
     m_nameLabel->set_ellipsize(Pango::ELLIPSIZE_END);
 
     m_switch->set_halign(Gtk::Align::ALIGN_END);
-    m_scale->set_halign(Gtk::Align::ALIGN_END);
+    volumeBox->set_halign(Gtk::Align::ALIGN_END);
 
     set_valign(Gtk::ALIGN_CENTER);
     show_all_children();
+
+    // The children are managed, so they go with the row
+    size_t size = sizeof(DeviceWidget) + GetInstanceSize(*this) + sizeof(Gtk::Box) + GetInstanceSize(*volumeBox);
+    size += sizeof(Gtk::CheckButton) + GetInstanceSize(*m_defaultButton) + sizeof(Gtk::Label) + GetInstanceSize(*m_nameLabel);
+    size += sizeof(Gtk::Switch) + GetInstanceSize(*m_switch) + sizeof(Gtk::Scale) + GetInstanceSize(*m_scale);
+    size += sizeof(Gtk::LevelBar) + GetInstanceSize(*m_peakBar);
+
+    for (const auto& binding : m_bindings)
+    {
+        if (binding)
+            size += sizeof(Glib::Binding) + GetInstanceSize(*binding.get());
+    }
+
+    m_memory.resize(size);
+}
+
+void DeviceWidget::setModel(DeviceModel::Ptr model)
+{
+    if (model == m_model)
+        return;
+
+    for (const auto& binding : m_bindings)
+    {
+        if (binding)
+            binding->unbind();
+    }
+
+    m_bindings.clear();
+    m_model = std::move(model);
+
+    if (m_model)
+        bindModel();
+}
+
+void DeviceWidget::bindModel()
+{
+    m_bindings = {Bind(m_model->getIsDefaultProperty(), m_defaultButton->property_active()),
+                  Bind(m_model->getNameProperty(), m_nameLabel->property_label(), true),
+                  Bind(m_model->getSoundVolumeProperty(), m_scale->get_adjustment()->property_value()),
+                  Bind(m_model->getSoundEnabledProperty(), m_switch->property_state()),
+                  Bind(m_model->getPeakProperty(), m_peakBar->property_value(), true),
+                  Bind(m_model->getHasPeakProperty(), m_peakBar->property_visible(), true)};
 }
 
 } // namespace ghaf::AudioControl
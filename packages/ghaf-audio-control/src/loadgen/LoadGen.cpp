@@ -0,0 +1,487 @@
+/*
+ * Copyright 2022-2024 TII (SSRC) and the Ghaf contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <GhafAudioControl/utils/Logger.hpp>
+#include <GhafAudioControl/utils/UniqueHandle.hpp>
+
+#include <giomm/dbusconnection.h>
+#include <giomm/init.h>
+#include <glibmm/main.h>
+#include <glibmm/optioncontext.h>
+#include <glibmm/optionentry.h>
+#include <glibmm/optiongroup.h>
+
+#include <pulse/context.h>
+#include <pulse/glib-mainloop.h>
+#include <pulse/introspect.h>
+#include <pulse/proplist.h>
+#include <pulse/stream.h>
+#include <pulse/volume.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace ghaf::AudioControl;
+
+namespace
+{
+
+namespace AudioControlService
+{
+
+constexpr auto ServiceName = "org.ghaf.Audio";
+constexpr auto ObjectPath = "/org/ghaf/Audio";
+constexpr auto InterfaceName = "org.ghaf.Audio";
+
+constexpr auto DeviceUpdatedSignalName = "DeviceUpdated";
+
+// The DeviceType and the EventType values of the DeviceUpdated signal
+constexpr int SinkInputType = 2;
+constexpr int UpdateEvent = 1;
+
+} // namespace AudioControlService
+
+constexpr auto TickInterval = std::chrono::milliseconds{10};
+
+// The service lists the new streams before the churn starts, and sends the last changes before the report
+constexpr auto SettleTime = std::chrono::seconds{1};
+constexpr auto DrainTime = std::chrono::seconds{2};
+
+constexpr pa_sample_spec SampleSpec{.format = PA_SAMPLE_S16LE, .rate = 48000, .channels = 2};
+
+struct Options
+{
+    Glib::ustring server; // The default server if empty
+    int streams = 10;
+    double volumeRate = 50.0; // Changes per second, over all the streams
+    double muteRate = 5.0;
+    int duration = 10; // Seconds
+};
+
+struct ContextDeleter final
+{
+    void operator()(pa_context* context) const noexcept
+    {
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+    }
+};
+
+struct StreamDeleter final
+{
+    void operator()(pa_stream* stream) const noexcept
+    {
+        pa_stream_disconnect(stream);
+        pa_stream_unref(stream);
+    }
+};
+
+using MainloopHandle = UniqueHandle<pa_glib_mainloop, FunctionDeleter<pa_glib_mainloop_free>>;
+using ContextHandle = UniqueHandle<pa_context, ContextDeleter>;
+using StreamHandle = UniqueHandle<pa_stream, StreamDeleter>;
+using ProplistHandle = UniqueHandle<pa_proplist, FunctionDeleter<pa_proplist_free>>;
+
+// A corked playback stream of an AppVM of its own: the service shows it as a stream of that AppVM, with its own name
+struct FakeStream
+{
+    std::string name;
+    StreamHandle stream;
+    uint32_t index = PA_INVALID_INDEX; // Of the sink input, once the stream is ready
+
+    int volume = 50; // In percents
+    bool isMuted = false;
+
+    // The first change not seen on the bus yet. The service may coalesce several changes into one signal
+    std::optional<std::chrono::steady_clock::time_point> pendingSince;
+};
+
+[[nodiscard]] std::chrono::microseconds GetPercentile(const std::vector<std::chrono::microseconds>& sorted, double share)
+{
+    if (sorted.empty())
+        return std::chrono::microseconds::zero();
+
+    const auto rank = static_cast<size_t>(std::ceil(share * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+[[nodiscard]] double ToMilliseconds(std::chrono::microseconds latency)
+{
+    return std::chrono::duration<double, std::milli>(latency).count();
+}
+
+// Churns the volumes and the mutes of the fake streams and measures the time from a change sent to the server till the
+// DeviceUpdated signal of the service, for the change. The signal is matched by the stream name, which is unique
+class LoadGenerator final
+{
+public:
+    LoadGenerator(const Options& options, Glib::RefPtr<Glib::MainLoop> loop)
+        : m_options(options)
+        , m_loop(std::move(loop))
+        , m_mainloop(pa_glib_mainloop_new(nullptr))
+        , m_context(pa_context_new(pa_glib_mainloop_get_api(m_mainloop.get()), "GhafAudioControlLoadGen"))
+    {
+        if (!m_context)
+            throw std::runtime_error("pa_context_new() failed");
+
+        m_bus = Gio::DBus::Connection::get_sync(Gio::DBus::BUS_TYPE_SESSION);
+        m_subscriptionId = m_bus->signal_subscribe(sigc::mem_fun(*this, &LoadGenerator::onDeviceUpdated),
+                                                   AudioControlService::ServiceName,
+                                                   AudioControlService::InterfaceName,
+                                                   AudioControlService::DeviceUpdatedSignalName,
+                                                   AudioControlService::ObjectPath);
+    }
+
+    ~LoadGenerator()
+    {
+        m_tick.disconnect();
+        m_bus->signal_unsubscribe(m_subscriptionId);
+
+        // The disconnects below are no failures
+        pa_context_set_state_callback(m_context.get(), nullptr, nullptr);
+
+        for (FakeStream& fake : m_streams)
+        {
+            if (fake.stream)
+                pa_stream_set_state_callback(fake.stream.get(), nullptr, nullptr);
+        }
+
+        // Before the context they belong to
+        m_streams.clear();
+    }
+
+    LoadGenerator(const LoadGenerator&) = delete;
+    LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+    void start()
+    {
+        pa_context_set_state_callback(m_context.get(), OnContextState, this);
+
+        if (pa_context_connect(m_context.get(), m_options.server.empty() ? nullptr : m_options.server.c_str(), PA_CONTEXT_NOFAIL, nullptr) < 0)
+            fail(std::format("couldn't connect to the server: {}", pa_strerror(pa_context_errno(m_context.get()))));
+    }
+
+    [[nodiscard]] bool hasFailed() const noexcept
+    {
+        return m_hasFailed;
+    }
+
+    void report() const
+    {
+        auto latencies = m_latencies;
+        std::ranges::sort(latencies);
+
+        const auto unseen = std::ranges::count_if(m_streams, [](const FakeStream& stream) { return stream.pendingSince.has_value(); });
+
+        std::cout << std::format("{} streams, {} volume and {} mute changes in {} s\n", m_streams.size(), m_volumeChanges, m_muteChanges, m_options.duration);
+        std::cout << std::format("{} changes seen on the bus, {} streams with changes not seen\n", latencies.size(), unseen);
+        std::cout << std::format("{:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "ms", "p50", "p90", "p99", "p99.9", "max");
+        std::cout << std::format("{:>10} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f}\n",
+                                 "latency",
+                                 ToMilliseconds(GetPercentile(latencies, 0.5)),
+                                 ToMilliseconds(GetPercentile(latencies, 0.9)),
+                                 ToMilliseconds(GetPercentile(latencies, 0.99)),
+                                 ToMilliseconds(GetPercentile(latencies, 0.999)),
+                                 ToMilliseconds(latencies.empty() ? std::chrono::microseconds::zero() : latencies.back()));
+    }
+
+private:
+    static void OnContextState(pa_context* context, void* userdata)
+    {
+        auto* self = static_cast<LoadGenerator*>(userdata);
+
+        switch (pa_context_get_state(context))
+        {
+        case PA_CONTEXT_READY:
+            self->createStreams();
+            break;
+
+        case PA_CONTEXT_FAILED:
+        case PA_CONTEXT_TERMINATED:
+            self->fail(std::format("the connection has been lost: {}", pa_strerror(pa_context_errno(context))));
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    static void OnStreamState(pa_stream* stream, void* userdata)
+    {
+        auto* self = static_cast<LoadGenerator*>(userdata);
+
+        switch (pa_stream_get_state(stream))
+        {
+        case PA_STREAM_READY:
+            self->onStreamReady(stream);
+            break;
+
+        case PA_STREAM_FAILED:
+            self->fail(std::format("a stream has failed: {}", pa_strerror(pa_context_errno(self->m_context.get()))));
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void createStreams()
+    {
+        Logger::info("LoadGenerator: connected, creating {} streams", m_options.streams);
+
+        m_streams.resize(static_cast<size_t>(m_options.streams));
+
+        for (size_t i = 0; i < m_streams.size(); ++i)
+        {
+            FakeStream& fake = m_streams[i];
+            fake.name = std::format("ghaf-loadgen-{}", i);
+
+            const ProplistHandle proplist{pa_proplist_new()};
+            pa_proplist_sets(proplist.get(), PA_PROP_APPLICATION_NAME, "GhafAudioControlLoadGen");
+            pa_proplist_sets(proplist.get(), "application.process.host", std::format("loadvm-{}", i).c_str());
+
+            fake.stream.reset(pa_stream_new_with_proplist(m_context.get(), fake.name.c_str(), &SampleSpec, nullptr, proplist.get()));
+            if (!fake.stream)
+            {
+                fail(std::format("couldn't create a stream: {}", pa_strerror(pa_context_errno(m_context.get()))));
+                return;
+            }
+
+            m_streamsByName.emplace(fake.name, i);
+
+            // Corked, as nothing is played: the sink input exists all the same
+            pa_stream_set_state_callback(fake.stream.get(), OnStreamState, this);
+            if (pa_stream_connect_playback(fake.stream.get(), nullptr, nullptr, PA_STREAM_START_CORKED, nullptr, nullptr) < 0)
+            {
+                fail(std::format("couldn't connect a stream: {}", pa_strerror(pa_context_errno(m_context.get()))));
+                return;
+            }
+        }
+    }
+
+    void onStreamReady(pa_stream* stream)
+    {
+        const auto fake = std::ranges::find(m_streams, stream, [](const FakeStream& item) { return item.stream.get(); });
+        if (fake == m_streams.end() || fake->index != PA_INVALID_INDEX)
+            return;
+
+        fake->index = pa_stream_get_index(stream);
+
+        if (++m_readyStreams < m_streams.size())
+            return;
+
+        Logger::info("LoadGenerator: all the streams are ready, churning for {} s", m_options.duration);
+
+        Glib::signal_timeout().connect_once(
+            [this]
+            {
+                m_churnStart = std::chrono::steady_clock::now();
+                m_tick = Glib::signal_timeout().connect(sigc::mem_fun(*this, &LoadGenerator::onTick), TickInterval.count());
+            },
+            std::chrono::duration_cast<std::chrono::milliseconds>(SettleTime).count());
+    }
+
+    // The changes due by now at the given rate are sent all at once, so the rates higher than the tick rate are kept as well
+    bool onTick()
+    {
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_churnStart);
+        const bool isDone = elapsed.count() >= m_options.duration;
+        const double seconds = std::min(elapsed.count(), static_cast<double>(m_options.duration));
+
+        for (const auto due = static_cast<size_t>(m_options.volumeRate * seconds); m_volumeChanges < due; ++m_volumeChanges)
+            changeVolume(nextStream());
+
+        for (const auto due = static_cast<size_t>(m_options.muteRate * seconds); m_muteChanges < due; ++m_muteChanges)
+            changeMute(nextStream());
+
+        if (!isDone)
+            return true;
+
+        Logger::info("LoadGenerator: done, waiting for the last signals");
+        Glib::signal_timeout().connect_once([this] { m_loop->quit(); }, std::chrono::duration_cast<std::chrono::milliseconds>(DrainTime).count());
+
+        return false;
+    }
+
+    [[nodiscard]] FakeStream& nextStream() noexcept
+    {
+        return m_streams[m_nextStream++ % m_streams.size()];
+    }
+
+    // Steps through 10..90 percents, so every change is visible in the percents the service sends
+    void changeVolume(FakeStream& fake)
+    {
+        fake.volume = 10 + (fake.volume - 10 + 7) % 81;
+
+        pa_cvolume volume;
+        pa_cvolume_set(&volume, SampleSpec.channels, static_cast<pa_volume_t>(PA_VOLUME_NORM * static_cast<uint64_t>(fake.volume) / 100));
+
+        send(fake, pa_context_set_sink_input_volume(m_context.get(), fake.index, &volume, nullptr, nullptr));
+    }
+
+    void changeMute(FakeStream& fake)
+    {
+        fake.isMuted = !fake.isMuted;
+        send(fake, pa_context_set_sink_input_mute(m_context.get(), fake.index, fake.isMuted ? 1 : 0, nullptr, nullptr));
+    }
+
+    void send(FakeStream& fake, pa_operation* operation)
+    {
+        if (operation == nullptr)
+        {
+            Logger::error("LoadGenerator: couldn't send a change of the stream: {}: {}", fake.name, pa_strerror(pa_context_errno(m_context.get())));
+            return;
+        }
+
+        pa_operation_unref(operation);
+
+        if (!fake.pendingSince)
+            fake.pendingSince = std::chrono::steady_clock::now();
+    }
+
+    void onDeviceUpdated([[maybe_unused]] const Glib::RefPtr<Gio::DBus::Connection>& connection, [[maybe_unused]] const Glib::ustring& sender,
+                         [[maybe_unused]] const Glib::ustring& objectPath, [[maybe_unused]] const Glib::ustring& interfaceName,
+                         [[maybe_unused]] const Glib::ustring& signalName, const Glib::VariantContainerBase& parameters)
+    {
+        const auto now = std::chrono::steady_clock::now();
+
+        Glib::Variant<int> type;
+        Glib::Variant<Glib::ustring> name;
+        Glib::Variant<int> event;
+
+        parameters.get_child(type, 1);
+        parameters.get_child(name, 2);
+        parameters.get_child(event, 6);
+
+        if (type.get() != AudioControlService::SinkInputType || event.get() != AudioControlService::UpdateEvent)
+            return;
+
+        const auto iter = m_streamsByName.find(name.get().raw());
+        if (iter == m_streamsByName.end())
+            return;
+
+        if (const auto pendingSince = std::exchange(m_streams[iter->second].pendingSince, std::nullopt))
+            m_latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - *pendingSince));
+    }
+
+    void fail(const std::string& reason)
+    {
+        Logger::error("LoadGenerator: {}", reason);
+
+        m_hasFailed = true;
+        m_loop->quit();
+    }
+
+private:
+    const Options m_options;
+    Glib::RefPtr<Glib::MainLoop> m_loop;
+
+    MainloopHandle m_mainloop;
+    ContextHandle m_context;
+
+    Glib::RefPtr<Gio::DBus::Connection> m_bus;
+    guint m_subscriptionId = 0;
+
+    std::vector<FakeStream> m_streams;
+    std::unordered_map<std::string, size_t> m_streamsByName;
+    size_t m_readyStreams = 0;
+    size_t m_nextStream = 0;
+
+    std::chrono::steady_clock::time_point m_churnStart;
+    sigc::connection m_tick;
+    size_t m_volumeChanges = 0;
+    size_t m_muteChanges = 0;
+
+    std::vector<std::chrono::microseconds> m_latencies;
+    bool m_hasFailed = false;
+};
+
+[[nodiscard]] Options ParseOptions(int argc, char** argv)
+{
+    Options options;
+
+    Glib::OptionEntry serverOption;
+    serverOption.set_long_name("server");
+    serverOption.set_description("PulseAudio server address, the default server if omitted");
+
+    Glib::OptionEntry streamsOption;
+    streamsOption.set_long_name("streams");
+    streamsOption.set_description("Number of the fake AppVM streams, 10 by default");
+
+    Glib::OptionEntry volumeRateOption;
+    volumeRateOption.set_long_name("volume_rate");
+    volumeRateOption.set_description("Volume changes per second over all the streams, 50 by default");
+
+    Glib::OptionEntry muteRateOption;
+    muteRateOption.set_long_name("mute_rate");
+    muteRateOption.set_description("Mute changes per second over all the streams, 5 by default");
+
+    Glib::OptionEntry durationOption;
+    durationOption.set_long_name("duration");
+    durationOption.set_description("Seconds of the changes, 10 by default");
+
+    Glib::OptionGroup group{"loadgen", "The load options", "Show the load options"};
+    group.add_entry(serverOption, options.server);
+    group.add_entry(streamsOption, options.streams);
+    group.add_entry(volumeRateOption, options.volumeRate);
+    group.add_entry(muteRateOption, options.muteRate);
+    group.add_entry(durationOption, options.duration);
+
+    Glib::OptionContext context{"- the AppVM streams load for the ghaf-audio-control service"};
+    context.set_main_group(group);
+    context.parse(argc, argv);
+
+    if (options.streams <= 0 || options.duration <= 0 || options.volumeRate < 0.0 || options.muteRate < 0.0)
+        throw std::runtime_error("the streams and the duration must be positive, the rates must not be negative");
+
+    return options;
+}
+
+} // namespace
+
+// GhafAudioControlLoadGen [--server <address>] [--streams <count>] [--volume_rate <per second>] [--mute_rate <per second>] [--duration <seconds>]
+// The service has to run on the session bus, connected to the same server
+int main(int argc, char** argv)
+{
+    Gio::init();
+    Logger::setLevel(Logger::LogLevel::INFO);
+
+    try
+    {
+        const Options options = ParseOptions(argc, argv);
+
+        const auto loop = Glib::MainLoop::create();
+        LoadGenerator generator{options, loop};
+
+        generator.start();
+        loop->run();
+
+        if (generator.hasFailed())
+            return 1;
+
+        generator.report();
+    }
+    catch (const Glib::Error& ex)
+    {
+        std::cerr << "LoadGen has failed: " << ex.what() << '\n';
+        return 1;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "LoadGen has failed: " << ex.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}